@@ -0,0 +1,79 @@
+//===- BlockFrequencyUpdater.h - Incremental BFI/BPI updates ----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the BlockFrequencyUpdater class, which keeps a
+// BlockFrequencyInfo and the BranchProbabilityInfo it was computed from
+// consistent across common CFG edits, without recomputing them.
+//
+// The updates are local: the blocks and edges directly involved in an edit get
+// exact frequencies and probabilities, derived from the frequency that flowed
+// along the edited edges before the edit. Frequencies further downstream are
+// not rescaled, which is the same approximation passes have been making by
+// hand. A pass that reshapes a whole region should recompute instead.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_ANALYSIS_BLOCKFREQUENCYUPDATER_H
+#define LLVM_ANALYSIS_BLOCKFREQUENCYUPDATER_H
+
+#include "llvm/Support/BlockFrequency.h"
+
+namespace llvm {
+
+class BasicBlock;
+class BlockFrequencyInfo;
+class BranchProbabilityInfo;
+
+class BlockFrequencyUpdater {
+public:
+  BlockFrequencyUpdater(BlockFrequencyInfo &BFI, BranchProbabilityInfo &BPI)
+      : BFI(BFI), BPI(BPI) {}
+
+  /// Returns the frequency that flows along the edge from \p Pred to its
+  /// successor number \p SuccIdx.
+  BlockFrequency getEdgeFreq(const BasicBlock *Pred, unsigned SuccIdx) const;
+
+  /// Returns the frequency that flows from \p Pred to \p Succ, summed over
+  /// all the edges between them.
+  BlockFrequency getEdgeFreq(const BasicBlock *Pred,
+                             const BasicBlock *Succ) const;
+
+  /// Update after \p Orig has been split in two, \p NewBB being the tail that
+  /// now holds the original terminator.
+  void splitBlock(const BasicBlock *Orig, const BasicBlock *NewBB);
+
+  /// Update after the edge from \p Pred has been split by inserting \p NewBB,
+  /// so that \p NewBB is now a successor of \p Pred with a single successor.
+  void splitEdge(const BasicBlock *Pred, const BasicBlock *NewBB);
+
+  /// Update after the edge from \p Pred to its successor number \p SuccIdx
+  /// has been redirected from \p OldSucc to a new block. The frequency that
+  /// flowed along the edge moves from \p OldSucc to the new successor.
+  void redirectEdge(const BasicBlock *Pred, unsigned SuccIdx,
+                    const BasicBlock *OldSucc);
+
+  /// Update after \p Clone has been created as a copy of \p Orig, taking
+  /// over \p Freq of the frequency of \p Orig. The terminator of \p Clone must
+  /// have the same successors as the one of \p Orig.
+  void cloneBlock(const BasicBlock *Orig, const BasicBlock *Clone,
+                  BlockFrequency Freq);
+
+  /// Update for merging \p BB into its single predecessor \p Pred, which then
+  /// takes over the terminator of \p BB. This must be called *before* the
+  /// blocks are merged, while the probabilities of \p BB are still available.
+  void mergeBlockIntoPredecessor(const BasicBlock *BB, const BasicBlock *Pred);
+
+private:
+  BlockFrequencyInfo &BFI;
+  BranchProbabilityInfo &BPI;
+};
+
+} // end namespace llvm
+
+#endif // LLVM_ANALYSIS_BLOCKFREQUENCYUPDATER_H
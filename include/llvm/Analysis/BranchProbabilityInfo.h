@@ -14,6 +14,7 @@
 #ifndef LLVM_ANALYSIS_BRANCHPROBABILITYINFO_H
 #define LLVM_ANALYSIS_BRANCHPROBABILITYINFO_H
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseMapInfo.h"
 #include "llvm/ADT/DenseSet.h"
@@ -126,6 +127,20 @@ public:
   void setEdgeProbability(const BasicBlock *Src, unsigned IndexInSuccessors,
                           BranchProbability Prob);
 
+  /// Set the raw probabilities of all the outgoing edges of \p Src at once.
+  ///
+  /// \p Probs must have one entry per successor of \p Src, in successor order,
+  /// and the probabilities must sum up to one.
+  void setEdgeProbability(const BasicBlock *Src,
+                          ArrayRef<BranchProbability> Probs);
+
+  /// Copy the outgoing edge probabilities of \p Src to \p Dst.
+  ///
+  /// This is meant for a \p Dst whose terminator is a clone of the one of
+  /// \p Src, or which has taken over the terminator of \p Src, as happens
+  /// when a block is split or merged into its predecessor.
+  void copyEdgeProbabilities(const BasicBlock *Src, const BasicBlock *Dst);
+
   static BranchProbability getBranchProbStackProtector(bool IsLikely) {
     static const BranchProbability LikelyProb((1u << 20) - 1, 1u << 20);
     return IsLikely ? LikelyProb : LikelyProb.getCompl();
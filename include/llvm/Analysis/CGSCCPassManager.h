@@ -89,7 +89,10 @@
 #ifndef LLVM_ANALYSIS_CGSCCPASSMANAGER_H
 #define LLVM_ANALYSIS_CGSCCPASSMANAGER_H
 
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/Optional.h"
 #include "llvm/ADT/PriorityWorklist.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallPtrSet.h"
@@ -110,6 +113,7 @@ namespace llvm {
 
 struct CGSCCUpdateResult;
 class Module;
+class ThreadPool;
 
 // Allow debug logging in this inline function.
 #define DEBUG_TYPE "cgscc"
@@ -302,6 +306,38 @@ struct CGSCCUpdateResult {
       &InlinedInternalEdges;
 };
 
+/// Computes function analyses for independent RefSCCs ahead of the post-order
+/// walk over the call graph, using several threads.
+///
+/// The RefSCCs are partitioned into waves with no path between the RefSCCs of
+/// a wave. When the walk first reaches a RefSCC of a wave, no pass has changed
+/// the functions of that wave yet, so their dominator trees and loop info are
+/// computed concurrently and cached in the function analysis manager. Only
+/// analyses which just read the IR are run concurrently: passes would race on
+/// the use lists of constants and on the uniquing tables of the context. The
+/// results are cached in a fixed order and do not depend on the number of
+/// threads.
+class CGSCCAnalysisPrefetcher {
+public:
+  CGSCCAnalysisPrefetcher(LazyCallGraph &CG, FunctionAnalysisManager &FAM);
+  ~CGSCCAnalysisPrefetcher();
+
+  /// Returns true if -cgscc-prefetch-threads requests prefetching.
+  static bool isEnabled();
+
+  /// Compute the analyses of the functions in the wave of \p RC, unless that
+  /// has been done already. RefSCCs in \p InvalidRefSCCs are skipped.
+  void prefetch(LazyCallGraph::RefSCC &RC,
+                const SmallPtrSetImpl<LazyCallGraph::RefSCC *> &InvalidRefSCCs);
+
+private:
+  FunctionAnalysisManager &FAM;
+  std::unique_ptr<ThreadPool> Pool;
+  SmallVector<SmallVector<LazyCallGraph::RefSCC *, 4>, 4> Waves;
+  DenseMap<LazyCallGraph::RefSCC *, unsigned> WaveIndices;
+  BitVector PrefetchedWaves;
+};
+
 /// The core module pass which does a post-order walk of the SCCs and
 /// runs a CGSCC pass over each one.
 ///
@@ -366,6 +402,10 @@ public:
 
     PreservedAnalyses PA = PreservedAnalyses::all();
     CG.buildRefSCCs();
+    Optional<CGSCCAnalysisPrefetcher> Prefetcher;
+    if (CGSCCAnalysisPrefetcher::isEnabled())
+      Prefetcher.emplace(
+          CG, AM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager());
     for (auto RCI = CG.postorder_ref_scc_begin(),
               RCE = CG.postorder_ref_scc_end();
          RCI != RCE;) {
@@ -382,6 +422,8 @@ public:
       //
       // We also eagerly increment the iterator to the next position because
       // the CGSCC passes below may delete the current RefSCC.
+      if (Prefetcher)
+        Prefetcher->prefetch(*RCI, InvalidRefSCCSet);
       RCWorklist.insert(&*RCI++);
 
       do {
@@ -0,0 +1,89 @@
+//===- CompileTimeBudget.h - Per-function compile-time budget ---*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the CompileTimeBudget class, a per-function budget that
+// expensive passes share to bound the worst-case compile time of a single
+// function.
+//
+// The budget is counted in abstract work units rather than wall-clock time so
+// that the decisions made by the passes are deterministic. Passes charge the
+// budget roughly one unit per IR entity they visit, and once it is exhausted
+// they are expected to degrade gracefully: skip optional work, stop iterating
+// to a fixed point, or bail out entirely. A missed-optimization remark is
+// emitted whenever a pass degrades.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_ANALYSIS_COMPILETIMEBUDGET_H
+#define LLVM_ANALYSIS_COMPILETIMEBUDGET_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/PassManager.h"
+#include <cstdint>
+
+namespace llvm {
+
+class Function;
+class OptimizationRemarkEmitter;
+
+/// A budget of work units shared by the passes run over one function.
+class CompileTimeBudget {
+public:
+  /// Construct a budget of \p Limit units. A limit of zero means the budget
+  /// is unlimited and never becomes exhausted.
+  explicit CompileTimeBudget(uint64_t Limit) : Limit(Limit) {}
+
+  bool isUnlimited() const { return Limit == 0; }
+  bool isExhausted() const { return !isUnlimited() && Used >= Limit; }
+
+  uint64_t getLimit() const { return Limit; }
+  uint64_t getUsed() const { return Used; }
+
+  /// Charge \p Units of work to the budget. Returns false if the budget is
+  /// exhausted after the charge, in which case the caller should degrade.
+  bool consume(uint64_t Units);
+
+  /// Emit a missed-optimization remark on behalf of \p PassName explaining
+  /// that it degraded on \p F because the budget ran out. \p Action describes
+  /// what the pass does instead, e.g. "skipping PRE".
+  void emitDegradationRemark(OptimizationRemarkEmitter &ORE,
+                             const char *PassName, const Function &F,
+                             StringRef Action) const;
+
+  /// The budget outlives the passes that charge it; it is only dropped along
+  /// with the function itself.
+  bool invalidate(Function &, const PreservedAnalyses &,
+                  FunctionAnalysisManager::Invalidator &) {
+    return false;
+  }
+
+private:
+  uint64_t Limit;
+  uint64_t Used = 0;
+};
+
+/// Analysis pass providing the compile-time budget of a function.
+class CompileTimeBudgetAnalysis
+    : public AnalysisInfoMixin<CompileTimeBudgetAnalysis> {
+  friend AnalysisInfoMixin<CompileTimeBudgetAnalysis>;
+  static AnalysisKey Key;
+
+public:
+  using Result = CompileTimeBudget;
+
+  /// Returns true if -compile-time-budget sets a limit. Passes only request
+  /// the analysis in that case, so that the default pipelines are unchanged.
+  static bool isEnabled();
+
+  CompileTimeBudget run(Function &F, FunctionAnalysisManager &);
+};
+
+} // end namespace llvm
+
+#endif // LLVM_ANALYSIS_COMPILETIMEBUDGET_H
@@ -40,6 +40,7 @@
 #ifndef LLVM_ANALYSIS_DEPENDENCEANALYSIS_H
 #define LLVM_ANALYSIS_DEPENDENCEANALYSIS_H
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallBitVector.h"
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/IR/Instructions.h"
@@ -47,6 +48,7 @@
 
 namespace llvm {
 template <typename T> class ArrayRef;
+  class DataLayout;
   class Loop;
   class LoopInfo;
   class ScalarEvolution;
@@ -925,6 +927,32 @@ template <typename T> class ArrayRef;
                         SmallVectorImpl<Subscript> &Pair);
   }; // class DependenceInfo
 
+  /// LoopDependenceGraph - A sparse view of the memory dependences inside a
+  /// loop nest, built on top of DependenceInfo. Pairs of loads, and pairs of
+  /// accesses to distinct identified objects, are known to be independent
+  /// and never reach the alias query or the subscript tests. The underlying
+  /// object of each access is only looked up once.
+  class LoopDependenceGraph {
+  public:
+    LoopDependenceGraph(DependenceInfo &DI, const Loop &L);
+
+    /// mayDepend - Returns false if Src and Dst are known to be independent
+    /// without running the subscript tests: both are loads, or they access
+    /// distinct identified objects.
+    bool mayDepend(Instruction *Src, Instruction *Dst);
+
+    /// depends - Returns the dependence between Src and Dst, or NULL if there
+    /// is none.
+    std::unique_ptr<Dependence> depends(Instruction *Src, Instruction *Dst);
+
+  private:
+    const Value *getBaseObject(Instruction *I);
+
+    DependenceInfo &DI;
+    const DataLayout &DL;
+    DenseMap<const Instruction *, const Value *> BaseObjects;
+  }; // class LoopDependenceGraph
+
   /// AnalysisPass to compute dependence information in a function
   class DependenceAnalysis : public AnalysisInfoMixin<DependenceAnalysis> {
   public:
@@ -14,9 +14,14 @@
 #ifndef LLVM_ANALYSIS_INLINECOST_H
 #define LLVM_ANALYSIS_INLINECOST_H
 
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/Analysis/AssumptionCache.h"
 #include "llvm/Analysis/CallGraphSCCPass.h"
 #include "llvm/Analysis/OptimizationRemarkEmitter.h"
+#include "llvm/IR/PassManager.h"
 #include <cassert>
 #include <climits>
 
@@ -24,6 +29,7 @@ namespace llvm {
 class AssumptionCacheTracker;
 class BlockFrequencyInfo;
 class CallSite;
+class Constant;
 class DataLayout;
 class Function;
 class ProfileSummaryInfo;
@@ -171,6 +177,10 @@ struct InlineParams {
   /// Threshold to use when the callsite is considered hot.
   Optional<int> HotCallSiteThreshold;
 
+  /// Threshold to use when the callsite is considered hot based on synthetic
+  /// entry counts, which are estimates rather than measurements.
+  Optional<int> SyntheticHotCallSiteThreshold;
+
   /// Threshold to use when the callsite is considered hot relative to function
   /// entry.
   Optional<int> LocallyHotCallSiteThreshold;
@@ -182,6 +192,121 @@ struct InlineParams {
   Optional<bool> ComputeFullInlineCost;
 };
 
+/// Memoized, call-site independent part of the inline cost analysis of a
+/// single callee.
+///
+/// Walking the body of a callee only depends on the callee itself and on what
+/// is known about the actual arguments at the call site: which of them are
+/// constants, which pointers share a base and at what constant offsets, which
+/// ones are caller allocas and which are marked nonnull. The cost analysis
+/// records the result of each walk here keyed by that argument context, so
+/// that the analysis cost is proportional to the number of unique callee and
+/// context pairs rather than to the number of call sites. Thresholds, call
+/// site bonuses and properties of the caller are still computed for every
+/// query.
+///
+/// The recorded results describe the callee body at the time of the walk, so
+/// they have to be dropped whenever the callee changes. In the new pass
+/// manager this is handled by \c InlineCostCacheAnalysis.
+class InlineCostCache {
+public:
+  /// What is known about a single actual argument at a call site.
+  struct ArgInfo {
+    /// The argument itself if it is a constant.
+    Constant *C = nullptr;
+
+    /// Index of the first argument with the same base pointer, or -1 if the
+    /// argument is not a pointer with a known base and constant offset.
+    int BaseArgNo = -1;
+
+    /// Constant offset from the base pointer. Only valid if BaseArgNo != -1.
+    APInt Offset;
+
+    /// The base pointer is an alloca in the caller.
+    bool IsAlloca = false;
+
+    /// The call site marks the argument nonnull.
+    bool IsNonNull = false;
+
+    bool operator==(const ArgInfo &RHS) const {
+      if (C != RHS.C || BaseArgNo != RHS.BaseArgNo ||
+          IsAlloca != RHS.IsAlloca || IsNonNull != RHS.IsNonNull)
+        return false;
+      if (BaseArgNo == -1)
+        return true;
+      return Offset.getBitWidth() == RHS.Offset.getBitWidth() &&
+             Offset == RHS.Offset;
+    }
+    bool operator!=(const ArgInfo &RHS) const { return !(*this == RHS); }
+  };
+
+  /// The outcome of walking the callee body under one argument context.
+  struct BodySummary {
+    /// Set if the walk found a construct which prevents inlining.
+    const char *FailureReason = nullptr;
+    /// The failure was an uninlinable pattern, which is reported as a remark.
+    bool IsUninlinablePattern = false;
+
+    /// Cost accumulated by the walk on top of the call site adjustments.
+    int Cost = 0;
+    uint64_t AllocatedSize = 0;
+    unsigned NumInstructions = 0;
+    unsigned NumVectorInstructions = 0;
+    bool SingleBB = true;
+    bool ContainsNoDuplicateCall = false;
+
+    // Statistics only used for debug output.
+    unsigned NumConstantPtrCmps = 0;
+    unsigned NumConstantPtrDiffs = 0;
+    unsigned NumInstructionsSimplified = 0;
+    unsigned SROACostSavings = 0;
+    unsigned SROACostSavingsLost = 0;
+    int LoadEliminationCost = 0;
+  };
+
+  /// Return the summary recorded for \p Context, or null if there is none.
+  const BodySummary *lookup(ArrayRef<ArgInfo> Context) const;
+
+  /// Record \p Summary as the result of walking the body under \p Context.
+  /// The number of contexts recorded per callee is bounded, further summaries
+  /// are silently dropped.
+  void insert(ArrayRef<ArgInfo> Context, const BodySummary &Summary);
+
+  /// Return the ephemeral values of \p Callee, computing them on first use.
+  const SmallPtrSetImpl<const Value *> &getEphemeralValues(Function &Callee,
+                                                          AssumptionCache &AC);
+
+  /// Drop everything recorded so far.
+  void clear() {
+    Entries.clear();
+    EphValues.clear();
+    HasEphValues = false;
+  }
+
+private:
+  SmallVector<std::pair<SmallVector<ArgInfo, 4>, BodySummary>, 4> Entries;
+  SmallPtrSet<const Value *, 32> EphValues;
+  bool HasEphValues = false;
+};
+
+/// Analysis pass providing an \c InlineCostCache for a function.
+///
+/// The cache is invalidated like any other function analysis whenever the
+/// function is changed by a transformation.
+class InlineCostCacheAnalysis
+    : public AnalysisInfoMixin<InlineCostCacheAnalysis> {
+  friend AnalysisInfoMixin<InlineCostCacheAnalysis>;
+
+  static AnalysisKey Key;
+
+public:
+  using Result = InlineCostCache;
+
+  InlineCostCache run(Function &F, FunctionAnalysisManager &) {
+    return InlineCostCache();
+  }
+};
+
 /// Generate the parameters to tune the inline cost analysis based only on the
 /// commandline options.
 InlineParams getInlineParams();
@@ -213,12 +338,15 @@ int getCallsiteCost(CallSite CS, const DataLayout &DL);
 /// sufficiently low to warrant inlining.
 ///
 /// Also note that calling this function *dynamically* computes the cost of
-/// inlining the callsite. It is an expensive, heavyweight call.
+/// inlining the callsite. It is an expensive, heavyweight call. If \p
+/// CalleeCache is provided, the walk over the callee body is shared with all
+/// other call sites presenting the same argument context.
 InlineCost getInlineCost(
     CallSite CS, const InlineParams &Params, TargetTransformInfo &CalleeTTI,
     std::function<AssumptionCache &(Function &)> &GetAssumptionCache,
     Optional<function_ref<BlockFrequencyInfo &(Function &)>> GetBFI,
-    ProfileSummaryInfo *PSI, OptimizationRemarkEmitter *ORE = nullptr);
+    ProfileSummaryInfo *PSI, OptimizationRemarkEmitter *ORE = nullptr,
+    InlineCostCache *CalleeCache = nullptr);
 
 /// Get an InlineCost with the callee explicitly specified.
 /// This allows you to calculate the cost of inlining a function via a
@@ -230,7 +358,8 @@ getInlineCost(CallSite CS, Function *Callee, const InlineParams &Params,
               TargetTransformInfo &CalleeTTI,
               std::function<AssumptionCache &(Function &)> &GetAssumptionCache,
               Optional<function_ref<BlockFrequencyInfo &(Function &)>> GetBFI,
-              ProfileSummaryInfo *PSI, OptimizationRemarkEmitter *ORE);
+              ProfileSummaryInfo *PSI, OptimizationRemarkEmitter *ORE,
+              InlineCostCache *CalleeCache = nullptr);
 
 /// Minimal filter to detect invalid constructs for inlining.
 bool isInlineViable(Function &Callee);
@@ -959,6 +959,18 @@ public:
     return make_range(postorder_ref_scc_begin(), postorder_ref_scc_end());
   }
 
+  /// Partition the RefSCCs of the graph into waves of independent RefSCCs.
+  ///
+  /// Each RefSCC is placed in the wave following the latest wave which holds
+  /// a RefSCC it has an edge to. There is never a path between two RefSCCs of
+  /// the same wave, so once every earlier wave has been processed the RefSCCs
+  /// of a wave may be processed in any order without violating the bottom-up
+  /// order of the post-order walk. Within a wave the RefSCCs are listed in
+  /// post-order, which keeps the schedule deterministic.
+  ///
+  /// This forms all the RefSCCs of the graph if they are not built yet.
+  void buildRefSCCWaves(SmallVectorImpl<SmallVector<RefSCC *, 4>> &Waves);
+
   /// Lookup a function in the graph which has already been scanned and added.
   Node *lookup(const Function &F) const { return NodeMap.lookup(&F); }
 
@@ -38,6 +38,11 @@ ModuleSummaryIndex buildModuleSummaryIndex(
     std::function<BlockFrequencyInfo *(const Function &F)> GetBFICallback,
     ProfileSummaryInfo *PSI);
 
+/// Compute the structural hash recorded in the summary of \p F, which is zero
+/// if \p F cannot be merged with functions in other modules.
+FunctionStructuralHash computeFunctionStructuralHash(const Module &M,
+                                                     const Function &F);
+
 /// Analysis pass to provide the ModuleSummaryIndex object.
 class ModuleSummaryIndexAnalysis
     : public AnalysisInfoMixin<ModuleSummaryIndexAnalysis> {
@@ -48,6 +48,10 @@ void findDevirtualizableCallsForTypeCheckedLoad(
     SmallVectorImpl<Instruction *> &LoadedPtrs,
     SmallVectorImpl<Instruction *> &Preds, bool &HasNonCallUses,
     const CallInst *CI);
+
+/// Return the pointer at byte offset \p Offset of the constant initializer
+/// \p I of a vtable in module \p M, or null if there is no pointer there.
+Constant *getPointerAtOffset(Constant *I, uint64_t Offset, Module &M);
 }
 
 #endif
@@ -268,6 +268,23 @@ enum GlobalValueSummarySymtabCodes {
   //           n x (typeid, kind, name, numrba,
   //                numrba x (numarg, numarg x arg, kind, info, byte, bit))]
   FS_TYPE_ID = 21,
+  // The structural hash of the function whose summary record follows. Used to
+  // find identical functions in different modules during the thin link.
+  // [hash_high, hash_low]
+  FS_STRUCTURAL_HASH = 22,
+  // Per-module summary of a vtable with type metadata, which also lists the
+  // functions it points to and their offsets.
+  // [valueid, flags, numrefs, numrefs x valueid, numfuncs,
+  //  numfuncs x (valueid, offset), n x offset]
+  // The trailing offsets hold pointers that are not known functions.
+  FS_PERMODULE_VTABLE_GLOBALVAR_INIT_REFS = 23,
+  // The vtable address points compatible with a type identifier.
+  // [typeid, n x (offset, vtable valueid)]
+  FS_TYPE_ID_METADATA = 24,
+  // The synthetic entry count of the function whose combined summary record
+  // follows, computed during the thin link.
+  // [count]
+  FS_ENTRY_COUNT = 25,
 };
 
 enum MetadataCodes {
@@ -409,6 +409,9 @@ inline GlobalValueSummary *GlobalValueSummary::getBaseObject() {
   return this;
 }
 
+/// 128-bit structural hash of a function, as {high, low} halves of its MD5.
+using FunctionStructuralHash = std::array<uint64_t, 2>;
+
 /// Function summary information to aid decisions and implementation of
 /// importing.
 class FunctionSummary : public GlobalValueSummary {
@@ -502,6 +505,19 @@ private:
 
   std::unique_ptr<TypeIdInfo> TIdInfo;
 
+  /// Hash of the function's body and signature, computed so that structurally
+  /// identical functions in different modules hash to the same value. Zero if
+  /// the function was not hashed or is not eligible for cross-module merging.
+  FunctionStructuralHash StructuralHash = {{0, 0}};
+
+  /// The synthetic entry count of the function, computed on the combined
+  /// call graph during the thin link. Zero if no count was computed.
+  uint64_t EntryCount = 0;
+
+  /// The canonical copy of this function chosen during the thin link, if this
+  /// function is a duplicate of it and will be redirected to it.
+  ValueInfo MergedInto;
+
 public:
   FunctionSummary(GVFlags Flags, unsigned NumInsts, FFlags FunFlags,
                   std::vector<ValueInfo> Refs, std::vector<EdgeTy> CGEdges,
@@ -591,6 +607,33 @@ public:
 
   const TypeIdInfo *getTypeIdInfo() const { return TIdInfo.get(); };
 
+  /// Get the structural hash of this function, or zero if there is none.
+  const FunctionStructuralHash &structuralHash() const {
+    return StructuralHash;
+  }
+
+  /// Return true if this function has a structural hash.
+  bool hasStructuralHash() const {
+    return StructuralHash[0] || StructuralHash[1];
+  }
+
+  /// Set the structural hash of this function.
+  void setStructuralHash(const FunctionStructuralHash &Hash) {
+    StructuralHash = Hash;
+  }
+
+  /// Get the synthetic entry count of this function.
+  uint64_t entryCount() const { return EntryCount; }
+
+  /// Set the synthetic entry count of this function.
+  void setEntryCount(uint64_t Count) { EntryCount = Count; }
+
+  /// Return the canonical function this function is merged into, if any.
+  ValueInfo mergedInto() const { return MergedInto; }
+
+  /// Record that this function is a duplicate of \p Canonical.
+  void setMergedInto(ValueInfo Canonical) { MergedInto = Canonical; }
+
   friend struct GraphTraits<ValueInfo>;
 };
 
@@ -628,13 +671,31 @@ template <> struct DenseMapInfo<FunctionSummary::ConstVCall> {
   }
 };
 
+/// Pair of a function that a virtual table points to and the offset of the
+/// pointer from the start of the virtual table. The function is empty if the
+/// pointer does not refer to a known function.
+struct VirtFuncOffset {
+  VirtFuncOffset(ValueInfo VI, uint64_t Offset)
+      : FuncVI(VI), VTableOffset(Offset) {}
+
+  ValueInfo FuncVI;
+  uint64_t VTableOffset;
+};
+/// List of functions referenced by a virtual table, sorted by offset.
+using VTableFuncList = std::vector<VirtFuncOffset>;
+
 /// Global variable summary information to aid decisions and
 /// implementation of importing.
 ///
-/// Currently this doesn't add anything to the base \p GlobalValueSummary,
-/// but is a placeholder as additional info may be added to the summary
-/// for variables.
+/// Besides the base \p GlobalValueSummary, this records the functions that a
+/// vtable with type metadata points to, for modules that were not split into
+/// a regular LTO part.
 class GlobalVarSummary : public GlobalValueSummary {
+private:
+  /// For vtables with type metadata, the functions at each offset of the
+  /// initializer. Used for whole program devirtualization on the index. Most
+  /// globals are not vtables, so only allocate space when needed.
+  std::unique_ptr<VTableFuncList> VTableFuncs;
 
 public:
   GlobalVarSummary(GVFlags Flags, std::vector<ValueInfo> Refs)
@@ -644,6 +705,19 @@ public:
   static bool classof(const GlobalValueSummary *GVS) {
     return GVS->getSummaryKind() == GlobalVarKind;
   }
+
+  void setVTableFuncs(VTableFuncList Funcs) {
+    assert(!VTableFuncs);
+    VTableFuncs = llvm::make_unique<VTableFuncList>(std::move(Funcs));
+  }
+
+  /// Returns the functions referenced by this vtable, or an empty list if this
+  /// is not a summarized vtable.
+  ArrayRef<VirtFuncOffset> vTableFuncs() const {
+    if (VTableFuncs)
+      return *VTableFuncs;
+    return {};
+  }
 };
 
 struct TypeTestResolution {
@@ -737,6 +811,19 @@ using ModulePathStringTableTy = StringMap<std::pair<uint64_t, ModuleHash>>;
 /// a particular module, and provide efficient access to their summary.
 using GVSummaryMapTy = DenseMap<GlobalValue::GUID, GlobalValueSummary *>;
 
+/// An address point of a vtable that is compatible with a type identifier:
+/// the vtable and the offset of the address point within it.
+struct TypeIdOffsetVtableInfo {
+  TypeIdOffsetVtableInfo(uint64_t Offset, ValueInfo VI)
+      : AddressPointOffset(Offset), VTableVI(VI) {}
+
+  uint64_t AddressPointOffset;
+  ValueInfo VTableVI;
+};
+/// List of vtable address points compatible with a type identifier, built
+/// from the !type metadata on vtable definitions.
+using TypeIdCompatibleVtableInfo = std::vector<TypeIdOffsetVtableInfo>;
+
 /// Class to hold module path string table and global value map,
 /// and encapsulate methods for operating on them.
 class ModuleSummaryIndex {
@@ -752,6 +839,11 @@ private:
   /// identifier.
   std::map<std::string, TypeIdSummary> TypeIdMap;
 
+  /// Mapping from type identifiers to the vtable address points compatible
+  /// with them. Only populated for vtables whose initializers are summarized,
+  /// and used for whole program devirtualization on the index.
+  std::map<std::string, TypeIdCompatibleVtableInfo> TypeIdCompatibleVtableMap;
+
   /// Mapping from original ID to GUID. If original ID can map to multiple
   /// GUIDs, it will be mapped to 0.
   std::map<GlobalValue::GUID, GlobalValue::GUID> OidGuidMap;
@@ -768,6 +860,11 @@ private:
   /// valid object file.
   bool SkipModuleByDistributedBackend = false;
 
+  /// Indicates that the vtables with type metadata are spread over the
+  /// regular LTO partition and ThinLTO modules that were not split, so whole
+  /// program devirtualization cannot rely on the targets it finds.
+  bool PartiallySplitLTOUnits = false;
+
   /// If true then we're performing analysis of IR module, or parsing along with
   /// the IR from assembly. The value of 'false' means we're reading summary
   /// from BC or YAML source. Affects the type of value stored in NameOrGV
@@ -880,6 +977,9 @@ public:
     SkipModuleByDistributedBackend = true;
   }
 
+  bool partiallySplitLTOUnits() const { return PartiallySplitLTOUnits; }
+  void setPartiallySplitLTOUnits() { PartiallySplitLTOUnits = true; }
+
   bool isGlobalValueLive(const GlobalValueSummary *GVS) const {
     return !WithGlobalValueDeadStripping || GVS->isLive();
   }
@@ -1082,6 +1182,28 @@ public:
     return &I->second;
   }
 
+  const std::map<std::string, TypeIdCompatibleVtableInfo> &
+  typeIdCompatibleVtableMap() const {
+    return TypeIdCompatibleVtableMap;
+  }
+
+  /// Return the list of vtable address points compatible with \p TypeId,
+  /// creating it if needed. Used when building or reading the index.
+  TypeIdCompatibleVtableInfo &
+  getOrInsertTypeIdCompatibleVtableSummary(StringRef TypeId) {
+    return TypeIdCompatibleVtableMap[TypeId];
+  }
+
+  /// Return the list of vtable address points compatible with \p TypeId, or
+  /// null if there is none.
+  const TypeIdCompatibleVtableInfo *
+  getTypeIdCompatibleVtableSummary(StringRef TypeId) const {
+    auto I = TypeIdCompatibleVtableMap.find(TypeId);
+    if (I == TypeIdCompatibleVtableMap.end())
+      return nullptr;
+    return &I->second;
+  }
+
   /// Collect for the given module the list of functions it defines
   /// (GUID -> Summary).
   void collectDefinedFunctionsForModule(StringRef ModulePath,
@@ -1108,6 +1230,7 @@ public:
 /// GraphTraits definition to build SCC for the index
 template <> struct GraphTraits<ValueInfo> {
   typedef ValueInfo NodeRef;
+  using EdgeRef = FunctionSummary::EdgeTy &;
 
   static NodeRef valueInfoFromEdge(FunctionSummary::EdgeTy &P) {
     return P.first;
@@ -1137,6 +1260,26 @@ template <> struct GraphTraits<ValueInfo> {
         cast<FunctionSummary>(N.getSummaryList().front()->getBaseObject());
     return ChildIteratorType(F->CallGraphEdgeList.end(), &valueInfoFromEdge);
   }
+
+  using ChildEdgeIteratorType = std::vector<FunctionSummary::EdgeTy>::iterator;
+
+  static ChildEdgeIteratorType child_edge_begin(NodeRef N) {
+    if (!N.getSummaryList().size()) // handle external function
+      return FunctionSummary::ExternalNode.CallGraphEdgeList.begin();
+    FunctionSummary *F =
+        cast<FunctionSummary>(N.getSummaryList().front()->getBaseObject());
+    return F->CallGraphEdgeList.begin();
+  }
+
+  static ChildEdgeIteratorType child_edge_end(NodeRef N) {
+    if (!N.getSummaryList().size()) // handle external function
+      return FunctionSummary::ExternalNode.CallGraphEdgeList.end();
+    FunctionSummary *F =
+        cast<FunctionSummary>(N.getSummaryList().front()->getBaseObject());
+    return F->CallGraphEdgeList.end();
+  }
+
+  static NodeRef edge_dest(EdgeRef E) { return E.first; }
 };
 
 template <>
@@ -718,6 +718,35 @@ public:
     return &static_cast<ResultModelT *>(ResultConcept)->Result;
   }
 
+  /// Cache a result of an analysis pass computed outside of the manager.
+  ///
+  /// The result is used as if the analysis had been run on \p IR. This allows
+  /// results to be computed elsewhere, e.g. on other threads, and handed over
+  /// once they are done. There must not be a cached result for \p IR yet.
+  template <typename PassT>
+  void cacheResult(IRUnitT &IR, typename PassT::Result Result) {
+    assert(AnalysisPasses.count(PassT::ID()) &&
+           "This analysis pass was not registered prior to being cached");
+
+    using ResultModelT =
+        detail::AnalysisResultModel<IRUnitT, PassT, typename PassT::Result,
+                                    PreservedAnalyses, Invalidator>;
+
+    typename AnalysisResultMapT::iterator RI;
+    bool Inserted;
+    std::tie(RI, Inserted) = AnalysisResults.insert(
+        std::make_pair(std::make_pair(PassT::ID(), &IR),
+                       typename AnalysisResultListT::iterator()));
+    assert(Inserted && "The analysis already has a cached result!");
+    (void)Inserted;
+
+    AnalysisResultListT &ResultList = AnalysisResultLists[&IR];
+    ResultList.emplace_back(
+        PassT::ID(),
+        std::unique_ptr<ResultConceptT>(new ResultModelT(std::move(Result))));
+    RI->second = std::prev(ResultList.end());
+  }
+
   /// Register an analysis pass with the manager.
   ///
   /// The parameter is a callable whose result is an analysis pass. This allows
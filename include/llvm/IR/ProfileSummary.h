@@ -26,9 +26,10 @@ class Metadata;
 // The profile summary is one or more (Cutoff, MinCount, NumCounts) triplets.
 // The semantics of counts depend on the type of profile. For instrumentation
 // profile, counts are block counts and for sample profile, counts are
-// per-line samples. Given a target counts percentile, we compute the minimum
-// number of counts needed to reach this target and the minimum among these
-// counts.
+// per-line samples. For synthetic profile, counts are block counts estimated
+// from the synthetic function entry counts. Given a target counts percentile,
+// we compute the minimum number of counts needed to reach this target and the
+// minimum among these counts.
 struct ProfileSummaryEntry {
   uint32_t Cutoff;    ///< The required percentile of counts.
   uint64_t MinCount;  ///< The minimum count for this percentile.
@@ -43,11 +44,11 @@ using SummaryEntryVector = std::vector<ProfileSummaryEntry>;
 
 class ProfileSummary {
 public:
-  enum Kind { PSK_Instr, PSK_Sample };
+  enum Kind { PSK_Instr, PSK_Sample, PSK_Synthetic };
 
 private:
   const Kind PSK;
-  static const char *KindStr[2];
+  static const char *KindStr[3];
   SummaryEntryVector DetailedSummary;
   uint64_t TotalCount, MaxCount, MaxInternalCount, MaxFunctionCount;
   uint32_t NumCounts, NumFunctions;
@@ -296,6 +296,9 @@ private:
       std::vector<GlobalValue *> Keep;
     };
     std::vector<AddedModule> ModsWithSummaries;
+    /// Whether a module with type metadata, such as the regular LTO part of a
+    /// split module, was added.
+    bool HasTypeMetadata = false;
   } RegularLTO;
 
   struct ThinLTOState {
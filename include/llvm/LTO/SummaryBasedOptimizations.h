@@ -0,0 +1,22 @@
+//===- SummaryBasedOptimizations.h - Optimizations on summaries -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LTO_SUMMARYBASEDOPTIMIZATIONS_H
+#define LLVM_LTO_SUMMARYBASEDOPTIMIZATIONS_H
+
+namespace llvm {
+class ModuleSummaryIndex;
+
+/// Compute synthetic function entry counts on the combined call graph of
+/// \p Index, and record them in the function summaries.
+void computeSyntheticCounts(ModuleSummaryIndex &Index);
+
+} // namespace llvm
+
+#endif
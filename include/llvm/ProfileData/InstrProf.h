@@ -158,6 +158,13 @@ inline StringRef getInstrProfRuntimeHookVarUseFuncName() {
   return "__llvm_profile_runtime_user";
 }
 
+/// Return the name of the thread-local counter that selects, on function
+/// entry, between the instrumented and uninstrumented copies of functions in
+/// sampled instrumentation mode.
+inline StringRef getInstrProfSamplingVarName() {
+  return "__llvm_profile_sampling";
+}
+
 /// Return the marker used to separate PGO names during serialization.
 inline StringRef getInstrProfNameSeparator() { return "\01"; }
 
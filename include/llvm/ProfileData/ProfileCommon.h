@@ -79,6 +79,20 @@ public:
   std::unique_ptr<ProfileSummary> getSummary();
 };
 
+/// Builder of the summary of synthetic counts, which are the synthetic entry
+/// counts of the functions and the block counts derived from them.
+class SyntheticProfileSummaryBuilder final : public ProfileSummaryBuilder {
+  uint64_t MaxInternalBlockCount = 0;
+
+public:
+  SyntheticProfileSummaryBuilder(std::vector<uint32_t> Cutoffs)
+      : ProfileSummaryBuilder(std::move(Cutoffs)) {}
+
+  void addEntryCount(uint64_t Count);
+  void addInternalCount(uint64_t Count);
+  std::unique_ptr<ProfileSummary> getSummary();
+};
+
 class SampleProfileSummaryBuilder final : public ProfileSummaryBuilder {
 public:
   SampleProfileSummaryBuilder(std::vector<uint32_t> Cutoffs)
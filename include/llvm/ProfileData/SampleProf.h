@@ -200,6 +200,79 @@ private:
 
 raw_ostream &operator<<(raw_ostream &OS, const SampleRecord &Sample);
 
+/// State of a context-sensitive profile while it is being applied.
+enum ContextState {
+  UnknownContext = 0, // Profile without calling context.
+  RawContext,         // Context profile as read from the input profile.
+  InlinedContext,     // Context profile of a callsite that was inlined.
+  MergedContext       // Context profile merged into another profile.
+};
+
+/// A frame of a calling context: the function and, for every frame but the
+/// innermost one, the location of the callsite within that function.
+struct SampleContextFrame {
+  SampleContextFrame(StringRef FuncName, LineLocation Location)
+      : FuncName(FuncName), Location(Location) {}
+
+  StringRef FuncName;
+  LineLocation Location;
+};
+
+using SampleContextFrames = SmallVector<SampleContextFrame, 8>;
+
+/// Calling context of a context-sensitive profile.
+///
+/// A context lists the frames from the outermost caller down to the profiled
+/// function, separated by " @ ". Every frame but the last one carries the
+/// location of the callsite in that frame, for example
+///
+///     main:3 @ _Z3fooi:2.1 @ _Z3bari
+///
+/// is the profile of _Z3bari when called from line offset 2, discriminator 1
+/// of _Z3fooi, itself called from line offset 3 of main. In text profiles
+/// the context is written in brackets in place of the function name.
+class SampleContext {
+public:
+  SampleContext() = default;
+  SampleContext(StringRef ContextStr) : FullContext(ContextStr) {
+    State = ContextStr.empty() ? UnknownContext : RawContext;
+    size_t Pos = ContextStr.rfind(" @ ");
+    Name = Pos == StringRef::npos ? ContextStr : ContextStr.substr(Pos + 3);
+  }
+
+  /// Return true if \p Name is a bracketed context of a text profile.
+  static bool isContextString(StringRef Name) {
+    return Name.size() > 2 && Name.front() == '[' && Name.back() == ']';
+  }
+
+  /// Decode \p ContextStr into its frames, outermost first.
+  ///
+  /// \returns false if a caller frame does not end with a valid location.
+  static bool decodeContextString(StringRef ContextStr,
+                                  SampleContextFrames &Frames);
+
+  /// Return the full context, e.g. "main:3 @ _Z3fooi".
+  StringRef getNameWithContext() const { return FullContext; }
+
+  /// Return the name of the innermost function of the context.
+  StringRef getName() const { return Name; }
+
+  /// Return true if the profile has a calling context, even one made of the
+  /// profiled function alone.
+  bool hasContext() const { return State != UnknownContext; }
+
+  /// Return true if the context has callers of the profiled function.
+  bool hasCallers() const { return FullContext.size() != Name.size(); }
+
+  ContextState getState() const { return State; }
+  void setState(ContextState S) { State = S; }
+
+private:
+  StringRef FullContext;
+  StringRef Name;
+  ContextState State = UnknownContext;
+};
+
 class FunctionSamples;
 
 using BodySampleMap = std::map<LineLocation, SampleRecord>;
@@ -356,6 +429,8 @@ public:
   sampleprof_error merge(const FunctionSamples &Other, uint64_t Weight = 1) {
     sampleprof_error Result = sampleprof_error::success;
     Name = Other.getName();
+    if (!Context.hasContext())
+      Context = Other.getContext();
     MergeResult(Result, addTotalSamples(Other.getTotalSamples(), Weight));
     MergeResult(Result, addHeadSamples(Other.getHeadSamples(), Weight));
     for (const auto &I : Other.getBodySamples()) {
@@ -402,6 +477,13 @@ public:
   /// Return the function name.
   const StringRef &getName() const { return Name; }
 
+  /// Set the calling context of a context-sensitive profile.
+  void setContext(const SampleContext &FContext) { Context = FContext; }
+
+  /// Return the calling context. The state of the context changes while the
+  /// profile is applied, so it can be updated through a const profile.
+  SampleContext &getContext() const { return Context; }
+
   /// Returns the line offset to the start line of the subprogram.
   /// We assume that a single function will not exceed 65535 LOC.
   static unsigned getOffset(const DILocation *DIL);
@@ -421,6 +503,9 @@ private:
   /// Mangled name of the function.
   StringRef Name;
 
+  /// Calling context of a context-sensitive profile.
+  mutable SampleContext Context;
+
   /// Total number of samples collected inside this function.
   ///
   /// Samples are cumulative, they include all the samples collected
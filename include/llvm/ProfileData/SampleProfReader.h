@@ -115,6 +115,21 @@
 //    total number of samples collected for the inlined instance at this
 //    callsite
 //
+// Context-sensitive profiles
+// --------------------------
+//
+// A function header may name a calling context in brackets instead of a
+// function, in which case the section holds the samples of the innermost
+// function of the context when called through that context only:
+//
+//     [main:3 @ _Z3fooi:2.1 @ _Z3bari]:total_samples:total_head_samples
+//
+// Each frame but the last is followed by the line offset and optional
+// discriminator of the callsite. Such profiles are flat: the samples of
+// callees are found in the sections of the longer contexts. A file holds
+// either context-sensitive or regular profiles, not both. Context-sensitive
+// profiles are only supported in the text format.
+//
 //
 // Binary format
 // -------------
@@ -318,6 +333,9 @@ public:
   /// \brief Return the profile format.
   SampleProfileFormat getFormat() { return Format; }
 
+  /// Return true if the profiles are keyed by calling context.
+  bool profileIsCS() const { return ProfileIsCS; }
+
 protected:
   /// Map every function to its associated profile.
   ///
@@ -340,6 +358,9 @@ protected:
 
   /// \brief The format of sample.
   SampleProfileFormat Format = SPF_None;
+
+  /// Whether the profiles are context-sensitive.
+  bool ProfileIsCS = false;
 };
 
 class SampleProfileReaderText : public SampleProfileReader {
@@ -201,6 +201,18 @@ Pass *createReversePostOrderFunctionAttrsPass();
 ///
 ModulePass *createMergeFunctionsPass();
 
+//===----------------------------------------------------------------------===//
+/// createFunctionSpecializationPass - This pass clones functions for the call
+/// sites that pass them constant arguments.
+///
+ModulePass *createFunctionSpecializationPass();
+
+//===----------------------------------------------------------------------===//
+/// createHotColdSplittingPass - This pass outlines cold regions of functions
+/// into separate functions placed in the .text.unlikely section.
+///
+ModulePass *createHotColdSplittingPass();
+
 //===----------------------------------------------------------------------===//
 /// createPartialInliningPass - This pass inlines parts of functions.
 ///
@@ -128,6 +128,16 @@ void computeDeadSymbols(
     const DenseSet<GlobalValue::GUID> &GUIDPreservedSymbols,
     function_ref<PrevailingType(GlobalValue::GUID)> isPrevailing);
 
+/// Find functions with the same structural hash whose prevailing copies are
+/// defined in different modules (or under different names), and record in
+/// the summary of each duplicate the canonical copy it is merged into. The
+/// canonical copies are added to \p ExportLists so that they are kept.
+void computeCrossModuleFunctionMerging(
+    ModuleSummaryIndex &Index,
+    function_ref<bool(GlobalValue::GUID, const GlobalValueSummary *)>
+        isPrevailing,
+    StringMap<FunctionImporter::ExportSetTy> &ExportLists);
+
 /// Converts value \p GV to declaration, or replaces with a declaration if
 /// it is an alias. Returns true if converted, false if replaced.
 bool convertToDeclaration(GlobalValue &GV);
@@ -163,6 +173,20 @@ void thinLTOResolveWeakForLinkerModule(Module &TheModule,
 void thinLTOInternalizeModule(Module &TheModule,
                               const GVSummaryMapTy &DefinedGlobals);
 
+/// Replace the body of each function in \p TheModule that the thin link merged
+/// into a canonical copy with a tail call to that copy. A function is only
+/// replaced if its structural hash, recomputed here before internalization,
+/// still matches its summary, and so does the canonical copy's if it is defined
+/// in \p TheModule. Returns true if the module was changed.
+bool thinLTOMergeFunctionsModule(Module &TheModule,
+                                 const GVSummaryMapTy &DefinedGlobals);
+
+/// Set the synthetic entry counts computed on the combined call graph during
+/// the thin link on the functions of \p TheModule. Functions with a real
+/// profile count keep it. Returns true if the module was changed.
+bool thinLTOApplySyntheticCountsModule(Module &TheModule,
+                                       const GVSummaryMapTy &DefinedGlobals);
+
 } // end namespace llvm
 
 #endif // LLVM_TRANSFORMS_IPO_FUNCTIONIMPORT_H
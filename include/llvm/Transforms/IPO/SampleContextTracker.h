@@ -0,0 +1,139 @@
+//===- SampleContextTracker.h - Context-sensitive profile tracking -*- C++ -*-//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file provides the interface for SampleContextTracker, which organizes
+// context-sensitive sample profiles into a trie of calling contexts and keeps
+// it up to date with the inline decisions of the sample profile loader.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TRANSFORMS_IPO_SAMPLECONTEXTTRACKER_H
+#define LLVM_TRANSFORMS_IPO_SAMPLECONTEXTTRACKER_H
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ProfileData/SampleProf.h"
+#include <list>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+
+class Function;
+class Instruction;
+
+namespace sampleprof {
+
+/// A node of the context trie.
+///
+/// The children of the root are the base contexts of the functions, and the
+/// children of any other node are the contexts of its callees, keyed by
+/// callsite location and callee name.
+class ContextTrieNode {
+public:
+  ContextTrieNode(ContextTrieNode *Parent = nullptr,
+                  StringRef FuncName = StringRef(),
+                  LineLocation CallSiteLoc = LineLocation(0, 0))
+      : ParentContext(Parent), FuncName(FuncName), CallSiteLoc(CallSiteLoc) {}
+
+  ContextTrieNode *getChildContext(const LineLocation &CallSite,
+                                   StringRef CalleeName);
+  ContextTrieNode &getOrCreateChildContext(const LineLocation &CallSite,
+                                           StringRef CalleeName);
+
+  /// Return the hottest child context at \p CallSite, if any.
+  ContextTrieNode *getHottestChildContext(const LineLocation &CallSite);
+
+  /// Append the child contexts at \p CallSite to \p Children.
+  void getChildContextsAt(const LineLocation &CallSite,
+                          SmallVectorImpl<ContextTrieNode *> &Children);
+
+  using ChildMap =
+      std::map<std::pair<LineLocation, StringRef>, ContextTrieNode>;
+  ChildMap &getAllChildContext() { return AllChildContext; }
+  const ChildMap &getAllChildContext() const { return AllChildContext; }
+
+  StringRef getFuncName() const { return FuncName; }
+  FunctionSamples *getFunctionSamples() const { return FuncSamples; }
+  void setFunctionSamples(FunctionSamples *FSamples) { FuncSamples = FSamples; }
+  ContextTrieNode *getParentContext() const { return ParentContext; }
+
+  /// Return the location of the callsite in the parent context.
+  LineLocation getCallSiteLoc() const { return CallSiteLoc; }
+
+  void dump(raw_ostream &OS, unsigned Indent = 0) const;
+
+private:
+  ContextTrieNode *ParentContext;
+  StringRef FuncName;
+  LineLocation CallSiteLoc;
+  FunctionSamples *FuncSamples = nullptr;
+  ChildMap AllChildContext;
+};
+
+/// Tracker of context-sensitive profiles for the sample profile loader.
+///
+/// Functions are expected to be processed top-down. Profiles of contexts that
+/// were inlined are applied to the inlined code through the inline stack of
+/// its debug locations. When a function is processed, the contexts it was
+/// called through that were not inlined are merged into its base profile,
+/// together with the contexts of its callees under them.
+class SampleContextTracker {
+public:
+  SampleContextTracker(StringMap<FunctionSamples> &Profiles);
+
+  /// Return the profile of the context of \p Inst, following the inline
+  /// stack of its debug location.
+  FunctionSamples *getContextSamplesFor(const Instruction &Inst);
+
+  /// Return the profile of the context of the call \p Inst to
+  /// \p CalleeName. An empty name returns the hottest callee context.
+  FunctionSamples *getCalleeContextSamplesFor(const Instruction &Inst,
+                                              StringRef CalleeName);
+
+  /// Return the profiles of all the callee contexts of the indirect call
+  /// \p Inst.
+  std::vector<const FunctionSamples *>
+  getIndirectCalleeContextSamplesFor(const Instruction &Inst);
+
+  /// Return the base profile of \p F, after merging into it the contexts of
+  /// \p F that were not inlined.
+  FunctionSamples *getBaseSamplesFor(const Function &F);
+
+  /// Record that the context profile \p InlinedSamples was inlined, so that
+  /// it is excluded from the base profile of its function.
+  void markContextSamplesInlined(const FunctionSamples *InlinedSamples);
+
+  void dump(raw_ostream &OS = dbgs()) const;
+
+private:
+  ContextTrieNode *getContextFor(const Instruction &Inst);
+  ContextTrieNode *getOrCreateContextPath(const SampleContextFrames &Frames);
+  ContextTrieNode &getOrCreateTopLevelContext(StringRef FName);
+  FunctionSamples &createFunctionSamples(ContextTrieNode &Node);
+  void mergeContextNode(ContextTrieNode &FromNode, ContextTrieNode &ToNode);
+
+  /// Root of the context trie.
+  ContextTrieNode RootContext;
+
+  /// The context profiles of every function, by function name.
+  StringMap<SmallVector<FunctionSamples *, 4>> FuncToCtxtProfiles;
+
+  /// Profiles created for contexts that had no profile of their own, and the
+  /// context strings naming them.
+  std::list<FunctionSamples> CreatedSamples;
+  std::list<std::string> CreatedContextStrs;
+};
+
+} // end namespace sampleprof
+} // end namespace llvm
+
+#endif // LLVM_TRANSFORMS_IPO_SAMPLECONTEXTTRACKER_H
@@ -15,10 +15,12 @@
 #ifndef LLVM_TRANSFORMS_IPO_WHOLEPROGRAMDEVIRT_H
 #define LLVM_TRANSFORMS_IPO_WHOLEPROGRAMDEVIRT_H
 
+#include "llvm/IR/GlobalValue.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/PassManager.h"
 #include <cassert>
 #include <cstdint>
+#include <set>
 #include <utility>
 #include <vector>
 
@@ -229,6 +231,15 @@ struct WholeProgramDevirtPass : public PassInfoMixin<WholeProgramDevirtPass> {
   PreservedAnalyses run(Module &M, ModuleAnalysisManager &);
 };
 
+/// Perform single implementation devirtualization on the summary \p Summary
+/// alone, using the vtable contents summarized for modules that were not
+/// split into a regular LTO part. The resolutions are stored in the type
+/// identifier summaries, to be applied by the import phase of the pass in the
+/// ThinLTO backends. The targets that are referenced from other modules as a
+/// result are added to \p ExportedGUIDs so that they are not internalized.
+void runWholeProgramDevirtOnIndex(ModuleSummaryIndex &Summary,
+                                  std::set<GlobalValue::GUID> &ExportedGUIDs);
+
 } // end namespace llvm
 
 #endif // LLVM_TRANSFORMS_IPO_WHOLEPROGRAMDEVIRT_H
@@ -12,6 +12,7 @@
 
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/Support/Compiler.h"
@@ -28,6 +29,13 @@ class InstCombineWorklist {
   SmallVector<Instruction*, 256> Worklist;
   DenseMap<Instruction*, unsigned> WorklistMap;
 
+  /// The instructions added to the worklist since the last call to
+  /// takeChanged, when RecordChanges is set. Instructions erased in the
+  /// meantime are dropped from ChangedSet but stay in Changed.
+  bool RecordChanges = false;
+  SmallVector<Instruction*, 64> Changed;
+  SmallPtrSet<Instruction*, 32> ChangedSet;
+
 public:
   InstCombineWorklist() = default;
 
@@ -39,6 +47,8 @@ public:
   /// Add - Add the specified instruction to the worklist if it isn't already
   /// in it.
   void Add(Instruction *I) {
+    if (RecordChanges && ChangedSet.insert(I).second)
+      Changed.push_back(I);
     if (WorklistMap.insert(std::make_pair(I, Worklist.size())).second) {
       LLVM_DEBUG(dbgs() << "IC: ADD: " << *I << '\n');
       Worklist.push_back(I);
@@ -68,6 +78,7 @@ public:
 
   // Remove - remove I from the worklist if it exists.
   void Remove(Instruction *I) {
+    ChangedSet.erase(I);
     DenseMap<Instruction*, unsigned>::iterator It = WorklistMap.find(I);
     if (It == WorklistMap.end()) return; // Not in worklist.
 
@@ -93,6 +104,29 @@ public:
   }
 
 
+  /// setRecordChanges - Start or stop remembering the instructions added to
+  /// the worklist, that is the instructions touched by the combines since the
+  /// worklist was seeded.
+  void setRecordChanges(bool Record) {
+    RecordChanges = Record;
+    Changed.clear();
+    ChangedSet.clear();
+  }
+
+  /// isRecordingChanges - Return true if the instructions added to the
+  /// worklist are remembered for the next iteration.
+  bool isRecordingChanges() const { return RecordChanges; }
+
+  /// takeChanged - Move the instructions added to the worklist since the
+  /// last call, and not removed since, to Out.
+  void takeChanged(SmallVectorImpl<Instruction *> &Out) {
+    for (Instruction *I : Changed)
+      if (ChangedSet.erase(I))
+        Out.push_back(I);
+    Changed.clear();
+    ChangedSet.clear();
+  }
+
   /// Zap - check that the worklist is empty and nuke the backing store for
   /// the map if it is large.
   void Zap() {
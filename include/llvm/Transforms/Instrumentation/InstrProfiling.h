@@ -75,6 +75,15 @@ private:
   /// any lowering.
   bool lowerIntrinsics(Function *F);
 
+  /// Duplicate the body of \p F into an instrumented and an uninstrumented
+  /// copy, and select one of them on entry with the sampling counter. Functions
+  /// with convergent or noduplicate calls are left alone. Returns true if \p F
+  /// was changed.
+  bool duplicateForSampling(Function &F);
+
+  /// Get the thread-local sampling counter, creating it if necessary.
+  GlobalVariable *getOrCreateSamplingVar();
+
   /// Register-promote counter loads and stores in loops.
   void promoteCounterLoadStores(Function *F);
 
@@ -23,9 +23,11 @@
 
 namespace llvm {
 
+class CallInst;
 class Function;
 class Instruction;
 class Module;
+class TargetLibraryInfo;
 
 /// The instrumentation (profile-instr-gen) pass for IR based PGO.
 class PGOInstrumentationGen : public PassInfoMixin<PGOInstrumentationGen> {
@@ -70,6 +72,11 @@ void setProfMetadata(Module *M, Instruction *TI, ArrayRef<uint64_t> EdgeCounts,
 
 void setIrrLoopHeaderMetadata(Module *M, Instruction *TI, uint64_t Count);
 
+/// Return true if \p CI calls one of the library functions whose size
+/// argument is value profiled like the length of memory intrinsics: memcpy,
+/// memmove, memset, memcmp and bcmp.
+bool isMemOPSizeLibCall(const CallInst &CI, const TargetLibraryInfo &TLI);
+
 } // end namespace llvm
 
 #endif // LLVM_TRANSFORMS_PGOINSTRUMENTATION_H
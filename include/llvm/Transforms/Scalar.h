@@ -300,6 +300,13 @@ FunctionPass *createGVNHoistPass();
 //
 FunctionPass *createGVNSinkPass();
 
+//===----------------------------------------------------------------------===//
+//
+// HeapToStack - Replace small heap allocations that do not escape the function
+// by stack allocations.
+//
+FunctionPass *createHeapToStackPass();
+
 //===----------------------------------------------------------------------===//
 //
 // MergedLoadStoreMotion - This pass merges loads and stores in diamonds. Loads
@@ -457,6 +464,12 @@ FunctionPass *createNaryReassociatePass();
 //
 FunctionPass *createLoopDistributePass();
 
+//===----------------------------------------------------------------------===//
+//
+// LoopFuse - Fuse adjacent loops.
+//
+FunctionPass *createLoopFusePass();
+
 //===----------------------------------------------------------------------===//
 //
 // LoopLoadElimination - Perform loop-aware load elimination.
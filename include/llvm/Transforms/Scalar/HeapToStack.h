@@ -0,0 +1,32 @@
+//===- HeapToStack.h - Heap to Stack Promotion Pass -------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the Heap to Stack pass, which turns small heap
+// allocations that do not escape the function allocating them into stack
+// allocations.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TRANSFORMS_SCALAR_HEAPTOSTACK_H
+#define LLVM_TRANSFORMS_SCALAR_HEAPTOSTACK_H
+
+#include "llvm/IR/PassManager.h"
+
+namespace llvm {
+
+class Function;
+
+class HeapToStackPass : public PassInfoMixin<HeapToStackPass> {
+public:
+  PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM);
+};
+
+} // end namespace llvm
+
+#endif // LLVM_TRANSFORMS_SCALAR_HEAPTOSTACK_H
@@ -34,6 +34,7 @@ class BasicBlock;
 class BinaryOperator;
 class BranchInst;
 class CmpInst;
+class CompileTimeBudget;
 class Constant;
 class DomTreeUpdater;
 class Function;
@@ -41,6 +42,7 @@ class Instruction;
 class IntrinsicInst;
 class LazyValueInfo;
 class LoadInst;
+class OptimizationRemarkEmitter;
 class PHINode;
 class TargetLibraryInfo;
 class Value;
@@ -82,6 +84,8 @@ class JumpThreadingPass : public PassInfoMixin<JumpThreadingPass> {
   DomTreeUpdater *DTU;
   std::unique_ptr<BlockFrequencyInfo> BFI;
   std::unique_ptr<BranchProbabilityInfo> BPI;
+  CompileTimeBudget *Budget = nullptr;
+  OptimizationRemarkEmitter *ORE = nullptr;
   bool HasProfileData = false;
   bool HasGuards = false;
 #ifdef NDEBUG
@@ -112,7 +116,9 @@ public:
   bool runImpl(Function &F, TargetLibraryInfo *TLI_, LazyValueInfo *LVI_,
                AliasAnalysis *AA_, DomTreeUpdater *DTU_, bool HasProfileData_,
                std::unique_ptr<BlockFrequencyInfo> BFI_,
-               std::unique_ptr<BranchProbabilityInfo> BPI_);
+               std::unique_ptr<BranchProbabilityInfo> BPI_,
+               CompileTimeBudget *Budget_ = nullptr,
+               OptimizationRemarkEmitter *ORE_ = nullptr);
 
   PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM);
 
@@ -55,7 +55,15 @@ namespace llvm {
 ///
 /// If enabled (via the constructor's `NonTrivial` parameter), this pass will
 /// additionally do non-trivial, full unswitching for branches and switches, and
-/// will do non-trivial, partial unswitching for branches.
+/// will do non-trivial, partial unswitching for branches. The default pipelines
+/// enable this at O3.
+///
+/// Non-trivial unswitching is driven by the TTI cost of the code that would be
+/// duplicated. Because the clones of a loop get unswitched again, the cost of
+/// each candidate is scaled by a multiplier that grows with the number of
+/// sibling loops and of remaining candidates, which bounds the total
+/// duplication. It is not done for functions optimized for size, nor on
+/// targets with divergent branches.
 ///
 /// Because partial unswitching of switches is extremely unlikely to be possible
 /// in practice and significantly complicates the implementation, this pass does
@@ -15,6 +15,7 @@
 #ifndef LLVM_TRANSFORMS_UTILS_CALLPROMOTIONUTILS_H
 #define LLVM_TRANSFORMS_UTILS_CALLPROMOTIONUTILS_H
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/IR/CallSite.h"
 
 namespace llvm {
@@ -49,6 +50,19 @@ Instruction *promoteCall(CallSite CS, Function *Callee,
 Instruction *promoteCallWithIfThenElse(CallSite CS, Function *Callee,
                                        MDNode *BranchWeights = nullptr);
 
+/// Promote the given virtual call site to conditionally call \p Callee,
+/// comparing the vtable pointer \p VTable to \p AddressPoints.
+///
+/// This is like promoteCallWithIfThenElse, except that the "if" condition
+/// holds when \p VTable is equal to one of the vtable address points in
+/// \p AddressPoints, which must all hold \p Callee in the slot loaded by the
+/// call site. The condition does not depend on the load of the called value,
+/// which is sunk into the "else" block when possible.
+Instruction *promoteCallWithVTableCmp(CallSite CS, Function *Callee,
+                                      Value *VTable,
+                                      ArrayRef<Constant *> AddressPoints,
+                                      MDNode *BranchWeights = nullptr);
+
 } // end namespace llvm
 
 #endif // LLVM_TRANSFORMS_UTILS_CALLPROMOTIONUTILS_H
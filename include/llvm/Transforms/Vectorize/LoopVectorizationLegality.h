@@ -310,7 +310,7 @@ public:
     return LAI->getDepChecker().getMaxSafeRegisterWidth();
   }
 
-  bool hasStride(Value *V) { return LAI->hasStride(V); }
+  bool hasStride(Value *V) { return LAI && LAI->hasStride(V); }
 
   /// Returns true if vector representation of the instruction \p I
   /// requires mask.
@@ -359,6 +359,17 @@ private:
   /// specific checks for outer loop vectorization.
   bool canVectorizeOuterLoop();
 
+  /// Set up the induction variables of the outer loop being vectorized in the
+  /// VPlan-native path. Return false if any phi of the outer loop header is
+  /// not an integer induction. Inductions are added to \p AllowedExit.
+  bool setupOuterLoopInductions(SmallPtrSetImpl<Value *> &AllowedExit);
+
+  /// Return true if every instruction in the outer loop nest can be widened
+  /// by the VPlan-native path, i.e. has a vectorizable type, an opcode that
+  /// InnerLoopVectorizer::widenInstruction supports and no users outside of
+  /// the loop nest other than the ones in \p AllowedExit.
+  bool canWidenOuterLoopInstrs(SmallPtrSetImpl<Value *> &AllowedExit);
+
   /// Return true if all of the instructions in the block can be speculatively
   /// executed. \p SafePtrs is a list of addresses that are known to be legal
   /// and we know that we can read from them without segfault.
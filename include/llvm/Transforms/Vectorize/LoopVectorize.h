@@ -68,9 +68,11 @@ class BlockFrequencyInfo;
 class DemandedBits;
 class DominatorTree;
 class Function;
+class InnerLoopVectorizer;
 class Loop;
 class LoopAccessInfo;
 class LoopInfo;
+class LoopVectorizeHints;
 class OptimizationRemarkEmitter;
 class ScalarEvolution;
 class TargetLibraryInfo;
@@ -108,6 +110,12 @@ struct LoopVectorizePass : public PassInfoMixin<LoopVectorizePass> {
                OptimizationRemarkEmitter &ORE);
 
   bool processLoop(Loop *L);
+
+  /// Vectorize the remainder loop \p L, left by the vectorization of \p L by
+  /// \p MainILV, with the smaller vectorization factor \p VF.
+  bool processEpilogueLoop(Loop *L, const InnerLoopVectorizer &MainILV,
+                           unsigned VF, LoopVectorizeHints &Hints,
+                           bool UseInterleaved);
 };
 
 } // end namespace llvm
@@ -0,0 +1,89 @@
+//===- BlockFrequencyUpdater.cpp - Incremental BFI/BPI updates ------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the local BlockFrequencyInfo and BranchProbabilityInfo
+// updates for common CFG edits.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Analysis/BlockFrequencyUpdater.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/BranchProbabilityInfo.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/Support/Debug.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "block-freq-updater"
+
+BlockFrequency BlockFrequencyUpdater::getEdgeFreq(const BasicBlock *Pred,
+                                                  unsigned SuccIdx) const {
+  return BFI.getBlockFreq(Pred) * BPI.getEdgeProbability(Pred, SuccIdx);
+}
+
+BlockFrequency BlockFrequencyUpdater::getEdgeFreq(const BasicBlock *Pred,
+                                                  const BasicBlock *Succ) const {
+  return BFI.getBlockFreq(Pred) * BPI.getEdgeProbability(Pred, Succ);
+}
+
+void BlockFrequencyUpdater::splitBlock(const BasicBlock *Orig,
+                                       const BasicBlock *NewBB) {
+  // Everything that enters Orig falls through to NewBB.
+  BFI.setBlockFreq(NewBB, BFI.getBlockFreq(Orig).getFrequency());
+  BPI.copyEdgeProbabilities(Orig, NewBB);
+  BPI.eraseBlock(Orig);
+}
+
+void BlockFrequencyUpdater::splitEdge(const BasicBlock *Pred,
+                                      const BasicBlock *NewBB) {
+  // The probabilities of Pred are indexed by successor and so still describe
+  // the split edge; NewBB only receives what flowed along it.
+  BlockFrequency Freq(0);
+  const TerminatorInst *TI = Pred->getTerminator();
+  for (unsigned I = 0, E = TI->getNumSuccessors(); I != E; ++I)
+    if (TI->getSuccessor(I) == NewBB)
+      Freq += getEdgeFreq(Pred, I);
+  BFI.setBlockFreq(NewBB, Freq.getFrequency());
+  LLVM_DEBUG(dbgs() << "Split edge " << Pred->getName() << " -> "
+                    << NewBB->getName() << ", new frequency "
+                    << Freq.getFrequency() << "\n");
+}
+
+void BlockFrequencyUpdater::redirectEdge(const BasicBlock *Pred,
+                                         unsigned SuccIdx,
+                                         const BasicBlock *OldSucc) {
+  const BasicBlock *NewSucc = Pred->getTerminator()->getSuccessor(SuccIdx);
+  if (NewSucc == OldSucc)
+    return;
+  BlockFrequency EdgeFreq = getEdgeFreq(Pred, SuccIdx);
+  BlockFrequency OldFreq = BFI.getBlockFreq(OldSucc);
+  BlockFrequency NewFreq = BFI.getBlockFreq(NewSucc);
+  // BlockFrequency subtraction saturates at zero.
+  BFI.setBlockFreq(OldSucc, (OldFreq - EdgeFreq).getFrequency());
+  BFI.setBlockFreq(NewSucc, (NewFreq + EdgeFreq).getFrequency());
+}
+
+void BlockFrequencyUpdater::cloneBlock(const BasicBlock *Orig,
+                                       const BasicBlock *Clone,
+                                       BlockFrequency Freq) {
+  BlockFrequency OrigFreq = BFI.getBlockFreq(Orig);
+  BFI.setBlockFreq(Orig, (OrigFreq - Freq).getFrequency());
+  BFI.setBlockFreq(Clone, Freq.getFrequency());
+  BPI.copyEdgeProbabilities(Orig, Clone);
+}
+
+void BlockFrequencyUpdater::mergeBlockIntoPredecessor(const BasicBlock *BB,
+                                                      const BasicBlock *Pred) {
+  assert(BB->getSinglePredecessor() == Pred &&
+         Pred->getSingleSuccessor() == BB && "Blocks cannot be merged");
+  // Pred keeps its frequency, which is also the frequency of BB, and takes
+  // over the outgoing edges of BB.
+  BPI.copyEdgeProbabilities(BB, Pred);
+}
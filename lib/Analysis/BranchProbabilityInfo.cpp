@@ -909,6 +909,43 @@ void BranchProbabilityInfo::setEdgeProbability(const BasicBlock *Src,
                     << "\n");
 }
 
+void BranchProbabilityInfo::setEdgeProbability(
+    const BasicBlock *Src, ArrayRef<BranchProbability> Probs) {
+  assert(Src->getTerminator()->getNumSuccessors() == Probs.size() &&
+         "Expected one probability per successor");
+  // Drop the stale entries first; Src may have had more successors before.
+  eraseBlock(Src);
+  if (Probs.empty())
+    return;
+#ifndef NDEBUG
+  uint64_t TotalNumerator = 0;
+  for (BranchProbability Prob : Probs)
+    TotalNumerator += Prob.getNumerator();
+  // Allow for the rounding error of one unit per probability.
+  assert(TotalNumerator <= BranchProbability::getDenominator() + Probs.size() &&
+         TotalNumerator >= BranchProbability::getDenominator() - Probs.size() &&
+         "Edge probabilities must sum up to one");
+#endif
+  for (unsigned I = 0, E = Probs.size(); I != E; ++I)
+    setEdgeProbability(Src, I, Probs[I]);
+}
+
+void BranchProbabilityInfo::copyEdgeProbabilities(const BasicBlock *Src,
+                                                  const BasicBlock *Dst) {
+  if (Src == Dst)
+    return;
+  // Either block may be the one currently holding the terminator the
+  // probabilities were computed for, so look at the larger successor count.
+  unsigned NumSuccs = std::max(Src->getTerminator()->getNumSuccessors(),
+                               Dst->getTerminator()->getNumSuccessors());
+  eraseBlock(Dst);
+  for (unsigned I = 0; I != NumSuccs; ++I) {
+    auto It = Probs.find(std::make_pair(Src, I));
+    if (It != Probs.end())
+      setEdgeProbability(Dst, I, It->second);
+  }
+}
+
 raw_ostream &
 BranchProbabilityInfo::printEdgeProbability(raw_ostream &OS,
                                             const BasicBlock *Src,
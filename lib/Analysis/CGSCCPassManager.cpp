@@ -16,13 +16,17 @@
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/iterator_range.h"
 #include "llvm/Analysis/LazyCallGraph.h"
+#include "llvm/Analysis/LoopInfo.h"
 #include "llvm/IR/CallSite.h"
 #include "llvm/IR/Constant.h"
+#include "llvm/IR/Dominators.h"
 #include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/PassManager.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
 #include <cassert>
@@ -32,6 +36,11 @@
 
 using namespace llvm;
 
+static cl::opt<unsigned> CGSCCPrefetchThreads(
+    "cgscc-prefetch-threads", cl::init(0), cl::Hidden,
+    cl::desc("Number of threads computing the function analyses of "
+             "independent RefSCCs ahead of the CGSCC walk (0 = disabled)"));
+
 // Explicit template instantiations and specialization definitions for core
 // template typedefs.
 namespace llvm {
@@ -284,6 +293,82 @@ bool FunctionAnalysisManagerCGSCCProxy::Result::invalidate(
   return false;
 }
 
+CGSCCAnalysisPrefetcher::CGSCCAnalysisPrefetcher(LazyCallGraph &CG,
+                                                 FunctionAnalysisManager &FAM)
+    : FAM(FAM), Pool(llvm::make_unique<ThreadPool>(CGSCCPrefetchThreads)) {
+  CG.buildRefSCCWaves(Waves);
+  for (unsigned I = 0, E = Waves.size(); I != E; ++I)
+    for (LazyCallGraph::RefSCC *RC : Waves[I])
+      WaveIndices[RC] = I;
+  PrefetchedWaves.resize(Waves.size());
+}
+
+CGSCCAnalysisPrefetcher::~CGSCCAnalysisPrefetcher() = default;
+
+bool CGSCCAnalysisPrefetcher::isEnabled() { return CGSCCPrefetchThreads != 0; }
+
+namespace {
+/// The analyses computed for one function by a prefetch thread.
+struct PrefetchedFunction {
+  Function *F;
+  const DominatorTree *CachedDT;
+  bool NeedLI;
+  DominatorTree DT;
+  LoopInfo LI;
+
+  PrefetchedFunction(Function &F, const DominatorTree *CachedDT, bool NeedLI)
+      : F(&F), CachedDT(CachedDT), NeedLI(NeedLI) {}
+};
+} // end anonymous namespace
+
+void CGSCCAnalysisPrefetcher::prefetch(
+    LazyCallGraph::RefSCC &RC,
+    const SmallPtrSetImpl<LazyCallGraph::RefSCC *> &InvalidRefSCCs) {
+  auto WI = WaveIndices.find(&RC);
+  if (WI == WaveIndices.end() || PrefetchedWaves.test(WI->second))
+    return;
+  PrefetchedWaves.set(WI->second);
+
+  // Collect the functions first so that the threads never touch the analysis
+  // manager, and so that the results are cached in a fixed order below.
+  std::vector<PrefetchedFunction> Work;
+  for (LazyCallGraph::RefSCC *WaveRC : Waves[WI->second]) {
+    if (InvalidRefSCCs.count(WaveRC))
+      continue;
+    for (LazyCallGraph::SCC &C : *WaveRC)
+      for (LazyCallGraph::Node &N : C) {
+        Function &F = N.getFunction();
+        if (F.isDeclaration())
+          continue;
+        auto *CachedDT = FAM.getCachedResult<DominatorTreeAnalysis>(F);
+        bool NeedLI = !FAM.getCachedResult<LoopAnalysis>(F);
+        if (CachedDT && !NeedLI)
+          continue;
+        Work.emplace_back(F, CachedDT, NeedLI);
+      }
+  }
+  if (Work.empty())
+    return;
+
+  LLVM_DEBUG(dbgs() << "Prefetching analyses of " << Work.size()
+                    << " functions in wave " << WI->second << "\n");
+  for (PrefetchedFunction &PF : Work)
+    Pool->async([&PF] {
+      if (!PF.CachedDT)
+        PF.DT.recalculate(*PF.F);
+      if (PF.NeedLI)
+        PF.LI.analyze(PF.CachedDT ? *PF.CachedDT : PF.DT);
+    });
+  Pool->wait();
+
+  for (PrefetchedFunction &PF : Work) {
+    if (!PF.CachedDT)
+      FAM.cacheResult<DominatorTreeAnalysis>(*PF.F, std::move(PF.DT));
+    if (PF.NeedLI)
+      FAM.cacheResult<LoopAnalysis>(*PF.F, std::move(PF.LI));
+  }
+}
+
 } // end namespace llvm
 
 /// When a new SCC is created for the graph and there might be function
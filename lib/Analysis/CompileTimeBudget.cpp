@@ -0,0 +1,71 @@
+//===- CompileTimeBudget.cpp - Per-function compile-time budget -----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the per-function compile-time budget shared by
+// expensive passes.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Analysis/CompileTimeBudget.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/OptimizationRemarkEmitter.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/Function.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "compile-time-budget"
+
+STATISTIC(NumFunctionsOverBudget,
+          "Number of functions that exhausted their compile-time budget");
+
+static cl::opt<unsigned> CompileTimeBudgetLimit(
+    "compile-time-budget", cl::init(0), cl::Hidden,
+    cl::desc("Number of work units expensive passes may spend on a single "
+             "function before degrading (0 = unlimited)"));
+
+bool CompileTimeBudget::consume(uint64_t Units) {
+  if (isUnlimited())
+    return true;
+  bool WasExhausted = isExhausted();
+  Used += Units;
+  if (!isExhausted())
+    return true;
+  if (!WasExhausted) {
+    ++NumFunctionsOverBudget;
+    LLVM_DEBUG(dbgs() << "Compile-time budget of " << Limit
+                      << " units exhausted\n");
+  }
+  return false;
+}
+
+void CompileTimeBudget::emitDegradationRemark(OptimizationRemarkEmitter &ORE,
+                                              const char *PassName,
+                                              const Function &F,
+                                              StringRef Action) const {
+  ORE.emit([&]() {
+    return OptimizationRemarkMissed(PassName, "CompileTimeBudgetExhausted",
+                                    F.getSubprogram(), &F.getEntryBlock())
+           << "compile-time budget exhausted (used " << ore::NV("Used", Used)
+           << " of " << ore::NV("Limit", Limit) << " units); " << Action;
+  });
+}
+
+AnalysisKey CompileTimeBudgetAnalysis::Key;
+
+bool CompileTimeBudgetAnalysis::isEnabled() {
+  return CompileTimeBudgetLimit != 0;
+}
+
+CompileTimeBudget CompileTimeBudgetAnalysis::run(Function &F,
+                                                 FunctionAnalysisManager &) {
+  return CompileTimeBudget(CompileTimeBudgetLimit);
+}
@@ -106,6 +106,8 @@ STATISTIC(GCDindependence, "GCD independence");
 STATISTIC(BanerjeeApplications, "Banerjee applications");
 STATISTIC(BanerjeeIndependence, "Banerjee independence");
 STATISTIC(BanerjeeSuccesses, "Banerjee successes");
+STATISTIC(GraphPairsSkipped,
+          "Dependence graph pairs found independent by base object");
 
 static cl::opt<bool>
     Delinearize("da-delinearize", cl::init(true), cl::Hidden, cl::ZeroOrMore,
@@ -3979,3 +3981,38 @@ const SCEV *DependenceInfo::getSplitIteration(const Dependence &Dep,
   llvm_unreachable("somehow reached end of routine");
   return nullptr;
 }
+
+//===----------------------------------------------------------------------===//
+// LoopDependenceGraph
+
+LoopDependenceGraph::LoopDependenceGraph(DependenceInfo &DI, const Loop &L)
+    : DI(DI), DL(L.getHeader()->getModule()->getDataLayout()) {}
+
+const Value *LoopDependenceGraph::getBaseObject(Instruction *I) {
+  const Value *&Obj = BaseObjects[I];
+  if (!Obj)
+    Obj = GetUnderlyingObject(getLoadStorePointerOperand(I), DL);
+  return Obj;
+}
+
+bool LoopDependenceGraph::mayDepend(Instruction *Src, Instruction *Dst) {
+  if (isa<LoadInst>(Src) && isa<LoadInst>(Dst))
+    return false;
+  if (!isLoadOrStore(Src) || !isLoadOrStore(Dst))
+    return true;
+  // This mirrors the underlying object check done by depends(), without the
+  // cost of an alias query.
+  const Value *SrcObj = getBaseObject(Src);
+  const Value *DstObj = getBaseObject(Dst);
+  return SrcObj == DstObj || !isIdentifiedObject(SrcObj) ||
+         !isIdentifiedObject(DstObj);
+}
+
+std::unique_ptr<Dependence> LoopDependenceGraph::depends(Instruction *Src,
+                                                         Instruction *Dst) {
+  if (!mayDepend(Src, Dst)) {
+    ++GraphPairsSkipped;
+    return nullptr;
+  }
+  return DI.depends(Src, Dst, true);
+}
@@ -43,6 +43,8 @@ using namespace llvm;
 #define DEBUG_TYPE "inline-cost"
 
 STATISTIC(NumCallsAnalyzed, "Number of call sites analyzed");
+STATISTIC(NumCalleeWalksReused,
+          "Number of call sites analyzed by reusing a cached callee walk");
 
 static cl::opt<int> InlineThreshold(
     "inline-threshold", cl::Hidden, cl::init(225), cl::ZeroOrMore,
@@ -69,6 +71,12 @@ static cl::opt<int>
                          cl::ZeroOrMore,
                          cl::desc("Threshold for hot callsites "));
 
+static cl::opt<int> SyntheticHotCallSiteThreshold(
+    "synthetic-hot-callsite-threshold", cl::Hidden, cl::init(1000),
+    cl::ZeroOrMore,
+    cl::desc("Threshold for callsites that are hot according to synthetic "
+             "entry counts"));
+
 static cl::opt<int> LocallyHotCallSiteThreshold(
     "locally-hot-callsite-threshold", cl::Hidden, cl::init(525), cl::ZeroOrMore,
     cl::desc("Threshold for locally hot callsites "));
@@ -90,6 +98,11 @@ static cl::opt<bool> OptComputeFullInlineCost(
     cl::desc("Compute the full inline cost of a call site even when the cost "
              "exceeds the threshold."));
 
+static cl::opt<unsigned> InlineCostCacheMaxContexts(
+    "inline-cost-cache-max-contexts", cl::Hidden, cl::init(8),
+    cl::desc("Maximum number of argument contexts for which the inline cost "
+             "walk of a single callee is cached"));
+
 namespace {
 
 class CallAnalyzer : public InstVisitor<CallAnalyzer, bool> {
@@ -181,6 +194,24 @@ class CallAnalyzer : public InstVisitor<CallAnalyzer, bool> {
   SmallPtrSet<Value *, 16> LoadAddrSet;
   int LoadEliminationCost;
 
+  /// Optional cache of callee body walks shared between call sites.
+  InlineCostCache *CalleeCache;
+
+  /// Cleared when the walk over the callee body depended on something other
+  /// than the callee and the argument context, e.g. the body of another
+  /// function or the caller, and thus must not be cached.
+  bool BodyIsCacheable;
+
+  /// Set when the walk over the callee body is going to be cached. A cached
+  /// walk is replayed for call sites with other thresholds, so it must not
+  /// stop once this call site's threshold is exceeded.
+  bool CacheBody;
+
+  /// Whether the walk has to continue after the threshold is exceeded.
+  bool shouldComputeFullCost() const {
+    return ComputeFullInlineCost || (CacheBody && BodyIsCacheable);
+  }
+
   // Custom simplification helper routines.
   bool isAllocaDerivedArg(Value *V);
   bool lookupSROAArgAndCost(Value *V, Value *&Arg,
@@ -226,9 +257,26 @@ class CallAnalyzer : public InstVisitor<CallAnalyzer, bool> {
   Optional<int> getHotCallSiteThreshold(CallSite CS,
                                         BlockFrequencyInfo *CallerBFI);
 
+  /// Compute the argument context of \p CS used as the key of the callee
+  /// cache. Returns false if the context cannot be cached.
+  bool computeCacheContext(CallSite CS,
+                           SmallVectorImpl<InlineCostCache::ArgInfo> &Context);
+
+  /// Record the result of a callee body walk which started at \p StartCost.
+  InlineCostCache::BodySummary summarizeBody(const InlineResult &IR,
+                                             bool IsUninlinablePattern,
+                                             int StartCost, bool SingleBB);
+
+  /// Apply the result of a previous walk of the callee body as if the body
+  /// had been walked for this call site.
+  void replayBody(const InlineCostCache::BodySummary &Summary);
+
+  /// Finish the analysis of \p CS once the callee body has been accounted for.
+  InlineResult finishAnalysis(CallSite CS);
+
   // Custom analysis routines.
   InlineResult analyzeBlock(BasicBlock *BB,
-                            SmallPtrSetImpl<const Value *> &EphValues);
+                            const SmallPtrSetImpl<const Value *> &EphValues);
 
   // Disable several entry points to the visitor so we don't accidentally use
   // them by declaring but not defining them here.
@@ -274,7 +322,8 @@ public:
                std::function<AssumptionCache &(Function &)> &GetAssumptionCache,
                Optional<function_ref<BlockFrequencyInfo &(Function &)>> &GetBFI,
                ProfileSummaryInfo *PSI, OptimizationRemarkEmitter *ORE,
-               Function &Callee, CallSite CSArg, const InlineParams &Params)
+               Function &Callee, CallSite CSArg, const InlineParams &Params,
+               InlineCostCache *CalleeCache = nullptr)
       : TTI(TTI), GetAssumptionCache(GetAssumptionCache), GetBFI(GetBFI),
         PSI(PSI), F(Callee), DL(F.getParent()->getDataLayout()), ORE(ORE),
         CandidateCS(CSArg), Params(Params), Threshold(Params.DefaultThreshold),
@@ -286,6 +335,7 @@ public:
         HasUninlineableIntrinsic(false), UsesVarArgs(false), AllocatedSize(0),
         NumInstructions(0), NumVectorInstructions(0), VectorBonus(0),
         SingleBBBonus(0), EnableLoadElimination(true), LoadEliminationCost(0),
+        CalleeCache(CalleeCache), BodyIsCacheable(true), CacheBody(false),
         NumConstantArgs(0), NumConstantOffsetPtrArgs(0), NumAllocaArgs(0),
         NumConstantPtrCmps(0), NumConstantPtrDiffs(0),
         NumInstructionsSimplified(0), SROACostSavings(0),
@@ -820,8 +870,11 @@ CallAnalyzer::getHotCallSiteThreshold(CallSite CS,
 
   // If global profile summary is available, then callsite's hotness is
   // determined based on that.
-  if (PSI && PSI->hasProfileSummary() && PSI->isHotCallSite(CS, CallerBFI))
+  if (PSI && PSI->hasProfileSummary() && PSI->isHotCallSite(CS, CallerBFI)) {
+    if (PSI->hasSyntheticProfile() && Params.SyntheticHotCallSiteThreshold)
+      return Params.SyntheticHotCallSiteThreshold;
     return Params.HotCallSiteThreshold;
+  }
 
   // Otherwise we need BFI to be available and to have a locally hot callsite
   // threshold.
@@ -1294,6 +1347,9 @@ bool CallAnalyzer::visitCallSite(CallSite CS) {
   IndirectCallParams.DefaultThreshold = InlineConstants::IndirectCallThreshold;
   CallAnalyzer CA(TTI, GetAssumptionCache, GetBFI, PSI, ORE, *F, CS,
                   IndirectCallParams);
+  // The bonus depends on the body of another function, which may change
+  // independently of this callee.
+  BodyIsCacheable = false;
   if (CA.analyzeCall(CS)) {
     // We were able to inline the indirect call! Subtract the cost from the
     // threshold to get the bonus we want to apply, but don't go below zero.
@@ -1435,7 +1491,7 @@ bool CallAnalyzer::visitSwitchInst(SwitchInst &SI) {
       std::min((int64_t)CostUpperBound,
                (int64_t)SI.getNumCases() * InlineConstants::InstrCost + Cost);
 
-  if (CostLowerBound > Threshold && !ComputeFullInlineCost) {
+  if (CostLowerBound > Threshold && !shouldComputeFullCost()) {
     Cost = CostLowerBound;
     return false;
   }
@@ -1544,7 +1600,7 @@ bool CallAnalyzer::visitInstruction(Instruction &I) {
 /// viable, and true if inlining remains viable.
 InlineResult
 CallAnalyzer::analyzeBlock(BasicBlock *BB,
-                           SmallPtrSetImpl<const Value *> &EphValues) {
+                           const SmallPtrSetImpl<const Value *> &EphValues) {
   for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I) {
     // FIXME: Currently, the number of instructions in a function regardless of
     // our ability to simplify them during inline to constants or dead code,
@@ -1606,6 +1662,7 @@ CallAnalyzer::analyzeBlock(BasicBlock *BB,
     // the caller stack usage dramatically.
     if (IsCallerRecursive &&
         AllocatedSize > InlineConstants::TotalAllocaSizeRecursiveCaller) {
+      BodyIsCacheable = false;
       InlineResult IR = "recursive and allocates too much stack space";
       if (ORE)
         ORE->emit([&]() {
@@ -1619,7 +1676,7 @@ CallAnalyzer::analyzeBlock(BasicBlock *BB,
 
     // Check if we've past the maximum possible threshold so we don't spin in
     // huge basic blocks that will never inline.
-    if (Cost >= Threshold && !ComputeFullInlineCost)
+    if (Cost >= Threshold && !shouldComputeFullCost())
       return false;
   }
 
@@ -1703,6 +1760,75 @@ void CallAnalyzer::findDeadBlocks(BasicBlock *CurrBB, BasicBlock *NextBB) {
   }
 }
 
+bool CallAnalyzer::computeCacheContext(
+    CallSite CS, SmallVectorImpl<InlineCostCache::ArgInfo> &Context) {
+  SmallVector<Value *, 4> Bases;
+  for (unsigned I = 0, E = CS.arg_size(); I != E; ++I) {
+    InlineCostCache::ArgInfo Info;
+    Value *V = CS.getArgument(I);
+    if (auto *C = dyn_cast<Constant>(V)) {
+      // Only constant data is never destroyed while the context is alive, so
+      // a key holding any other constant could later match a new constant
+      // allocated at the same address.
+      if (!isa<ConstantData>(C))
+        return false;
+      Info.C = C;
+    }
+
+    Value *PtrArg = V;
+    if (ConstantInt *Offset = stripAndComputeInBoundsConstantOffsets(PtrArg)) {
+      // Name the base by the first argument which shares it, the analysis only
+      // ever compares bases with each other.
+      auto It = find(Bases, PtrArg);
+      Info.BaseArgNo =
+          It == Bases.end() ? I : Context[It - Bases.begin()].BaseArgNo;
+      Info.Offset = Offset->getValue();
+      Info.IsAlloca = isa<AllocaInst>(PtrArg);
+    }
+    Bases.push_back(Info.BaseArgNo == -1 ? nullptr : PtrArg);
+    Info.IsNonNull = CS.paramHasAttr(I, Attribute::NonNull);
+    Context.push_back(std::move(Info));
+  }
+  return true;
+}
+
+InlineCostCache::BodySummary
+CallAnalyzer::summarizeBody(const InlineResult &IR, bool IsUninlinablePattern,
+                            int StartCost, bool SingleBB) {
+  InlineCostCache::BodySummary Summary;
+  Summary.FailureReason = IR.message;
+  Summary.IsUninlinablePattern = IsUninlinablePattern;
+  Summary.Cost = Cost - StartCost;
+  Summary.AllocatedSize = AllocatedSize;
+  Summary.NumInstructions = NumInstructions;
+  Summary.NumVectorInstructions = NumVectorInstructions;
+  Summary.SingleBB = SingleBB;
+  Summary.ContainsNoDuplicateCall = ContainsNoDuplicateCall;
+  Summary.NumConstantPtrCmps = NumConstantPtrCmps;
+  Summary.NumConstantPtrDiffs = NumConstantPtrDiffs;
+  Summary.NumInstructionsSimplified = NumInstructionsSimplified;
+  Summary.SROACostSavings = SROACostSavings;
+  Summary.SROACostSavingsLost = SROACostSavingsLost;
+  Summary.LoadEliminationCost = LoadEliminationCost;
+  return Summary;
+}
+
+void CallAnalyzer::replayBody(const InlineCostCache::BodySummary &Summary) {
+  Cost += Summary.Cost;
+  AllocatedSize = Summary.AllocatedSize;
+  NumInstructions = Summary.NumInstructions;
+  NumVectorInstructions = Summary.NumVectorInstructions;
+  if (!Summary.SingleBB)
+    Threshold -= SingleBBBonus;
+  ContainsNoDuplicateCall = Summary.ContainsNoDuplicateCall;
+  NumConstantPtrCmps = Summary.NumConstantPtrCmps;
+  NumConstantPtrDiffs = Summary.NumConstantPtrDiffs;
+  NumInstructionsSimplified = Summary.NumInstructionsSimplified;
+  SROACostSavings = Summary.SROACostSavings;
+  SROACostSavingsLost = Summary.SROACostSavingsLost;
+  LoadEliminationCost = Summary.LoadEliminationCost;
+}
+
 /// Analyze a call site for potential inlining.
 ///
 /// Returns true if inlining this call is viable, and false if it is not
@@ -1787,11 +1913,42 @@ InlineResult CallAnalyzer::analyzeCall(CallSite CS) {
   NumConstantOffsetPtrArgs = ConstantOffsetPtrs.size();
   NumAllocaArgs = SROAArgValues.size();
 
-  // FIXME: If a caller has multiple calls to a callee, we end up recomputing
-  // the ephemeral values multiple times (and they're completely determined by
-  // the callee, so this is purely duplicate work).
-  SmallPtrSet<const Value *, 32> EphValues;
-  CodeMetrics::collectEphemeralValues(&F, &GetAssumptionCache(F), EphValues);
+  // If another call site with the same argument context already walked the
+  // callee body, reuse that walk instead of repeating it.
+  SmallVector<InlineCostCache::ArgInfo, 4> Context;
+  bool ContextIsCacheable = CalleeCache && computeCacheContext(CS, Context);
+  if (ContextIsCacheable)
+    if (const InlineCostCache::BodySummary *Summary =
+            CalleeCache->lookup(Context)) {
+      ++NumCalleeWalksReused;
+      replayBody(*Summary);
+      if (Summary->FailureReason) {
+        if (ORE && Summary->IsUninlinablePattern)
+          ORE->emit([&]() {
+            return OptimizationRemarkMissed(DEBUG_TYPE, "NeverInline",
+                                            CandidateCS.getInstruction())
+                   << ore::NV("Callee", &F) << " has uninlinable pattern ("
+                   << ore::NV("InlineResult", Summary->FailureReason)
+                   << ") and cost is not fully computed";
+          });
+        return Summary->FailureReason;
+      }
+      return finishAnalysis(CS);
+    }
+  CacheBody = ContextIsCacheable;
+
+  // The ephemeral values are completely determined by the callee, so share
+  // them between call sites when we can.
+  SmallPtrSet<const Value *, 32> LocalEphValues;
+  const SmallPtrSetImpl<const Value *> *EphValues = &LocalEphValues;
+  if (CalleeCache)
+    EphValues = &CalleeCache->getEphemeralValues(F, GetAssumptionCache(F));
+  else
+    CodeMetrics::collectEphemeralValues(&F, &GetAssumptionCache(F),
+                                        LocalEphValues);
+  int StartCost = Cost;
+  InlineResult BodyResult = true;
+  bool IsUninlinablePattern = false;
 
   // The worklist of live basic blocks in the callee *after* inlining. We avoid
   // adding basic blocks of the callee which can be proven to be dead for this
@@ -1810,7 +1967,7 @@ InlineResult CallAnalyzer::analyzeCall(CallSite CS) {
   for (unsigned Idx = 0; Idx != BBWorklist.size(); ++Idx) {
     // Bail out the moment we cross the threshold. This means we'll under-count
     // the cost, but only when undercounting doesn't matter.
-    if (Cost >= Threshold && !ComputeFullInlineCost)
+    if (Cost >= Threshold && !shouldComputeFullCost())
       break;
 
     BasicBlock *BB = BBWorklist[Idx];
@@ -1823,14 +1980,21 @@ InlineResult CallAnalyzer::analyzeCall(CallSite CS) {
     // see an indirect branch that ends up being dead code at a particular call
     // site. If the blockaddress escapes the function, e.g., via a global
     // variable, inlining may lead to an invalid cross-function reference.
-    if (BB->hasAddressTaken())
-      return "blockaddress";
+    if (BB->hasAddressTaken()) {
+      BodyResult = "blockaddress";
+      break;
+    }
 
     // Analyze the cost of this block. If we blow through the threshold, this
     // returns false, and we can bail on out.
-    InlineResult IR = analyzeBlock(BB, EphValues);
-    if (!IR)
-      return IR;
+    InlineResult IR = analyzeBlock(BB, *EphValues);
+    if (!IR) {
+      BodyResult = IR;
+      IsUninlinablePattern = IsRecursiveCall || ExposesReturnsTwice ||
+                             HasDynamicAlloca || HasIndirectBr ||
+                             HasUninlineableIntrinsic || UsesVarArgs;
+      break;
+    }
 
     TerminatorInst *TI = BB->getTerminator();
 
@@ -1877,6 +2041,32 @@ InlineResult CallAnalyzer::analyzeCall(CallSite CS) {
     }
   }
 
+  if (ContextIsCacheable && BodyIsCacheable)
+    CalleeCache->insert(Context, summarizeBody(BodyResult, IsUninlinablePattern,
+                                               StartCost, SingleBB));
+  if (!BodyResult)
+    return BodyResult;
+
+  return finishAnalysis(CS);
+}
+
+/// Apply the parts of the analysis which depend on the caller and on the
+/// callee body as a whole, once the body has been walked.
+InlineResult CallAnalyzer::finishAnalysis(CallSite CS) {
+  // A cached walk of the body did not know whether the caller is recursive.
+  if (IsCallerRecursive &&
+      AllocatedSize > InlineConstants::TotalAllocaSizeRecursiveCaller) {
+    InlineResult IR = "recursive and allocates too much stack space";
+    if (ORE)
+      ORE->emit([&]() {
+        return OptimizationRemarkMissed(DEBUG_TYPE, "NeverInline",
+                                        CandidateCS.getInstruction())
+               << ore::NV("Callee", &F) << " is "
+               << ore::NV("InlineResult", IR.message);
+      });
+    return IR;
+  }
+
   bool OnlyOneCallAndLocalLinkage =
       F.hasLocalLinkage() && F.hasOneUse() && &F == CS.getCalledFunction();
   // If this is a noduplicate call, we can still inline as long as
@@ -1963,9 +2153,10 @@ InlineCost llvm::getInlineCost(
     CallSite CS, const InlineParams &Params, TargetTransformInfo &CalleeTTI,
     std::function<AssumptionCache &(Function &)> &GetAssumptionCache,
     Optional<function_ref<BlockFrequencyInfo &(Function &)>> GetBFI,
-    ProfileSummaryInfo *PSI, OptimizationRemarkEmitter *ORE) {
+    ProfileSummaryInfo *PSI, OptimizationRemarkEmitter *ORE,
+    InlineCostCache *CalleeCache) {
   return getInlineCost(CS, CS.getCalledFunction(), Params, CalleeTTI,
-                       GetAssumptionCache, GetBFI, PSI, ORE);
+                       GetAssumptionCache, GetBFI, PSI, ORE, CalleeCache);
 }
 
 InlineCost llvm::getInlineCost(
@@ -1973,7 +2164,8 @@ InlineCost llvm::getInlineCost(
     TargetTransformInfo &CalleeTTI,
     std::function<AssumptionCache &(Function &)> &GetAssumptionCache,
     Optional<function_ref<BlockFrequencyInfo &(Function &)>> GetBFI,
-    ProfileSummaryInfo *PSI, OptimizationRemarkEmitter *ORE) {
+    ProfileSummaryInfo *PSI, OptimizationRemarkEmitter *ORE,
+    InlineCostCache *CalleeCache) {
 
   // Cannot inline indirect calls.
   if (!Callee)
@@ -2032,7 +2224,7 @@ InlineCost llvm::getInlineCost(
                           << "... (caller:" << Caller->getName() << ")\n");
 
   CallAnalyzer CA(CalleeTTI, GetAssumptionCache, GetBFI, PSI, ORE, *Callee, CS,
-                  Params);
+                  Params, CalleeCache);
   InlineResult ShouldInline = CA.analyzeCall(CS);
 
   LLVM_DEBUG(CA.dump());
@@ -2046,6 +2238,33 @@ InlineCost llvm::getInlineCost(
   return llvm::InlineCost::get(CA.getCost(), CA.getThreshold());
 }
 
+const InlineCostCache::BodySummary *
+InlineCostCache::lookup(ArrayRef<ArgInfo> Context) const {
+  for (const auto &Entry : Entries)
+    if (makeArrayRef(Entry.first) == Context)
+      return &Entry.second;
+  return nullptr;
+}
+
+void InlineCostCache::insert(ArrayRef<ArgInfo> Context,
+                             const BodySummary &Summary) {
+  if (Entries.size() >= InlineCostCacheMaxContexts)
+    return;
+  Entries.emplace_back(SmallVector<ArgInfo, 4>(Context.begin(), Context.end()),
+                       Summary);
+}
+
+const SmallPtrSetImpl<const Value *> &
+InlineCostCache::getEphemeralValues(Function &Callee, AssumptionCache &AC) {
+  if (!HasEphValues) {
+    CodeMetrics::collectEphemeralValues(&Callee, &AC, EphValues);
+    HasEphValues = true;
+  }
+  return EphValues;
+}
+
+AnalysisKey InlineCostCacheAnalysis::Key;
+
 bool llvm::isInlineViable(Function &F) {
   bool ReturnsTwice = F.hasFnAttribute(Attribute::ReturnsTwice);
   for (Function::iterator BI = F.begin(), BE = F.end(); BI != BE; ++BI) {
@@ -2114,6 +2333,10 @@ InlineParams llvm::getInlineParams(int Threshold) {
   // Set the HotCallSiteThreshold knob from the -hot-callsite-threshold.
   Params.HotCallSiteThreshold = HotCallSiteThreshold;
 
+  // Set the SyntheticHotCallSiteThreshold knob from the
+  // -synthetic-hot-callsite-threshold.
+  Params.SyntheticHotCallSiteThreshold = SyntheticHotCallSiteThreshold;
+
   // If the -locally-hot-callsite-threshold is explicitly specified, use it to
   // populate LocallyHotCallSiteThreshold. Later, we populate
   // Params.LocallyHotCallSiteThreshold from -locally-hot-callsite-threshold if
@@ -1684,6 +1684,34 @@ void LazyCallGraph::buildSCCs(RefSCC &RC, node_stack_range Nodes) {
     RC.SCCIndices[RC.SCCs[i]] = i;
 }
 
+void LazyCallGraph::buildRefSCCWaves(
+    SmallVectorImpl<SmallVector<RefSCC *, 4>> &Waves) {
+  buildRefSCCs();
+  Waves.clear();
+
+  // Walking in post-order means every RefSCC reachable from the current one
+  // has already been assigned its wave.
+  DenseMap<RefSCC *, int> WaveIndices;
+  for (RefSCC &RC : postorder_ref_sccs()) {
+    int Wave = 0;
+    for (SCC &C : RC)
+      for (Node &N : C)
+        for (Edge &E : *N) {
+          RefSCC *TargetRC = lookupRefSCC(E.getNode());
+          if (TargetRC == &RC)
+            continue;
+          assert(WaveIndices.count(TargetRC) &&
+                 "Edge to a RefSCC which is not earlier in post-order!");
+          Wave = std::max(Wave, WaveIndices.lookup(TargetRC) + 1);
+        }
+
+    WaveIndices[&RC] = Wave;
+    if (Wave == (int)Waves.size())
+      Waves.emplace_back();
+    Waves[Wave].push_back(&RC);
+  }
+}
+
 void LazyCallGraph::buildRefSCCs() {
   if (EntryEdges.empty() || !PostOrderRefSCCs.empty())
     // RefSCCs are either non-existent or already built!
@@ -40,9 +40,11 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/InlineAsm.h"
 #include "llvm/IR/Metadata.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/ModuleSummaryIndex.h"
+#include "llvm/IR/Operator.h"
 #include "llvm/IR/Use.h"
 #include "llvm/IR/User.h"
 #include "llvm/Object/ModuleSymbolTable.h"
@@ -50,6 +52,8 @@
 #include "llvm/Pass.h"
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/MD5.h"
 #include <algorithm>
 #include <cassert>
 #include <cstdint>
@@ -71,6 +75,11 @@ cl::opt<FunctionSummary::ForceSummaryHotnessType, true> FSEC(
                           "all-non-critical", "All non-critical edges."),
                clEnumValN(FunctionSummary::FSHT_All, "all", "All edges.")));
 
+static cl::opt<bool> ComputeStructuralHash(
+    "module-summary-structural-hash", cl::init(false), cl::Hidden,
+    cl::desc("Record a structural hash of each function in the summary, used "
+             "to merge identical functions across modules in ThinLTO"));
+
 // Walk through the operands of a given User via worklist iteration and populate
 // the set of GlobalValue references encountered. Invoked either on an
 // Instruction or a GlobalVariable (which walks its initializer).
@@ -208,6 +217,345 @@ static void addIntrinsicToSummary(
   }
 }
 
+namespace {
+
+/// Computes a hash of a function definition that only depends on its
+/// structure, so that identical functions defined in different modules, maybe
+/// under different names, hash to the same value. Arguments, blocks and
+/// instructions are numbered in order, named types are hashed by their body,
+/// and anything whose meaning depends on the module it appears in (references
+/// to local or unnamed globals, block addresses) makes the function
+/// ineligible.
+class StructuralHasher {
+public:
+  StructuralHasher(const Module &M, const Function &F) : M(M), F(F) {
+    F.getContext().getMDKindNames(MDKindNames);
+  }
+
+  /// Return the hash of the function, or zero if it cannot be merged with
+  /// functions in other modules.
+  FunctionStructuralHash run();
+
+private:
+  // Tags distinguishing the kinds of values that can appear as operands.
+  enum OperandTag : uint64_t {
+    OT_Local,
+    OT_Constant,
+    OT_Self,
+    OT_Global,
+    OT_InlineAsm,
+    OT_Metadata,
+    OT_NewMetadata,
+  };
+
+  void add(uint64_t V) {
+    uint8_t Bytes[8];
+    support::endian::write64le(Bytes, V);
+    Hasher.update(Bytes);
+  }
+
+  void add(StringRef S) {
+    add(S.size());
+    Hasher.update(S);
+  }
+
+  void hashAPInt(const APInt &V);
+  void hashType(Type *Ty);
+  void hashAttributes(AttributeList AL);
+  void hashMetadata(const Metadata *MD);
+  void hashMetadataAttachments(
+      ArrayRef<std::pair<unsigned, MDNode *>> MDs);
+  void hashConstant(const Constant *C);
+  void hashValue(const Value *V);
+  void hashInstruction(const Instruction &I);
+
+  const Module &M;
+  const Function &F;
+  MD5 Hasher;
+  bool Eligible = true;
+  SmallVector<StringRef, 32> MDKindNames;
+  DenseMap<const Value *, uint64_t> LocalNumbers;
+  DenseMap<const Type *, uint64_t> StructNumbers;
+  DenseMap<const Metadata *, uint64_t> MDNumbers;
+};
+
+} // end anonymous namespace
+
+void StructuralHasher::hashAPInt(const APInt &V) {
+  add(V.getBitWidth());
+  for (unsigned I = 0, E = V.getNumWords(); I != E; ++I)
+    add(V.getRawData()[I]);
+}
+
+void StructuralHasher::hashType(Type *Ty) {
+  add(Ty->getTypeID());
+  if (auto *STy = dyn_cast<StructType>(Ty)) {
+    // Named structs may be recursive; hash each body once.
+    auto Inserted = StructNumbers.insert({STy, StructNumbers.size()});
+    add(Inserted.first->second);
+    if (!Inserted.second)
+      return;
+    add(STy->isPacked());
+    add(STy->isOpaque());
+  } else if (auto *ITy = dyn_cast<IntegerType>(Ty)) {
+    add(ITy->getBitWidth());
+  } else if (auto *PTy = dyn_cast<PointerType>(Ty)) {
+    add(PTy->getAddressSpace());
+  } else if (auto *SeqTy = dyn_cast<SequentialType>(Ty)) {
+    add(SeqTy->getNumElements());
+  } else if (auto *FTy = dyn_cast<FunctionType>(Ty)) {
+    add(FTy->isVarArg());
+  }
+  add(Ty->getNumContainedTypes());
+  for (Type *SubTy : Ty->subtypes())
+    hashType(SubTy);
+}
+
+void StructuralHasher::hashAttributes(AttributeList AL) {
+  add(AL.getNumAttrSets());
+  for (unsigned I = AL.index_begin(), E = AL.index_end(); I != E; ++I)
+    add(AL.getAsString(I));
+}
+
+void StructuralHasher::hashMetadata(const Metadata *MD) {
+  if (!MD) {
+    add(OT_Metadata);
+    add(~0ULL);
+    return;
+  }
+  auto Inserted = MDNumbers.insert({MD, MDNumbers.size()});
+  if (!Inserted.second) {
+    add(OT_Metadata);
+    add(Inserted.first->second);
+    return;
+  }
+  add(OT_NewMetadata);
+  add(MD->getMetadataID());
+  if (auto *S = dyn_cast<MDString>(MD)) {
+    add(S->getString());
+  } else if (auto *C = dyn_cast<ConstantAsMetadata>(MD)) {
+    hashConstant(C->getValue());
+  } else if (auto *L = dyn_cast<LocalAsMetadata>(MD)) {
+    hashValue(L->getValue());
+  } else if (auto *N = dyn_cast<MDTuple>(MD)) {
+    add(N->isDistinct());
+    add(N->getNumOperands());
+    for (const MDOperand &Op : N->operands())
+      hashMetadata(Op);
+  }
+  // Other nodes carry debug information, which does not affect the code.
+}
+
+void StructuralHasher::hashMetadataAttachments(
+    ArrayRef<std::pair<unsigned, MDNode *>> MDs) {
+  for (auto &MD : MDs) {
+    if (MD.first == LLVMContext::MD_dbg || MD.first == LLVMContext::MD_prof)
+      continue;
+    // Custom kind IDs are assigned per context, so hash the name instead.
+    add(MDKindNames[MD.first]);
+    hashMetadata(MD.second);
+  }
+}
+
+void StructuralHasher::hashConstant(const Constant *C) {
+  if (auto *GV = dyn_cast<GlobalValue>(C)) {
+    if (GV == &F) {
+      add(OT_Self);
+      return;
+    }
+    // Local and unnamed globals are different objects in each module.
+    if (GV->hasLocalLinkage() || !GV->hasName()) {
+      Eligible = false;
+      return;
+    }
+    add(OT_Global);
+    add(GV->getName());
+    hashType(GV->getType());
+    return;
+  }
+  if (isa<BlockAddress>(C)) {
+    Eligible = false;
+    return;
+  }
+
+  add(OT_Constant);
+  add(C->getValueID());
+  hashType(C->getType());
+  if (auto *CI = dyn_cast<ConstantInt>(C)) {
+    hashAPInt(CI->getValue());
+  } else if (auto *CFP = dyn_cast<ConstantFP>(C)) {
+    hashAPInt(CFP->getValueAPF().bitcastToAPInt());
+  } else if (auto *CDS = dyn_cast<ConstantDataSequential>(C)) {
+    add(CDS->getRawDataValues());
+  } else if (auto *CE = dyn_cast<ConstantExpr>(C)) {
+    add(CE->getOpcode());
+    add(CE->getRawSubclassOptionalData());
+    if (CE->isCompare())
+      add(CE->getPredicate());
+    if (CE->hasIndices())
+      for (unsigned Idx : CE->getIndices())
+        add(Idx);
+    if (auto *GEP = dyn_cast<GEPOperator>(CE))
+      hashType(GEP->getSourceElementType());
+  }
+  add(C->getNumOperands());
+  for (const Use &Op : C->operands())
+    hashConstant(cast<Constant>(Op));
+}
+
+void StructuralHasher::hashValue(const Value *V) {
+  if (auto *C = dyn_cast<Constant>(V)) {
+    hashConstant(C);
+    return;
+  }
+  auto It = LocalNumbers.find(V);
+  if (It != LocalNumbers.end()) {
+    add(OT_Local);
+    add(It->second);
+    return;
+  }
+  if (auto *IA = dyn_cast<InlineAsm>(V)) {
+    add(OT_InlineAsm);
+    hashType(IA->getFunctionType());
+    add(IA->getAsmString());
+    add(IA->getConstraintString());
+    add(IA->hasSideEffects());
+    add(IA->isAlignStack());
+    add(IA->getDialect());
+    return;
+  }
+  if (auto *MAV = dyn_cast<MetadataAsValue>(V)) {
+    hashMetadata(MAV->getMetadata());
+    return;
+  }
+  Eligible = false;
+}
+
+void StructuralHasher::hashInstruction(const Instruction &I) {
+  add(I.getOpcode());
+  hashType(I.getType());
+  add(I.getRawSubclassOptionalData());
+  add(I.getNumOperands());
+  for (const Use &Op : I.operands())
+    hashValue(Op);
+
+  if (auto *PN = dyn_cast<PHINode>(&I)) {
+    for (const BasicBlock *BB : PN->blocks())
+      hashValue(BB);
+  } else if (auto *AI = dyn_cast<AllocaInst>(&I)) {
+    hashType(AI->getAllocatedType());
+    add(AI->getAlignment());
+    add(AI->isUsedWithInAlloca());
+    add(AI->isSwiftError());
+  } else if (auto *LI = dyn_cast<LoadInst>(&I)) {
+    add(LI->isVolatile());
+    add(LI->getAlignment());
+    add(static_cast<uint64_t>(LI->getOrdering()));
+    add(LI->getSyncScopeID());
+  } else if (auto *SI = dyn_cast<StoreInst>(&I)) {
+    add(SI->isVolatile());
+    add(SI->getAlignment());
+    add(static_cast<uint64_t>(SI->getOrdering()));
+    add(SI->getSyncScopeID());
+  } else if (auto *CI = dyn_cast<CmpInst>(&I)) {
+    add(CI->getPredicate());
+  } else if (auto CS = ImmutableCallSite(&I)) {
+    hashType(CS.getFunctionType());
+    add(CS.getCallingConv());
+    hashAttributes(CS.getAttributes());
+    if (auto *Call = dyn_cast<CallInst>(&I))
+      add(Call->getTailCallKind());
+    add(CS.getNumOperandBundles());
+    for (unsigned B = 0, E = CS.getNumOperandBundles(); B != E; ++B) {
+      OperandBundleUse Bundle = CS.getOperandBundleAt(B);
+      add(Bundle.getTagName());
+      add(Bundle.Inputs.size());
+    }
+  } else if (auto *GEP = dyn_cast<GetElementPtrInst>(&I)) {
+    hashType(GEP->getSourceElementType());
+  } else if (auto *EVI = dyn_cast<ExtractValueInst>(&I)) {
+    for (unsigned Idx : EVI->indices())
+      add(Idx);
+  } else if (auto *IVI = dyn_cast<InsertValueInst>(&I)) {
+    for (unsigned Idx : IVI->indices())
+      add(Idx);
+  } else if (auto *FI = dyn_cast<FenceInst>(&I)) {
+    add(static_cast<uint64_t>(FI->getOrdering()));
+    add(FI->getSyncScopeID());
+  } else if (auto *CXI = dyn_cast<AtomicCmpXchgInst>(&I)) {
+    add(CXI->isVolatile());
+    add(CXI->isWeak());
+    add(static_cast<uint64_t>(CXI->getSuccessOrdering()));
+    add(static_cast<uint64_t>(CXI->getFailureOrdering()));
+    add(CXI->getSyncScopeID());
+  } else if (auto *RMWI = dyn_cast<AtomicRMWInst>(&I)) {
+    add(RMWI->getOperation());
+    add(RMWI->isVolatile());
+    add(static_cast<uint64_t>(RMWI->getOrdering()));
+    add(RMWI->getSyncScopeID());
+  } else if (auto *LP = dyn_cast<LandingPadInst>(&I)) {
+    add(LP->isCleanup());
+  }
+
+  SmallVector<std::pair<unsigned, MDNode *>, 4> MDs;
+  I.getAllMetadataOtherThanDebugLoc(MDs);
+  hashMetadataAttachments(MDs);
+}
+
+FunctionStructuralHash StructuralHasher::run() {
+  if (F.isDeclaration() || F.hasLocalLinkage() || F.hasPrefixData() ||
+      F.hasPrologueData())
+    return {{0, 0}};
+
+  add(M.getDataLayoutStr());
+  add(M.getTargetTriple());
+  hashType(F.getFunctionType());
+  add(F.getCallingConv());
+  hashAttributes(F.getAttributes());
+  add(F.hasGC() ? F.getGC() : "");
+  add(F.getSection());
+  add(F.getAlignment());
+  add(F.hasPersonalityFn());
+  if (F.hasPersonalityFn())
+    hashConstant(F.getPersonalityFn());
+  SmallVector<std::pair<unsigned, MDNode *>, 4> MDs;
+  F.getAllMetadata(MDs);
+  hashMetadataAttachments(MDs);
+
+  uint64_t NextNumber = 0;
+  for (const Argument &A : F.args())
+    LocalNumbers[&A] = NextNumber++;
+  for (const BasicBlock &BB : F) {
+    LocalNumbers[&BB] = NextNumber++;
+    for (const Instruction &I : BB)
+      if (!isa<DbgInfoIntrinsic>(I))
+        LocalNumbers[&I] = NextNumber++;
+  }
+
+  for (const BasicBlock &BB : F)
+    for (const Instruction &I : BB) {
+      if (isa<DbgInfoIntrinsic>(I))
+        continue;
+      hashInstruction(I);
+      if (!Eligible)
+        return {{0, 0}};
+    }
+  if (!Eligible)
+    return {{0, 0}};
+
+  MD5::MD5Result Result;
+  Hasher.final(Result);
+  // Zero means "not hashed".
+  if (!Result.high() && !Result.low())
+    return {{0, 1}};
+  return {{Result.high(), Result.low()}};
+}
+
+FunctionStructuralHash llvm::computeFunctionStructuralHash(const Module &M,
+                                                          const Function &F) {
+  return StructuralHasher(M, F).run();
+}
+
 static void
 computeFunctionSummary(ModuleSummaryIndex &Index, const Module &M,
                        const Function &F, BlockFrequencyInfo *BFI,
@@ -359,13 +707,87 @@ computeFunctionSummary(ModuleSummaryIndex &Index, const Module &M,
       TypeTestAssumeVCalls.takeVector(), TypeCheckedLoadVCalls.takeVector(),
       TypeTestAssumeConstVCalls.takeVector(),
       TypeCheckedLoadConstVCalls.takeVector());
+  // Inline asm may refer to local symbols by name, so the same body can mean
+  // different things in different modules.
+  if (ComputeStructuralHash && !HasInlineAsmMaybeReferencingInternal)
+    FuncSummary->setStructuralHash(StructuralHasher(M, F).run());
   if (NonRenamableLocal)
     CantBePromoted.insert(F.getGUID());
   Index.addGlobalValueSummary(F, std::move(FuncSummary));
 }
 
+/// Find the function pointers in the initializer \p I of a vtable, which
+/// starts at \p StartingOffset bytes from the start of the vtable, and add
+/// them with their offsets to \p VTableFuncs. Pointers to anything else are
+/// added without a function, so that calls through them are not
+/// devirtualized.
+static void findFuncPointers(const Constant *I, uint64_t StartingOffset,
+                             const Module &M, ModuleSummaryIndex &Index,
+                             VTableFuncList &VTableFuncs) {
+  if (I->getType()->isPointerTy()) {
+    const Value *V = I->stripPointerCasts();
+    if (isa<ConstantPointerNull>(V) || isa<UndefValue>(V))
+      return;
+    // An alias that cannot be interposed, such as a C++ destructor alias,
+    // always calls its aliasee.
+    if (auto *GA = dyn_cast<GlobalAlias>(V))
+      if (!GA->isInterposable())
+        V = GA->getBaseObject();
+    auto *Fn = dyn_cast_or_null<Function>(V);
+    if (!Fn) {
+      VTableFuncs.push_back({ValueInfo(), StartingOffset});
+      return;
+    }
+    // We can disregard __cxa_pure_virtual as a possible call target, as
+    // calls to pure virtuals are UB.
+    if (Fn->getName() != "__cxa_pure_virtual")
+      VTableFuncs.push_back({Index.getOrInsertValueInfo(Fn), StartingOffset});
+    return;
+  }
+
+  const DataLayout &DL = M.getDataLayout();
+  if (auto *C = dyn_cast<ConstantStruct>(I)) {
+    const StructLayout *SL = DL.getStructLayout(C->getType());
+    for (unsigned Op = 0, E = C->getNumOperands(); Op != E; ++Op)
+      findFuncPointers(C->getOperand(Op),
+                       StartingOffset + SL->getElementOffset(Op), M, Index,
+                       VTableFuncs);
+  } else if (auto *C = dyn_cast<ConstantArray>(I)) {
+    uint64_t EltSize = DL.getTypeAllocSize(C->getType()->getElementType());
+    for (unsigned Op = 0, E = C->getNumOperands(); Op != E; ++Op)
+      findFuncPointers(C->getOperand(Op), StartingOffset + Op * EltSize, M,
+                       Index, VTableFuncs);
+  }
+}
+
+/// Record the functions in the vtable \p V, and the type identifiers it is
+/// compatible with according to its !type metadata \p Types, so that virtual
+/// calls can be devirtualized on the index.
+static void computeVTableFuncs(ModuleSummaryIndex &Index,
+                               const GlobalVariable &V, const Module &M,
+                               ArrayRef<MDNode *> Types,
+                               GlobalVarSummary &Summary) {
+  VTableFuncList VTableFuncs;
+  findFuncPointers(V.getInitializer(), 0, M, Index, VTableFuncs);
+  Summary.setVTableFuncs(std::move(VTableFuncs));
+
+  for (MDNode *Type : Types) {
+    // Type identifiers that are not strings are local to the module.
+    auto *TypeId = dyn_cast<MDString>(Type->getOperand(1));
+    if (!TypeId)
+      continue;
+    uint64_t Offset =
+        cast<ConstantInt>(
+            cast<ConstantAsMetadata>(Type->getOperand(0))->getValue())
+            ->getZExtValue();
+    Index.getOrInsertTypeIdCompatibleVtableSummary(TypeId->getString())
+        .push_back({Offset, Index.getOrInsertValueInfo(&V)});
+  }
+}
+
 static void
 computeVariableSummary(ModuleSummaryIndex &Index, const GlobalVariable &V,
+                       const Module &M,
                        DenseSet<GlobalValue::GUID> &CantBePromoted) {
   SetVector<ValueInfo> RefEdges;
   SmallPtrSet<const User *, 8> Visited;
@@ -375,6 +797,12 @@ computeVariableSummary(ModuleSummaryIndex &Index, const GlobalVariable &V,
                                     /* Live = */ false, V.isDSOLocal());
   auto GVarSummary =
       llvm::make_unique<GlobalVarSummary>(Flags, RefEdges.takeVector());
+
+  // Only constant initializers describe the functions a vtable points to.
+  SmallVector<MDNode *, 2> Types;
+  V.getMetadata(LLVMContext::MD_type, Types);
+  if (!Types.empty() && V.isConstant())
+    computeVTableFuncs(Index, V, M, Types, *GVarSummary);
   if (NonRenamableLocal)
     CantBePromoted.insert(V.getGUID());
   Index.addGlobalValueSummary(V, std::move(GVarSummary));
@@ -509,7 +937,7 @@ ModuleSummaryIndex llvm::buildModuleSummaryIndex(
   for (const GlobalVariable &G : M.globals()) {
     if (G.isDeclaration())
       continue;
-    computeVariableSummary(Index, G, CantBePromoted);
+    computeVariableSummary(Index, G, M, CantBePromoted);
   }
 
   // Compute summaries for all aliases defined in module, and save in the
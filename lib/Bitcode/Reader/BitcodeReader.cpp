@@ -5195,6 +5195,8 @@ Error ModuleSummaryIndexBitcodeReader::parseEntireSummary(unsigned ID) {
       PendingTypeCheckedLoadVCalls;
   std::vector<FunctionSummary::ConstVCall> PendingTypeTestAssumeConstVCalls,
       PendingTypeCheckedLoadConstVCalls;
+  FunctionStructuralHash PendingStructuralHash = {{0, 0}};
+  uint64_t PendingEntryCount = 0;
 
   while (true) {
     BitstreamEntry Entry = Stream.advanceSkippingSubblocks();
@@ -5293,6 +5295,8 @@ Error ModuleSummaryIndexBitcodeReader::parseEntireSummary(unsigned ID) {
       PendingTypeCheckedLoadVCalls.clear();
       PendingTypeTestAssumeConstVCalls.clear();
       PendingTypeCheckedLoadConstVCalls.clear();
+      FS->setStructuralHash(PendingStructuralHash);
+      PendingStructuralHash = {{0, 0}};
       auto VIAndOriginalGUID = getValueInfoFromValueId(ValueID);
       FS->setModulePath(getThisModule()->first());
       FS->setOriginalName(VIAndOriginalGUID.second);
@@ -5343,6 +5347,44 @@ Error ModuleSummaryIndexBitcodeReader::parseEntireSummary(unsigned ID) {
       TheIndex.addGlobalValueSummary(GUID.first, std::move(FS));
       break;
     }
+    // FS_PERMODULE_VTABLE_GLOBALVAR_INIT_REFS: [valueid, flags, numrefs,
+    //                                           numrefs x valueid, numfuncs,
+    //                                           numfuncs x (valueid, offset),
+    //                                           n x offset]
+    case bitc::FS_PERMODULE_VTABLE_GLOBALVAR_INIT_REFS: {
+      unsigned ValueID = Record[0];
+      uint64_t RawFlags = Record[1];
+      auto Flags = getDecodedGVSummaryFlags(RawFlags, Version);
+      unsigned NumRefs = Record[2];
+      unsigned RefListStartIndex = 3;
+      unsigned FuncListStartIndex = RefListStartIndex + NumRefs + 1;
+      if (Record.size() < FuncListStartIndex)
+        return error("Invalid record");
+      unsigned NumFuncs = Record[FuncListStartIndex - 1];
+      unsigned UnknownListStartIndex = FuncListStartIndex + 2 * NumFuncs;
+      if (Record.size() < UnknownListStartIndex)
+        return error("Invalid record");
+      std::vector<ValueInfo> Refs = makeRefList(
+          ArrayRef<uint64_t>(Record).slice(RefListStartIndex, NumRefs));
+      VTableFuncList VTableFuncs;
+      for (unsigned I = FuncListStartIndex; I != UnknownListStartIndex; I += 2)
+        VTableFuncs.push_back(
+            {getValueInfoFromValueId(Record[I]).first, Record[I + 1]});
+      // Pointers that are not known functions have no value id.
+      for (unsigned I = UnknownListStartIndex, E = Record.size(); I != E; ++I)
+        VTableFuncs.push_back({ValueInfo(), Record[I]});
+      llvm::sort(VTableFuncs.begin(), VTableFuncs.end(),
+                 [](const VirtFuncOffset &L, const VirtFuncOffset &R) {
+                   return L.VTableOffset < R.VTableOffset;
+                 });
+      auto VS = llvm::make_unique<GlobalVarSummary>(Flags, std::move(Refs));
+      VS->setVTableFuncs(std::move(VTableFuncs));
+      VS->setModulePath(getThisModule()->first());
+      auto GUID = getValueInfoFromValueId(ValueID);
+      VS->setOriginalName(GUID.second);
+      TheIndex.addGlobalValueSummary(GUID.first, std::move(VS));
+      break;
+    }
     // FS_COMBINED: [valueid, modid, flags, instcount, fflags, numrefs,
     //               numrefs x valueid, n x (valueid)]
     // FS_COMBINED_PROFILE: [valueid, modid, flags, instcount, fflags, numrefs,
@@ -5386,6 +5428,10 @@ Error ModuleSummaryIndexBitcodeReader::parseEntireSummary(unsigned ID) {
       PendingTypeCheckedLoadVCalls.clear();
       PendingTypeTestAssumeConstVCalls.clear();
       PendingTypeCheckedLoadConstVCalls.clear();
+      FS->setStructuralHash(PendingStructuralHash);
+      PendingStructuralHash = {{0, 0}};
+      FS->setEntryCount(PendingEntryCount);
+      PendingEntryCount = 0;
       LastSeenSummary = FS.get();
       LastSeenGUID = VI.getGUID();
       FS->setModulePath(ModuleIdMap[ModuleId]);
@@ -5473,6 +5519,20 @@ Error ModuleSummaryIndexBitcodeReader::parseEntireSummary(unsigned ID) {
           {{Record[0], Record[1]}, {Record.begin() + 2, Record.end()}});
       break;
 
+    case bitc::FS_STRUCTURAL_HASH:
+      assert(!PendingStructuralHash[0] && !PendingStructuralHash[1]);
+      if (Record.size() != 2)
+        return error("Invalid record");
+      PendingStructuralHash = {{Record[0], Record[1]}};
+      break;
+
+    case bitc::FS_ENTRY_COUNT:
+      assert(!PendingEntryCount);
+      if (Record.size() != 1)
+        return error("Invalid record");
+      PendingEntryCount = Record[0];
+      break;
+
     case bitc::FS_CFI_FUNCTION_DEFS: {
       std::set<std::string> &CfiFunctionDefs = TheIndex.cfiFunctionDefs();
       for (unsigned I = 0; I != Record.size(); I += 2)
@@ -5492,6 +5552,18 @@ Error ModuleSummaryIndexBitcodeReader::parseEntireSummary(unsigned ID) {
     case bitc::FS_TYPE_ID:
       parseTypeIdSummaryRecord(Record, Strtab, TheIndex);
       break;
+
+    case bitc::FS_TYPE_ID_METADATA: {
+      if (Record.size() < 2 || Record.size() % 2)
+        return error("Invalid record");
+      TypeIdCompatibleVtableInfo &Info =
+          TheIndex.getOrInsertTypeIdCompatibleVtableSummary(
+              {Strtab.data() + Record[0], static_cast<size_t>(Record[1])});
+      for (unsigned I = 2, E = Record.size(); I != E; I += 2)
+        Info.push_back(
+            {Record[I], getValueInfoFromValueId(Record[I + 1]).first});
+      break;
+    }
     }
   }
   llvm_unreachable("Exit infinite loop");
@@ -3400,6 +3400,17 @@ static void writeFunctionTypeMetadataRecords(
                      FS->type_checked_load_const_vcalls());
 }
 
+/// Write the structural hash record that needs to appear before a function
+/// summary entry, if the function was hashed.
+static void writeFunctionStructuralHashRecord(BitstreamWriter &Stream,
+                                              FunctionSummary *FS) {
+  if (FS->hasStructuralHash()) {
+    const FunctionStructuralHash &Hash = FS->structuralHash();
+    uint64_t Record[] = {Hash[0], Hash[1]};
+    Stream.EmitRecord(bitc::FS_STRUCTURAL_HASH, Record);
+  }
+}
+
 static void writeWholeProgramDevirtResolutionByArg(
     SmallVector<uint64_t, 64> &NameVals, const std::vector<uint64_t> &args,
     const WholeProgramDevirtResolution::ByArg &ByArg) {
@@ -3455,6 +3466,7 @@ void ModuleBitcodeWriterBase::writePerModuleFunctionSummaryRecord(
   FunctionSummary *FS = cast<FunctionSummary>(Summary);
   std::set<GlobalValue::GUID> ReferencedTypeIds;
   writeFunctionTypeMetadataRecords(Stream, FS, ReferencedTypeIds);
+  writeFunctionStructuralHashRecord(Stream, FS);
 
   NameVals.push_back(getEncodedGVSummaryFlags(FS->flags()));
   NameVals.push_back(FS->instCount());
@@ -3502,6 +3514,10 @@ void ModuleBitcodeWriterBase::writeModuleLevelReferences(
   GlobalVarSummary *VS = cast<GlobalVarSummary>(Summary);
   NameVals.push_back(getEncodedGVSummaryFlags(VS->flags()));
 
+  auto VTableFuncs = VS->vTableFuncs();
+  if (!VTableFuncs.empty())
+    NameVals.push_back(VS->refs().size());
+
   unsigned SizeBeforeRefs = NameVals.size();
   for (auto &RI : VS->refs())
     NameVals.push_back(VE.getValueID(RI.getValue()));
@@ -3509,8 +3525,23 @@ void ModuleBitcodeWriterBase::writeModuleLevelReferences(
   // been initialized from a DenseSet.
   llvm::sort(NameVals.begin() + SizeBeforeRefs, NameVals.end());
 
-  Stream.EmitRecord(bitc::FS_PERMODULE_GLOBALVAR_INIT_REFS, NameVals,
-                    FSModRefsAbbrev);
+  if (VTableFuncs.empty()) {
+    Stream.EmitRecord(bitc::FS_PERMODULE_GLOBALVAR_INIT_REFS, NameVals,
+                      FSModRefsAbbrev);
+  } else {
+    // The vtable functions are already sorted by offset.
+    NameVals.push_back(llvm::count_if(
+        VTableFuncs, [](const VirtFuncOffset &P) { return bool(P.FuncVI); }));
+    for (auto &P : VTableFuncs)
+      if (P.FuncVI) {
+        NameVals.push_back(VE.getValueID(P.FuncVI.getValue()));
+        NameVals.push_back(P.VTableOffset);
+      }
+    for (auto &P : VTableFuncs)
+      if (!P.FuncVI)
+        NameVals.push_back(P.VTableOffset);
+    Stream.EmitRecord(bitc::FS_PERMODULE_VTABLE_GLOBALVAR_INIT_REFS, NameVals);
+  }
   NameVals.clear();
 }
 
@@ -3632,6 +3663,18 @@ void ModuleBitcodeWriterBase::writePerModuleGlobalValueSummary() {
     NameVals.clear();
   }
 
+  // Emit the vtable address points compatible with each type identifier.
+  for (auto &TId : Index->typeIdCompatibleVtableMap()) {
+    NameVals.push_back(StrtabBuilder.add(TId.first));
+    NameVals.push_back(TId.first.size());
+    for (auto &P : TId.second) {
+      NameVals.push_back(P.AddressPointOffset);
+      NameVals.push_back(VE.getValueID(P.VTableVI.getValue()));
+    }
+    Stream.EmitRecord(bitc::FS_TYPE_ID_METADATA, NameVals);
+    NameVals.clear();
+  }
+
   Stream.ExitBlock();
 }
 
@@ -3765,6 +3808,11 @@ void IndexBitcodeWriter::writeCombinedGlobalValueSummary() {
 
     auto *FS = cast<FunctionSummary>(S);
     writeFunctionTypeMetadataRecords(Stream, FS, ReferencedTypeIds);
+    writeFunctionStructuralHashRecord(Stream, FS);
+    if (uint64_t EntryCount = FS->entryCount()) {
+      uint64_t Record[] = {EntryCount};
+      Stream.EmitRecord(bitc::FS_ENTRY_COUNT, Record);
+    }
 
     NameVals.push_back(*ValueId);
     NameVals.push_back(Index.getModuleId(FS->modulePath()));
@@ -22,7 +22,8 @@
 
 using namespace llvm;
 
-const char *ProfileSummary::KindStr[2] = {"InstrProf", "SampleProfile"};
+const char *ProfileSummary::KindStr[3] = {"InstrProf", "SampleProfile",
+                                          "SyntheticProfile"};
 
 // Return an MDTuple with two elements. The first element is a string Key and
 // the second is a uint64_t Value.
@@ -65,9 +66,10 @@ Metadata *ProfileSummary::getDetailedSummaryMD(LLVMContext &Context) {
 
 // This returns an MDTuple representing this ProfileSummary object. The first
 // entry of this tuple is another MDTuple of two elements: a string
-// "ProfileFormat" and a string representing the format ("InstrProf" or
-// "SampleProfile"). The rest of the elements of the outer MDTuple are specific
-// to the kind of profile summary as returned by getFormatSpecificMD.
+// "ProfileFormat" and a string representing the format ("InstrProf",
+// "SampleProfile" or "SyntheticProfile"). The rest of the elements of the
+// outer MDTuple are specific to the kind of profile summary as returned by
+// getFormatSpecificMD.
 Metadata *ProfileSummary::getMD(LLVMContext &Context) {
   Metadata *Components[] = {
     getKeyValMD(Context, "ProfileFormat", KindStr[PSK]),
@@ -154,6 +156,9 @@ ProfileSummary *ProfileSummary::getFromMD(Metadata *MD) {
   else if (isKeyValuePair(dyn_cast_or_null<MDTuple>(FormatMD), "ProfileFormat",
                           "InstrProf"))
     SummaryKind = PSK_Instr;
+  else if (isKeyValuePair(dyn_cast_or_null<MDTuple>(FormatMD), "ProfileFormat",
+                          "SyntheticProfile"))
+    SummaryKind = PSK_Synthetic;
   else
     return nullptr;
 
@@ -25,6 +25,7 @@
 #include "llvm/IR/Mangler.h"
 #include "llvm/IR/Metadata.h"
 #include "llvm/LTO/LTOBackend.h"
+#include "llvm/LTO/SummaryBasedOptimizations.h"
 #include "llvm/Linker/IRMover.h"
 #include "llvm/Object/IRObjectFile.h"
 #include "llvm/Support/Error.h"
@@ -42,6 +43,7 @@
 #include "llvm/Target/TargetOptions.h"
 #include "llvm/Transforms/IPO.h"
 #include "llvm/Transforms/IPO/PassManagerBuilder.h"
+#include "llvm/Transforms/IPO/WholeProgramDevirt.h"
 #include "llvm/Transforms/Utils/SplitModule.h"
 
 #include <set>
@@ -56,6 +58,11 @@ static cl::opt<bool>
     DumpThinCGSCCs("dump-thin-cg-sccs", cl::init(false), cl::Hidden,
                    cl::desc("Dump the SCCs in the ThinLTO index's callgraph"));
 
+static cl::opt<bool> EnableThinLTOFunctionMerging(
+    "thinlto-merge-functions", cl::init(false), cl::Hidden,
+    cl::desc("Merge functions with the same structural hash in different "
+             "ThinLTO modules into a single copy"));
+
 // The values are (type identifier, summary) pairs.
 typedef DenseMap<
     GlobalValue::GUID,
@@ -215,6 +222,13 @@ static void computeCacheKey(
         ArrayRef<uint8_t>((const uint8_t *)&Linkage, sizeof(Linkage)));
     AddUsedCfiGlobal(GS.first);
     AddUsedThings(GS.second);
+    // Functions merged into another copy are replaced by a thunk to it.
+    if (auto *FS = dyn_cast<FunctionSummary>(GS.second)) {
+      if (ValueInfo Canonical = FS->mergedInto())
+        AddUint64(Canonical.getGUID());
+      // The synthetic entry counts are set on the defined functions.
+      AddUint64(FS->entryCount());
+    }
   }
 
   // Imported functions may introduce new uses of type identifier resolutions,
@@ -599,9 +613,12 @@ LTO::addRegularLTO(BitcodeModule BM, ArrayRef<InputFile::Symbol> Syms,
   ModuleSymbolTable SymTab;
   SymTab.addModule(&M);
 
-  for (GlobalVariable &GV : M.globals())
+  for (GlobalVariable &GV : M.globals()) {
     if (GV.hasAppendingLinkage())
       Mod.Keep.push_back(&GV);
+    if (GV.hasMetadata(LLVMContext::MD_type))
+      RegularLTO.HasTypeMetadata = true;
+  }
 
   DenseSet<GlobalObject *> AliasedGlobals;
   for (auto &GA : M.aliases())
@@ -771,6 +788,17 @@ unsigned LTO::getMaxTasks() const {
   return RegularLTO.ParallelCodeGenParallelismLevel + ThinLTO.ModuleMap.size();
 }
 
+/// Returns true if a ThinLTO module has vtables in its summary, i.e. it was
+/// not split. The summaries of the regular LTO modules have no module path.
+static bool hasThinLTOVTables(const ModuleSummaryIndex &Index) {
+  for (auto &P : Index)
+    for (auto &S : P.second.SummaryList)
+      if (auto *VS = dyn_cast<GlobalVarSummary>(S.get()))
+        if (!VS->vTableFuncs().empty() && !VS->modulePath().empty())
+          return true;
+  return false;
+}
+
 Error LTO::run(AddStreamFn AddStream, NativeObjectCache Cache) {
   // Compute "dead" symbols, we don't want to import/export these!
   DenseSet<GlobalValue::GUID> GUIDPreservedSymbols;
@@ -800,6 +828,12 @@ Error LTO::run(AddStreamFn AddStream, NativeObjectCache Cache) {
   };
   computeDeadSymbols(ThinLTO.CombinedIndex, GUIDPreservedSymbols, isPrevailing);
 
+  // Whole program devirtualization on the regular LTO module does not see the
+  // vtables of the ThinLTO modules that were not split. If there are vtables
+  // on both sides, the targets it finds for a call may be incomplete.
+  if (RegularLTO.HasTypeMetadata && hasThinLTOVTables(ThinLTO.CombinedIndex))
+    ThinLTO.CombinedIndex.setPartiallySplitLTOUnits();
+
   // Setup output file to emit statistics.
   std::unique_ptr<ToolOutputFile> StatsFile = nullptr;
   if (!Conf.StatsFile.empty()) {
@@ -1169,11 +1203,33 @@ Error LTO::runThinLTO(AddStreamFn AddStream, NativeObjectCache Cache) {
     ComputeCrossModuleImport(ThinLTO.CombinedIndex, ModuleToDefinedGVSummaries,
                              ImportLists, ExportLists);
 
+  auto isPrevailing = [&](GlobalValue::GUID GUID,
+                          const GlobalValueSummary *S) {
+    return ThinLTO.PrevailingModuleForGUID[GUID] == S->modulePath();
+  };
+
+  // Redirect duplicate functions to a single copy before deciding what to
+  // internalize, as the canonical copies must be exported.
+  if (Conf.OptLevel > 0 && EnableThinLTOFunctionMerging)
+    computeCrossModuleFunctionMerging(ThinLTO.CombinedIndex, isPrevailing,
+                                      ExportLists);
+
+  // Propagate synthetic entry counts on the combined call graph, so that
+  // functions get counts that reflect their callers in other modules.
+  if (Conf.OptLevel > 0)
+    computeSyntheticCounts(ThinLTO.CombinedIndex);
+
   // Figure out which symbols need to be internalized. This also needs to happen
   // at -O0 because summary-based DCE is implemented using internalization, and
   // we must apply DCE consistently with the full LTO module in order to avoid
   // undefined references during the final link.
   std::set<GlobalValue::GUID> ExportedGUIDs;
+
+  // Perform index-based WPD. This returns immediately if no vtables were
+  // summarized (e.g. when the modules were split and the vtables are in the
+  // regular LTO partition), or if only some of the modules were split.
+  runWholeProgramDevirtOnIndex(ThinLTO.CombinedIndex, ExportedGUIDs);
+
   for (auto &Res : GlobalResolutions) {
     // If the symbol does not have external references or it is not prevailing,
     // then not need to mark it as exported from a ThinLTO partition.
@@ -1201,10 +1257,6 @@ Error LTO::runThinLTO(AddStreamFn AddStream, NativeObjectCache Cache) {
   };
   thinLTOInternalizeAndPromoteInIndex(ThinLTO.CombinedIndex, isExported);
 
-  auto isPrevailing = [&](GlobalValue::GUID GUID,
-                          const GlobalValueSummary *S) {
-    return ThinLTO.PrevailingModuleForGUID[GUID] == S->modulePath();
-  };
   auto recordNewLinkage = [&](StringRef ModuleIdentifier,
                               GlobalValue::GUID GUID,
                               GlobalValue::LinkageTypes NewLinkage) {
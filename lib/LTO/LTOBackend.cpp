@@ -488,8 +488,13 @@ Error lto::thinBackend(Config &Conf, unsigned Task, AddStreamFn AddStream,
   if (Conf.PostPromoteModuleHook && !Conf.PostPromoteModuleHook(Task, Mod))
     return finalizeOptimizationRemarks(std::move(DiagnosticOutputFile));
 
-  if (!DefinedGlobals.empty())
+  if (!DefinedGlobals.empty()) {
+    // The structural hashes are recomputed before local linkage makes the
+    // functions ineligible.
+    thinLTOMergeFunctionsModule(Mod, DefinedGlobals);
     thinLTOInternalizeModule(Mod, DefinedGlobals);
+    thinLTOApplySyntheticCountsModule(Mod, DefinedGlobals);
+  }
 
   if (Conf.PostInternalizeModuleHook &&
       !Conf.PostInternalizeModuleHook(Task, Mod))
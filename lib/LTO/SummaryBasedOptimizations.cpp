@@ -0,0 +1,78 @@
+//===- SummaryBasedOptimizations.cpp - Optimizations on summaries ---------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements optimizations that are based on the module summaries.
+// These optimizations are performed during the thinlink phase of the
+// compilation.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/LTO/SummaryBasedOptimizations.h"
+#include "llvm/Analysis/SyntheticCountsUtils.h"
+#include "llvm/IR/ModuleSummaryIndex.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "summary-based-opts"
+
+static cl::opt<bool> ThinLTOSynthesizeEntryCounts(
+    "thinlto-synthesize-entry-counts", cl::init(false), cl::Hidden,
+    cl::desc("Synthesize entry counts based on the summary"));
+
+static cl::opt<int> ThinLTOInitialSyntheticCount(
+    "thinlto-initial-synthetic-count", cl::Hidden, cl::init(10),
+    cl::ZeroOrMore,
+    cl::desc("Initial synthetic entry count of the roots of the combined "
+             "call graph."));
+
+using Scaled64 = ScaledNumber<uint64_t>;
+
+// The functions with no callers in the combined call graph are the roots of
+// the propagation, and get the initial count. Every other function gets its
+// count from its callers.
+static void initializeCounts(ModuleSummaryIndex &Index) {
+  FunctionSummary Root = Index.calculateCallGraphRoot();
+  for (auto &C : Root.calls()) {
+    ValueInfo V = C.first;
+    for (auto &GVS : V.getSummaryList())
+      if (auto *F = dyn_cast<FunctionSummary>(GVS->getBaseObject()))
+        F->setEntryCount(ThinLTOInitialSyntheticCount);
+  }
+}
+
+void llvm::computeSyntheticCounts(ModuleSummaryIndex &Index) {
+  if (!ThinLTOSynthesizeEntryCounts)
+    return;
+
+  initializeCounts(Index);
+
+  // The relative block frequencies of the calls are only recorded in the
+  // summaries of modules without a profile.
+  auto GetCallSiteRelFreq = [](FunctionSummary::EdgeTy &Edge) {
+    return Optional<Scaled64>(
+        Scaled64(Edge.second.RelBlockFreq, -CalleeInfo::ScaleShift));
+  };
+  auto GetEntryCount = [](ValueInfo V) -> uint64_t {
+    if (V.getSummaryList().empty())
+      return 0;
+    auto *F =
+        dyn_cast<FunctionSummary>(V.getSummaryList().front()->getBaseObject());
+    return F ? F->entryCount() : 0;
+  };
+  auto AddToEntryCount = [](ValueInfo V, uint64_t New) {
+    for (auto &GVS : V.getSummaryList())
+      if (auto *F = dyn_cast<FunctionSummary>(GVS->getBaseObject()))
+        F->setEntryCount(SaturatingAdd(F->entryCount(), New));
+  };
+
+  SyntheticCountsUtils<ModuleSummaryIndex *>::propagate(
+      &Index, GetCallSiteRelFreq, GetEntryCount, AddToEntryCount);
+}
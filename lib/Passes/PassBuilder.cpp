@@ -28,6 +28,7 @@
 #include "llvm/Analysis/CFLSteensAliasAnalysis.h"
 #include "llvm/Analysis/CGSCCPassManager.h"
 #include "llvm/Analysis/CallGraph.h"
+#include "llvm/Analysis/CompileTimeBudget.h"
 #include "llvm/Analysis/DemandedBits.h"
 #include "llvm/Analysis/DependenceAnalysis.h"
 #include "llvm/Analysis/DominanceFrontier.h"
@@ -72,9 +73,11 @@
 #include "llvm/Transforms/IPO/ForceFunctionAttrs.h"
 #include "llvm/Transforms/IPO/FunctionAttrs.h"
 #include "llvm/Transforms/IPO/FunctionImport.h"
+#include "llvm/Transforms/IPO/FunctionSpecialization.h"
 #include "llvm/Transforms/IPO/GlobalDCE.h"
 #include "llvm/Transforms/IPO/GlobalOpt.h"
 #include "llvm/Transforms/IPO/GlobalSplit.h"
+#include "llvm/Transforms/IPO/HotColdSplitting.h"
 #include "llvm/Transforms/IPO/InferFunctionAttrs.h"
 #include "llvm/Transforms/IPO/Inliner.h"
 #include "llvm/Transforms/IPO/Internalize.h"
@@ -103,6 +106,7 @@
 #include "llvm/Transforms/Scalar/Float2Int.h"
 #include "llvm/Transforms/Scalar/GVN.h"
 #include "llvm/Transforms/Scalar/GuardWidening.h"
+#include "llvm/Transforms/Scalar/HeapToStack.h"
 #include "llvm/Transforms/Scalar/IVUsersPrinter.h"
 #include "llvm/Transforms/Scalar/IndVarSimplify.h"
 #include "llvm/Transforms/Scalar/InductiveRangeCheckElimination.h"
@@ -113,6 +117,7 @@
 #include "llvm/Transforms/Scalar/LoopDataPrefetch.h"
 #include "llvm/Transforms/Scalar/LoopDeletion.h"
 #include "llvm/Transforms/Scalar/LoopDistribute.h"
+#include "llvm/Transforms/Scalar/LoopFuse.h"
 #include "llvm/Transforms/Scalar/LoopIdiomRecognize.h"
 #include "llvm/Transforms/Scalar/LoopInstSimplify.h"
 #include "llvm/Transforms/Scalar/LoopLoadElimination.h"
@@ -164,6 +169,23 @@ static cl::opt<bool>
                        cl::Hidden, cl::ZeroOrMore,
                        cl::desc("Run Partial inlinining pass"));
 
+static cl::opt<bool> RunLoopFusion(
+    "enable-npm-loop-fusion", cl::init(false), cl::Hidden, cl::ZeroOrMore,
+    cl::desc("Run the loop fusion pass"));
+
+static cl::opt<bool> RunHeapToStack(
+    "enable-npm-heap-to-stack", cl::init(false), cl::Hidden, cl::ZeroOrMore,
+    cl::desc("Run the heap to stack promotion pass"));
+
+static cl::opt<bool> RunFunctionSpecialization(
+    "enable-npm-function-specialization", cl::init(false), cl::Hidden,
+    cl::ZeroOrMore, cl::desc("Run the function specialization pass"));
+
+static cl::opt<bool>
+    RunHotColdSplitting("enable-npm-hot-cold-split", cl::init(false),
+                        cl::Hidden, cl::ZeroOrMore,
+                        cl::desc("Run the hot/cold splitting pass"));
+
 static cl::opt<bool>
     RunNewGVN("enable-npm-newgvn", cl::init(false),
               cl::Hidden, cl::ZeroOrMore,
@@ -355,6 +377,13 @@ PassBuilder::buildFunctionSimplificationPipeline(OptimizationLevel Level,
   // Catch trivial redundancies
   FPM.addPass(EarlyCSEPass(EnableEarlyCSEMemSSA));
 
+  // Move the small heap allocations that the inliner exposed as not escaping
+  // to the stack, and break them apart as well.
+  if (RunHeapToStack) {
+    FPM.addPass(HeapToStackPass());
+    FPM.addPass(SROA());
+  }
+
   // Hoisting of scalars and load expressions.
   if (EnableGVNHoist)
     FPM.addPass(GVNHoistPass());
@@ -415,7 +444,7 @@ PassBuilder::buildFunctionSimplificationPipeline(OptimizationLevel Level,
   // Rotate Loop - disable header duplication at -Oz
   LPM1.addPass(LoopRotatePass(Level != Oz));
   LPM1.addPass(LICMPass());
-  LPM1.addPass(SimpleLoopUnswitchPass());
+  LPM1.addPass(SimpleLoopUnswitchPass(/* NonTrivial */ Level == O3));
   LPM2.addPass(IndVarSimplifyPass());
   LPM2.addPass(LoopIdiomRecognizePass());
 
@@ -609,6 +638,10 @@ PassBuilder::buildModuleSimplificationPipeline(OptimizationLevel Level,
   // and prior to optimizing globals.
   // FIXME: This position in the pipeline hasn't been carefully considered in
   // years, it should be re-analyzed.
+  // Specialize functions on constant arguments first, so that IPSCCP can
+  // propagate them into the specializations.
+  if (RunFunctionSpecialization)
+    MPM.addPass(FunctionSpecializationPass());
   MPM.addPass(IPSCCPPass());
 
   // Attach metadata to indirect call sites indicating the set of functions
@@ -646,8 +679,10 @@ PassBuilder::buildModuleSimplificationPipeline(OptimizationLevel Level,
     MPM.addPass(PGOIndirectCallPromotion(false, false));
   }
 
-  // Synthesize function entry counts for non-PGO compilation.
-  if (EnableSyntheticCounts && !PGOOpt)
+  // Synthesize function entry counts for non-PGO compilation. The ThinLTO
+  // backends keep the counts of the pre-link phase, which the thin link may
+  // have updated from the combined call graph.
+  if (EnableSyntheticCounts && !PGOOpt && Phase != ThinLTOPhase::PostLink)
     MPM.addPass(SyntheticCountsPropagation());
 
   // Require the GlobalsAA analysis for the module so we can query it within
@@ -762,6 +797,11 @@ PassBuilder::buildModuleOptimizationPipeline(OptimizationLevel Level,
   OptimizePM.addPass(
       createFunctionToLoopPassAdaptor(LoopRotatePass(), DebugLogging));
 
+  // Fuse adjacent loops over the same iteration space, so that the data they
+  // share is only streamed once and the vectorizer sees a single loop.
+  if (RunLoopFusion)
+    OptimizePM.addPass(LoopFusePass());
+
   // Distribute loops to allow partial vectorization.  I.e. isolate dependences
   // into separate loop that would otherwise inhibit vectorization.  This is
   // currently only performed for loops marked with the metadata
@@ -844,6 +884,11 @@ PassBuilder::buildModuleOptimizationPipeline(OptimizationLevel Level,
   // Add the core optimizing pipeline.
   MPM.addPass(createModuleToFunctionPassAdaptor(std::move(OptimizePM)));
 
+  // Split out cold code late, so that the optimizations above still see it
+  // in the context of the function it came from.
+  if (RunHotColdSplitting)
+    MPM.addPass(HotColdSplittingPass());
+
   MPM.addPass(CGProfilePass());
 
   // Now we need to do some global optimization transforms.
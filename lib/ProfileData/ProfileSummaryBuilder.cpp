@@ -101,6 +101,26 @@ std::unique_ptr<ProfileSummary> InstrProfSummaryBuilder::getSummary() {
       MaxInternalBlockCount, MaxFunctionCount, NumCounts, NumFunctions);
 }
 
+std::unique_ptr<ProfileSummary> SyntheticProfileSummaryBuilder::getSummary() {
+  computeDetailedSummary();
+  return llvm::make_unique<ProfileSummary>(
+      ProfileSummary::PSK_Synthetic, DetailedSummary, TotalCount, MaxCount,
+      MaxInternalBlockCount, MaxFunctionCount, NumCounts, NumFunctions);
+}
+
+void SyntheticProfileSummaryBuilder::addEntryCount(uint64_t Count) {
+  addCount(Count);
+  NumFunctions++;
+  if (Count > MaxFunctionCount)
+    MaxFunctionCount = Count;
+}
+
+void SyntheticProfileSummaryBuilder::addInternalCount(uint64_t Count) {
+  addCount(Count);
+  if (Count > MaxInternalBlockCount)
+    MaxInternalBlockCount = Count;
+}
+
 void InstrProfSummaryBuilder::addEntryCount(uint64_t Count) {
   addCount(Count);
   NumFunctions++;
@@ -22,6 +22,7 @@
 #include "llvm/Support/raw_ostream.h"
 #include <string>
 #include <system_error>
+#include <tuple>
 
 using namespace llvm;
 using namespace sampleprof;
@@ -88,6 +89,36 @@ raw_ostream &llvm::sampleprof::operator<<(raw_ostream &OS,
 LLVM_DUMP_METHOD void LineLocation::dump() const { print(dbgs()); }
 #endif
 
+bool SampleContext::decodeContextString(StringRef ContextStr,
+                                        SampleContextFrames &Frames) {
+  Frames.clear();
+  while (!ContextStr.empty()) {
+    StringRef Frame;
+    std::tie(Frame, ContextStr) = ContextStr.split(" @ ");
+    if (ContextStr.empty()) {
+      // The innermost frame is the profiled function itself.
+      Frames.emplace_back(Frame, LineLocation(0, 0));
+      break;
+    }
+
+    // Function names may contain ':', the location follows the last one.
+    size_t Pos = Frame.rfind(':');
+    if (Pos == StringRef::npos || Pos == 0)
+      return false;
+    StringRef Loc = Frame.substr(Pos + 1);
+    uint32_t LineOffset, Discriminator = 0;
+    StringRef LineStr, DiscriminatorStr;
+    std::tie(LineStr, DiscriminatorStr) = Loc.split('.');
+    if (LineStr.getAsInteger(10, LineOffset) ||
+        (!DiscriminatorStr.empty() &&
+         DiscriminatorStr.getAsInteger(10, Discriminator)))
+      return false;
+    Frames.emplace_back(Frame.substr(0, Pos),
+                        LineLocation(LineOffset, Discriminator));
+  }
+  return !Frames.empty();
+}
+
 /// Print the sample record to the stream \p OS indented by \p Indent.
 void SampleRecord::print(raw_ostream &OS, unsigned Indent) const {
   OS << NumSamples;
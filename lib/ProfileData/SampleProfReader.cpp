@@ -195,6 +195,7 @@ std::error_code SampleProfileReaderText::read() {
   sampleprof_error Result = sampleprof_error::success;
 
   InlineCallStack InlineStack;
+  bool SeenContextProfile = false, SeenRegularProfile = false;
 
   for (; !LineIt.is_at_eof(); ++LineIt) {
     if ((*LineIt)[(*LineIt).find_first_not_of(' ')] == '#')
@@ -219,9 +220,31 @@ std::error_code SampleProfileReaderText::read() {
                     "Expected 'mangled_name:NUM:NUM', found " + *LineIt);
         return sampleprof_error::malformed;
       }
+      // A context-sensitive profile is keyed by its full calling context.
+      SampleContext FContext;
+      if (SampleContext::isContextString(FName)) {
+        FName = FName.substr(1, FName.size() - 2);
+        SampleContextFrames Frames;
+        if (!SampleContext::decodeContextString(FName, Frames)) {
+          reportError(LineIt.line_number(),
+                      "Expected '[name:NUM[.NUM] @ ... @ name]', found " +
+                          *LineIt);
+          return sampleprof_error::malformed;
+        }
+        FContext = SampleContext(FName);
+        SeenContextProfile = true;
+      } else {
+        SeenRegularProfile = true;
+      }
+      if (SeenContextProfile && SeenRegularProfile) {
+        reportError(LineIt.line_number(),
+                    "Cannot mix context-sensitive and regular profiles");
+        return sampleprof_error::malformed;
+      }
       Profiles[FName] = FunctionSamples();
       FunctionSamples &FProfile = Profiles[FName];
-      FProfile.setName(FName);
+      FProfile.setName(FContext.hasContext() ? FContext.getName() : FName);
+      FProfile.setContext(FContext);
       MergeResult(Result, FProfile.addTotalSamples(NumSamples));
       MergeResult(Result, FProfile.addHeadSamples(NumHeadSamples));
       InlineStack.clear();
@@ -263,6 +286,7 @@ std::error_code SampleProfileReaderText::read() {
       }
     }
   }
+  ProfileIsCS = SeenContextProfile;
   if (Result == sampleprof_error::success)
     computeSummary();
 
@@ -74,7 +74,11 @@ SampleProfileWriter::write(const StringMap<FunctionSamples> &ProfileMap) {
 /// it needs to be parsed by the SampleProfileReaderText class.
 std::error_code SampleProfileWriterText::write(const FunctionSamples &S) {
   auto &OS = *OutputStream;
-  OS << S.getName() << ":" << S.getTotalSamples();
+  if (Indent == 0 && S.getContext().hasContext())
+    OS << "[" << S.getContext().getNameWithContext() << "]";
+  else
+    OS << S.getName();
+  OS << ":" << S.getTotalSamples();
   if (Indent == 0)
     OS << ":" << S.getHeadSamples();
   OS << "\n";
@@ -279,6 +283,9 @@ std::error_code SampleProfileWriterBinary::writeBody(const FunctionSamples &S) {
 ///
 /// \returns true if the samples were written successfully, false otherwise.
 std::error_code SampleProfileWriterBinary::write(const FunctionSamples &S) {
+  // The binary formats do not record calling contexts.
+  if (S.getContext().hasContext())
+    return sampleprof_error::unsupported_writing_format;
   encodeULEB128(S.getHeadSamples(), *OutputStream);
   return writeBody(S);
 }
@@ -1921,6 +1921,11 @@ int X86TTIImpl::getMemoryOpCost(unsigned Opcode, Type *Src, unsigned Alignment,
       // Cost = 128 bit store + unpack + 64 bit store.
       return 3;
 
+    // <6 x float> with AVX
+    if (NumElem == 6 && VTy->getScalarSizeInBits() == 32 && ST->hasAVX())
+      // Cost = 128 bit store + extract + 64 bit store.
+      return 3;
+
     // Assume that all other non-power-of-two numbers are scalarized.
     if (!isPowerOf2_32(NumElem)) {
       int Cost = BaseT::getMemoryOpCost(Opcode, VTy->getScalarType(), Alignment,
@@ -14,17 +14,24 @@
 // GEP + load from the coroutine frame. At the point of the definition we spill
 // the value into the coroutine frame.
 //
-// TODO: pack values tightly using liveness info.
+// Values whose frame storage is never live at the same time share a field of
+// the frame, and the fields are sorted by decreasing alignment to limit the
+// padding between them.
 //===----------------------------------------------------------------------===//
 
 #include "CoroInternal.h"
 #include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/OptimizationRemarkEmitter.h"
 #include "llvm/Transforms/Utils/Local.h"
 #include "llvm/Config/llvm-config.h"
 #include "llvm/IR/CFG.h"
 #include "llvm/IR/Dominators.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/InstIterator.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/circular_raw_ostream.h"
@@ -131,6 +138,10 @@ struct SuspendCrossingInfo {
   bool isDefinitionAcrossSuspend(Instruction &I, User *U) const {
     return isDefinitionAcrossSuspend(I.getParent(), U);
   }
+
+  BitVector getSpillLiveBlocks(BasicBlock *DefBB,
+                               ArrayRef<BasicBlock *> UseBBs) const;
+  BitVector getAllocaLiveBlocks(AllocaInst *AI) const;
 };
 } // end anonymous namespace
 
@@ -256,9 +267,100 @@ SuspendCrossingInfo::SuspendCrossingInfo(Function &F, coro::Shape &Shape)
   LLVM_DEBUG(dump());
 }
 
+// Returns the blocks in which the frame storage of a value defined in DefBB
+// and used in UseBBs must be preserved: the blocks on a path from the
+// definition to one of the uses.
+BitVector
+SuspendCrossingInfo::getSpillLiveBlocks(BasicBlock *DefBB,
+                                        ArrayRef<BasicBlock *> UseBBs) const {
+  const size_t N = Block.size();
+  const size_t DefIndex = Mapping.blockToIndex(DefBB);
+
+  BitVector ReachesUse(N);
+  for (BasicBlock *UseBB : UseBBs)
+    ReachesUse |= Block[Mapping.blockToIndex(UseBB)].Consumes;
+
+  BitVector Live(N);
+  for (unsigned I : ReachesUse.set_bits())
+    if (Block[I].Consumes[DefIndex])
+      Live.set(I);
+  return Live;
+}
+
+// Returns the blocks in which the frame storage of an alloca must be
+// preserved: the blocks reached by one of its lifetime.start markers without
+// passing a lifetime.end. Without lifetime markers, the storage must be
+// preserved everywhere.
+BitVector SuspendCrossingInfo::getAllocaLiveBlocks(AllocaInst *AI) const {
+  const size_t N = Block.size();
+
+  // Collect the markers on the alloca, and on the casts of it.
+  SmallVector<IntrinsicInst *, 4> Markers;
+  SmallVector<Value *, 4> Worklist{AI};
+  while (!Worklist.empty()) {
+    Value *V = Worklist.pop_back_val();
+    for (User *U : V->users()) {
+      if (isa<BitCastInst>(U))
+        Worklist.push_back(U);
+      else if (auto *II = dyn_cast<IntrinsicInst>(U))
+        if (II->getIntrinsicID() == Intrinsic::lifetime_start ||
+            II->getIntrinsicID() == Intrinsic::lifetime_end)
+          Markers.push_back(II);
+    }
+  }
+  if (Markers.empty())
+    return BitVector(N, true);
+
+  // For the blocks that contain markers, whether the storage is live at their
+  // end, as set by their last marker.
+  BitVector HasMarker(N), LiveAtMarkedEnd(N), HasStart(N);
+  for (IntrinsicInst *II : Markers) {
+    BasicBlock *BB = II->getParent();
+    size_t Index = Mapping.blockToIndex(BB);
+    if (HasMarker[Index])
+      continue;
+    HasMarker.set(Index);
+    for (Instruction &I : *BB) {
+      if (!is_contained(Markers, &I))
+        continue;
+      bool IsStart = cast<IntrinsicInst>(I).getIntrinsicID() ==
+                     Intrinsic::lifetime_start;
+      LiveAtMarkedEnd[Index] = IsStart;
+      if (IsStart)
+        HasStart.set(Index);
+    }
+  }
+
+  // Propagate the liveness forward until it stops changing.
+  BitVector LiveIn(N), LiveOut(LiveAtMarkedEnd);
+  bool Changed;
+  do {
+    Changed = false;
+    for (size_t I = 0; I < N; ++I) {
+      bool In = LiveIn[I];
+      for (BasicBlock *Pred : predecessors(Mapping.indexToBlock(I)))
+        In |= LiveOut[Mapping.blockToIndex(Pred)];
+      bool Out = HasMarker[I] ? LiveAtMarkedEnd[I] : In;
+      Changed |= In != LiveIn[I] || Out != LiveOut[I];
+      LiveIn[I] = In;
+      LiveOut[I] = Out;
+    }
+  } while (Changed);
+
+  return LiveIn |= HasStart;
+}
+
 #undef DEBUG_TYPE // "coro-suspend-crossing"
 #define DEBUG_TYPE "coro-frame"
 
+STATISTIC(NumFrameFieldsReused,
+          "Number of spilled values sharing a coroutine frame field");
+
+static cl::opt<bool> ReuseFrameFields(
+    "coro-reuse-frame-fields", cl::init(true), cl::Hidden,
+    cl::desc("Let the values whose frame storage is never live at the same "
+             "time share a field of the coroutine frame"));
+
 // We build up the list of spills for every case where a use is separated
 // from the definition by a suspend point.
 
@@ -367,10 +469,11 @@ struct PaddingCalculator {
 //     ResumeFnTy DestroyFnAddr;
 //     int ResumeIndex;
 //     ... promise (if present) ...
-//     ... spills ...
+//     ... spills, by decreasing alignment ...
 //   };
 static StructType *buildFrameType(Function &F, coro::Shape &Shape,
-                                  SpillInfo &Spills) {
+                                  SpillInfo &Spills,
+                                  const SuspendCrossingInfo &Checker) {
   LLVMContext &C = F.getContext();
   const DataLayout &DL = F.getParent()->getDataLayout();
   PaddingCalculator Padder(C, DL);
@@ -389,40 +492,131 @@ static StructType *buildFrameType(Function &F, coro::Shape &Shape,
                           : Type::getInt1Ty(C);
   SmallVector<Type *, 8> Types{FnPtrTy, FnPtrTy, PromiseType,
                                Type::getIntNTy(C, IndexBits)};
-  Value *CurrentDef = nullptr;
 
   Padder.addTypes(Types);
 
-  // Create an entry for every spilled value.
+  // Describe every spilled value with the blocks in which its frame storage
+  // must be preserved. The spills of a value are contiguous.
+  struct FrameValue {
+    Value *Def;
+    Type *Ty;
+    uint64_t Size;
+    unsigned Align;
+    unsigned ForcedAlign = 0;
+    SmallVector<BasicBlock *, 4> UseBBs;
+    BitVector Live;
+  };
+  SmallVector<FrameValue, 8> Values;
   for (auto &S : Spills) {
-    if (CurrentDef == S.def())
-      continue;
-
-    CurrentDef = S.def();
     // PromiseAlloca was already added to Types array earlier.
-    if (CurrentDef == Shape.PromiseAlloca)
+    if (S.def() == Shape.PromiseAlloca)
       continue;
+    if (Values.empty() || Values.back().Def != S.def()) {
+      FrameValue V;
+      V.Def = S.def();
+      V.Ty = V.Def->getType();
+      V.Align = DL.getABITypeAlignment(V.Ty);
+      if (auto *AI = dyn_cast<AllocaInst>(V.Def)) {
+        V.Ty = AI->getAllocatedType();
+        V.Align = DL.getABITypeAlignment(V.Ty);
+        if (AI->getAlignment() > V.Align)
+          V.ForcedAlign = V.Align = AI->getAlignment();
+      }
+      V.Size = DL.getTypeAllocSize(V.Ty);
+      Values.push_back(std::move(V));
+    }
+    Values.back().UseBBs.push_back(S.userBlock());
+  }
 
-    Type *Ty = nullptr;
-    if (auto *AI = dyn_cast<AllocaInst>(CurrentDef)) {
-      Ty = AI->getAllocatedType();
-      if (unsigned AllocaAlignment = AI->getAlignment()) {
-        // If alignment is specified in alloca, see if we need to insert extra
-        // padding.
-        if (auto PaddingTy = Padder.getPaddingType(Ty, AllocaAlignment)) {
-          Types.push_back(PaddingTy);
-          Padder.addType(PaddingTy);
+  for (FrameValue &V : Values) {
+    if (auto *AI = dyn_cast<AllocaInst>(V.Def))
+      V.Live = Checker.getAllocaLiveBlocks(AI);
+    else if (auto *I = dyn_cast<Instruction>(V.Def))
+      V.Live = Checker.getSpillLiveBlocks(I->getParent(), V.UseBBs);
+    else
+      V.Live = Checker.getSpillLiveBlocks(&F.getEntryBlock(), V.UseBBs);
+  }
+
+  // Placing the most aligned values first leaves the least padding between
+  // the fields.
+  std::stable_sort(Values.begin(), Values.end(),
+                   [](const FrameValue &A, const FrameValue &B) {
+                     return A.Align > B.Align;
+                   });
+
+  // Give every value a field, sharing the field of a value that is at least
+  // as large and as aligned when their storage is never live at the same
+  // time. Values with an alignment forced above the natural one of their type
+  // are preceded by padding, and keep their own field.
+  struct FrameField {
+    Type *Ty;
+    uint64_t Size;
+    unsigned Align;
+    unsigned ForcedAlign;
+    BitVector Live;
+    SmallVector<Value *, 2> Defs;
+  };
+  SmallVector<FrameField, 8> Fields;
+  for (FrameValue &V : Values) {
+    bool Shareable = ReuseFrameFields && !V.ForcedAlign;
+    FrameField *Field = nullptr;
+    if (Shareable)
+      for (FrameField &Candidate : Fields)
+        if (!Candidate.ForcedAlign && V.Size <= Candidate.Size &&
+            V.Align <= Candidate.Align && !Candidate.Live.anyCommon(V.Live)) {
+          Field = &Candidate;
+          break;
         }
+
+    if (Field) {
+      LLVM_DEBUG(dbgs() << "Sharing the frame field of "
+                        << Field->Defs.front()->getName() << " with "
+                        << V.Def->getName() << "\n");
+      Field->Live |= V.Live;
+      Field->Defs.push_back(V.Def);
+      ++NumFrameFieldsReused;
+      continue;
+    }
+    Fields.push_back({V.Ty, V.Size, V.Align, V.ForcedAlign, V.Live, {V.Def}});
+  }
+
+  // Create an entry for every field.
+  DenseMap<Value *, unsigned> FieldIndex;
+  for (FrameField &Field : Fields) {
+    if (Field.ForcedAlign) {
+      // If alignment is specified in alloca, see if we need to insert extra
+      // padding.
+      if (auto PaddingTy = Padder.getPaddingType(Field.Ty, Field.ForcedAlign)) {
+        Types.push_back(PaddingTy);
+        Padder.addType(PaddingTy);
       }
-    } else {
-      Ty = CurrentDef->getType();
     }
-    S.setFieldIndex(Types.size());
-    Types.push_back(Ty);
-    Padder.addType(Ty);
+    for (Value *Def : Field.Defs)
+      FieldIndex[Def] = Types.size();
+    Types.push_back(Field.Ty);
+    Padder.addType(Field.Ty);
   }
   FrameTy->setBody(Types);
 
+  // The field index is stored in the first spill of each value.
+  Value *CurrentDef = nullptr;
+  for (auto &S : Spills) {
+    if (CurrentDef == S.def() || S.def() == Shape.PromiseAlloca)
+      continue;
+    CurrentDef = S.def();
+    S.setFieldIndex(FieldIndex[CurrentDef]);
+  }
+
+  OptimizationRemarkEmitter ORE(&F);
+  ORE.emit([&]() {
+    return OptimizationRemarkAnalysis(DEBUG_TYPE, "CoroFrame", Shape.CoroBegin)
+           << "coroutine frame is "
+           << ore::NV("FrameSize", DL.getTypeAllocSize(FrameTy))
+           << " bytes, with " << ore::NV("NumSpills", (unsigned)Values.size())
+           << " spilled values in "
+           << ore::NV("NumFields", (unsigned)Fields.size()) << " fields";
+  });
+
   return FrameTy;
 }
 
@@ -494,16 +688,17 @@ static Instruction *insertSpills(SpillInfo &Spills, coro::Shape &Shape) {
 
   // Create a load instruction to reload the spilled value from the coroutine
   // frame.
-  auto CreateReload = [&](Instruction *InsertBefore) {
+  auto CreateReload = [&](Instruction *InsertBefore) -> Value * {
     assert(Index && "accessing unassigned field number");
     Builder.SetInsertPoint(InsertBefore);
     auto *G = Builder.CreateConstInBoundsGEP2_32(FrameTy, FramePtr, 0, Index,
                                                  CurrentValue->getName() +
                                                      Twine(".reload.addr"));
-    return isa<AllocaInst>(CurrentValue)
-               ? G
-               : Builder.CreateLoad(G,
-                                    CurrentValue->getName() + Twine(".reload"));
+    // The field may be shared with values of another type.
+    if (isa<AllocaInst>(CurrentValue))
+      return Builder.CreateBitCast(G, CurrentValue->getType());
+    G = Builder.CreateBitCast(G, CurrentValue->getType()->getPointerTo());
+    return Builder.CreateLoad(G, CurrentValue->getName() + Twine(".reload"));
   };
 
   for (auto const &E : Spills) {
@@ -554,6 +749,7 @@ static Instruction *insertSpills(SpillInfo &Spills, coro::Shape &Shape) {
         auto *G = Builder.CreateConstInBoundsGEP2_32(
             FrameTy, FramePtr, 0, Index,
             CurrentValue->getName() + Twine(".spill.addr"));
+        G = Builder.CreateBitCast(G, CurrentValue->getType()->getPointerTo());
         Builder.CreateStore(CurrentValue, G);
       }
     }
@@ -590,6 +786,7 @@ static Instruction *insertSpills(SpillInfo &Spills, coro::Shape &Shape) {
   for (auto &P : Allocas) {
     auto *G =
         Builder.CreateConstInBoundsGEP2_32(FrameTy, FramePtr, 0, P.second);
+    G = Builder.CreateBitCast(G, P.first->getType());
     // We are not using ReplaceInstWithInst(P.first, cast<Instruction>(G)) here,
     // as we are changing location of the instruction.
     G->takeName(P.first);
@@ -938,6 +1135,6 @@ void coro::buildCoroutineFrame(Function &F, Shape &Shape) {
   }
   LLVM_DEBUG(dump("Spills", Spills));
   moveSpillUsesAfterCoroBegin(F, Spills, Shape.CoroBegin);
-  Shape.FrameTy = buildFrameType(F, Shape, Spills);
+  Shape.FrameTy = buildFrameType(F, Shape, Spills, Checker);
   Shape.FramePtr = insertSpills(Spills, Shape);
 }
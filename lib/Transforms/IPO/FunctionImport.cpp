@@ -13,6 +13,7 @@
 
 #include "llvm/Transforms/IPO/FunctionImport.h"
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/SmallVector.h"
@@ -20,6 +21,7 @@
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/StringSet.h"
+#include "llvm/Analysis/ModuleSummaryAnalysis.h"
 #include "llvm/Bitcode/BitcodeReader.h"
 #include "llvm/IR/AutoUpgrade.h"
 #include "llvm/IR/Constants.h"
@@ -28,6 +30,8 @@
 #include "llvm/IR/GlobalObject.h"
 #include "llvm/IR/GlobalValue.h"
 #include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
 #include "llvm/IR/Metadata.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/ModuleSummaryIndex.h"
@@ -49,6 +53,7 @@
 #include "llvm/Transforms/Utils/FunctionImportUtils.h"
 #include "llvm/Transforms/Utils/ValueMapper.h"
 #include <cassert>
+#include <map>
 #include <memory>
 #include <set>
 #include <string>
@@ -65,6 +70,8 @@ STATISTIC(NumImportedGlobalVars, "Number of global variables imported");
 STATISTIC(NumImportedModules, "Number of modules imported from");
 STATISTIC(NumDeadSymbols, "Number of dead stripped symbols in index");
 STATISTIC(NumLiveSymbols, "Number of live symbols in index");
+STATISTIC(NumMergeCandidates, "Number of functions merged in index");
+STATISTIC(NumMergedFunctions, "Number of functions replaced by a thunk");
 
 /// Limit on instruction count of imported functions.
 static cl::opt<unsigned> ImportInstrLimit(
@@ -701,6 +708,48 @@ void llvm::computeDeadSymbols(
   NumLiveSymbols += LiveSymbols;
 }
 
+void llvm::computeCrossModuleFunctionMerging(
+    ModuleSummaryIndex &Index,
+    function_ref<bool(GlobalValue::GUID, const GlobalValueSummary *)>
+        isPrevailing,
+    StringMap<FunctionImporter::ExportSetTy> &ExportLists) {
+  // Group the prevailing copies of the hashed functions by hash. The index is
+  // walked in GUID order, so the choice of canonical copy is deterministic.
+  std::map<FunctionStructuralHash,
+           SmallVector<std::pair<ValueInfo, FunctionSummary *>, 2>>
+      Groups;
+  for (auto &I : Index) {
+    ValueInfo VI = Index.getValueInfo(I);
+    // The backends find the canonical copy by name.
+    if (VI.name().empty())
+      continue;
+    for (auto &S : I.second.SummaryList) {
+      auto *FS = dyn_cast<FunctionSummary>(S.get());
+      if (!FS || !FS->hasStructuralHash() || !Index.isGlobalValueLive(FS) ||
+          GlobalValue::isInterposableLinkage(FS->linkage()) ||
+          !isPrevailing(VI.getGUID(), FS))
+        continue;
+      Groups[FS->structuralHash()].push_back({VI, FS});
+    }
+  }
+
+  for (auto &Group : Groups) {
+    auto &Copies = Group.second;
+    if (Copies.size() < 2)
+      continue;
+    ValueInfo Canonical = Copies.front().first;
+    FunctionSummary *CanonicalFS = Copies.front().second;
+    for (auto &Copy : make_range(std::next(Copies.begin()), Copies.end())) {
+      LLVM_DEBUG(dbgs() << "Merging " << Copy.first.name() << " into "
+                        << Canonical.name() << "\n");
+      Copy.second->setMergedInto(Canonical);
+      ++NumMergeCandidates;
+    }
+    // The duplicates now refer to the canonical copy, so keep it.
+    ExportLists[CanonicalFS->modulePath()].insert(Canonical.getGUID());
+  }
+}
+
 /// Compute the set of summaries needed for a ThinLTO backend compilation of
 /// \p ModulePath.
 void llvm::gatherImportedSummariesForModule(
@@ -881,6 +930,100 @@ void llvm::thinLTOInternalizeModule(Module &TheModule,
   internalizeModule(TheModule, MustPreserveGV);
 }
 
+/// Replace functions merged during the thin link with thunks to the canonical
+/// copy, so that their bodies are not optimized and emitted again.
+bool llvm::thinLTOMergeFunctionsModule(Module &TheModule,
+                                       const GVSummaryMapTy &DefinedGlobals) {
+  bool Changed = false;
+  for (Function &F : TheModule) {
+    if (F.isDeclaration() || F.hasAvailableExternallyLinkage() ||
+        F.isVarArg())
+      continue;
+    auto GS = DefinedGlobals.find(F.getGUID());
+    if (GS == DefinedGlobals.end())
+      continue;
+    auto *FS = dyn_cast<FunctionSummary>(GS->second->getBaseObject());
+    if (!FS || !FS->mergedInto())
+      continue;
+    StringRef CanonicalName = FS->mergedInto().name();
+    if (CanonicalName.empty() || CanonicalName == F.getName())
+      continue;
+
+    // The thin link only compared hashes. Check that the body still has the
+    // hash it was merged by, and that the canonical copy has it too when its
+    // body is available here, before dropping the body.
+    const FunctionStructuralHash &Hash = FS->structuralHash();
+    if (computeFunctionStructuralHash(TheModule, F) != Hash)
+      continue;
+    Function *CanonicalF = TheModule.getFunction(CanonicalName);
+    if (CanonicalF && (CanonicalF->getFunctionType() != F.getFunctionType() ||
+                       (!CanonicalF->isDeclaration() &&
+                        computeFunctionStructuralHash(TheModule,
+                                                      *CanonicalF) != Hash)))
+      continue;
+
+    LLVM_DEBUG(dbgs() << "Replacing " << F.getName() << " with a thunk to "
+                      << CanonicalName << "\n");
+    Constant *Canonical = TheModule.getOrInsertFunction(
+        CanonicalName, F.getFunctionType(), F.getAttributes());
+
+    // Calls through an unnamed_addr function do not care about its address,
+    // so they can go to the canonical copy directly.
+    if (F.hasGlobalUnnamedAddr()) {
+      Constant *Cast = ConstantExpr::getBitCast(Canonical, F.getType());
+      for (auto UI = F.use_begin(), UE = F.use_end(); UI != UE;) {
+        Use &U = *UI++;
+        if (isa<Instruction>(U.getUser()))
+          U.set(Cast);
+      }
+    }
+
+    // Deleting the body resets the linkage, which was already resolved.
+    GlobalValue::LinkageTypes Linkage = F.getLinkage();
+    F.deleteBody();
+    F.setLinkage(Linkage);
+
+    BasicBlock *BB = BasicBlock::Create(TheModule.getContext(), "", &F);
+    IRBuilder<> Builder(BB);
+    SmallVector<Value *, 8> Args;
+    for (Argument &A : F.args())
+      Args.push_back(&A);
+    CallInst *CI = Builder.CreateCall(Canonical, Args);
+    CI->setTailCall();
+    CI->setCallingConv(F.getCallingConv());
+    CI->setAttributes(F.getAttributes());
+    if (F.getReturnType()->isVoidTy())
+      Builder.CreateRetVoid();
+    else
+      Builder.CreateRet(CI);
+    ++NumMergedFunctions;
+    Changed = true;
+  }
+  return Changed;
+}
+
+bool llvm::thinLTOApplySyntheticCountsModule(
+    Module &TheModule, const GVSummaryMapTy &DefinedGlobals) {
+  bool Changed = false;
+  for (Function &F : TheModule) {
+    if (F.isDeclaration())
+      continue;
+    auto GS = DefinedGlobals.find(F.getGUID());
+    if (GS == DefinedGlobals.end())
+      continue;
+    auto *FS = dyn_cast<FunctionSummary>(GS->second);
+    if (!FS || !FS->entryCount())
+      continue;
+    auto EntryCount = F.getEntryCount();
+    if (EntryCount.hasValue() && !EntryCount.isSynthetic())
+      continue;
+    F.setEntryCount(
+        Function::ProfileCount(FS->entryCount(), Function::PCT_Synthetic));
+    Changed = true;
+  }
+  return Changed;
+}
+
 /// Make alias a clone of its aliasee.
 static Function *replaceAliasWithAliasee(Module *SrcModule, GlobalAlias *GA) {
   Function *Fn = cast<Function>(GA->getBaseObject());
@@ -0,0 +1,531 @@
+//===- FunctionSpecialization.cpp - Specialize functions ------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass specializes functions on the constant arguments passed to them by
+// some of their call sites. IPSCCP can only propagate an argument that is the
+// same constant at every call site; here, call sites passing the same
+// constants are redirected to a clone of the callee in which the constants
+// have been propagated, leaving the other call sites alone.
+//
+// The benefit of a specialization is estimated in the units of the inline
+// cost analysis by simulating the propagation of the constants through the
+// callee: instructions that fold, branches and switches that become
+// unconditional along with the code they make dead, indirect calls that
+// become direct, and loop exit conditions that become comparisons against a
+// constant. Code in loops is weighted by its loop depth. A specialization is
+// only made when its benefit is large enough compared to the size of the
+// callee, and the total size of the clones is bounded by a budget
+// proportional to the size of the module.
+//
+// With a profile, only the hot call sites are considered.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Transforms/IPO/FunctionSpecialization.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/ConstantFolding.h"
+#include "llvm/Analysis/InlineCost.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/OptimizationRemarkEmitter.h"
+#include "llvm/Analysis/ProfileSummaryInfo.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/InstrTypes.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "function-specialization"
+
+STATISTIC(NumSpecializations, "Number of functions specialized");
+STATISTIC(NumCallSitesRedirected,
+          "Number of call sites redirected to a specialization");
+STATISTIC(NumNotProfitable,
+          "Number of candidate specializations rejected by the cost model");
+STATISTIC(NumOverBudget,
+          "Number of specializations skipped for lack of code size budget");
+STATISTIC(NumTooManyClones,
+          "Number of specializations skipped because the function already "
+          "has the maximum number of clones");
+
+static cl::opt<unsigned> MinBenefitPercent(
+    "func-specialization-min-benefit", cl::init(20), cl::Hidden,
+    cl::desc("Minimum estimated benefit of a specialization, as a percentage "
+             "of the size of the function it clones"));
+
+static cl::opt<unsigned> SizeBudgetPercent(
+    "func-specialization-size-budget", cl::init(10), cl::Hidden,
+    cl::desc("Maximum total size of the specializations, as a percentage of "
+             "the size of the module"));
+
+static cl::opt<unsigned> MaxClonesPerFunction(
+    "func-specialization-max-clones", cl::init(3), cl::Hidden,
+    cl::desc("Maximum number of specializations of a single function"));
+
+static cl::opt<unsigned> MinFunctionSize(
+    "func-specialization-min-size", cl::init(10), cl::Hidden,
+    cl::desc("Do not specialize functions with fewer instructions, which the "
+             "inliner is expected to handle"));
+
+static cl::opt<int> TripCountBonus(
+    "func-specialization-trip-count-bonus", cl::init(50), cl::Hidden,
+    cl::desc("Bonus for a loop exit condition that becomes a comparison "
+             "against a constant"));
+
+namespace {
+
+/// The arguments of a function fixed to constants, by argument number.
+using ArgConstants = SmallVector<std::pair<unsigned, Constant *>, 4>;
+
+/// A clone of a function to be made for a set of call sites passing it the
+/// same constant arguments.
+struct Specialization {
+  Function *F;
+  ArgConstants Args;
+  SmallVector<CallSite, 4> Sites;
+  /// The sum of the profile counts of the call sites, if there is a profile.
+  uint64_t Count = 0;
+  int Bonus = 0;
+  int Cost = 0;
+
+  Specialization(Function *F, ArgConstants Args)
+      : F(F), Args(std::move(Args)) {}
+};
+
+class FunctionSpecializer {
+public:
+  FunctionSpecializer(
+      ProfileSummaryInfo *PSI,
+      function_ref<BlockFrequencyInfo &(Function &)> GetBFI,
+      function_ref<LoopInfo &(Function &)> GetLI)
+      : PSI(PSI), GetBFI(GetBFI), GetLI(GetLI) {}
+
+  bool run(Module &M);
+
+private:
+  bool isCandidate(Function &F) const;
+  void collectSpecializations(Function &F,
+                              SmallVectorImpl<Specialization> &Specs);
+  int getSpecializationBonus(Function &F, const ArgConstants &Args);
+  Function *createSpecialization(Specialization &S);
+
+  ProfileSummaryInfo *PSI;
+  function_ref<BlockFrequencyInfo &(Function &)> GetBFI;
+  function_ref<LoopInfo &(Function &)> GetLI;
+};
+
+} // end anonymous namespace
+
+/// Returns V if it is a constant worth specializing on: an integer or floating
+/// point constant, or the address of a function. A cast instruction of a
+/// function is not a constant that the clone could be given.
+static Constant *getSpecializableConstant(Value *V) {
+  if (isa<ConstantInt>(V) || isa<ConstantFP>(V))
+    return cast<Constant>(V);
+  if (isa<Function>(V->stripPointerCasts()))
+    return dyn_cast<Constant>(V);
+  return nullptr;
+}
+
+/// Returns the weight of the code in BB. Code in loops runs several times per
+/// call, so assume every level of nesting multiplies it by four.
+static int getLoopWeight(const BasicBlock *BB, const LoopInfo &LI) {
+  return 1 << (2 * std::min(LI.getLoopDepth(BB), 3U));
+}
+
+/// Returns the number of instructions that become dead along with Succ when
+/// the terminator of BB stops branching to it.
+static int getDeadSuccessorSize(const BasicBlock *BB, const BasicBlock *Succ) {
+  if (Succ->getSinglePredecessor() != BB)
+    return 0;
+  return Succ->size();
+}
+
+bool FunctionSpecializer::isCandidate(Function &F) const {
+  if (F.isDeclaration() || F.isVarArg() || F.isInterposable())
+    return false;
+  if (F.hasFnAttribute(Attribute::OptimizeNone) ||
+      F.hasFnAttribute(Attribute::NoDuplicate) ||
+      F.hasFnAttribute(Attribute::Naked))
+    return false;
+  if (F.getInstructionCount() < MinFunctionSize)
+    return false;
+  return !F.hasFnAttribute(Attribute::Cold) &&
+         !(PSI && PSI->isFunctionEntryCold(&F));
+}
+
+void FunctionSpecializer::collectSpecializations(
+    Function &F, SmallVectorImpl<Specialization> &Specs) {
+  bool HasProfile = PSI && PSI->hasProfileSummary();
+  for (Use &U : F.uses()) {
+    CallSite CS(U.getUser());
+    if (!CS || !CS.isCallee(&U))
+      continue;
+    Function *Caller = CS.getCaller();
+    if (Caller->hasFnAttribute(Attribute::OptimizeNone))
+      continue;
+
+    ArgConstants Args;
+    for (Argument &A : F.args())
+      if (!A.use_empty())
+        if (Constant *C = getSpecializableConstant(
+                CS.getArgument(A.getArgNo())))
+          Args.push_back({A.getArgNo(), C});
+    if (Args.empty())
+      continue;
+
+    uint64_t Count = 0;
+    if (HasProfile) {
+      BlockFrequencyInfo &BFI = GetBFI(*Caller);
+      if (!PSI->isHotCallSite(CS, &BFI)) {
+        LLVM_DEBUG(dbgs() << "Ignoring cold call to " << F.getName() << " in "
+                          << Caller->getName() << "\n");
+        continue;
+      }
+      Count = PSI->getProfileCount(CS.getInstruction(), &BFI).getValueOr(0);
+    }
+
+    // Call sites passing the same constants share a specialization.
+    auto It = llvm::find_if(
+        Specs, [&](const Specialization &S) { return S.Args == Args; });
+    if (It == Specs.end()) {
+      Specs.emplace_back(&F, std::move(Args));
+      It = std::prev(Specs.end());
+    }
+    It->Sites.push_back(CS);
+    It->Count += Count;
+  }
+}
+
+int FunctionSpecializer::getSpecializationBonus(Function &F,
+                                                const ArgConstants &Args) {
+  const DataLayout &DL = F.getParent()->getDataLayout();
+  LoopInfo &LI = GetLI(F);
+
+  // Propagate the constants through the users of the arguments, folding what
+  // can be folded, and credit the work that the specialization saves.
+  DenseMap<Value *, Constant *> Known;
+  SmallPtrSet<Instruction *, 16> Credited;
+  SmallVector<Instruction *, 16> Worklist;
+  auto AddUsers = [&](Value *V) {
+    for (User *U : V->users())
+      if (auto *I = dyn_cast<Instruction>(U))
+        Worklist.push_back(I);
+  };
+  for (auto &A : Args) {
+    Argument *Arg = F.arg_begin() + A.first;
+    Known[Arg] = A.second;
+    AddUsers(Arg);
+  }
+
+  int Bonus = 0;
+  while (!Worklist.empty()) {
+    Instruction *I = Worklist.pop_back_val();
+    if (Known.count(I) || Credited.count(I))
+      continue;
+    BasicBlock *BB = I->getParent();
+    int Weight = getLoopWeight(BB, LI);
+
+    if (auto *BI = dyn_cast<BranchInst>(I)) {
+      auto *Cond = BI->isConditional()
+                       ? dyn_cast_or_null<ConstantInt>(
+                             Known.lookup(BI->getCondition()))
+                       : nullptr;
+      if (!Cond)
+        continue;
+      Credited.insert(I);
+      BasicBlock *Dead = BI->getSuccessor(Cond->isZero() ? 0 : 1);
+      Bonus += Weight * InlineConstants::InstrCost *
+               (1 + getDeadSuccessorSize(BB, Dead));
+      continue;
+    }
+
+    if (auto *SI = dyn_cast<SwitchInst>(I)) {
+      auto *Cond =
+          dyn_cast_or_null<ConstantInt>(Known.lookup(SI->getCondition()));
+      if (!Cond)
+        continue;
+      Credited.insert(I);
+      BasicBlock *Taken = SI->findCaseValue(Cond)->getCaseSuccessor();
+      SmallPtrSet<BasicBlock *, 8> Dead;
+      int DeadSize = 0;
+      for (BasicBlock *Succ : successors(BB))
+        if (Succ != Taken && Dead.insert(Succ).second)
+          DeadSize += getDeadSuccessorSize(BB, Succ);
+      Bonus += Weight * InlineConstants::InstrCost * (1 + DeadSize);
+      continue;
+    }
+
+    if (auto CS = CallSite(I)) {
+      // An indirect call through a constant function pointer becomes direct,
+      // and can then be inlined.
+      Constant *Callee = Known.lookup(CS.getCalledValue());
+      if (Callee && isa<Function>(Callee->stripPointerCasts())) {
+        Credited.insert(I);
+        Bonus += Weight * InlineConstants::IndirectCallThreshold;
+        continue;
+      }
+    }
+
+    if (isa<PHINode>(I) || I->isTerminator() || I->mayHaveSideEffects())
+      continue;
+
+    SmallVector<Constant *, 4> Ops;
+    for (Value *Op : I->operands()) {
+      auto *C = dyn_cast<Constant>(Op);
+      if (!C)
+        C = Known.lookup(Op);
+      if (!C)
+        break;
+      Ops.push_back(C);
+    }
+
+    if (Ops.size() != I->getNumOperands()) {
+      // A loop exit condition comparing against one of the constants gives
+      // the loop a constant trip count, which enables unrolling and spares
+      // the vectorizer its runtime checks.
+      auto *Cmp = dyn_cast<CmpInst>(I);
+      Loop *L = LI.getLoopFor(BB);
+      if (Cmp && L && L->isLoopExiting(BB) &&
+          BB->getTerminator()->getOperand(0) == Cmp) {
+        Credited.insert(I);
+        Bonus += TripCountBonus;
+      }
+      continue;
+    }
+
+    Constant *Folded = nullptr;
+    if (auto *Cmp = dyn_cast<CmpInst>(I))
+      Folded = ConstantFoldCompareInstOperands(Cmp->getPredicate(), Ops[0],
+                                               Ops[1], DL);
+    else
+      Folded = ConstantFoldInstOperands(I, Ops, DL);
+    if (!Folded)
+      continue;
+    Known[I] = Folded;
+    Bonus += Weight * InlineConstants::InstrCost;
+    AddUsers(I);
+  }
+  return Bonus;
+}
+
+Function *FunctionSpecializer::createSpecialization(Specialization &S) {
+  Function &F = *S.F;
+  ValueToValueMapTy VMap;
+  Function *Clone = CloneFunction(&F, VMap);
+  Clone->setName(F.getName() + ".specialized");
+  // Only the call sites we redirect can reach the clone.
+  Clone->setLinkage(GlobalValue::InternalLinkage);
+  Clone->setVisibility(GlobalValue::DefaultVisibility);
+  Clone->setDLLStorageClass(GlobalValue::DefaultStorageClass);
+  Clone->setComdat(nullptr);
+
+  // Split the profile between the original and the clone.
+  auto EntryCount = F.getEntryCount();
+  if (EntryCount.hasValue() && S.Count) {
+    uint64_t Moved = std::min(S.Count, EntryCount.getCount());
+    Clone->setEntryCount(Function::ProfileCount(Moved, EntryCount.getType()));
+    F.setEntryCount(Function::ProfileCount(EntryCount.getCount() - Moved,
+                                           EntryCount.getType()));
+  }
+
+  // Propagate the constants and fold what they make trivially foldable, so
+  // that the following passes already see the direct calls and the pruned
+  // control flow.
+  for (auto &A : S.Args) {
+    Argument *Arg = Clone->arg_begin() + A.first;
+    Arg->replaceAllUsesWith(A.second);
+  }
+  for (BasicBlock &BB : *Clone) {
+    SimplifyInstructionsInBlock(&BB);
+    ConstantFoldTerminator(&BB, /*DeleteDeadConditions=*/true);
+  }
+  removeUnreachableBlocks(*Clone);
+
+  for (CallSite CS : S.Sites) {
+    CS.setCalledFunction(Clone);
+    ++NumCallSitesRedirected;
+  }
+  ++NumSpecializations;
+  return Clone;
+}
+
+bool FunctionSpecializer::run(Module &M) {
+  SmallVector<Function *, 16> Candidates;
+  uint64_t ModuleSize = 0;
+  for (Function &F : M) {
+    ModuleSize += F.getInstructionCount();
+    if (isCandidate(F))
+      Candidates.push_back(&F);
+  }
+
+  // Keep the specializations with the best ratio of benefit to cost for
+  // every function.
+  SmallVector<Specialization, 16> Worklist;
+  for (Function *F : Candidates) {
+    SmallVector<Specialization, 4> Specs;
+    collectSpecializations(*F, Specs);
+    for (Specialization &S : Specs) {
+      S.Bonus = getSpecializationBonus(*F, S.Args);
+      S.Cost = F->getInstructionCount() * InlineConstants::InstrCost;
+      LLVM_DEBUG(dbgs() << "Specialization of " << F->getName() << " for "
+                        << S.Sites.size() << " call sites: bonus " << S.Bonus
+                        << ", cost " << S.Cost << "\n");
+      if ((int64_t)S.Bonus * 100 < (int64_t)S.Cost * MinBenefitPercent) {
+        ++NumNotProfitable;
+        Instruction *Call = S.Sites.front().getInstruction();
+        OptimizationRemarkEmitter ORE(Call->getFunction());
+        ORE.emit([&]() {
+          return OptimizationRemarkMissed(DEBUG_TYPE, "NotProfitable", Call)
+                 << "not specializing " << ore::NV("Callee", F)
+                 << ": benefit " << ore::NV("Bonus", S.Bonus)
+                 << " is too small for the cost " << ore::NV("Cost", S.Cost);
+        });
+        continue;
+      }
+      Worklist.push_back(std::move(S));
+    }
+  }
+
+  // Spend the budget on the most profitable specializations first.
+  std::stable_sort(Worklist.begin(), Worklist.end(),
+                   [](const Specialization &A, const Specialization &B) {
+                     int64_t LHS = (int64_t)A.Bonus * B.Cost;
+                     int64_t RHS = (int64_t)B.Bonus * A.Cost;
+                     if (LHS != RHS)
+                       return LHS > RHS;
+                     return A.Count > B.Count;
+                   });
+
+  uint64_t Budget = ModuleSize * SizeBudgetPercent / 100;
+  uint64_t Used = 0;
+  DenseMap<Function *, unsigned> NumClones;
+  bool Changed = false;
+  for (Specialization &S : Worklist) {
+    Function *F = S.F;
+    Instruction *Call = S.Sites.front().getInstruction();
+    OptimizationRemarkEmitter ORE(Call->getFunction());
+    unsigned Size = F->getInstructionCount();
+    if (NumClones[F] == MaxClonesPerFunction) {
+      ++NumTooManyClones;
+      ORE.emit([&]() {
+        return OptimizationRemarkMissed(DEBUG_TYPE, "TooManyClones", Call)
+               << "not specializing " << ore::NV("Callee", F)
+               << ": reached the limit of "
+               << ore::NV("MaxClones", (unsigned)MaxClonesPerFunction)
+               << " specializations";
+      });
+      continue;
+    }
+    if (Used + Size > Budget) {
+      ++NumOverBudget;
+      ORE.emit([&]() {
+        return OptimizationRemarkMissed(DEBUG_TYPE, "OverBudget", Call)
+               << "not specializing " << ore::NV("Callee", F)
+               << ": code size budget exhausted";
+      });
+      continue;
+    }
+
+    Function *Clone = createSpecialization(S);
+    Used += Size;
+    ++NumClones[F];
+    Changed = true;
+    ORE.emit([&]() {
+      return OptimizationRemark(DEBUG_TYPE, "Specialized", Call)
+             << "specialized " << ore::NV("Callee", F) << " into "
+             << ore::NV("Specialization", Clone) << " for "
+             << ore::NV("NumCallSites", (unsigned)S.Sites.size())
+             << " call sites";
+    });
+  }
+  return Changed;
+}
+
+namespace {
+
+class FunctionSpecializationLegacyPass : public ModulePass {
+public:
+  static char ID;
+
+  FunctionSpecializationLegacyPass() : ModulePass(ID) {
+    initializeFunctionSpecializationLegacyPassPass(
+        *PassRegistry::getPassRegistry());
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<BlockFrequencyInfoWrapperPass>();
+    AU.addRequired<LoopInfoWrapperPass>();
+    AU.addRequired<ProfileSummaryInfoWrapperPass>();
+  }
+
+  bool runOnModule(Module &M) override {
+    if (skipModule(M))
+      return false;
+    ProfileSummaryInfo *PSI =
+        getAnalysis<ProfileSummaryInfoWrapperPass>().getPSI();
+    auto GetBFI = [this](Function &F) -> BlockFrequencyInfo & {
+      return this->getAnalysis<BlockFrequencyInfoWrapperPass>(F).getBFI();
+    };
+    auto GetLI = [this](Function &F) -> LoopInfo & {
+      return this->getAnalysis<LoopInfoWrapperPass>(F).getLoopInfo();
+    };
+    return FunctionSpecializer(PSI, GetBFI, GetLI).run(M);
+  }
+};
+
+} // end anonymous namespace
+
+char FunctionSpecializationLegacyPass::ID = 0;
+
+INITIALIZE_PASS_BEGIN(FunctionSpecializationLegacyPass,
+                      "function-specialization",
+                      "Function Specialization", false, false)
+INITIALIZE_PASS_DEPENDENCY(BlockFrequencyInfoWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(LoopInfoWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(ProfileSummaryInfoWrapperPass)
+INITIALIZE_PASS_END(FunctionSpecializationLegacyPass,
+                    "function-specialization",
+                    "Function Specialization", false, false)
+
+ModulePass *llvm::createFunctionSpecializationPass() {
+  return new FunctionSpecializationLegacyPass();
+}
+
+PreservedAnalyses FunctionSpecializationPass::run(Module &M,
+                                                  ModuleAnalysisManager &AM) {
+  ProfileSummaryInfo *PSI = &AM.getResult<ProfileSummaryAnalysis>(M);
+  auto &FAM = AM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+  auto GetBFI = [&FAM](Function &F) -> BlockFrequencyInfo & {
+    return FAM.getResult<BlockFrequencyAnalysis>(F);
+  };
+  auto GetLI = [&FAM](Function &F) -> LoopInfo & {
+    return FAM.getResult<LoopAnalysis>(F);
+  };
+  if (!FunctionSpecializer(PSI, GetBFI, GetLI).run(M))
+    return PreservedAnalyses::all();
+  return PreservedAnalyses::none();
+}
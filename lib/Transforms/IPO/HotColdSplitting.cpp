@@ -0,0 +1,346 @@
+//===- HotColdSplitting.cpp - Outline cold regions of functions -----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass outlines the cold regions of functions into separate functions
+// that are marked cold, optimized for size and placed in the .text.unlikely
+// section. The hot parts of the functions are left dense, which improves
+// i-cache and iTLB utilization.
+//
+// A block is cold when the profile summary says so, or, without a profile,
+// when it is statically unlikely to execute: it calls a cold function or ends
+// in unreachable. A block all of whose successors are cold is cold as well.
+// Cold blocks are grouped into single-entry regions which are outlined with
+// the CodeExtractor when they are large enough to pay for the call.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Transforms/IPO/HotColdSplitting.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/BranchProbabilityInfo.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/OptimizationRemarkEmitter.h"
+#include "llvm/Analysis/ProfileSummaryInfo.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/Utils/CodeExtractor.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "hotcoldsplit"
+
+STATISTIC(NumColdRegionsOutlined, "Number of cold regions outlined");
+STATISTIC(NumColdRegionsRejected,
+          "Number of cold regions not outlined because of their cost");
+
+static cl::opt<unsigned> MinOutliningSize(
+    "hotcoldsplit-threshold", cl::init(3), cl::Hidden,
+    cl::desc("Minimum number of instructions a cold region must contain to be "
+             "outlined"));
+
+static cl::opt<unsigned> MaxRegionsPerFunction(
+    "hotcoldsplit-max-regions", cl::init(8), cl::Hidden,
+    cl::desc("Maximum number of cold regions outlined from one function"));
+
+/// Returns true if BB is statically unlikely to be executed.
+static bool unlikelyExecuted(const BasicBlock &BB) {
+  // The block is cold if it calls or invokes a cold function.
+  for (const Instruction &I : BB)
+    if (auto CS = ImmutableCallSite(&I))
+      if (CS.hasFnAttr(Attribute::Cold))
+        return true;
+  // Branch probability info already treats edges leading to unreachable as
+  // extremely unlikely; agree with it.
+  return isa<UnreachableInst>(BB.getTerminator());
+}
+
+/// Returns the number of instructions that would leave the function with the
+/// blocks in Region.
+static unsigned getRegionSize(ArrayRef<BasicBlock *> Region) {
+  unsigned Size = 0;
+  for (BasicBlock *BB : Region)
+    for (Instruction &I : *BB)
+      if (!isa<DbgInfoIntrinsic>(I))
+        ++Size;
+  return Size;
+}
+
+namespace {
+
+class HotColdSplitting {
+public:
+  explicit HotColdSplitting(ProfileSummaryInfo *PSI) : PSI(PSI) {}
+  bool run(Module &M);
+
+private:
+  bool shouldSplit(const Function &F) const;
+  bool splitFunction(Function &F);
+  void findColdBlocks(Function &F, BlockFrequencyInfo *BFI,
+                      SmallPtrSetImpl<BasicBlock *> &ColdBlocks) const;
+  void
+  findRegions(Function &F, DominatorTree &DT,
+              const SmallPtrSetImpl<BasicBlock *> &ColdBlocks,
+              SmallVectorImpl<SmallVector<BasicBlock *, 8>> &Regions) const;
+  Function *outlineRegion(ArrayRef<BasicBlock *> Region, DominatorTree &DT,
+                          BlockFrequencyInfo *BFI, BranchProbabilityInfo *BPI,
+                          OptimizationRemarkEmitter &ORE);
+
+  ProfileSummaryInfo *PSI;
+};
+
+} // end anonymous namespace
+
+bool HotColdSplitting::shouldSplit(const Function &F) const {
+  if (F.isDeclaration() || F.hasFnAttribute(Attribute::OptimizeNone) ||
+      F.hasFnAttribute(Attribute::Naked))
+    return false;
+  // Nothing to gain when the whole function is cold, and this also keeps us
+  // from splitting the functions we outlined ourselves.
+  if (F.hasFnAttribute(Attribute::Cold))
+    return false;
+  if (PSI && PSI->isFunctionEntryCold(&F))
+    return false;
+  return F.size() > 1;
+}
+
+void HotColdSplitting::findColdBlocks(
+    Function &F, BlockFrequencyInfo *BFI,
+    SmallPtrSetImpl<BasicBlock *> &ColdBlocks) const {
+  // Visit the successors first so that coldness propagates backwards from
+  // the blocks that are unlikely to execute.
+  for (BasicBlock *BB : post_order(&F)) {
+    bool Cold = (BFI && PSI->isColdBB(BB, BFI)) || unlikelyExecuted(*BB);
+    if (!Cold && succ_begin(BB) != succ_end(BB))
+      Cold = llvm::all_of(successors(BB), [&](BasicBlock *Succ) {
+        return ColdBlocks.count(Succ);
+      });
+    // The extracted code must be entered through a regular edge.
+    if (Cold && !BB->isEHPad() && BB != &F.getEntryBlock())
+      ColdBlocks.insert(BB);
+  }
+}
+
+void HotColdSplitting::findRegions(
+    Function &F, DominatorTree &DT,
+    const SmallPtrSetImpl<BasicBlock *> &ColdBlocks,
+    SmallVectorImpl<SmallVector<BasicBlock *, 8>> &Regions) const {
+  SmallPtrSet<BasicBlock *, 16> Assigned;
+  ReversePostOrderTraversal<Function *> RPOT(&F);
+  for (BasicBlock *Entry : RPOT) {
+    if (!ColdBlocks.count(Entry) || Assigned.count(Entry))
+      continue;
+
+    // Grow the region through the cold blocks dominated by its entry.
+    SetVector<BasicBlock *> Region;
+    Region.insert(Entry);
+    for (unsigned I = 0; I != Region.size(); ++I)
+      for (BasicBlock *Succ : successors(Region[I]))
+        if (ColdBlocks.count(Succ) && !Assigned.count(Succ) &&
+            DT.dominates(Entry, Succ))
+          Region.insert(Succ);
+
+    // Only the entry may be reached from outside the region. Drop the blocks
+    // that are, along with what is no longer reachable from the entry, until
+    // the region is stable.
+    bool Changed = true;
+    while (Changed) {
+      Changed = false;
+      SmallPtrSet<BasicBlock *, 8> InRegion(Region.begin(), Region.end());
+      SetVector<BasicBlock *> Kept;
+      Kept.insert(Entry);
+      for (unsigned I = 0; I != Kept.size(); ++I)
+        for (BasicBlock *Succ : successors(Kept[I])) {
+          if (!InRegion.count(Succ))
+            continue;
+          if (llvm::all_of(predecessors(Succ), [&](BasicBlock *Pred) {
+                return InRegion.count(Pred);
+              }))
+            Kept.insert(Succ);
+        }
+      if (Kept.size() != Region.size()) {
+        Region = std::move(Kept);
+        Changed = true;
+      }
+    }
+
+    Assigned.insert(Region.begin(), Region.end());
+    Regions.emplace_back(Region.begin(), Region.end());
+  }
+}
+
+Function *HotColdSplitting::outlineRegion(ArrayRef<BasicBlock *> Region,
+                                          DominatorTree &DT,
+                                          BlockFrequencyInfo *BFI,
+                                          BranchProbabilityInfo *BPI,
+                                          OptimizationRemarkEmitter &ORE) {
+  BasicBlock *Entry = Region.front();
+  unsigned Size = getRegionSize(Region);
+  if (Size < MinOutliningSize) {
+    LLVM_DEBUG(dbgs() << "Cold region at " << Entry->getName()
+                      << " is too small: " << Size << " instructions\n");
+    return nullptr;
+  }
+
+  CodeExtractor CE(Region, &DT, /* AggregateArgs */ false, BFI, BPI);
+  if (!CE.isEligible()) {
+    ORE.emit([&]() {
+      return OptimizationRemarkMissed(DEBUG_TYPE, "ExtractFailed",
+                                      &*Entry->begin())
+             << "cold region cannot be extracted";
+    });
+    return nullptr;
+  }
+
+  // The call needs roughly one instruction per argument, and each output also
+  // costs a store in the outlined function and a load after the call.
+  SetVector<Value *> Inputs, Outputs, Sinks;
+  CE.findInputsOutputs(Inputs, Outputs, Sinks);
+  unsigned CallCost = 1 + Inputs.size() + 2 * Outputs.size();
+  if (Size <= CallCost) {
+    ++NumColdRegionsRejected;
+    ORE.emit([&]() {
+      return OptimizationRemarkMissed(DEBUG_TYPE, "NotProfitable",
+                                      &*Entry->begin())
+             << "cold region of " << ore::NV("Size", Size)
+             << " instructions is not worth the cost of the call ("
+             << ore::NV("Cost", CallCost) << ")";
+    });
+    return nullptr;
+  }
+
+  Function *OutF = CE.extractCodeRegion();
+  if (!OutF)
+    return nullptr;
+
+  OutF->addFnAttr(Attribute::Cold);
+  OutF->addFnAttr(Attribute::MinSize);
+  OutF->addFnAttr(Attribute::NoInline);
+  OutF->setSectionPrefix(".unlikely");
+
+  CallInst *CI = cast<CallInst>(*OutF->user_begin());
+  ORE.emit([&]() {
+    return OptimizationRemark(DEBUG_TYPE, "HotColdSplit", CI)
+           << "split cold code into " << ore::NV("Split", OutF);
+  });
+  ++NumColdRegionsOutlined;
+  return OutF;
+}
+
+bool HotColdSplitting::splitFunction(Function &F) {
+  LLVM_DEBUG(dbgs() << "Looking for cold regions in " << F.getName() << "\n");
+
+  // Block frequencies are only needed to query the profile.
+  std::unique_ptr<LoopInfo> LI;
+  std::unique_ptr<BranchProbabilityInfo> BPI;
+  std::unique_ptr<BlockFrequencyInfo> BFI;
+  DominatorTree DT(F);
+  if (PSI && PSI->hasProfileSummary() && F.hasProfileData()) {
+    LI.reset(new LoopInfo(DT));
+    BPI.reset(new BranchProbabilityInfo(F, *LI));
+    BFI.reset(new BlockFrequencyInfo(F, *BPI, *LI));
+  }
+
+  SmallPtrSet<BasicBlock *, 16> ColdBlocks;
+  findColdBlocks(F, BFI.get(), ColdBlocks);
+  if (ColdBlocks.empty())
+    return false;
+
+  SmallVector<SmallVector<BasicBlock *, 8>, 4> Regions;
+  findRegions(F, DT, ColdBlocks, Regions);
+
+  // The regions are disjoint, so outlining one of them leaves the blocks of
+  // the others untouched. The dominator tree is not kept up to date by the
+  // extractor though, so recompute it after every extraction.
+  OptimizationRemarkEmitter ORE(&F);
+  unsigned NumOutlined = 0;
+  for (auto &Region : Regions) {
+    if (NumOutlined == MaxRegionsPerFunction)
+      break;
+    if (!outlineRegion(Region, DT, BFI.get(), BPI.get(), ORE))
+      continue;
+    ++NumOutlined;
+    DT.recalculate(F);
+  }
+  return NumOutlined != 0;
+}
+
+bool HotColdSplitting::run(Module &M) {
+  // Collect the functions first; the outlined ones are added to the module as
+  // we go.
+  SmallVector<Function *, 16> Worklist;
+  for (Function &F : M)
+    if (shouldSplit(F))
+      Worklist.push_back(&F);
+
+  bool Changed = false;
+  for (Function *F : Worklist)
+    Changed |= splitFunction(*F);
+  return Changed;
+}
+
+namespace {
+
+class HotColdSplittingLegacyPass : public ModulePass {
+public:
+  static char ID;
+
+  HotColdSplittingLegacyPass() : ModulePass(ID) {
+    initializeHotColdSplittingLegacyPassPass(*PassRegistry::getPassRegistry());
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<ProfileSummaryInfoWrapperPass>();
+  }
+
+  bool runOnModule(Module &M) override {
+    if (skipModule(M))
+      return false;
+    ProfileSummaryInfo *PSI =
+        getAnalysis<ProfileSummaryInfoWrapperPass>().getPSI();
+    return HotColdSplitting(PSI).run(M);
+  }
+};
+
+} // end anonymous namespace
+
+char HotColdSplittingLegacyPass::ID = 0;
+
+INITIALIZE_PASS_BEGIN(HotColdSplittingLegacyPass, "hotcoldsplit",
+                      "Hot Cold Splitting", false, false)
+INITIALIZE_PASS_DEPENDENCY(ProfileSummaryInfoWrapperPass)
+INITIALIZE_PASS_END(HotColdSplittingLegacyPass, "hotcoldsplit",
+                    "Hot Cold Splitting", false, false)
+
+ModulePass *llvm::createHotColdSplittingPass() {
+  return new HotColdSplittingLegacyPass();
+}
+
+PreservedAnalyses HotColdSplittingPass::run(Module &M,
+                                            ModuleAnalysisManager &AM) {
+  ProfileSummaryInfo *PSI = &AM.getResult<ProfileSummaryAnalysis>(M);
+  if (!HotColdSplitting(PSI).run(M))
+    return PreservedAnalyses::all();
+  return PreservedAnalyses::none();
+}
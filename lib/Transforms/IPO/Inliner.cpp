@@ -967,8 +967,9 @@ PreservedAnalyses InlinerPass::run(LazyCallGraph::SCC &InitialC,
     auto GetInlineCost = [&](CallSite CS) {
       Function &Callee = *CS.getCalledFunction();
       auto &CalleeTTI = FAM.getResult<TargetIRAnalysis>(Callee);
+      auto &CalleeCache = FAM.getResult<InlineCostCacheAnalysis>(Callee);
       return getInlineCost(CS, Params, CalleeTTI, GetAssumptionCache, {GetBFI},
-                           PSI, &ORE);
+                           PSI, &ORE, &CalleeCache);
     };
 
     // Now process as many calls as we have within this caller in the sequnece.
@@ -1028,6 +1029,13 @@ PreservedAnalyses InlinerPass::run(LazyCallGraph::SCC &InitialC,
       DidInline = true;
       InlinedCallees.insert(&Callee);
 
+      // The body of the caller changed, so any inline cost walks cached for it
+      // as a callee are stale. They may be needed again before this pass
+      // finishes for calls within the current SCC.
+      if (auto *CallerCostCache =
+              FAM.getCachedResult<InlineCostCacheAnalysis>(F))
+        CallerCostCache->clear();
+
       emit_inlined_into(ORE, DLoc, Block, Callee, F, *OIC);
 
       // Add any new callsites to defined functions to the worklist.
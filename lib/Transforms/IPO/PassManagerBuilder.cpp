@@ -49,6 +49,23 @@ static cl::opt<bool>
     RunPartialInlining("enable-partial-inlining", cl::init(false), cl::Hidden,
                        cl::ZeroOrMore, cl::desc("Run Partial inlinining pass"));
 
+static cl::opt<bool> RunLoopFusion(
+    "enable-loop-fusion", cl::init(false), cl::Hidden, cl::ZeroOrMore,
+    cl::desc("Run the loop fusion pass"));
+
+static cl::opt<bool> RunHeapToStack(
+    "enable-heap-to-stack", cl::init(false), cl::Hidden, cl::ZeroOrMore,
+    cl::desc("Run the heap to stack promotion pass"));
+
+static cl::opt<bool> RunFunctionSpecialization(
+    "enable-function-specialization", cl::init(false), cl::Hidden,
+    cl::ZeroOrMore, cl::desc("Run the function specialization pass"));
+
+static cl::opt<bool>
+    RunHotColdSplitting("hot-cold-split", cl::init(false), cl::Hidden,
+                        cl::ZeroOrMore,
+                        cl::desc("Outline cold regions of functions"));
+
 static cl::opt<bool>
     RunLoopVectorization("vectorize-loops", cl::Hidden,
                          cl::desc("Run the Loop vectorization passes"));
@@ -313,6 +330,12 @@ void PassManagerBuilder::addFunctionSimplificationPasses(
   // Break up aggregate allocas, using SSAUpdater.
   MPM.add(createSROAPass());
   MPM.add(createEarlyCSEPass(EnableEarlyCSEMemSSA)); // Catch trivial redundancies
+  // Move the small heap allocations that the inliner exposed as not escaping
+  // to the stack, and break them apart as well.
+  if (RunHeapToStack) {
+    MPM.add(createHeapToStackPass());
+    MPM.add(createSROAPass());
+  }
   if (EnableGVNHoist)
     MPM.add(createGVNHoistPass());
   if (EnableGVNSink) {
@@ -353,7 +376,8 @@ void PassManagerBuilder::addFunctionSimplificationPasses(
   MPM.add(createLoopRotatePass(SizeLevel == 2 ? 0 : -1));
   MPM.add(createLICMPass());                  // Hoist loop invariants
   if (EnableSimpleLoopUnswitch)
-    MPM.add(createSimpleLoopUnswitchLegacyPass());
+    MPM.add(createSimpleLoopUnswitchLegacyPass(OptLevel >= 3 &&
+                                               SizeLevel == 0));
   else
     MPM.add(createLoopUnswitchPass(SizeLevel || OptLevel < 3, DivergentTarget));
   // FIXME: We break the loop pass pipeline here in order to do full
@@ -494,6 +518,10 @@ void PassManagerBuilder::populateModulePassManager(
   if (OptLevel > 2)
     MPM.add(createCallSiteSplittingPass());
 
+  // Specialize functions on constant arguments first, so that IPSCCP can
+  // propagate them into the specializations.
+  if (RunFunctionSpecialization)
+    MPM.add(createFunctionSpecializationPass());
   MPM.add(createIPSCCPPass());          // IP SCCP
   MPM.add(createCalledValuePropagationPass());
   MPM.add(createGlobalOptimizerPass()); // Optimize out global vars
@@ -621,6 +649,11 @@ void PassManagerBuilder::populateModulePassManager(
   // on the rotated form. Disable header duplication at -Oz.
   MPM.add(createLoopRotatePass(SizeLevel == 2 ? 0 : -1));
 
+  // Fuse adjacent loops over the same iteration space, so that the data they
+  // share is only streamed once and the vectorizer sees a single loop.
+  if (RunLoopFusion)
+    MPM.add(createLoopFusePass());
+
   // Distribute loops to allow partial vectorization.  I.e. isolate dependences
   // into separate loop that would otherwise inhibit vectorization.  This is
   // currently only performed for loops marked with the metadata
@@ -699,6 +732,11 @@ void PassManagerBuilder::populateModulePassManager(
   // FIXME: We shouldn't bother with this anymore.
   MPM.add(createStripDeadPrototypesPass()); // Get rid of dead prototypes
 
+  // Split out cold code late, so that the optimizations above still see it
+  // in the context of the function it came from.
+  if (RunHotColdSplitting)
+    MPM.add(createHotColdSplittingPass());
+
   // GlobalOpt already deletes dead functions and globals, at -O2 try a
   // late pass of GlobalDCE.  It is capable of deleting dead cycles.
   if (OptLevel > 1) {
@@ -0,0 +1,281 @@
+//===- SampleContextTracker.cpp - Context-sensitive profile tracking ------===//
+//
+//                      The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the SampleContextTracker used by the sample profile
+// loader to apply context-sensitive profiles.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Transforms/IPO/SampleContextTracker.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+
+using namespace llvm;
+using namespace sampleprof;
+
+#define DEBUG_TYPE "sample-context-tracker"
+
+static bool isSameLocation(const LineLocation &A, const LineLocation &B) {
+  return A.LineOffset == B.LineOffset && A.Discriminator == B.Discriminator;
+}
+
+/// Return the name the profile uses for the function of \p SP.
+static StringRef getProfileNameFor(const DISubprogram *SP) {
+  StringRef Name = SP->getLinkageName();
+  return Name.empty() ? SP->getName() : Name;
+}
+
+/// Return the name the profile uses for \p F. Suffixes added to the names
+/// of promoted and cloned functions are not part of the profile.
+static StringRef getProfileNameFor(const Function &F) {
+  return F.getName().split('.').first;
+}
+
+ContextTrieNode *ContextTrieNode::getChildContext(const LineLocation &CallSite,
+                                                  StringRef CalleeName) {
+  auto It = AllChildContext.find(std::make_pair(CallSite, CalleeName));
+  if (It == AllChildContext.end())
+    return nullptr;
+  return &It->second;
+}
+
+ContextTrieNode &
+ContextTrieNode::getOrCreateChildContext(const LineLocation &CallSite,
+                                         StringRef CalleeName) {
+  auto Key = std::make_pair(CallSite, CalleeName);
+  auto It = AllChildContext.find(Key);
+  if (It != AllChildContext.end())
+    return It->second;
+  return AllChildContext
+      .emplace(Key, ContextTrieNode(this, CalleeName, CallSite))
+      .first->second;
+}
+
+void ContextTrieNode::getChildContextsAt(
+    const LineLocation &CallSite, SmallVectorImpl<ContextTrieNode *> &Children) {
+  // Children are ordered by callsite first, so the ones at CallSite are
+  // adjacent.
+  for (auto It = AllChildContext.lower_bound(
+           std::make_pair(CallSite, StringRef()));
+       It != AllChildContext.end() && isSameLocation(It->first.first, CallSite);
+       ++It)
+    Children.push_back(&It->second);
+}
+
+ContextTrieNode *
+ContextTrieNode::getHottestChildContext(const LineLocation &CallSite) {
+  SmallVector<ContextTrieNode *, 4> Children;
+  getChildContextsAt(CallSite, Children);
+  ContextTrieNode *Hottest = nullptr;
+  uint64_t MaxTotalSamples = 0;
+  for (ContextTrieNode *Child : Children) {
+    FunctionSamples *FS = Child->getFunctionSamples();
+    if (FS && (!Hottest || FS->getTotalSamples() > MaxTotalSamples)) {
+      MaxTotalSamples = FS->getTotalSamples();
+      Hottest = Child;
+    }
+  }
+  return Hottest;
+}
+
+void ContextTrieNode::dump(raw_ostream &OS, unsigned Indent) const {
+  OS.indent(Indent);
+  if (ParentContext && ParentContext->ParentContext)
+    OS << CallSiteLoc << ": ";
+  OS << FuncName;
+  if (FuncSamples)
+    OS << " (" << FuncSamples->getTotalSamples() << " samples, "
+       << FuncSamples->getContext().getState() << ")";
+  OS << "\n";
+  for (const auto &Child : AllChildContext)
+    Child.second.dump(OS, Indent + 2);
+}
+
+SampleContextTracker::SampleContextTracker(
+    StringMap<FunctionSamples> &Profiles) {
+  for (auto &FuncSample : Profiles) {
+    FunctionSamples *FSamples = &FuncSample.second;
+    SampleContextFrames Frames;
+    if (!SampleContext::decodeContextString(
+            FSamples->getContext().getNameWithContext(), Frames))
+      continue;
+    ContextTrieNode *Node = getOrCreateContextPath(Frames);
+    Node->setFunctionSamples(FSamples);
+    FuncToCtxtProfiles[FSamples->getName()].push_back(FSamples);
+  }
+}
+
+ContextTrieNode *
+SampleContextTracker::getOrCreateContextPath(const SampleContextFrames &Frames) {
+  ContextTrieNode *Node = &RootContext;
+  LineLocation CallSite(0, 0);
+  for (const SampleContextFrame &Frame : Frames) {
+    Node = &Node->getOrCreateChildContext(CallSite, Frame.FuncName);
+    CallSite = Frame.Location;
+  }
+  return Node;
+}
+
+ContextTrieNode &
+SampleContextTracker::getOrCreateTopLevelContext(StringRef FName) {
+  return RootContext.getOrCreateChildContext(LineLocation(0, 0), FName);
+}
+
+ContextTrieNode *SampleContextTracker::getContextFor(const Instruction &Inst) {
+  ContextTrieNode *Node = RootContext.getChildContext(
+      LineLocation(0, 0), getProfileNameFor(*Inst.getFunction()));
+  const DILocation *DIL = Inst.getDebugLoc();
+  if (!DIL || !Node)
+    return Node;
+
+  // Collect the inline stack of Inst, innermost callsite first.
+  SmallVector<std::pair<LineLocation, StringRef>, 10> S;
+  const DILocation *PrevDIL = DIL;
+  for (DIL = DIL->getInlinedAt(); DIL; DIL = DIL->getInlinedAt()) {
+    S.push_back(std::make_pair(
+        LineLocation(FunctionSamples::getOffset(DIL),
+                     DIL->getBaseDiscriminator()),
+        getProfileNameFor(PrevDIL->getScope()->getSubprogram())));
+    PrevDIL = DIL;
+  }
+  for (int I = S.size() - 1; I >= 0 && Node; --I)
+    Node = Node->getChildContext(S[I].first, S[I].second);
+  return Node;
+}
+
+FunctionSamples *
+SampleContextTracker::getContextSamplesFor(const Instruction &Inst) {
+  ContextTrieNode *Node = getContextFor(Inst);
+  return Node ? Node->getFunctionSamples() : nullptr;
+}
+
+FunctionSamples *
+SampleContextTracker::getCalleeContextSamplesFor(const Instruction &Inst,
+                                                 StringRef CalleeName) {
+  const DILocation *DIL = Inst.getDebugLoc();
+  if (!DIL)
+    return nullptr;
+  ContextTrieNode *CallerNode = getContextFor(Inst);
+  if (!CallerNode)
+    return nullptr;
+
+  LineLocation CallSite(FunctionSamples::getOffset(DIL),
+                        DIL->getBaseDiscriminator());
+  ContextTrieNode *CalleeNode =
+      CalleeName.empty() ? CallerNode->getHottestChildContext(CallSite)
+                         : CallerNode->getChildContext(CallSite, CalleeName);
+  return CalleeNode ? CalleeNode->getFunctionSamples() : nullptr;
+}
+
+std::vector<const FunctionSamples *>
+SampleContextTracker::getIndirectCalleeContextSamplesFor(
+    const Instruction &Inst) {
+  std::vector<const FunctionSamples *> R;
+  const DILocation *DIL = Inst.getDebugLoc();
+  if (!DIL)
+    return R;
+  ContextTrieNode *CallerNode = getContextFor(Inst);
+  if (!CallerNode)
+    return R;
+
+  SmallVector<ContextTrieNode *, 4> Children;
+  CallerNode->getChildContextsAt(
+      LineLocation(FunctionSamples::getOffset(DIL),
+                   DIL->getBaseDiscriminator()),
+      Children);
+  for (ContextTrieNode *Child : Children)
+    if (const FunctionSamples *FS = Child->getFunctionSamples())
+      R.push_back(FS);
+  return R;
+}
+
+FunctionSamples *SampleContextTracker::getBaseSamplesFor(const Function &F) {
+  auto It = FuncToCtxtProfiles.find(getProfileNameFor(F));
+  if (It == FuncToCtxtProfiles.end())
+    return nullptr;
+
+  // Key the trie by the name owned by the profile map rather than by the IR.
+  StringRef FName = It->first();
+  ContextTrieNode &BaseNode = getOrCreateTopLevelContext(FName);
+
+  // Merging may create profiles of F's callees and of F itself for recursive
+  // contexts, so iterate over a copy.
+  SmallVector<FunctionSamples *, 4> CtxProfiles(It->second.begin(),
+                                                It->second.end());
+  for (FunctionSamples *CSamples : CtxProfiles) {
+    const SampleContext &Context = CSamples->getContext();
+    if (!Context.hasCallers() || Context.getState() != RawContext)
+      continue;
+    SampleContextFrames Frames;
+    SampleContext::decodeContextString(Context.getNameWithContext(), Frames);
+    ContextTrieNode *FromNode = getOrCreateContextPath(Frames);
+    LLVM_DEBUG(dbgs() << "Merging context " << Context.getNameWithContext()
+                      << " into the base profile of " << FName << "\n");
+    mergeContextNode(*FromNode, BaseNode);
+  }
+  return BaseNode.getFunctionSamples();
+}
+
+void SampleContextTracker::markContextSamplesInlined(
+    const FunctionSamples *InlinedSamples) {
+  assert(InlinedSamples && "Expected a context profile");
+  InlinedSamples->getContext().setState(InlinedContext);
+}
+
+FunctionSamples &
+SampleContextTracker::createFunctionSamples(ContextTrieNode &Node) {
+  std::string ContextStr;
+  raw_string_ostream OS(ContextStr);
+  SmallVector<const ContextTrieNode *, 8> Path;
+  for (const ContextTrieNode *N = &Node; N != &RootContext;
+       N = N->getParentContext())
+    Path.push_back(N);
+  for (int I = Path.size() - 1; I >= 0; --I) {
+    OS << Path[I]->getFuncName();
+    if (I > 0)
+      OS << ":" << Path[I - 1]->getCallSiteLoc() << " @ ";
+  }
+  CreatedContextStrs.push_back(OS.str());
+
+  CreatedSamples.emplace_back();
+  FunctionSamples &FS = CreatedSamples.back();
+  FS.setName(Node.getFuncName());
+  FS.setContext(SampleContext(CreatedContextStrs.back()));
+  Node.setFunctionSamples(&FS);
+  FuncToCtxtProfiles[Node.getFuncName()].push_back(&FS);
+  return FS;
+}
+
+void SampleContextTracker::mergeContextNode(ContextTrieNode &FromNode,
+                                            ContextTrieNode &ToNode) {
+  FunctionSamples *FromSamples = FromNode.getFunctionSamples();
+  if (FromSamples && FromSamples->getContext().getState() == RawContext) {
+    FunctionSamples *ToSamples = ToNode.getFunctionSamples();
+    if (!ToSamples)
+      ToSamples = &createFunctionSamples(ToNode);
+    ToSamples->merge(*FromSamples);
+    FromSamples->getContext().setState(MergedContext);
+  }
+
+  // The contexts of the callees move along with their caller.
+  for (auto &Child : FromNode.getAllChildContext())
+    mergeContextNode(Child.second,
+                     ToNode.getOrCreateChildContext(Child.first.first,
+                                                    Child.first.second));
+}
+
+void SampleContextTracker::dump(raw_ostream &OS) const {
+  for (const auto &Child : RootContext.getAllChildContext())
+    Child.second.dump(OS);
+}
@@ -27,6 +27,7 @@
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/None.h"
+#include "llvm/ADT/SCCIterator.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallSet.h"
 #include "llvm/ADT/SmallVector.h"
@@ -34,6 +35,7 @@
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/Twine.h"
 #include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/Analysis/CallGraph.h"
 #include "llvm/Analysis/InlineCost.h"
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/OptimizationRemarkEmitter.h"
@@ -70,6 +72,7 @@
 #include "llvm/Support/GenericDomTree.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/IPO/SampleContextTracker.h"
 #include "llvm/Transforms/Instrumentation.h"
 #include "llvm/Transforms/Utils/CallPromotionUtils.h"
 #include "llvm/Transforms/Utils/Cloning.h"
@@ -198,6 +201,7 @@ public:
 
 protected:
   bool runOnFunction(Function &F, ModuleAnalysisManager *AM);
+  std::vector<Function *> buildFunctionOrder(Module &M);
   unsigned getFunctionLoc(Function &F);
   bool emitAnnotations(Function &F);
   ErrorOr<uint64_t> getInstWeight(const Instruction &I);
@@ -279,6 +283,10 @@ protected:
   /// Samples collected for the body of this function.
   FunctionSamples *Samples = nullptr;
 
+  /// Tracker of the calling contexts of context-sensitive profiles, null if
+  /// the profile is not context-sensitive.
+  std::unique_ptr<SampleContextTracker> ContextTracker;
+
   /// Name of the profile file to load.
   std::string Filename;
 
@@ -536,8 +544,9 @@ ErrorOr<uint64_t> SampleProfileLoader::getInstWeight(const Instruction &Inst) {
   // If a direct call/invoke instruction is inlined in profile
   // (findCalleeFunctionSamples returns non-empty result), but not inlined here,
   // it means that the inlined callsite has no sample, thus the call
-  // instruction should have 0 count.
-  if ((isa<CallInst>(Inst) || isa<InvokeInst>(Inst)) &&
+  // instruction should have 0 count. Context-sensitive profiles have a
+  // callee context for every sampled call, inlined or not.
+  if (!ContextTracker && (isa<CallInst>(Inst) || isa<InvokeInst>(Inst)) &&
       !ImmutableCallSite(&Inst).isIndirectCall() &&
       findCalleeFunctionSamples(Inst))
     return 0;
@@ -639,6 +648,9 @@ SampleProfileLoader::findCalleeFunctionSamples(const Instruction &Inst) const {
     if (Function *Callee = CI->getCalledFunction())
       CalleeName = Callee->getName();
 
+  if (ContextTracker)
+    return ContextTracker->getCalleeContextSamplesFor(Inst, CalleeName);
+
   const FunctionSamples *FS = findFunctionSamples(Inst);
   if (FS == nullptr)
     return nullptr;
@@ -675,19 +687,23 @@ SampleProfileLoader::findIndirectCallFunctionSamples(
   if (T)
     for (const auto &T_C : T.get())
       Sum += T_C.second;
-  if (const FunctionSamplesMap *M = FS->findFunctionSamplesMapAt(LineLocation(
-          FunctionSamples::getOffset(DIL), DIL->getBaseDiscriminator()))) {
-    if (M->empty())
-      return R;
+  if (ContextTracker) {
+    R = ContextTracker->getIndirectCalleeContextSamplesFor(Inst);
+    for (const FunctionSamples *CalleeSamples : R)
+      Sum += CalleeSamples->getEntrySamples();
+  } else if (const FunctionSamplesMap *M =
+                 FS->findFunctionSamplesMapAt(LineLocation(
+                     FunctionSamples::getOffset(DIL),
+                     DIL->getBaseDiscriminator()))) {
     for (const auto &NameFS : *M) {
       Sum += NameFS.second.getEntrySamples();
       R.push_back(&NameFS.second);
     }
-    llvm::sort(R.begin(), R.end(),
-               [](const FunctionSamples *L, const FunctionSamples *R) {
-                 return L->getEntrySamples() > R->getEntrySamples();
-               });
   }
+  llvm::sort(R.begin(), R.end(),
+             [](const FunctionSamples *L, const FunctionSamples *R) {
+               return L->getEntrySamples() > R->getEntrySamples();
+             });
   return R;
 }
 
@@ -702,7 +718,9 @@ SampleProfileLoader::findIndirectCallFunctionSamples(
 /// \returns the FunctionSamples pointer to the inlined instance.
 const FunctionSamples *
 SampleProfileLoader::findFunctionSamples(const Instruction &Inst) const {
-  SmallVector<std::pair<LineLocation, StringRef>, 10> S;
+  if (ContextTracker)
+    return ContextTracker->getContextSamplesFor(Inst);
+
   const DILocation *DIL = Inst.getDebugLoc();
   if (!DIL)
     return Samples;
@@ -771,6 +789,10 @@ bool SampleProfileLoader::inlineHotFunctions(
         const FunctionSamples *FS = nullptr;
         if ((isa<CallInst>(I) || isa<InvokeInst>(I)) &&
             !isa<IntrinsicInst>(I) && (FS = findCalleeFunctionSamples(I))) {
+          // Context-sensitive profiles tell apart the callsites of a block,
+          // so only the hot ones are inlined.
+          if (ContextTracker && !callsiteIsHot(FS, PSI))
+            continue;
           Candidates.push_back(&I);
           if (callsiteIsHot(FS, PSI))
             Hot = true;
@@ -820,8 +842,11 @@ bool SampleProfileLoader::inlineHotFunctions(
             PromotedInsns.insert(I);
             // If profile mismatches, we should not attempt to inline DI.
             if ((isa<CallInst>(DI) || isa<InvokeInst>(DI)) &&
-                inlineCallInstruction(DI))
+                inlineCallInstruction(DI)) {
+              if (ContextTracker)
+                ContextTracker->markContextSamplesInlined(FS);
               LocalChanged = true;
+            }
           } else {
             LLVM_DEBUG(dbgs()
                        << "\nFailed to promote indirect call to "
@@ -830,8 +855,12 @@ bool SampleProfileLoader::inlineHotFunctions(
         }
       } else if (CalledFunction && CalledFunction->getSubprogram() &&
                  !CalledFunction->isDeclaration()) {
-        if (inlineCallInstruction(I))
+        const FunctionSamples *FS = findCalleeFunctionSamples(*I);
+        if (inlineCallInstruction(I)) {
+          if (ContextTracker)
+            ContextTracker->markContextSamplesInlined(FS);
           LocalChanged = true;
+        }
       } else if (IsThinLTOPreLink) {
         findCalleeFunctionSamples(*I)->findInlinedFunctions(
             InlinedGUIDs, F.getParent(), PSI->getOrCompHotCountThreshold(),
@@ -1537,6 +1566,9 @@ bool SampleProfileLoader::runOnModule(Module &M, ModuleAnalysisManager *AM,
     return false;
 
   PSI = _PSI;
+  if (Reader->profileIsCS())
+    ContextTracker =
+        llvm::make_unique<SampleContextTracker>(Reader->getProfiles());
   if (M.getProfileSummary() == nullptr)
     M.setProfileSummary(Reader->getSummary().getMD(M.getContext()));
 
@@ -1565,14 +1597,44 @@ bool SampleProfileLoader::runOnModule(Module &M, ModuleAnalysisManager *AM,
   }
 
   bool retval = false;
-  for (auto &F : M)
-    if (!F.isDeclaration()) {
-      clearFunctionData();
-      retval |= runOnFunction(F, AM);
-    }
+  for (Function *F : buildFunctionOrder(M)) {
+    clearFunctionData();
+    retval |= runOnFunction(*F, AM);
+  }
   return retval;
 }
 
+/// Return the functions of \p M with a body in the order they are processed.
+///
+/// With context-sensitive profiles, callers are processed before their
+/// callees, so that all the inline decisions about the contexts a function
+/// is called through are made when its base profile is built.
+std::vector<Function *> SampleProfileLoader::buildFunctionOrder(Module &M) {
+  std::vector<Function *> FunctionOrderList;
+  if (!ContextTracker) {
+    for (auto &F : M)
+      if (!F.isDeclaration())
+        FunctionOrderList.push_back(&F);
+    return FunctionOrderList;
+  }
+
+  // Walk the SCCs bottom-up and reverse the result. Functions not reachable
+  // from the external node come first.
+  CallGraph CG(M);
+  SmallPtrSet<Function *, 16> Visited;
+  for (scc_iterator<CallGraph *> CGI = scc_begin(&CG); !CGI.isAtEnd(); ++CGI)
+    for (CallGraphNode *Node : *CGI) {
+      Function *F = Node->getFunction();
+      if (F && !F->isDeclaration() && Visited.insert(F).second)
+        FunctionOrderList.push_back(F);
+    }
+  for (auto &F : M)
+    if (!F.isDeclaration() && !Visited.count(&F))
+      FunctionOrderList.push_back(&F);
+  std::reverse(FunctionOrderList.begin(), FunctionOrderList.end());
+  return FunctionOrderList;
+}
+
 bool SampleProfileLoaderLegacyPass::runOnModule(Module &M) {
   ACT = &getAnalysis<AssumptionCacheTracker>();
   TTIWP = &getAnalysis<TargetTransformInfoWrapperPass>();
@@ -1596,7 +1658,10 @@ bool SampleProfileLoader::runOnFunction(Function &F, ModuleAnalysisManager *AM)
     OwnedORE = make_unique<OptimizationRemarkEmitter>(&F);
     ORE = OwnedORE.get();
   }
-  Samples = Reader->getSamplesFor(F);
+  if (ContextTracker)
+    Samples = ContextTracker->getBaseSamplesFor(F);
+  else
+    Samples = Reader->getSamplesFor(F);
   if (Samples && !Samples->empty())
     return emitAnnotations(F);
   return false;
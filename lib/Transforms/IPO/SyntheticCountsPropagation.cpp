@@ -23,6 +23,10 @@
 // count. For non-trivial SCCs, the new counts are computed from the previous
 // counts and updated in one shot.
 //
+// Unless the module already has a profile summary, a summary of the synthetic
+// counts is attached to it as well, so that the hot and cold count thresholds
+// of ProfileSummaryInfo are available to the rest of the pipeline.
+//
 //===----------------------------------------------------------------------===//
 
 #include "llvm/Transforms/IPO/SyntheticCountsPropagation.h"
@@ -35,6 +39,7 @@
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
+#include "llvm/ProfileData/ProfileCommon.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
@@ -61,6 +66,12 @@ static cl::opt<int> ColdSyntheticCount(
     "cold-synthetic-count", cl::Hidden, cl::init(5), cl::ZeroOrMore,
     cl::desc("Initial synthetic entry count for cold functions."));
 
+/// Attach a profile summary of the synthetic counts to the module.
+static cl::opt<bool> SyntheticCountsSummary(
+    "synthetic-counts-summary", cl::Hidden, cl::init(true), cl::ZeroOrMore,
+    cl::desc("Attach a profile summary of the synthetic counts to the "
+             "module."));
+
 // Assign initial synthetic entry counts to functions.
 static void
 initializeCounts(Module &M, function_ref<void(Function *, uint64_t)> SetCount) {
@@ -136,5 +147,22 @@ PreservedAnalyses SyntheticCountsPropagation::run(Module &M,
     Entry.first->setEntryCount(
         ProfileCount(Entry.second, Function::PCT_Synthetic));
 
+  // Summarize the entry counts and the block counts derived from them. A
+  // summary of a real profile takes precedence.
+  if (SyntheticCountsSummary && !M.getProfileSummary()) {
+    SyntheticProfileSummaryBuilder Builder(
+        ProfileSummaryBuilder::DefaultCutoffs);
+    for (auto Entry : Counts) {
+      Function *F = Entry.first;
+      Builder.addEntryCount(Entry.second);
+      auto &BFI = FAM.getResult<BlockFrequencyAnalysis>(*F);
+      for (BasicBlock &BB : *F)
+        if (&BB != &F->getEntryBlock())
+          if (auto Count = BFI.getBlockProfileCount(&BB))
+            Builder.addInternalCount(*Count);
+    }
+    M.setProfileSummary(Builder.getSummary()->getMD(M.getContext()));
+  }
+
   return PreservedAnalyses::all();
 }
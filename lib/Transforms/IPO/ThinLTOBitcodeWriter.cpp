@@ -20,6 +20,7 @@
 #include "llvm/IR/PassManager.h"
 #include "llvm/Object/ModuleSymbolTable.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ScopedPrinter.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/IPO.h"
@@ -29,6 +30,13 @@
 #include "llvm/Transforms/Utils/ModuleUtils.h"
 using namespace llvm;
 
+static cl::opt<bool> SplitLTOUnit(
+    "thinlto-split-lto-unit", cl::init(true), cl::Hidden,
+    cl::desc("Split modules with type metadata into a ThinLTO part and a "
+             "regular LTO part. If disabled, the vtables are described in the "
+             "summary, which only supports whole program devirtualization "
+             "and not control flow integrity checks"));
+
 namespace {
 
 // Promote each local-linkage entity defined by ExportM and used by ImportM by
@@ -430,8 +438,9 @@ bool requiresSplit(Module &M) {
 void writeThinLTOBitcode(raw_ostream &OS, raw_ostream *ThinLinkOS,
                          function_ref<AAResults &(Function &)> AARGetter,
                          Module &M, const ModuleSummaryIndex *Index) {
-  // See if this module has any type metadata. If so, we need to split it.
-  if (requiresSplit(M))
+  // See if this module has any type metadata. If so, we need to split it,
+  // unless devirtualization is to be performed on the summary alone.
+  if (SplitLTOUnit && requiresSplit(M))
     return splitAndWriteThinLTOBitcode(OS, ThinLinkOS, AARGetter, M);
 
   // Otherwise we can just write it out as a regular module.
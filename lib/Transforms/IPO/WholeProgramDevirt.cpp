@@ -39,6 +39,10 @@
 //   modules. The pass applies the resolutions previously computed during the
 //   import phase to each eligible virtual call.
 //
+// If the modules were not split, the vtables are only described by the
+// summary, and the export phase is replaced by runWholeProgramDevirtOnIndex,
+// which performs single implementation devirtualization on the summary alone.
+//
 //===----------------------------------------------------------------------===//
 
 #include "llvm/Transforms/IPO/WholeProgramDevirt.h"
@@ -69,6 +73,7 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Metadata.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/ModuleSummaryIndex.h"
 #include "llvm/IR/ModuleSummaryIndexYAML.h"
 #include "llvm/Pass.h"
 #include "llvm/PassRegistry.h"
@@ -453,7 +458,6 @@ struct DevirtModule {
   void buildTypeIdentifierMap(
       std::vector<VTableBits> &Bits,
       DenseMap<Metadata *, std::set<TypeMemberInfo>> &TypeIdMap);
-  Constant *getPointerAtOffset(Constant *I, uint64_t Offset);
   bool
   tryFindVirtualCallTargets(std::vector<VirtualCallTarget> &TargetsForSlot,
                             const std::set<TypeMemberInfo> &TypeMemberInfos,
@@ -538,6 +542,29 @@ struct DevirtModule {
       function_ref<OptimizationRemarkEmitter &(Function *)> OREGetter);
 };
 
+struct DevirtIndex {
+  ModuleSummaryIndex &ExportSummary;
+  // The set in which to record GUIDs exported from their module by
+  // devirtualization, so that they are not internalized.
+  std::set<GlobalValue::GUID> &ExportedGUIDs;
+
+  // The (type identifier, offset) pairs of the virtual calls in the summary.
+  std::set<std::pair<StringRef, uint64_t>> CallSlots;
+
+  DevirtIndex(ModuleSummaryIndex &ExportSummary,
+              std::set<GlobalValue::GUID> &ExportedGUIDs)
+      : ExportSummary(ExportSummary), ExportedGUIDs(ExportedGUIDs) {}
+
+  bool tryFindVirtualCallTargets(std::vector<ValueInfo> &TargetsForSlot,
+                                 const TypeIdCompatibleVtableInfo &TIdInfo,
+                                 uint64_t ByteOffset);
+
+  bool trySingleImplDevirt(ArrayRef<ValueInfo> TargetsForSlot,
+                           WholeProgramDevirtResolution &Res);
+
+  void run();
+};
+
 struct WholeProgramDevirt : public ModulePass {
   static char ID;
 
@@ -617,6 +644,11 @@ PreservedAnalyses WholeProgramDevirtPass::run(Module &M,
   return PreservedAnalyses::none();
 }
 
+void llvm::runWholeProgramDevirtOnIndex(
+    ModuleSummaryIndex &Summary, std::set<GlobalValue::GUID> &ExportedGUIDs) {
+  DevirtIndex(Summary, ExportedGUIDs).run();
+}
+
 bool DevirtModule::runForTesting(
     Module &M, function_ref<AAResults &(Function &)> AARGetter,
     function_ref<OptimizationRemarkEmitter &(Function *)> OREGetter) {
@@ -690,38 +722,6 @@ void DevirtModule::buildTypeIdentifierMap(
   }
 }
 
-Constant *DevirtModule::getPointerAtOffset(Constant *I, uint64_t Offset) {
-  if (I->getType()->isPointerTy()) {
-    if (Offset == 0)
-      return I;
-    return nullptr;
-  }
-
-  const DataLayout &DL = M.getDataLayout();
-
-  if (auto *C = dyn_cast<ConstantStruct>(I)) {
-    const StructLayout *SL = DL.getStructLayout(C->getType());
-    if (Offset >= SL->getSizeInBytes())
-      return nullptr;
-
-    unsigned Op = SL->getElementContainingOffset(Offset);
-    return getPointerAtOffset(cast<Constant>(I->getOperand(Op)),
-                              Offset - SL->getElementOffset(Op));
-  }
-  if (auto *C = dyn_cast<ConstantArray>(I)) {
-    ArrayType *VTableTy = C->getType();
-    uint64_t ElemSize = DL.getTypeAllocSize(VTableTy->getElementType());
-
-    unsigned Op = Offset / ElemSize;
-    if (Op >= C->getNumOperands())
-      return nullptr;
-
-    return getPointerAtOffset(cast<Constant>(I->getOperand(Op)),
-                              Offset % ElemSize);
-  }
-  return nullptr;
-}
-
 bool DevirtModule::tryFindVirtualCallTargets(
     std::vector<VirtualCallTarget> &TargetsForSlot,
     const std::set<TypeMemberInfo> &TypeMemberInfos, uint64_t ByteOffset) {
@@ -730,7 +730,7 @@ bool DevirtModule::tryFindVirtualCallTargets(
       return false;
 
     Constant *Ptr = getPointerAtOffset(TM.Bits->GV->getInitializer(),
-                                       TM.Offset + ByteOffset);
+                                       TM.Offset + ByteOffset, M);
     if (!Ptr)
       return false;
 
@@ -750,6 +750,131 @@ bool DevirtModule::tryFindVirtualCallTargets(
   return !TargetsForSlot.empty();
 }
 
+bool DevirtIndex::tryFindVirtualCallTargets(
+    std::vector<ValueInfo> &TargetsForSlot,
+    const TypeIdCompatibleVtableInfo &TIdInfo, uint64_t ByteOffset) {
+  for (const TypeIdOffsetVtableInfo &P : TIdInfo) {
+    // The copies of a vtable with the same GUID are identical, so look at the
+    // first live one.
+    const GlobalVarSummary *VS = nullptr;
+    for (auto &S : P.VTableVI.getSummaryList()) {
+      auto *CurVS = dyn_cast<GlobalVarSummary>(S->getBaseObject());
+      if (CurVS && ExportSummary.isGlobalValueLive(CurVS)) {
+        VS = CurVS;
+        break;
+      }
+    }
+    if (!VS)
+      continue;
+    // Give up if the contents of the vtable are unknown.
+    if (VS->vTableFuncs().empty())
+      return false;
+    // A missing entry is a call to a pure virtual function, which is UB.
+    for (const VirtFuncOffset &VTP : VS->vTableFuncs())
+      if (VTP.VTableOffset == P.AddressPointOffset + ByteOffset) {
+        // Give up if the slot does not hold a known function.
+        if (!VTP.FuncVI)
+          return false;
+        TargetsForSlot.push_back(VTP.FuncVI);
+        break;
+      }
+  }
+
+  // Give up if we couldn't find any targets.
+  return !TargetsForSlot.empty();
+}
+
+bool DevirtIndex::trySingleImplDevirt(ArrayRef<ValueInfo> TargetsForSlot,
+                                      WholeProgramDevirtResolution &Res) {
+  // See if the program contains a single implementation of this virtual
+  // function.
+  ValueInfo TheFn = TargetsForSlot[0];
+  for (ValueInfo Target : TargetsForSlot)
+    if (TheFn != Target)
+      return false;
+
+  // The backends refer to the implementation by name.
+  StringRef Name = TheFn.name();
+  if (Name.empty())
+    return false;
+
+  std::string SingleImplName = Name;
+  auto SummaryList = TheFn.getSummaryList();
+  bool IsLocal = llvm::any_of(
+      SummaryList, [](const std::unique_ptr<GlobalValueSummary> &S) {
+        return GlobalValue::isLocalLinkage(S->linkage());
+      });
+  if (IsLocal) {
+    // A local implementation is promoted when it is exported, which renames
+    // it in the backend of its module.
+    if (SummaryList.size() != 1)
+      return false;
+    SingleImplName = ModuleSummaryIndex::getGlobalNameForLocal(
+        Name, ExportSummary.getModuleHash(SummaryList[0]->modulePath()));
+  }
+
+  LLVM_DEBUG(dbgs() << "Single implementation " << SingleImplName << "\n");
+  ExportedGUIDs.insert(TheFn.getGUID());
+  Res.TheKind = WholeProgramDevirtResolution::SingleImpl;
+  Res.SingleImplName = SingleImplName;
+  return true;
+}
+
+void DevirtIndex::run() {
+  if (ExportSummary.typeIdCompatibleVtableMap().empty())
+    return;
+
+  // Some of the vtables may only be visible in the regular LTO module, so a
+  // slot with a single summarized target may have others.
+  if (ExportSummary.partiallySplitLTOUnits())
+    return;
+
+  // The function summaries only record the GUIDs of the type identifiers.
+  DenseMap<GlobalValue::GUID, std::vector<StringRef>> NameByGUID;
+  for (auto &P : ExportSummary.typeIdCompatibleVtableMap())
+    NameByGUID[GlobalValue::getGUID(P.first)].push_back(P.first);
+
+  auto AddCallSlot = [&](FunctionSummary::VFuncId VF) {
+    auto I = NameByGUID.find(VF.GUID);
+    if (I == NameByGUID.end())
+      return;
+    for (StringRef Name : I->second)
+      CallSlots.insert({Name, VF.Offset});
+  };
+  for (auto &P : ExportSummary) {
+    for (auto &S : P.second.SummaryList) {
+      auto *FS = dyn_cast<FunctionSummary>(S.get());
+      if (!FS || !ExportSummary.isGlobalValueLive(FS))
+        continue;
+      for (FunctionSummary::VFuncId VF : FS->type_test_assume_vcalls())
+        AddCallSlot(VF);
+      for (const FunctionSummary::ConstVCall &VC :
+           FS->type_test_assume_const_vcalls())
+        AddCallSlot(VC.VFunc);
+    }
+  }
+
+  for (auto &Slot : CallSlots) {
+    // Do not override a resolution computed on the regular LTO module.
+    if (const TypeIdSummary *TidSummary =
+            ExportSummary.getTypeIdSummary(Slot.first))
+      if (TidSummary->WPDRes.count(Slot.second))
+        continue;
+
+    std::vector<ValueInfo> TargetsForSlot;
+    auto *TIdInfo =
+        ExportSummary.getTypeIdCompatibleVtableSummary(Slot.first);
+    if (!TIdInfo ||
+        !tryFindVirtualCallTargets(TargetsForSlot, *TIdInfo, Slot.second))
+      continue;
+
+    WholeProgramDevirtResolution Res;
+    if (trySingleImplDevirt(TargetsForSlot, Res))
+      ExportSummary.getOrInsertTypeIdSummary(Slot.first)
+          .WPDRes[Slot.second] = Res;
+  }
+}
+
 void DevirtModule::applySingleImplDevirt(VTableSlotInfo &SlotInfo,
                                          Constant *TheFn, bool &IsExported) {
   auto Apply = [&](CallSiteInfo &CSInfo) {
@@ -1571,6 +1696,11 @@ bool DevirtModule::run() {
   if (TypeIdMap.empty())
     return true;
 
+  // The vtables of the modules that were not split are only in the summary,
+  // so the targets found in this module may be incomplete.
+  if (ExportSummary && ExportSummary->partiallySplitLTOUnits())
+    return true;
+
   // Collect information from summary about which calls to try to devirtualize.
   if (ExportSummary) {
     DenseMap<GlobalValue::GUID, TinyPtrVector<Metadata *>> MetadataByGUID;
@@ -40,6 +40,7 @@
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/None.h"
+#include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/Statistic.h"
@@ -116,6 +117,15 @@ STATISTIC(NumSunkInst , "Number of instructions sunk");
 STATISTIC(NumExpand,    "Number of expansions");
 STATISTIC(NumFactor   , "Number of factorizations");
 STATISTIC(NumReassoc  , "Number of reassociations");
+STATISTIC(NumWorklistIterations,
+          "Number of instruction combining iterations performed");
+STATISTIC(NumOneIteration, "Number of functions with one iteration");
+STATISTIC(NumTwoIterations, "Number of functions with two iterations");
+STATISTIC(NumThreeIterations, "Number of functions with three iterations");
+STATISTIC(NumFourOrMoreIterations,
+          "Number of functions with four or more iterations");
+STATISTIC(NumSeeded, "Number of instructions seeded into the worklist");
+STATISTIC(NumVisited, "Number of instructions visited by the combiner");
 DEBUG_COUNTER(VisitCounter, "instcombine-visit",
               "Controls which instructions are visited");
 
@@ -127,6 +137,12 @@ static cl::opt<unsigned>
 MaxArraySize("instcombine-maxarray-size", cl::init(1024),
              cl::desc("Maximum array size considered when doing a combine"));
 
+static cl::opt<bool> IncrementalIterations(
+    "instcombine-incremental-iterations", cl::init(false), cl::Hidden,
+    cl::desc("Seed the iterations after the first one with the instructions "
+             "changed by the previous iteration and their users, instead of "
+             "the whole function"));
+
 // FIXME: Remove this flag when it is no longer necessary to convert
 // llvm.dbg.declare to avoid inaccurate debug info. Setting this to false
 // increases variable availability at the cost of accuracy. Variables that
@@ -2961,6 +2977,7 @@ bool InstCombiner::run() {
 
     if (!DebugCounter::shouldExecute(VisitCounter))
       continue;
+    ++NumVisited;
 
     // Instruction isn't dead, see if we can constant propagate it.
     if (!I->use_empty() &&
@@ -3049,6 +3066,15 @@ bool InstCombiner::run() {
     LLVM_DEBUG(raw_string_ostream SS(OrigI); I->print(SS); OrigI = SS.str(););
     LLVM_DEBUG(dbgs() << "IC: Visiting: " << OrigI << '\n');
 
+    // A combine that rewrites I in place may drop its last use of an operand.
+    // The next incremental iteration does not sweep the function, so such an
+    // operand has to be queued here to be cleaned up.
+    SmallVector<WeakVH, 4> OrigOperands;
+    if (Worklist.isRecordingChanges())
+      for (Value *Op : I->operand_values())
+        if (isa<Instruction>(Op))
+          OrigOperands.push_back(Op);
+
     if (Instruction *Result = visit(*I)) {
       ++NumCombined;
       // Should we replace the old instruction with a new one?
@@ -3091,6 +3117,9 @@ bool InstCombiner::run() {
         } else {
           Worklist.AddUsersToWorkList(*I);
           Worklist.Add(I);
+          for (WeakVH &Op : OrigOperands)
+            if (Op)
+              Worklist.Add(cast<Instruction>(Op));
         }
       }
       MadeIRChange = true;
@@ -3101,6 +3130,27 @@ bool InstCombiner::run() {
   return MadeIRChange;
 }
 
+/// Add the successors of TI to Worklist. If TI is a branch or switch on a
+/// constant, only add the reachable successor.
+static void addReachableSuccessors(TerminatorInst *TI,
+                                   SmallVectorImpl<BasicBlock *> &Worklist) {
+  if (BranchInst *BI = dyn_cast<BranchInst>(TI)) {
+    if (BI->isConditional() && isa<ConstantInt>(BI->getCondition())) {
+      bool CondVal = cast<ConstantInt>(BI->getCondition())->getZExtValue();
+      Worklist.push_back(BI->getSuccessor(!CondVal));
+      return;
+    }
+  } else if (SwitchInst *SI = dyn_cast<SwitchInst>(TI)) {
+    if (ConstantInt *Cond = dyn_cast<ConstantInt>(SI->getCondition())) {
+      Worklist.push_back(SI->findCaseValue(Cond)->getCaseSuccessor());
+      return;
+    }
+  }
+
+  for (BasicBlock *SuccBB : TI->successors())
+    Worklist.push_back(SuccBB);
+}
+
 /// Walk the function in depth-first order, adding all reachable code to the
 /// worklist.
 ///
@@ -3181,25 +3231,8 @@ static bool AddReachableCodeToWorklist(BasicBlock *BB, const DataLayout &DL,
         InstrsForInstCombineWorklist.push_back(Inst);
     }
 
-    // Recursively visit successors.  If this is a branch or switch on a
-    // constant, only visit the reachable successor.
-    TerminatorInst *TI = BB->getTerminator();
-    if (BranchInst *BI = dyn_cast<BranchInst>(TI)) {
-      if (BI->isConditional() && isa<ConstantInt>(BI->getCondition())) {
-        bool CondVal = cast<ConstantInt>(BI->getCondition())->getZExtValue();
-        BasicBlock *ReachableBB = BI->getSuccessor(!CondVal);
-        Worklist.push_back(ReachableBB);
-        continue;
-      }
-    } else if (SwitchInst *SI = dyn_cast<SwitchInst>(TI)) {
-      if (ConstantInt *Cond = dyn_cast<ConstantInt>(SI->getCondition())) {
-        Worklist.push_back(SI->findCaseValue(Cond)->getCaseSuccessor());
-        continue;
-      }
-    }
-
-    for (BasicBlock *SuccBB : TI->successors())
-      Worklist.push_back(SuccBB);
+    // Recursively visit successors.
+    addReachableSuccessors(BB->getTerminator(), Worklist);
   } while (!Worklist.empty());
 
   // Once we've found all of the instructions to add to instcombine's worklist,
@@ -3208,7 +3241,25 @@ static bool AddReachableCodeToWorklist(BasicBlock *BB, const DataLayout &DL,
   // of instructions to the worklist after doing a transformation, thus avoiding
   // some N^2 behavior in pathological cases.
   ICWorklist.AddInitialGroup(InstrsForInstCombineWorklist);
+  NumSeeded += InstrsForInstCombineWorklist.size();
+
+  return MadeIRChange;
+}
+
+/// Remove the instructions of the blocks of F that are not in Reachable. This
+/// prevents the instcombine code from having to deal with some bad special
+/// cases.
+static bool removeUnreachableInstructions(
+    Function &F, const SmallPtrSetImpl<BasicBlock *> &Reachable) {
+  bool MadeIRChange = false;
+  for (BasicBlock &BB : F) {
+    if (Reachable.count(&BB))
+      continue;
 
+    unsigned NumDeadInstInBB = removeAllNonTerminatorAndEHPadInstructions(&BB);
+    MadeIRChange |= NumDeadInstInBB > 0;
+    NumDeadInst += NumDeadInstInBB;
+  }
   return MadeIRChange;
 }
 
@@ -3229,18 +3280,45 @@ static bool prepareICWorklistFromFunction(Function &F, const DataLayout &DL,
   MadeIRChange |=
       AddReachableCodeToWorklist(&F.front(), DL, Visited, ICWorklist, TLI);
 
-  // Do a quick scan over the function.  If we find any blocks that are
-  // unreachable, remove any instructions inside of them.  This prevents
-  // the instcombine code from having to deal with some bad special cases.
-  for (BasicBlock &BB : F) {
-    if (Visited.count(&BB))
-      continue;
+  MadeIRChange |= removeUnreachableInstructions(F, Visited);
+  return MadeIRChange;
+}
 
-    unsigned NumDeadInstInBB = removeAllNonTerminatorAndEHPadInstructions(&BB);
-    MadeIRChange |= NumDeadInstInBB > 0;
-    NumDeadInst += NumDeadInstInBB;
+/// Populate the IC worklist with the instructions that were added to it
+/// during the previous iteration, that is the instructions changed by the
+/// combines and their neighbors, along with their users. Unlike
+/// prepareICWorklistFromFunction, this does not walk the instructions of the
+/// whole function.
+static bool prepareICWorklistFromChanges(Function &F,
+                                         InstCombineWorklist &ICWorklist) {
+  SmallVector<Instruction *, 64> Changed;
+  ICWorklist.takeChanged(Changed);
+
+  // The previous iteration may have folded branch conditions, so find the
+  // blocks that are still reachable.
+  SmallPtrSet<BasicBlock *, 32> Visited;
+  SmallVector<BasicBlock *, 32> Worklist;
+  Worklist.push_back(&F.front());
+  do {
+    BasicBlock *BB = Worklist.pop_back_val();
+    if (Visited.insert(BB).second)
+      addReachableSuccessors(BB->getTerminator(), Worklist);
+  } while (!Worklist.empty());
+
+  SmallSetVector<Instruction *, 64> Seeds;
+  auto AddSeed = [&](Instruction *I) {
+    if (Visited.count(I->getParent()) && !isa<DbgInfoIntrinsic>(I))
+      Seeds.insert(I);
+  };
+  for (Instruction *I : Changed) {
+    AddSeed(I);
+    for (User *U : I->users())
+      AddSeed(cast<Instruction>(U));
   }
 
+  bool MadeIRChange = removeUnreachableInstructions(F, Visited);
+  ICWorklist.AddInitialGroup(Seeds.getArrayRef());
+  NumSeeded += Seeds.size();
   return MadeIRChange;
 }
 
@@ -3268,14 +3346,21 @@ static bool combineInstructionsOverFunction(
   if (ShouldLowerDbgDeclare)
     MadeIRChange = LowerDbgDeclare(F);
 
-  // Iterate while there is work to do.
+  // Iterate while there is work to do. The first iteration visits the whole
+  // function; in incremental mode, the following ones only revisit what the
+  // previous iteration changed.
   int Iteration = 0;
+  Worklist.setRecordChanges(IncrementalIterations);
   while (true) {
     ++Iteration;
+    ++NumWorklistIterations;
     LLVM_DEBUG(dbgs() << "\n\nINSTCOMBINE ITERATION #" << Iteration << " on "
                       << F.getName() << "\n");
 
-    MadeIRChange |= prepareICWorklistFromFunction(F, DL, &TLI, Worklist);
+    if (Iteration == 1 || !IncrementalIterations)
+      MadeIRChange |= prepareICWorklistFromFunction(F, DL, &TLI, Worklist);
+    else
+      MadeIRChange |= prepareICWorklistFromChanges(F, Worklist);
 
     InstCombiner IC(Worklist, Builder, F.optForMinSize(), ExpensiveCombines, AA,
                     AC, TLI, DT, ORE, DL, LI);
@@ -3284,6 +3369,16 @@ static bool combineInstructionsOverFunction(
     if (!IC.run())
       break;
   }
+  Worklist.setRecordChanges(false);
+
+  if (Iteration == 1)
+    ++NumOneIteration;
+  else if (Iteration == 2)
+    ++NumTwoIterations;
+  else if (Iteration == 3)
+    ++NumThreeIterations;
+  else
+    ++NumFourOrMoreIterations;
 
   return MadeIRChange || Iteration > 1;
 }
@@ -9,11 +9,14 @@
 //
 // This file implements the transformation that promotes indirect calls to
 // conditional direct calls when the indirect-call value profile metadata is
-// available.
+// available. Virtual calls can optionally be promoted by comparing the vtable
+// pointer instead of the loaded function pointer, using the type metadata of
+// the vtables in the module.
 //
 //===----------------------------------------------------------------------===//
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/Statistic.h"
@@ -22,16 +25,20 @@
 #include "llvm/Analysis/IndirectCallSiteVisitor.h"
 #include "llvm/Analysis/OptimizationRemarkEmitter.h"
 #include "llvm/Analysis/ProfileSummaryInfo.h"
+#include "llvm/Analysis/TypeMetadataUtils.h"
 #include "llvm/IR/Attributes.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/CallSite.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/DiagnosticInfo.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InstIterator.h"
 #include "llvm/IR/InstrTypes.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/MDBuilder.h"
 #include "llvm/IR/PassManager.h"
@@ -108,6 +115,23 @@ static cl::opt<bool> ICPInvokeOnly("icp-invoke-only", cl::init(false),
                                    cl::desc("Run indirect-call promotion for "
                                             "invoke instruction only"));
 
+// If the option is set to true, virtual calls are promoted by comparing the
+// vtable pointer to the vtables that hold the target in the called slot,
+// rather than by comparing the loaded function pointer. This needs the type
+// metadata of the vtables.
+static cl::opt<bool>
+    ICPEnableVTableCmp("icp-enable-vtable-cmp", cl::init(false), cl::Hidden,
+                       cl::desc("Promote virtual calls by comparing vtable "
+                                "pointers"));
+
+// The maximum number of vtables compared to promote one target of a virtual
+// call. Targets in more vtables are promoted by comparing function pointers.
+static cl::opt<unsigned>
+    ICPMaxNumVTables("icp-max-num-vtables", cl::init(2), cl::Hidden,
+                     cl::ZeroOrMore,
+                     cl::desc("Max number of vtables compared to promote a "
+                              "virtual call target"));
+
 // Dump the function level IR if the transformation happened in this
 // function. For debug use only.
 static cl::opt<bool>
@@ -165,6 +189,14 @@ ModulePass *llvm::createPGOIndirectCallPromotionLegacyPass(bool InLTO,
 
 namespace {
 
+// A vtable compatible with a type identifier, and the offset of the address
+// point for the type identifier in it.
+using VTableAddressPoint = std::pair<GlobalVariable *, uint64_t>;
+
+// The vtables compatible with each type identifier.
+using TypeIdVTableMap =
+    DenseMap<Metadata *, SmallVector<VTableAddressPoint, 4>>;
+
 // The class for main data structure to promote indirect calls to conditional
 // direct calls.
 class ICallPromotionFunc {
@@ -176,6 +208,29 @@ private:
   // defines.
   InstrProfSymtab *Symtab;
 
+  // The vtables of the module by type identifier, if virtual calls are
+  // promoted by comparing vtables.
+  const TypeIdVTableMap *VTables;
+
+  // The vtable pointer of a virtual call, the offset of the called slot from
+  // the address point and the type identifier of the vtable.
+  struct VirtualCallInfo {
+    Value *VTable;
+    uint64_t Offset;
+    Metadata *TypeId;
+  };
+  DenseMap<Instruction *, VirtualCallInfo> VirtualCalls;
+
+  // Find the virtual calls of the function from the type tests of their
+  // vtable pointers.
+  void findVirtualCalls();
+
+  // Get the address points of the vtables that hold Target in the slot called
+  // by Inst. Return false if the call can't be promoted by comparing vtables.
+  bool getVTableAddressPoints(Instruction *Inst, Function *Target,
+                              Value *&VTable,
+                              SmallVectorImpl<Constant *> &AddressPoints);
+
   bool SamplePGO;
 
   OptimizationRemarkEmitter &ORE;
@@ -205,8 +260,13 @@ private:
 
 public:
   ICallPromotionFunc(Function &Func, Module *Modu, InstrProfSymtab *Symtab,
-                     bool SamplePGO, OptimizationRemarkEmitter &ORE)
-      : F(Func), M(Modu), Symtab(Symtab), SamplePGO(SamplePGO), ORE(ORE) {}
+                     const TypeIdVTableMap *VTables, bool SamplePGO,
+                     OptimizationRemarkEmitter &ORE)
+      : F(Func), M(Modu), Symtab(Symtab), VTables(VTables),
+        SamplePGO(SamplePGO), ORE(ORE) {
+    if (VTables)
+      findVirtualCalls();
+  }
   ICallPromotionFunc(const ICallPromotionFunc &) = delete;
   ICallPromotionFunc &operator=(const ICallPromotionFunc &) = delete;
 
@@ -293,18 +353,70 @@ ICallPromotionFunc::getPromotionCandidatesForCallSite(
   return Ret;
 }
 
+void ICallPromotionFunc::findVirtualCalls() {
+  for (Instruction &I : instructions(F)) {
+    auto *TypeTest = dyn_cast<IntrinsicInst>(&I);
+    if (!TypeTest || TypeTest->getIntrinsicID() != Intrinsic::type_test)
+      continue;
+    auto *TypeId = cast<MetadataAsValue>(TypeTest->getArgOperand(1));
+    SmallVector<DevirtCallSite, 1> DevirtCalls;
+    SmallVector<CallInst *, 1> Assumes;
+    findDevirtualizableCallsForTypeTest(DevirtCalls, Assumes, TypeTest);
+    Value *VTable = TypeTest->getArgOperand(0)->stripPointerCasts();
+    for (DevirtCallSite &Call : DevirtCalls)
+      VirtualCalls[Call.CS.getInstruction()] = {VTable, Call.Offset,
+                                                TypeId->getMetadata()};
+  }
+}
+
+bool ICallPromotionFunc::getVTableAddressPoints(
+    Instruction *Inst, Function *Target, Value *&VTable,
+    SmallVectorImpl<Constant *> &AddressPoints) {
+  auto CallIt = VirtualCalls.find(Inst);
+  if (CallIt == VirtualCalls.end())
+    return false;
+  const VirtualCallInfo &Call = CallIt->second;
+  auto VTablesIt = VTables->find(Call.TypeId);
+  if (VTablesIt == VTables->end())
+    return false;
+
+  Type *Int8Ty = Type::getInt8Ty(M->getContext());
+  for (const VTableAddressPoint &VT : VTablesIt->second) {
+    GlobalVariable *GV = VT.first;
+    Constant *Ptr =
+        getPointerAtOffset(GV->getInitializer(), VT.second + Call.Offset, *M);
+    if (!Ptr || Ptr->stripPointerCasts() != Target)
+      continue;
+    if (AddressPoints.size() == ICPMaxNumVTables)
+      return false;
+    AddressPoints.push_back(ConstantExpr::getInBoundsGetElementPtr(
+        Int8Ty, ConstantExpr::getBitCast(GV, Int8Ty->getPointerTo()),
+        ConstantInt::get(Type::getInt64Ty(M->getContext()), VT.second)));
+  }
+  VTable = Call.VTable;
+  return !AddressPoints.empty();
+}
+
+// Return the branch weights of the promoted call with count Count, out of
+// TotalCount for the call site.
+static MDNode *getPromotedCallBranchWeights(LLVMContext &Ctx, uint64_t Count,
+                                            uint64_t TotalCount) {
+  uint64_t ElseCount = TotalCount - Count;
+  uint64_t MaxCount = (Count >= ElseCount ? Count : ElseCount);
+  uint64_t Scale = calculateCountScale(MaxCount);
+  MDBuilder MDB(Ctx);
+  return MDB.createBranchWeights(scaleBranchCount(Count, Scale),
+                                 scaleBranchCount(ElseCount, Scale));
+}
+
 Instruction *llvm::pgo::promoteIndirectCall(Instruction *Inst,
                                             Function *DirectCallee,
                                             uint64_t Count, uint64_t TotalCount,
                                             bool AttachProfToDirectCall,
                                             OptimizationRemarkEmitter *ORE) {
 
-  uint64_t ElseCount = TotalCount - Count;
-  uint64_t MaxCount = (Count >= ElseCount ? Count : ElseCount);
-  uint64_t Scale = calculateCountScale(MaxCount);
-  MDBuilder MDB(Inst->getContext());
-  MDNode *BranchWeights = MDB.createBranchWeights(
-      scaleBranchCount(Count, Scale), scaleBranchCount(ElseCount, Scale));
+  MDNode *BranchWeights =
+      getPromotedCallBranchWeights(Inst->getContext(), Count, TotalCount);
 
   Instruction *NewInst =
       promoteCallWithIfThenElse(CallSite(Inst), DirectCallee, BranchWeights);
@@ -336,8 +448,32 @@ uint32_t ICallPromotionFunc::tryToPromote(
 
   for (auto &C : Candidates) {
     uint64_t Count = C.Count;
-    pgo::promoteIndirectCall(Inst, C.TargetFunction, Count, TotalCount,
-                             SamplePGO, &ORE);
+    Value *VTable;
+    SmallVector<Constant *, 2> AddressPoints;
+    if (VTables && getVTableAddressPoints(Inst, C.TargetFunction, VTable,
+                                          AddressPoints)) {
+      Instruction *NewInst = promoteCallWithVTableCmp(
+          CallSite(Inst), C.TargetFunction, VTable, AddressPoints,
+          getPromotedCallBranchWeights(Inst->getContext(), Count, TotalCount));
+      if (SamplePGO) {
+        MDBuilder MDB(NewInst->getContext());
+        NewInst->setMetadata(LLVMContext::MD_prof,
+                             MDB.createBranchWeights({uint32_t(Count)}));
+      }
+      ORE.emit([&]() {
+        using namespace ore;
+        return OptimizationRemark(DEBUG_TYPE, "Promoted", Inst)
+               << "Promote indirect call to "
+               << NV("DirectCallee", C.TargetFunction) << " with count "
+               << NV("Count", Count) << " out of "
+               << NV("TotalCount", TotalCount) << " by comparing "
+               << NV("NumVTables", unsigned(AddressPoints.size()))
+               << " vtables";
+      });
+    } else {
+      pgo::promoteIndirectCall(Inst, C.TargetFunction, Count, TotalCount,
+                               SamplePGO, &ORE);
+    }
     assert(TotalCount >= Count);
     TotalCount -= Count;
     NumOfPGOICallPromotion++;
@@ -391,6 +527,26 @@ static bool promoteIndirectCalls(Module &M, ProfileSummaryInfo *PSI,
     (void)SymtabFailure;
     return false;
   }
+  // Collect the vtables of the module by type identifier. Only the vtables
+  // whose contents are known can be compared to.
+  std::unique_ptr<TypeIdVTableMap> VTables;
+  if (ICPEnableVTableCmp) {
+    VTables = llvm::make_unique<TypeIdVTableMap>();
+    SmallVector<MDNode *, 2> Types;
+    for (GlobalVariable &GV : M.globals()) {
+      if (!GV.isConstant() || !GV.hasDefinitiveInitializer())
+        continue;
+      Types.clear();
+      GV.getMetadata(LLVMContext::MD_type, Types);
+      for (MDNode *Type : Types) {
+        auto *Offset = mdconst::dyn_extract<ConstantInt>(Type->getOperand(0));
+        if (Offset)
+          (*VTables)[Type->getOperand(1).get()].push_back(
+              {&GV, Offset->getZExtValue()});
+      }
+    }
+  }
+
   bool Changed = false;
   for (auto &F : M) {
     if (F.isDeclaration())
@@ -409,7 +565,8 @@ static bool promoteIndirectCalls(Module &M, ProfileSummaryInfo *PSI,
       ORE = OwnedORE.get();
     }
 
-    ICallPromotionFunc ICallPromotion(F, &M, &Symtab, SamplePGO, *ORE);
+    ICallPromotionFunc ICallPromotion(F, &M, &Symtab, VTables.get(), SamplePGO,
+                                      *ORE);
     bool FuncChanged = ICallPromotion.processFunction(PSI);
     if (ICPDUMPAFTER && FuncChanged) {
       LLVM_DEBUG(dbgs() << "\n== IR Dump After =="; F.print(dbgs()));
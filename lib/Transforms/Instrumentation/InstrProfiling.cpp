@@ -23,6 +23,7 @@
 #include "llvm/Analysis/TargetLibraryInfo.h"
 #include "llvm/IR/Attributes.h"
 #include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/CallSite.h"
 #include "llvm/IR/Constant.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DerivedTypes.h"
@@ -31,9 +32,11 @@
 #include "llvm/IR/GlobalValue.h"
 #include "llvm/IR/GlobalVariable.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/MDBuilder.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Type.h"
 #include "llvm/Pass.h"
@@ -43,8 +46,10 @@
 #include "llvm/Support/Error.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/Cloning.h"
 #include "llvm/Transforms/Utils/ModuleUtils.h"
 #include "llvm/Transforms/Utils/SSAUpdater.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
 #include <algorithm>
 #include <cassert>
 #include <cstddef>
@@ -136,6 +141,24 @@ cl::opt<bool> IterativeCounterPromotion(
     cl::ZeroOrMore, "iterative-counter-promotion", cl::init(true),
     cl::desc("Allow counter promotion across the whole loop nest."));
 
+// In sampled instrumentation mode, every instrumented function runs either an
+// instrumented or an uninstrumented copy of its body. A thread-local counter,
+// incremented on every function entry and wrapped at the sampling period,
+// selects the instrumented copy for the first calls of each period only.
+cl::opt<bool> SampledInstrumentation(
+    "sampled-instrumentation", cl::ZeroOrMore, cl::init(false),
+    cl::desc("Only update profile counters in bursts of function calls"));
+
+cl::opt<unsigned> SampledInstrPeriod(
+    "sampled-instr-period", cl::init(65536),
+    cl::desc("The number of function calls in a sampling period of sampled "
+             "instrumentation"));
+
+cl::opt<unsigned> SampledInstrBurstDuration(
+    "sampled-instr-burst-duration", cl::init(200),
+    cl::desc("The number of function calls running instrumented code at the "
+             "start of every sampling period of sampled instrumentation"));
+
 class InstrProfilingLegacyPass : public ModulePass {
   InstrProfiling InstrProf;
 
@@ -467,6 +490,14 @@ bool InstrProfiling::run(Module &M, const TargetLibraryInfo &TLI) {
   if (!containsProfilingIntrinsics(M) && !CoverageNamesVar)
     return MadeChange;
 
+  if (SampledInstrumentation) {
+    if (SampledInstrBurstDuration >= SampledInstrPeriod)
+      report_fatal_error("sampled-instr-burst-duration must be less than "
+                         "sampled-instr-period");
+    for (Function &F : M)
+      MadeChange |= duplicateForSampling(F);
+  }
+
   // We did not know how many value sites there would be inside
   // the instrumented function. This is counting the number of instrumented
   // target value sites to enter it as field in the profile data variable.
@@ -591,6 +622,92 @@ void InstrProfiling::lowerValueProfileInst(InstrProfValueProfileInst *Ind) {
   Ind->eraseFromParent();
 }
 
+GlobalVariable *InstrProfiling::getOrCreateSamplingVar() {
+  if (GlobalVariable *SamplingVar =
+          M->getNamedGlobal(getInstrProfSamplingVarName()))
+    return SamplingVar;
+
+  // Every module defines the counter, and the copies are merged at link time.
+  // It is thread-local so that threads do not contend for it.
+  Type *Int32Ty = Type::getInt32Ty(M->getContext());
+  auto *SamplingVar = new GlobalVariable(
+      *M, Int32Ty, false, GlobalValue::LinkOnceODRLinkage,
+      ConstantInt::get(Int32Ty, 0), getInstrProfSamplingVarName(), nullptr,
+      GlobalValue::GeneralDynamicTLSModel);
+  SamplingVar->setVisibility(GlobalValue::HiddenVisibility);
+  if (TT.supportsCOMDAT())
+    SamplingVar->setComdat(M->getOrInsertComdat(SamplingVar->getName()));
+  return SamplingVar;
+}
+
+bool InstrProfiling::duplicateForSampling(Function &F) {
+  if (F.isDeclaration())
+    return false;
+  bool HasIncrement = false;
+  for (Instruction &I : instructions(F)) {
+    // Convergent calls must not become control dependent on the sampling
+    // counter, and noduplicate calls must not be cloned.
+    if (auto CS = CallSite(&I))
+      if (CS.isConvergent() || CS.cannotDuplicate())
+        return false;
+    if (castToIncrementInst(&I))
+      HasIncrement = true;
+  }
+  if (!HasIncrement)
+    return false;
+
+  LLVMContext &Ctx = M->getContext();
+  BasicBlock *OrigEntry = &F.getEntryBlock();
+  BasicBlock *SampleBB = BasicBlock::Create(Ctx, "pgo.sample", &F, OrigEntry);
+
+  // Keep the static allocas in the entry block, shared by both copies.
+  for (auto I = OrigEntry->begin(), E = OrigEntry->end(); I != E;) {
+    auto *AI = dyn_cast<AllocaInst>(&*I++);
+    if (AI && isa<Constant>(AI->getArraySize()))
+      AI->moveBefore(*SampleBB, SampleBB->end());
+  }
+
+  // Clone the body into the uninstrumented copy.
+  SmallVector<BasicBlock *, 16> OrigBlocks;
+  for (BasicBlock &BB : F)
+    if (&BB != SampleBB)
+      OrigBlocks.push_back(&BB);
+  ValueToValueMapTy VMap;
+  SmallVector<BasicBlock *, 16> ClonedBlocks;
+  for (BasicBlock *BB : OrigBlocks) {
+    BasicBlock *Clone = CloneBasicBlock(BB, VMap, ".noinstr", &F);
+    VMap[BB] = Clone;
+    ClonedBlocks.push_back(Clone);
+  }
+  for (BasicBlock *Clone : ClonedBlocks)
+    for (auto I = Clone->begin(), E = Clone->end(); I != E;) {
+      Instruction *Inst = &*I++;
+      if (castToIncrementInst(Inst) || isa<InstrProfValueProfileInst>(Inst)) {
+        Inst->eraseFromParent();
+        continue;
+      }
+      RemapInstruction(Inst, VMap,
+                       RF_NoModuleLevelChanges | RF_IgnoreMissingLocals);
+    }
+
+  // Select the copy on entry. The counter wraps at the end of every period.
+  GlobalVariable *SamplingVar = getOrCreateSamplingVar();
+  IRBuilder<> Builder(SampleBB);
+  Value *Count = Builder.CreateLoad(SamplingVar, "pgo.sampling");
+  Value *Next = Builder.CreateAdd(Count, Builder.getInt32(1));
+  Value *Wrap =
+      Builder.CreateICmpUGE(Next, Builder.getInt32(SampledInstrPeriod));
+  Builder.CreateStore(Builder.CreateSelect(Wrap, Builder.getInt32(0), Next),
+                      SamplingVar);
+  Value *InBurst =
+      Builder.CreateICmpULT(Count, Builder.getInt32(SampledInstrBurstDuration));
+  Builder.CreateCondBr(InBurst, OrigEntry, cast<BasicBlock>(VMap[OrigEntry]),
+                       MDBuilder(Ctx).createBranchWeights(
+                           SampledInstrBurstDuration,
+                           SampledInstrPeriod - SampledInstrBurstDuration));
+  return true;
+}
+
 void InstrProfiling::lowerIncrement(InstrProfIncrementInst *Inc) {
   GlobalVariable *Counters = getOrCreateRegionCounters(Inc);
 
@@ -66,6 +66,7 @@
 #include "llvm/Analysis/IndirectCallSiteVisitor.h"
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/OptimizationRemarkEmitter.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
 #include "llvm/IR/Attributes.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/CFG.h"
@@ -219,6 +220,15 @@ static cl::opt<bool>
                   cl::desc("Use this option to turn on/off "
                            "memory intrinsic size profiling."));
 
+// Command line option to enable/disable size profiling of the library calls
+// that are not memory intrinsics, such as memcmp. The value sites of these
+// calls are not reflected in the function hash, so the option must have the
+// same value when generating and when using a profile.
+static cl::opt<bool> PGOInstrMemOPLibCalls(
+    "pgo-instr-memop-libcalls", cl::init(false), cl::Hidden,
+    cl::desc("Use this option to turn on/off size profiling of calls to "
+             "memcpy, memmove, memset, memcmp and bcmp."));
+
 // Emit branch probability as optimization remarks.
 static cl::opt<bool>
     EmitBranchProbability("pgo-emit-branch-prob", cl::init(false), cl::Hidden,
@@ -330,9 +340,11 @@ struct SelectInstVisitor : public InstVisitor<SelectInstVisitor> {
   unsigned getNumOfSelectInsts() const { return NSIs; }
 };
 
-/// Instruction Visitor class to visit memory intrinsic calls.
+/// Instruction Visitor class to visit memory intrinsic calls, and the calls
+/// to library functions with the same kind of size argument.
 struct MemIntrinsicVisitor : public InstVisitor<MemIntrinsicVisitor> {
   Function &F;
+  const TargetLibraryInfo *TLI;
   unsigned NMemIs = 0;          // Number of memIntrinsics instrumented.
   VisitMode Mode = VM_counting; // Visiting mode.
   unsigned CurCtrId = 0;        // Current counter index.
@@ -342,7 +354,8 @@ struct MemIntrinsicVisitor : public InstVisitor<MemIntrinsicVisitor> {
   PGOUseFunc *UseFunc = nullptr;
   std::vector<Instruction *> Candidates;
 
-  MemIntrinsicVisitor(Function &Func) : F(Func) {}
+  MemIntrinsicVisitor(Function &Func, const TargetLibraryInfo *TLI)
+      : F(Func), TLI(TLI) {}
 
   void countMemIntrinsics(Function &Func) {
     NMemIs = 0;
@@ -367,11 +380,17 @@ struct MemIntrinsicVisitor : public InstVisitor<MemIntrinsicVisitor> {
   }
 
   // Visit the IR stream and annotate all mem intrinsic call instructions.
-  void instrumentOneMemIntrinsic(MemIntrinsic &MI);
+  void instrumentOneMemIntrinsic(Instruction &MI, Value *Length);
+
+  // Perform tasks according to visit mode on \p MI, of size \p Length.
+  void visitMemOp(Instruction &MI, Value *Length);
 
   // Visit \p MI instruction and perform tasks according to visit mode.
   void visitMemIntrinsic(MemIntrinsic &SI);
 
+  // Visit the calls to the library functions with a profiled size.
+  void visitCallInst(CallInst &CI);
+
   unsigned getNumOfMemIntrinsics() const { return NMemIs; }
 };
 
@@ -391,6 +410,7 @@ private:
 
   void getAnalysisUsage(AnalysisUsage &AU) const override {
     AU.addRequired<BlockFrequencyInfoWrapperPass>();
+    AU.addRequired<TargetLibraryInfoWrapperPass>();
   }
 };
 
@@ -416,6 +436,7 @@ private:
 
   void getAnalysisUsage(AnalysisUsage &AU) const override {
     AU.addRequired<BlockFrequencyInfoWrapperPass>();
+    AU.addRequired<TargetLibraryInfoWrapperPass>();
   }
 };
 
@@ -427,6 +448,7 @@ INITIALIZE_PASS_BEGIN(PGOInstrumentationGenLegacyPass, "pgo-instr-gen",
                       "PGO instrumentation.", false, false)
 INITIALIZE_PASS_DEPENDENCY(BlockFrequencyInfoWrapperPass)
 INITIALIZE_PASS_DEPENDENCY(BranchProbabilityInfoWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(TargetLibraryInfoWrapperPass)
 INITIALIZE_PASS_END(PGOInstrumentationGenLegacyPass, "pgo-instr-gen",
                     "PGO instrumentation.", false, false)
 
@@ -440,6 +462,7 @@ INITIALIZE_PASS_BEGIN(PGOInstrumentationUseLegacyPass, "pgo-instr-use",
                       "Read PGO instrumentation profile.", false, false)
 INITIALIZE_PASS_DEPENDENCY(BlockFrequencyInfoWrapperPass)
 INITIALIZE_PASS_DEPENDENCY(BranchProbabilityInfoWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(TargetLibraryInfoWrapperPass)
 INITIALIZE_PASS_END(PGOInstrumentationUseLegacyPass, "pgo-instr-use",
                     "Read PGO instrumentation profile.", false, false)
 
@@ -528,12 +551,12 @@ public:
   }
 
   FuncPGOInstrumentation(
-      Function &Func,
+      Function &Func, const TargetLibraryInfo *TLI,
       std::unordered_multimap<Comdat *, GlobalValue *> &ComdatMembers,
       bool CreateGlobalVar = false, BranchProbabilityInfo *BPI = nullptr,
       BlockFrequencyInfo *BFI = nullptr)
       : F(Func), ComdatMembers(ComdatMembers), ValueSites(IPVK_Last + 1),
-        SIVisitor(Func), MIVisitor(Func), MST(F, BPI, BFI) {
+        SIVisitor(Func), MIVisitor(Func, TLI), MST(F, BPI, BFI) {
     // This should be done before CFG hash computation.
     SIVisitor.countSelects(Func);
     MIVisitor.countMemIntrinsics(Func);
@@ -715,13 +738,14 @@ BasicBlock *FuncPGOInstrumentation<Edge, BBInfo>::getInstrBB(Edge *E) {
 // Visit all edge and instrument the edges not in MST, and do value profiling.
 // Critical edges will be split.
 static void instrumentOneFunc(
-    Function &F, Module *M, BranchProbabilityInfo *BPI, BlockFrequencyInfo *BFI,
+    Function &F, Module *M, const TargetLibraryInfo *TLI,
+    BranchProbabilityInfo *BPI, BlockFrequencyInfo *BFI,
     std::unordered_multimap<Comdat *, GlobalValue *> &ComdatMembers) {
   // Split indirectbr critical edges here before computing the MST rather than
   // later in getInstrBB() to avoid invalidating it.
   SplitIndirectBrCriticalEdges(F, BPI, BFI);
-  FuncPGOInstrumentation<PGOEdge, BBInfo> FuncInfo(F, ComdatMembers, true, BPI,
-                                                   BFI);
+  FuncPGOInstrumentation<PGOEdge, BBInfo> FuncInfo(F, TLI, ComdatMembers, true,
+                                                   BPI, BFI);
   unsigned NumCounters = FuncInfo.getNumCounters();
 
   uint32_t I = 0;
@@ -845,12 +869,12 @@ namespace {
 
 class PGOUseFunc {
 public:
-  PGOUseFunc(Function &Func, Module *Modu,
+  PGOUseFunc(Function &Func, Module *Modu, const TargetLibraryInfo *TLI,
              std::unordered_multimap<Comdat *, GlobalValue *> &ComdatMembers,
              BranchProbabilityInfo *BPI = nullptr,
              BlockFrequencyInfo *BFIin = nullptr)
       : F(Func), M(Modu), BFI(BFIin),
-        FuncInfo(Func, ComdatMembers, false, BPI, BFIin),
+        FuncInfo(Func, TLI, ComdatMembers, false, BPI, BFIin),
         FreqAttr(FFA_Normal) {}
 
   // Read counts for the instrumented BB from profile.
@@ -1269,12 +1293,12 @@ void SelectInstVisitor::visitSelectInst(SelectInst &SI) {
   llvm_unreachable("Unknown visiting mode");
 }
 
-void MemIntrinsicVisitor::instrumentOneMemIntrinsic(MemIntrinsic &MI) {
+void MemIntrinsicVisitor::instrumentOneMemIntrinsic(Instruction &MI,
+                                                    Value *Length) {
   Module *M = F.getParent();
   IRBuilder<> Builder(&MI);
   Type *Int64Ty = Builder.getInt64Ty();
   Type *I8PtrTy = Builder.getInt8PtrTy();
-  Value *Length = MI.getLength();
   assert(!dyn_cast<ConstantInt>(Length));
   Builder.CreateCall(
       Intrinsic::getDeclaration(M, Intrinsic::instrprof_value_profile),
@@ -1284,10 +1308,7 @@ void MemIntrinsicVisitor::instrumentOneMemIntrinsic(MemIntrinsic &MI) {
   ++CurCtrId;
 }
 
-void MemIntrinsicVisitor::visitMemIntrinsic(MemIntrinsic &MI) {
-  if (!PGOInstrMemOP)
-    return;
-  Value *Length = MI.getLength();
+void MemIntrinsicVisitor::visitMemOp(Instruction &MI, Value *Length) {
   // Not instrument constant length calls.
   if (dyn_cast<ConstantInt>(Length))
     return;
@@ -1297,7 +1318,7 @@ void MemIntrinsicVisitor::visitMemIntrinsic(MemIntrinsic &MI) {
     NMemIs++;
     return;
   case VM_instrument:
-    instrumentOneMemIntrinsic(MI);
+    instrumentOneMemIntrinsic(MI, Length);
     return;
   case VM_annotate:
     Candidates.push_back(&MI);
@@ -1306,6 +1327,38 @@ void MemIntrinsicVisitor::visitMemIntrinsic(MemIntrinsic &MI) {
   llvm_unreachable("Unknown visiting mode");
 }
 
+void MemIntrinsicVisitor::visitMemIntrinsic(MemIntrinsic &MI) {
+  if (!PGOInstrMemOP)
+    return;
+  visitMemOp(MI, MI.getLength());
+}
+
+void MemIntrinsicVisitor::visitCallInst(CallInst &CI) {
+  if (!PGOInstrMemOP || !PGOInstrMemOPLibCalls || !TLI)
+    return;
+  if (isMemOPSizeLibCall(CI, *TLI))
+    visitMemOp(CI, CI.getArgOperand(2));
+}
+
+bool llvm::isMemOPSizeLibCall(const CallInst &CI,
+                              const TargetLibraryInfo &TLI) {
+  const Function *Callee = CI.getCalledFunction();
+  LibFunc Func;
+  if (!Callee || CI.isNoBuiltin() || !TLI.getLibFunc(*Callee, Func) ||
+      !TLI.has(Func))
+    return false;
+  switch (Func) {
+  case LibFunc_memcpy:
+  case LibFunc_memmove:
+  case LibFunc_memset:
+  case LibFunc_memcmp:
+  case LibFunc_bcmp:
+    return true;
+  default:
+    return false;
+  }
+}
+
 // Traverse all valuesites and annotate the instructions for all value kind.
 void PGOUseFunc::annotateValueSites() {
   if (DisableValueProfiling)
@@ -1382,7 +1435,8 @@ static void collectComdatMembers(
 }
 
 static bool InstrumentAllFunctions(
-    Module &M, function_ref<BranchProbabilityInfo *(Function &)> LookupBPI,
+    Module &M, const TargetLibraryInfo *TLI,
+    function_ref<BranchProbabilityInfo *(Function &)> LookupBPI,
     function_ref<BlockFrequencyInfo *(Function &)> LookupBFI) {
   createIRLevelProfileFlagVariable(M);
   std::unordered_multimap<Comdat *, GlobalValue *> ComdatMembers;
@@ -1393,7 +1447,7 @@ static bool InstrumentAllFunctions(
       continue;
     auto *BPI = LookupBPI(F);
     auto *BFI = LookupBFI(F);
-    instrumentOneFunc(F, &M, BPI, BFI, ComdatMembers);
+    instrumentOneFunc(F, &M, TLI, BPI, BFI, ComdatMembers);
   }
   return true;
 }
@@ -1408,7 +1462,8 @@ bool PGOInstrumentationGenLegacyPass::runOnModule(Module &M) {
   auto LookupBFI = [this](Function &F) {
     return &this->getAnalysis<BlockFrequencyInfoWrapperPass>(F).getBFI();
   };
-  return InstrumentAllFunctions(M, LookupBPI, LookupBFI);
+  auto &TLI = getAnalysis<TargetLibraryInfoWrapperPass>().getTLI();
+  return InstrumentAllFunctions(M, &TLI, LookupBPI, LookupBFI);
 }
 
 PreservedAnalyses PGOInstrumentationGen::run(Module &M,
@@ -1422,14 +1477,15 @@ PreservedAnalyses PGOInstrumentationGen::run(Module &M,
     return &FAM.getResult<BlockFrequencyAnalysis>(F);
   };
 
-  if (!InstrumentAllFunctions(M, LookupBPI, LookupBFI))
+  auto &TLI = AM.getResult<TargetLibraryAnalysis>(M);
+  if (!InstrumentAllFunctions(M, &TLI, LookupBPI, LookupBFI))
     return PreservedAnalyses::all();
 
   return PreservedAnalyses::none();
 }
 
 static bool annotateAllFunctions(
-    Module &M, StringRef ProfileFileName,
+    Module &M, StringRef ProfileFileName, const TargetLibraryInfo *TLI,
     function_ref<BranchProbabilityInfo *(Function &)> LookupBPI,
     function_ref<BlockFrequencyInfo *(Function &)> LookupBFI) {
   LLVM_DEBUG(dbgs() << "Read in profile counters: ");
@@ -1470,7 +1526,7 @@ static bool annotateAllFunctions(
     // Split indirectbr critical edges here before computing the MST rather than
     // later in getInstrBB() to avoid invalidating it.
     SplitIndirectBrCriticalEdges(F, BPI, BFI);
-    PGOUseFunc Func(F, &M, ComdatMembers, BPI, BFI);
+    PGOUseFunc Func(F, &M, TLI, ComdatMembers, BPI, BFI);
     if (!Func.readCounters(PGOReader.get()))
       continue;
     Func.populateCounters();
@@ -1547,7 +1603,8 @@ PreservedAnalyses PGOInstrumentationUse::run(Module &M,
     return &FAM.getResult<BlockFrequencyAnalysis>(F);
   };
 
-  if (!annotateAllFunctions(M, ProfileFileName, LookupBPI, LookupBFI))
+  auto &TLI = AM.getResult<TargetLibraryAnalysis>(M);
+  if (!annotateAllFunctions(M, ProfileFileName, &TLI, LookupBPI, LookupBFI))
     return PreservedAnalyses::all();
 
   return PreservedAnalyses::none();
@@ -1563,8 +1620,9 @@ bool PGOInstrumentationUseLegacyPass::runOnModule(Module &M) {
   auto LookupBFI = [this](Function &F) {
     return &this->getAnalysis<BlockFrequencyInfoWrapperPass>(F).getBFI();
   };
+  auto &TLI = getAnalysis<TargetLibraryInfoWrapperPass>().getTLI();
 
-  return annotateAllFunctions(M, ProfileFileName, LookupBPI, LookupBFI);
+  return annotateAllFunctions(M, ProfileFileName, &TLI, LookupBPI, LookupBFI);
 }
 
 static std::string getSimpleNodeName(const BasicBlock *Node) {
@@ -12,9 +12,13 @@
 // value profile metadata is available, a single memory intrinsic is expanded
 // to a sequence of guarded specialized versions that are called with the
 // hottest size(s), for later expansion into more optimal inline sequences.
+// Calls to the memcpy, memmove, memset, memcmp and bcmp library functions are
+// handled the same way. Optionally, a hot range of small sizes of copies and
+// memsets is lowered inline to two overlapping accesses.
 //
 //===----------------------------------------------------------------------===//
 
+#include "llvm/ADT/APInt.h"
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/StringRef.h"
@@ -22,6 +26,7 @@
 #include "llvm/Analysis/BlockFrequencyInfo.h"
 #include "llvm/Analysis/GlobalsModRef.h"
 #include "llvm/Analysis/OptimizationRemarkEmitter.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/CallSite.h"
 #include "llvm/IR/DerivedTypes.h"
@@ -48,8 +53,10 @@
 #include "llvm/Transforms/Instrumentation.h"
 #include "llvm/Transforms/Instrumentation/PGOInstrumentation.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
+#include <utility>
 #include <vector>
 
 using namespace llvm;
@@ -91,6 +98,19 @@ static cl::opt<bool>
                     cl::desc("Scale the memop size counts using the basic "
                              " block count value"));
 
+// Lower a hot range of sizes of memory copies and memsets inline.
+static cl::opt<bool>
+    MemOPRangeOpt("pgo-memop-range-opt", cl::init(false), cl::Hidden,
+                  cl::desc("Lower the hottest range of small memop sizes "
+                           "inline with overlapping loads and stores"));
+
+// The largest size in the range lowered inline.
+static cl::opt<unsigned>
+    MemOPRangeMax("pgo-memop-range-max", cl::init(32), cl::Hidden,
+                  cl::ZeroOrMore,
+                  cl::desc("The largest memop size lowered inline by "
+                           "-pgo-memop-range-opt"));
+
 // This option sets the rangge of precise profile memop sizes.
 extern cl::opt<std::string> MemOPSizeRange;
 
@@ -113,6 +133,7 @@ private:
   void getAnalysisUsage(AnalysisUsage &AU) const override {
     AU.addRequired<BlockFrequencyInfoWrapperPass>();
     AU.addRequired<OptimizationRemarkEmitterWrapperPass>();
+    AU.addRequired<TargetLibraryInfoWrapperPass>();
     AU.addPreserved<GlobalsAAWrapperPass>();
     AU.addPreserved<DominatorTreeWrapperPass>();
   }
@@ -124,6 +145,7 @@ INITIALIZE_PASS_BEGIN(PGOMemOPSizeOptLegacyPass, "pgo-memop-opt",
                       "Optimize memory intrinsic using its size value profile",
                       false, false)
 INITIALIZE_PASS_DEPENDENCY(BlockFrequencyInfoWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(TargetLibraryInfoWrapperPass)
 INITIALIZE_PASS_END(PGOMemOPSizeOptLegacyPass, "pgo-memop-opt",
                     "Optimize memory intrinsic using its size value profile",
                     false, false)
@@ -133,13 +155,45 @@ FunctionPass *llvm::createPGOMemOPSizeOptLegacyPass() {
 }
 
 namespace {
+// A memory operation with a value profiled size: a memory intrinsic, or a call
+// to one of the library functions accepted by isMemOPSizeLibCall.
+struct MemOp {
+  CallInst *I;
+  // The library function called, or NumLibFuncs for memory intrinsics.
+  LibFunc Func;
+
+  MemOp(MemIntrinsic *MI) : I(MI), Func(NumLibFuncs) {}
+  MemOp(CallInst *CI, LibFunc Func) : I(CI), Func(Func) {}
+
+  Value *getLength() const { return I->getArgOperand(2); }
+
+  bool isMemset() const {
+    return Func == NumLibFuncs ? isa<MemSetInst>(I) : Func == LibFunc_memset;
+  }
+
+  bool isCompare() const {
+    return Func == LibFunc_memcmp || Func == LibFunc_bcmp;
+  }
+
+  // Return true if the operation can be lowered to plain loads and stores.
+  bool canLowerInline() const {
+    if (auto *MI = dyn_cast<MemIntrinsic>(I))
+      return !MI->isVolatile();
+    return !isCompare();
+  }
+};
+
 class MemOPSizeOpt : public InstVisitor<MemOPSizeOpt> {
 public:
   MemOPSizeOpt(Function &Func, BlockFrequencyInfo &BFI,
-               OptimizationRemarkEmitter &ORE, DominatorTree *DT)
-      : Func(Func), BFI(BFI), ORE(ORE), DT(DT), Changed(false) {
-    ValueDataArray =
-        llvm::make_unique<InstrProfValueData[]>(MemOPMaxVersion + 2);
+               OptimizationRemarkEmitter &ORE, DominatorTree *DT,
+               const TargetLibraryInfo &TLI)
+      : Func(Func), BFI(BFI), ORE(ORE), DT(DT), TLI(TLI), Changed(false) {
+    // Lowering a range of sizes needs the counts of all the sizes in it.
+    MaxNumVals = MemOPMaxVersion + 2;
+    if (MemOPRangeOpt)
+      MaxNumVals += MemOPRangeMax;
+    ValueDataArray = llvm::make_unique<InstrProfValueData[]>(MaxNumVals);
     // Get the MemOPSize range information from option MemOPSizeRange,
     getMemOPSizeRangeFromOption(MemOPSizeRange, PreciseRangeStart,
                                 PreciseRangeLast);
@@ -149,13 +203,13 @@ public:
     WorkList.clear();
     visit(Func);
 
-    for (auto &MI : WorkList) {
+    for (auto &MO : WorkList) {
       ++NumOfPGOMemOPAnnotate;
-      if (perform(MI)) {
+      if (perform(MO)) {
         Changed = true;
         ++NumOfPGOMemOPOpt;
         LLVM_DEBUG(dbgs() << "MemOP call: "
-                          << MI->getCalledFunction()->getName()
+                          << MO.I->getCalledFunction()->getName()
                           << "is Transformed.\n");
       }
     }
@@ -166,7 +220,15 @@ public:
     // Not perform on constant length calls.
     if (dyn_cast<ConstantInt>(Length))
       return;
-    WorkList.push_back(&MI);
+    WorkList.push_back(MemOp(&MI));
+  }
+
+  void visitCallInst(CallInst &CI) {
+    LibFunc Func;
+    if (!isMemOPSizeLibCall(CI, TLI) || isa<ConstantInt>(CI.getArgOperand(2)))
+      return;
+    TLI.getLibFunc(*CI.getCalledFunction(), Func);
+    WorkList.push_back(MemOp(&CI, Func));
   }
 
 private:
@@ -174,15 +236,19 @@ private:
   BlockFrequencyInfo &BFI;
   OptimizationRemarkEmitter &ORE;
   DominatorTree *DT;
+  const TargetLibraryInfo &TLI;
   bool Changed;
-  std::vector<MemIntrinsic *> WorkList;
+  std::vector<MemOp> WorkList;
   // Start of the previse range.
   int64_t PreciseRangeStart;
   // Last value of the previse range.
   int64_t PreciseRangeLast;
   // The space to read the profile annotation.
   std::unique_ptr<InstrProfValueData[]> ValueDataArray;
-  bool perform(MemIntrinsic *MI);
+  // The maximum number of values read from the profile annotation.
+  uint32_t MaxNumVals;
+  bool perform(MemOp MO);
+  StringRef getName(const MemOp &MO) const;
 
   // This kind shows which group the value falls in. For PreciseValue, we have
   // the profile count for that value. LargeGroup groups the values that are in
@@ -211,6 +277,12 @@ static const char *getMIName(const MemIntrinsic *MI) {
   }
 }
 
+StringRef MemOPSizeOpt::getName(const MemOp &MO) const {
+  if (MO.Func == NumLibFuncs)
+    return getMIName(cast<MemIntrinsic>(MO.I));
+  return TLI.getName(MO.Func);
+}
+
 static bool isProfitable(uint64_t Count, uint64_t TotalCount) {
   assert(Count <= TotalCount);
   if (Count < MemOPCountThreshold)
@@ -229,14 +301,51 @@ static inline uint64_t getScaledCount(uint64_t Count, uint64_t Num,
   return ScaleCount / Denom;
 }
 
-bool MemOPSizeOpt::perform(MemIntrinsic *MI) {
+// Lower \p MO, whose size is in range (Width, 2 * Width], to two overlapping
+// accesses of Width bytes at the start and at the end of the memory. Returns
+// the value of the call.
+static Value *lowerToOverlappingAccesses(IRBuilder<> &IRB, const MemOp &MO,
+                                         uint64_t Width) {
+  Value *Dst = MO.I->getArgOperand(0);
+  Value *Length = MO.getLength();
+  Type *AccessTy = IRB.getIntNTy(8 * Width);
+  Value *TailOffset =
+      IRB.CreateSub(Length, ConstantInt::get(Length->getType(), Width));
+  auto GetAccessPtrs = [&](Value *Ptr) {
+    Type *AccessPtrTy =
+        AccessTy->getPointerTo(Ptr->getType()->getPointerAddressSpace());
+    Value *HeadPtr = IRB.CreateBitCast(Ptr, AccessPtrTy);
+    Value *TailPtr = IRB.CreateBitCast(
+        IRB.CreateInBoundsGEP(IRB.getInt8Ty(), Ptr, TailOffset), AccessPtrTy);
+    return std::make_pair(HeadPtr, TailPtr);
+  };
+
+  Value *Head, *Tail;
+  if (MO.isMemset()) {
+    Value *Byte =
+        IRB.CreateZExtOrTrunc(MO.I->getArgOperand(1), IRB.getInt8Ty());
+    Head = Tail = IRB.CreateMul(
+        IRB.CreateZExt(Byte, AccessTy),
+        ConstantInt::get(AccessTy, APInt::getSplat(8 * Width, APInt(8, 1))));
+  } else {
+    // Both loads come first so that overlapping memmoves are correct.
+    auto SrcPtrs = GetAccessPtrs(MO.I->getArgOperand(1));
+    Head = IRB.CreateAlignedLoad(SrcPtrs.first, 1);
+    Tail = IRB.CreateAlignedLoad(SrcPtrs.second, 1);
+  }
+  auto DstPtrs = GetAccessPtrs(Dst);
+  IRB.CreateAlignedStore(Head, DstPtrs.first, 1);
+  IRB.CreateAlignedStore(Tail, DstPtrs.second, 1);
+  return Dst;
+}
+
+bool MemOPSizeOpt::perform(MemOp MO) {
+  CallInst *MI = MO.I;
   assert(MI);
-  if (MI->getIntrinsicID() == Intrinsic::memmove)
-    return false;
 
-  uint32_t NumVals, MaxNumPromotions = MemOPMaxVersion + 2;
+  uint32_t NumVals;
   uint64_t TotalCount;
-  if (!getValueProfDataFromInst(*MI, IPVK_MemOPSize, MaxNumPromotions,
+  if (!getValueProfDataFromInst(*MI, IPVK_MemOPSize, MaxNumVals,
                                 ValueDataArray.get(), NumVals, TotalCount))
     return false;
 
@@ -273,11 +382,14 @@ bool MemOPSizeOpt::perform(MemIntrinsic *MI) {
   uint64_t SavedRemainCount = SavedTotalCount;
   SmallVector<uint64_t, 16> SizeIds;
   SmallVector<uint64_t, 16> CaseCounts;
+  // Whether each value is handled by a specialized version.
+  SmallVector<bool, 16> Handled(NumVals, false);
   uint64_t MaxCount = 0;
   unsigned Version = 0;
   // Default case is in the front -- save the slot here.
   CaseCounts.push_back(0);
-  for (auto &VD : VDs) {
+  for (unsigned I = 0; I < NumVals; ++I) {
+    const InstrProfValueData &VD = VDs[I];
     int64_t V = VD.Value;
     uint64_t C = VD.Count;
     if (MemOPScaleCount)
@@ -294,6 +406,7 @@ bool MemOPSizeOpt::perform(MemIntrinsic *MI) {
 
     SizeIds.push_back(V);
     CaseCounts.push_back(C);
+    Handled[I] = true;
     if (C > MaxCount)
       MaxCount = C;
 
@@ -306,12 +419,52 @@ bool MemOPSizeOpt::perform(MemIntrinsic *MI) {
       break;
   }
 
-  if (Version == 0)
+  // Find the hottest range of the remaining sizes of the form (W, 2 * W],
+  // which is lowered inline with two overlapping accesses of W bytes.
+  uint64_t RangeWidth = 0;
+  uint64_t RangeCount = 0;
+  if (MemOPRangeOpt && MO.canLowerInline()) {
+    uint64_t SavedRangeCount = 0;
+    for (uint64_t W = 1; 2 * W <= MemOPRangeMax; W *= 2) {
+      uint64_t C = 0, SavedC = 0;
+      for (unsigned I = 0; I < NumVals; ++I) {
+        int64_t V = VDs[I].Value;
+        if (Handled[I] || getMemOPSizeKind(V) != PreciseValue ||
+            V <= (int64_t)W || V > (int64_t)(2 * W))
+          continue;
+        C += getScaledCount(VDs[I].Count, ActualCount, SavedTotalCount);
+        SavedC += VDs[I].Count;
+      }
+      if (C > RangeCount) {
+        RangeWidth = W;
+        RangeCount = C;
+        SavedRangeCount = SavedC;
+      }
+    }
+
+    if (RangeCount && isProfitable(RangeCount, RemainCount)) {
+      for (unsigned I = 0; I < NumVals; ++I) {
+        int64_t V = VDs[I].Value;
+        if (getMemOPSizeKind(V) == PreciseValue && V > (int64_t)RangeWidth &&
+            V <= (int64_t)(2 * RangeWidth))
+          Handled[I] = true;
+      }
+      RemainCount -= RangeCount;
+      assert(SavedRemainCount >= SavedRangeCount);
+      SavedRemainCount -= SavedRangeCount;
+    } else {
+      RangeWidth = 0;
+      RangeCount = 0;
+    }
+  }
+
+  if (Version == 0 && RangeWidth == 0)
     return false;
 
-  CaseCounts[0] = RemainCount;
-  if (RemainCount > MaxCount)
-    MaxCount = RemainCount;
+  // The default case of the switch includes the range.
+  CaseCounts[0] = RemainCount + RangeCount;
+  if (CaseCounts[0] > MaxCount)
+    MaxCount = CaseCounts[0];
 
   uint64_t SumForOpt = TotalCount - RemainCount;
 
@@ -330,6 +483,10 @@ bool MemOPSizeOpt::perform(MemIntrinsic *MI) {
   //      goto merge_bb;
   //   ...
   //   default:
+  //      if (size - (W + 1) <= W - 1) {
+  //        (inline accesses of W bytes at the start and at the end)
+  //        goto merge_bb;
+  //      }
   //      mem_op(..., size);
   //      goto merge_bb;
   // }
@@ -353,47 +510,104 @@ bool MemOPSizeOpt::perform(MemIntrinsic *MI) {
   auto &Ctx = Func.getContext();
   IRBuilder<> IRB(BB);
   BB->getTerminator()->eraseFromParent();
-  Value *SizeVar = MI->getLength();
-  SwitchInst *SI = IRB.CreateSwitch(SizeVar, DefaultBB, SizeIds.size());
+  Value *SizeVar = MO.getLength();
+  BasicBlock *SwitchDefaultBB = DefaultBB;
+  if (RangeWidth)
+    SwitchDefaultBB =
+        BasicBlock::Create(Ctx, "MemOP.RangeCheck", &Func, DefaultBB);
+  // Without a specialized version, only the range is checked.
+  SwitchInst *SI = nullptr;
+  if (SizeIds.empty())
+    IRB.CreateBr(SwitchDefaultBB);
+  else
+    SI = IRB.CreateSwitch(SizeVar, SwitchDefaultBB, SizeIds.size());
+
+  // Library calls may have uses of their result, which merge here.
+  PHINode *Result = nullptr;
+  if (!MI->use_empty()) {
+    Result = PHINode::Create(MI->getType(), SizeIds.size() + 2,
+                             MI->getName() + ".merge", &MergeBB->front());
+    MI->replaceAllUsesWith(Result);
+    Result->addIncoming(MI, DefaultBB);
+  }
 
   // Clear the value profile data.
   MI->setMetadata(LLVMContext::MD_prof, nullptr);
   // If all promoted, we don't need the MD.prof metadata.
-  if (SavedRemainCount > 0 || Version != NumVals)
+  SmallVector<InstrProfValueData, 16> RemainVDs;
+  for (unsigned I = 0; I < NumVals; ++I)
+    if (!Handled[I])
+      RemainVDs.push_back(VDs[I]);
+  if (SavedRemainCount > 0 || !RemainVDs.empty())
     // Otherwise we need update with the un-promoted records back.
-    annotateValueSite(*Func.getParent(), *MI, VDs.slice(Version),
-                      SavedRemainCount, IPVK_MemOPSize, NumVals);
+    annotateValueSite(*Func.getParent(), *MI, RemainVDs, SavedRemainCount,
+                      IPVK_MemOPSize, NumVals);
 
   LLVM_DEBUG(dbgs() << "\n\n== Basic Block After==\n");
 
   std::vector<DominatorTree::UpdateType> Updates;
   if (DT)
-    Updates.reserve(2 * SizeIds.size());
+    Updates.reserve(2 * SizeIds.size() + 5);
 
   for (uint64_t SizeId : SizeIds) {
     BasicBlock *CaseBB = BasicBlock::Create(
         Ctx, Twine("MemOP.Case.") + Twine(SizeId), &Func, DefaultBB);
     Instruction *NewInst = MI->clone();
     // Fix the argument.
-    MemIntrinsic * MemI = dyn_cast<MemIntrinsic>(NewInst);
-    IntegerType *SizeType = dyn_cast<IntegerType>(MemI->getLength()->getType());
+    IntegerType *SizeType = dyn_cast<IntegerType>(SizeVar->getType());
     assert(SizeType && "Expected integer type size argument.");
     ConstantInt *CaseSizeId = ConstantInt::get(SizeType, SizeId);
-    MemI->setLength(CaseSizeId);
+    cast<CallInst>(NewInst)->setArgOperand(2, CaseSizeId);
     CaseBB->getInstList().push_back(NewInst);
     IRBuilder<> IRBCase(CaseBB);
     IRBCase.CreateBr(MergeBB);
     SI->addCase(CaseSizeId, CaseBB);
+    if (Result)
+      Result->addIncoming(NewInst, CaseBB);
     if (DT) {
       Updates.push_back({DominatorTree::Insert, CaseBB, MergeBB});
       Updates.push_back({DominatorTree::Insert, BB, CaseBB});
     }
     LLVM_DEBUG(dbgs() << *CaseBB << "\n");
   }
+
+  if (RangeWidth) {
+    BasicBlock *RangeBB = BasicBlock::Create(
+        Ctx,
+        Twine("MemOP.Range.") + Twine(RangeWidth + 1) + "." +
+            Twine(2 * RangeWidth),
+        &Func, DefaultBB);
+    IRBuilder<> IRBCheck(SwitchDefaultBB);
+    Type *SizeType = SizeVar->getType();
+    Value *Offset = IRBCheck.CreateSub(
+        SizeVar, ConstantInt::get(SizeType, RangeWidth + 1));
+    Value *InRange = IRBCheck.CreateICmpULE(
+        Offset, ConstantInt::get(SizeType, RangeWidth - 1));
+    BranchInst *BI = IRBCheck.CreateCondBr(InRange, RangeBB, DefaultBB);
+    setProfMetadata(Func.getParent(), BI, {RangeCount, RemainCount},
+                    std::max(RangeCount, RemainCount));
+
+    IRBuilder<> IRBRange(RangeBB);
+    IRBRange.SetCurrentDebugLocation(MI->getDebugLoc());
+    Value *RangeResult = lowerToOverlappingAccesses(IRBRange, MO, RangeWidth);
+    IRBRange.CreateBr(MergeBB);
+    if (Result)
+      Result->addIncoming(RangeResult, RangeBB);
+    if (DT) {
+      Updates.push_back({DominatorTree::Insert, BB, SwitchDefaultBB});
+      Updates.push_back({DominatorTree::Insert, SwitchDefaultBB, RangeBB});
+      Updates.push_back({DominatorTree::Insert, SwitchDefaultBB, DefaultBB});
+      Updates.push_back({DominatorTree::Insert, RangeBB, MergeBB});
+      Updates.push_back({DominatorTree::Delete, BB, DefaultBB});
+    }
+    LLVM_DEBUG(dbgs() << *SwitchDefaultBB << "\n");
+    LLVM_DEBUG(dbgs() << *RangeBB << "\n");
+  }
   DTU.applyUpdates(Updates);
   Updates.clear();
 
-  setProfMetadata(Func.getParent(), SI, CaseCounts, MaxCount);
+  if (SI)
+    setProfMetadata(Func.getParent(), SI, CaseCounts, MaxCount);
 
   LLVM_DEBUG(dbgs() << *BB << "\n");
   LLVM_DEBUG(dbgs() << *DefaultBB << "\n");
@@ -401,11 +615,14 @@ bool MemOPSizeOpt::perform(MemIntrinsic *MI) {
 
   ORE.emit([&]() {
     using namespace ore;
-    return OptimizationRemark(DEBUG_TYPE, "memopt-opt", MI)
-             << "optimized " << NV("Intrinsic", StringRef(getMIName(MI)))
-             << " with count " << NV("Count", SumForOpt) << " out of "
-             << NV("Total", TotalCount) << " for " << NV("Versions", Version)
-             << " versions";
+    OptimizationRemark R(DEBUG_TYPE, "memopt-opt", MI);
+    R << "optimized " << NV("Intrinsic", getName(MO)) << " with count "
+      << NV("Count", SumForOpt) << " out of " << NV("Total", TotalCount)
+      << " for " << NV("Versions", Version) << " versions";
+    if (RangeWidth)
+      R << " and sizes " << NV("RangeMin", RangeWidth + 1) << " to "
+        << NV("RangeMax", 2 * RangeWidth) << " inline";
+    return R;
   });
 
   return true;
@@ -414,13 +631,14 @@ bool MemOPSizeOpt::perform(MemIntrinsic *MI) {
 
 static bool PGOMemOPSizeOptImpl(Function &F, BlockFrequencyInfo &BFI,
                                 OptimizationRemarkEmitter &ORE,
-                                DominatorTree *DT) {
+                                DominatorTree *DT,
+                                const TargetLibraryInfo &TLI) {
   if (DisableMemOPOPT)
     return false;
 
   if (F.hasFnAttribute(Attribute::OptimizeForSize))
     return false;
-  MemOPSizeOpt MemOPSizeOpt(F, BFI, ORE, DT);
+  MemOPSizeOpt MemOPSizeOpt(F, BFI, ORE, DT, TLI);
   MemOPSizeOpt.perform();
   return MemOPSizeOpt.isChanged();
 }
@@ -431,7 +649,8 @@ bool PGOMemOPSizeOptLegacyPass::runOnFunction(Function &F) {
   auto &ORE = getAnalysis<OptimizationRemarkEmitterWrapperPass>().getORE();
   auto *DTWP = getAnalysisIfAvailable<DominatorTreeWrapperPass>();
   DominatorTree *DT = DTWP ? &DTWP->getDomTree() : nullptr;
-  return PGOMemOPSizeOptImpl(F, BFI, ORE, DT);
+  auto &TLI = getAnalysis<TargetLibraryInfoWrapperPass>().getTLI();
+  return PGOMemOPSizeOptImpl(F, BFI, ORE, DT, TLI);
 }
 
 namespace llvm {
@@ -442,7 +661,8 @@ PreservedAnalyses PGOMemOPSizeOpt::run(Function &F,
   auto &BFI = FAM.getResult<BlockFrequencyAnalysis>(F);
   auto &ORE = FAM.getResult<OptimizationRemarkEmitterAnalysis>(F);
   auto *DT = FAM.getCachedResult<DominatorTreeAnalysis>(F);
-  bool Changed = PGOMemOPSizeOptImpl(F, BFI, ORE, DT);
+  auto &TLI = FAM.getResult<TargetLibraryAnalysis>(F);
+  bool Changed = PGOMemOPSizeOptImpl(F, BFI, ORE, DT, TLI);
   if (!Changed)
     return PreservedAnalyses::all();
   auto PA = PreservedAnalyses();
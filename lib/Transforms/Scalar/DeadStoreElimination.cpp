@@ -10,30 +10,36 @@
 // This file implements a trivial dead store elimination that only considers
 // basic-block local redundant stores.
 //
-// FIXME: This should eventually be extended to be a post-dominator tree
-// traversal.  Doing so would be pretty trivial.
+// With -enable-dse-memoryssa, a MemorySSA-based implementation is used
+// instead, which eliminates stores that are dead on all paths through the CFG.
 //
 //===----------------------------------------------------------------------===//
 
 #include "llvm/Transforms/Scalar/DeadStoreElimination.h"
 #include "llvm/ADT/APInt.h"
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/CFG.h"
 #include "llvm/Analysis/CaptureTracking.h"
 #include "llvm/Analysis/GlobalsModRef.h"
 #include "llvm/Analysis/MemoryBuiltins.h"
 #include "llvm/Analysis/MemoryDependenceAnalysis.h"
 #include "llvm/Analysis/MemoryLocation.h"
+#include "llvm/Analysis/MemorySSA.h"
+#include "llvm/Analysis/MemorySSAUpdater.h"
+#include "llvm/Analysis/PostDominators.h"
 #include "llvm/Analysis/TargetLibraryInfo.h"
 #include "llvm/Transforms/Utils/Local.h"
 #include "llvm/Analysis/ValueTracking.h"
 #include "llvm/IR/Argument.h"
 #include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/CFG.h"
 #include "llvm/IR/CallSite.h"
 #include "llvm/IR/Constant.h"
 #include "llvm/IR/Constants.h"
@@ -85,6 +91,21 @@ EnablePartialStoreMerging("enable-dse-partial-store-merging",
   cl::init(true), cl::Hidden,
   cl::desc("Enable partial store merging in DSE"));
 
+static cl::opt<bool>
+EnableMemorySSA("enable-dse-memoryssa", cl::init(false), cl::Hidden,
+  cl::desc("Use the MemorySSA-based implementation of DSE"));
+
+static cl::opt<unsigned>
+MemorySSAScanLimit("dse-memoryssa-scanlimit", cl::init(150), cl::Hidden,
+  cl::desc("The number of memory accesses visited to find the writes "
+           "killing a store in MemorySSA-based DSE"));
+
+static cl::opt<unsigned>
+MemorySSAPathCheckLimit("dse-memoryssa-path-check-limit", cl::init(50),
+  cl::Hidden,
+  cl::desc("The number of blocks visited to check that a store is killed on "
+           "all paths in MemorySSA-based DSE"));
+
 //===----------------------------------------------------------------------===//
 // Helper functions
 //===----------------------------------------------------------------------===//
@@ -1322,21 +1343,345 @@ static bool eliminateDeadStores(Function &F, AliasAnalysis *AA,
   return MadeChange;
 }
 
+//===----------------------------------------------------------------------===//
+// MemorySSA-based DSE
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+/// Eliminates stores that are dead across the whole CFG. For every candidate
+/// store, the uses of its MemoryDef are followed downwards until they reach a
+/// store overwriting it completely, or a free or lifetime.end of the stored
+/// object. The store is dead if no read of its location was found on the way,
+/// and every path through the CFG starting at the store reaches one of these
+/// killers, or leaves the function while the object is dead. Writes that
+/// post-dominate the store and together overwrite all of it are also killers
+/// for the paths leaving the function.
+class DSEState {
+public:
+  DSEState(Function &F, AliasAnalysis &AA, MemorySSA &MSSA, DominatorTree &DT,
+           PostDominatorTree &PDT, const TargetLibraryInfo &TLI)
+      : F(F), AA(AA), MSSA(MSSA), MSSAU(&MSSA), DT(DT), PDT(PDT), TLI(TLI),
+        DL(F.getParent()->getDataLayout()) {}
+
+  bool run();
+
+private:
+  bool eliminateNoopStore(StoreInst *SI);
+  bool isKiller(Instruction *I, const MemoryLocation &Loc, const Value *Object);
+  bool findKillers(Instruction *Dead, const MemoryLocation &Loc,
+                   const Value *Object, SmallPtrSetImpl<Instruction *> &Killers,
+                   InstOverlapIntervalsTy &IOL, bool &KilledAtExit);
+  bool allPathsKilled(Instruction *Dead, const Value *Object,
+                      const SmallPtrSetImpl<Instruction *> &Killers,
+                      bool KilledAtExit);
+  bool isDeadOnUnwind(const Value *Object);
+  bool isDeadAtExit(const Value *Object);
+  void deleteDeadInstruction(Instruction *I);
+
+  Function &F;
+  AliasAnalysis &AA;
+  MemorySSA &MSSA;
+  MemorySSAUpdater MSSAU;
+  DominatorTree &DT;
+  PostDominatorTree &PDT;
+  const TargetLibraryInfo &TLI;
+  const DataLayout &DL;
+
+  /// Caches whether a store to an object is dead once the function unwinds,
+  /// and once it returns.
+  DenseMap<const Value *, bool> DeadOnUnwind;
+  DenseMap<const Value *, bool> DeadAtExit;
+};
+
+} // end anonymous namespace
+
+bool DSEState::isDeadOnUnwind(const Value *Object) {
+  auto Cached = DeadOnUnwind.find(Object);
+  if (Cached != DeadOnUnwind.end())
+    return Cached->second;
+  bool Dead = isa<AllocaInst>(Object) ||
+              (isAllocLikeFn(Object, &TLI) &&
+               !PointerMayBeCaptured(Object, false, true));
+  return DeadOnUnwind[Object] = Dead;
+}
+
+bool DSEState::isDeadAtExit(const Value *Object) {
+  auto Cached = DeadAtExit.find(Object);
+  if (Cached != DeadAtExit.end())
+    return Cached->second;
+  bool Dead = isa<AllocaInst>(Object) ||
+              (isAllocLikeFn(Object, &TLI) &&
+               !PointerMayBeCaptured(Object, true, true));
+  return DeadAtExit[Object] = Dead;
+}
+
+void DSEState::deleteDeadInstruction(Instruction *I) {
+  SmallVector<Instruction *, 32> NowDeadInsts;
+  NowDeadInsts.push_back(I);
+  --NumFastOther;
+
+  do {
+    Instruction *DeadInst = NowDeadInsts.pop_back_val();
+    ++NumFastOther;
+
+    salvageDebugInfo(*DeadInst);
+    if (MemoryAccess *MA = MSSA.getMemoryAccess(DeadInst))
+      MSSAU.removeMemoryAccess(MA);
+
+    for (unsigned op = 0, e = DeadInst->getNumOperands(); op != e; ++op) {
+      Value *Op = DeadInst->getOperand(op);
+      DeadInst->setOperand(op, nullptr);
+      if (!Op->use_empty())
+        continue;
+      if (Instruction *OpI = dyn_cast<Instruction>(Op))
+        if (isInstructionTriviallyDead(OpI, &TLI))
+          NowDeadInsts.push_back(OpI);
+    }
+    DeadInst->eraseFromParent();
+  } while (!NowDeadInsts.empty());
+}
+
+/// Removes a store of a value loaded from the same pointer, when the memory is
+/// not modified in between.
+bool DSEState::eliminateNoopStore(StoreInst *SI) {
+  auto *Load = dyn_cast<LoadInst>(SI->getValueOperand());
+  if (!Load || Load->getPointerOperand() != SI->getPointerOperand() ||
+      !isRemovable(SI))
+    return false;
+
+  MemoryAccess *LoadAccess = MSSA.getMemoryAccess(Load);
+  auto *StoreAccess = cast<MemoryDef>(MSSA.getMemoryAccess(SI));
+  if (!LoadAccess)
+    return false;
+  MemoryAccess *Clobber = MSSA.getWalker()->getClobberingMemoryAccess(
+      StoreAccess->getDefiningAccess(), MemoryLocation::get(SI));
+  if (!MSSA.dominates(Clobber, LoadAccess))
+    return false;
+
+  LLVM_DEBUG(dbgs() << "DSE: Remove Store Of Load from same pointer:\n  LOAD: "
+                    << *Load << "\n  STORE: " << *SI << '\n');
+  deleteDeadInstruction(SI);
+  ++NumRedundantStores;
+  return true;
+}
+
+/// Returns true if the write I, which follows a store to Loc on some path,
+/// makes the store dead on this path.
+bool DSEState::isKiller(Instruction *I, const MemoryLocation &Loc,
+                        const Value *Object) {
+  // The stored object is deallocated, or its lifetime ends.
+  if (CallInst *Free = isFreeCall(I, &TLI))
+    return GetUnderlyingObject(Free->getArgOperand(0), DL) == Object;
+  if (auto *II = dyn_cast<IntrinsicInst>(I))
+    if (II->getIntrinsicID() == Intrinsic::lifetime_end)
+      return GetUnderlyingObject(II->getArgOperand(1), DL) == Object;
+
+  if (!hasAnalyzableMemoryWrite(I, TLI) || isRefSet(AA.getModRefInfo(I, Loc)))
+    return false;
+  MemoryLocation KillLoc = getLocForWrite(I);
+  if (!KillLoc.Ptr)
+    return false;
+
+  InstOverlapIntervalsTy IOL;
+  int64_t KillOffset, DeadOffset;
+  return isOverwrite(KillLoc, Loc, DL, TLI, DeadOffset, KillOffset, I, IOL, AA,
+                     &F) == OW_Complete;
+}
+
+/// Follows the MemorySSA uses of Dead, collecting the writes that kill it on
+/// some path. The parts of Dead overwritten by writes post-dominating it are
+/// recorded in IOL, and KilledAtExit is set if they cover all of it. Returns
+/// false if the location of Dead may be read before it is killed.
+bool DSEState::findKillers(Instruction *Dead, const MemoryLocation &Loc,
+                           const Value *Object,
+                           SmallPtrSetImpl<Instruction *> &Killers,
+                           InstOverlapIntervalsTy &IOL, bool &KilledAtExit) {
+  BasicBlock *DeadBB = Dead->getParent();
+  SmallVector<MemoryAccess *, 16> WorkList;
+  SmallPtrSet<MemoryAccess *, 16> Visited;
+  auto PushUsers = [&](MemoryAccess *MA) {
+    for (User *U : MA->users())
+      if (Visited.insert(cast<MemoryAccess>(U)).second)
+        WorkList.push_back(cast<MemoryAccess>(U));
+  };
+  PushUsers(MSSA.getMemoryAccess(Dead));
+
+  unsigned ScanLimit = MemorySSAScanLimit;
+  while (!WorkList.empty()) {
+    MemoryAccess *MA = WorkList.pop_back_val();
+    if (ScanLimit-- == 0)
+      return false;
+
+    // Past a phi that may lead back to Dead, the pointers in Loc may refer to
+    // a different location than they do for Dead.
+    if (auto *Phi = dyn_cast<MemoryPhi>(MA)) {
+      if (isPotentiallyReachable(Phi->getBlock(), DeadBB, &DT))
+        return false;
+      PushUsers(Phi);
+      continue;
+    }
+
+    Instruction *I = cast<MemoryUseOrDef>(MA)->getMemoryInst();
+    if (isa<MemoryUse>(MA)) {
+      if (isRefSet(AA.getModRefInfo(I, Loc)))
+        return false;
+      continue;
+    }
+
+    if (isKiller(I, Loc, Object)) {
+      Killers.insert(I);
+      continue;
+    }
+    if (isRefSet(AA.getModRefInfo(I, Loc)))
+      return false;
+
+    // Writes that happen on every path may together overwrite Dead.
+    if (hasAnalyzableMemoryWrite(I, TLI) &&
+        PDT.dominates(I->getParent(), DeadBB)) {
+      int64_t KillOffset, DeadOffset;
+      if (isOverwrite(getLocForWrite(I), Loc, DL, TLI, DeadOffset, KillOffset,
+                      Dead, IOL, AA, &F) == OW_Complete)
+        KilledAtExit = true;
+    }
+    PushUsers(MA);
+  }
+  return true;
+}
+
+/// Returns true if every path starting right after Dead reaches one of the
+/// Killers, or leaves the function while Object is dead or KilledAtExit is
+/// set. Unwinding out of the function in the middle of a block is only allowed
+/// if Object is dead on unwind, as this is not a post-dominated exit.
+bool DSEState::allPathsKilled(Instruction *Dead, const Value *Object,
+                              const SmallPtrSetImpl<Instruction *> &Killers,
+                              bool KilledAtExit) {
+  BasicBlock *DeadBB = Dead->getParent();
+  SmallVector<BasicBlock *, 16> WorkList;
+  SmallPtrSet<BasicBlock *, 16> Visited;
+  unsigned BlockLimit = MemorySSAPathCheckLimit;
+
+  // Scans BB from Start, returning false if a path escapes before a killer.
+  // Paths that are not killed in BB continue in its successors.
+  auto ScanBlock = [&](BasicBlock *BB, BasicBlock::iterator Start) {
+    for (Instruction &I : make_range(Start, BB->end())) {
+      if (Killers.count(&I))
+        return true;
+      if (isa<CallInst>(I) && I.mayThrow() && !isDeadOnUnwind(Object))
+        return false;
+    }
+    TerminatorInst *TI = BB->getTerminator();
+    if (TI->getNumSuccessors() == 0)
+      return KilledAtExit || (isa<ReturnInst>(TI) && isDeadAtExit(Object));
+    for (BasicBlock *Succ : successors(BB)) {
+      // A path that comes back to Dead is not killed by a later write.
+      if (Succ == DeadBB)
+        return false;
+      if (Visited.insert(Succ).second)
+        WorkList.push_back(Succ);
+    }
+    return true;
+  };
+
+  if (!ScanBlock(DeadBB, std::next(Dead->getIterator())))
+    return false;
+  while (!WorkList.empty()) {
+    if (BlockLimit-- == 0)
+      return false;
+    BasicBlock *BB = WorkList.pop_back_val();
+    if (!ScanBlock(BB, BB->begin()))
+      return false;
+  }
+  return true;
+}
+
+bool DSEState::run() {
+  // Collect the candidates first, as eliminating them changes MemorySSA.
+  SmallVector<Instruction *, 64> Candidates;
+  for (BasicBlock *BB : post_order(&F))
+    for (Instruction &I : reverse(*BB))
+      if (hasAnalyzableMemoryWrite(&I, TLI) && isRemovable(&I) &&
+          MSSA.getMemoryAccess(&I))
+        Candidates.push_back(&I);
+
+  bool MadeChange = false;
+  for (Instruction *Dead : Candidates) {
+    if (auto *SI = dyn_cast<StoreInst>(Dead))
+      if (eliminateNoopStore(SI)) {
+        MadeChange = true;
+        continue;
+      }
+
+    MemoryLocation Loc = getLocForWrite(Dead);
+    if (!Loc.Ptr || Loc.Size == MemoryLocation::UnknownSize)
+      continue;
+    const Value *Object = GetUnderlyingObject(Loc.Ptr, DL);
+
+    SmallPtrSet<Instruction *, 4> Killers;
+    InstOverlapIntervalsTy IOL;
+    bool KilledAtExit = false;
+    if (!findKillers(Dead, Loc, Object, Killers, IOL, KilledAtExit))
+      continue;
+
+    if (allPathsKilled(Dead, Object, Killers, KilledAtExit)) {
+      LLVM_DEBUG(dbgs() << "DSE: Remove Dead Store:\n  DEAD: " << *Dead
+                        << '\n');
+      deleteDeadInstruction(Dead);
+      ++NumFastStores;
+      MadeChange = true;
+      continue;
+    }
+
+    // The parts of the location that are overwritten on every path can be
+    // trimmed from memory intrinsics.
+    OverlapIntervalsTy &Intervals = IOL[Dead];
+    if (Intervals.empty() || !allPathsKilled(Dead, Object, Killers, true))
+      continue;
+    int64_t DeadStart = 0;
+    int64_t DeadSize = int64_t(Loc.Size);
+    GetPointerBaseWithConstantOffset(Loc.Ptr->stripPointerCasts(), DeadStart,
+                                     DL);
+    bool Shortened = tryToShortenEnd(Dead, Intervals, DeadStart, DeadSize);
+    if (!Intervals.empty())
+      Shortened |= tryToShortenBegin(Dead, Intervals, DeadStart, DeadSize);
+    if (Shortened) {
+      ++NumModifiedStores;
+      MadeChange = true;
+    }
+  }
+  return MadeChange;
+}
+
+static bool eliminateDeadStoresMemorySSA(Function &F, AliasAnalysis &AA,
+                                         MemorySSA &MSSA, DominatorTree &DT,
+                                         PostDominatorTree &PDT,
+                                         const TargetLibraryInfo &TLI) {
+  return DSEState(F, AA, MSSA, DT, PDT, TLI).run();
+}
+
 //===----------------------------------------------------------------------===//
 // DSE Pass
 //===----------------------------------------------------------------------===//
 PreservedAnalyses DSEPass::run(Function &F, FunctionAnalysisManager &AM) {
   AliasAnalysis *AA = &AM.getResult<AAManager>(F);
   DominatorTree *DT = &AM.getResult<DominatorTreeAnalysis>(F);
-  MemoryDependenceResults *MD = &AM.getResult<MemoryDependenceAnalysis>(F);
   const TargetLibraryInfo *TLI = &AM.getResult<TargetLibraryAnalysis>(F);
 
-  if (!eliminateDeadStores(F, AA, MD, DT, TLI))
-    return PreservedAnalyses::all();
-
   PreservedAnalyses PA;
   PA.preserveSet<CFGAnalyses>();
   PA.preserve<GlobalsAA>();
+  if (EnableMemorySSA) {
+    MemorySSA &MSSA = AM.getResult<MemorySSAAnalysis>(F).getMSSA();
+    PostDominatorTree &PDT = AM.getResult<PostDominatorTreeAnalysis>(F);
+    if (!eliminateDeadStoresMemorySSA(F, *AA, MSSA, *DT, PDT, *TLI))
+      return PreservedAnalyses::all();
+    PA.preserve<MemorySSAAnalysis>();
+    return PA;
+  }
+
+  MemoryDependenceResults *MD = &AM.getResult<MemoryDependenceAnalysis>(F);
+  if (!eliminateDeadStores(F, AA, MD, DT, TLI))
+    return PreservedAnalyses::all();
   PA.preserve<MemoryDependenceAnalysis>();
   return PA;
 }
@@ -1358,11 +1703,18 @@ public:
 
     DominatorTree *DT = &getAnalysis<DominatorTreeWrapperPass>().getDomTree();
     AliasAnalysis *AA = &getAnalysis<AAResultsWrapperPass>().getAAResults();
-    MemoryDependenceResults *MD =
-        &getAnalysis<MemoryDependenceWrapperPass>().getMemDep();
     const TargetLibraryInfo *TLI =
         &getAnalysis<TargetLibraryInfoWrapperPass>().getTLI();
 
+    if (EnableMemorySSA) {
+      MemorySSA &MSSA = getAnalysis<MemorySSAWrapperPass>().getMSSA();
+      PostDominatorTree &PDT =
+          getAnalysis<PostDominatorTreeWrapperPass>().getPostDomTree();
+      return eliminateDeadStoresMemorySSA(F, *AA, MSSA, *DT, PDT, *TLI);
+    }
+
+    MemoryDependenceResults *MD =
+        &getAnalysis<MemoryDependenceWrapperPass>().getMemDep();
     return eliminateDeadStores(F, AA, MD, DT, TLI);
   }
 
@@ -1370,11 +1722,18 @@ public:
     AU.setPreservesCFG();
     AU.addRequired<DominatorTreeWrapperPass>();
     AU.addRequired<AAResultsWrapperPass>();
-    AU.addRequired<MemoryDependenceWrapperPass>();
     AU.addRequired<TargetLibraryInfoWrapperPass>();
     AU.addPreserved<DominatorTreeWrapperPass>();
     AU.addPreserved<GlobalsAAWrapperPass>();
-    AU.addPreserved<MemoryDependenceWrapperPass>();
+    if (EnableMemorySSA) {
+      AU.addRequired<MemorySSAWrapperPass>();
+      AU.addRequired<PostDominatorTreeWrapperPass>();
+      AU.addPreserved<MemorySSAWrapperPass>();
+      AU.addPreserved<PostDominatorTreeWrapperPass>();
+    } else {
+      AU.addRequired<MemoryDependenceWrapperPass>();
+      AU.addPreserved<MemoryDependenceWrapperPass>();
+    }
   }
 };
 
@@ -1388,6 +1747,8 @@ INITIALIZE_PASS_DEPENDENCY(DominatorTreeWrapperPass)
 INITIALIZE_PASS_DEPENDENCY(AAResultsWrapperPass)
 INITIALIZE_PASS_DEPENDENCY(GlobalsAAWrapperPass)
 INITIALIZE_PASS_DEPENDENCY(MemoryDependenceWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(MemorySSAWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(PostDominatorTreeWrapperPass)
 INITIALIZE_PASS_DEPENDENCY(TargetLibraryInfoWrapperPass)
 INITIALIZE_PASS_END(DSELegacyPass, "dse", "Dead Store Elimination", false,
                     false)
@@ -30,6 +30,7 @@
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/Analysis/AssumptionCache.h"
 #include "llvm/Analysis/CFG.h"
+#include "llvm/Analysis/CompileTimeBudget.h"
 #include "llvm/Analysis/GlobalsModRef.h"
 #include "llvm/Analysis/InstructionSimplify.h"
 #include "llvm/Analysis/LoopInfo.h"
@@ -638,7 +639,10 @@ PreservedAnalyses GVN::run(Function &F, FunctionAnalysisManager &AM) {
   auto &MemDep = AM.getResult<MemoryDependenceAnalysis>(F);
   auto *LI = AM.getCachedResult<LoopAnalysis>(F);
   auto &ORE = AM.getResult<OptimizationRemarkEmitterAnalysis>(F);
-  bool Changed = runImpl(F, AC, DT, TLI, AA, &MemDep, LI, &ORE);
+  CompileTimeBudget *Budget = nullptr;
+  if (CompileTimeBudgetAnalysis::isEnabled())
+    Budget = &AM.getResult<CompileTimeBudgetAnalysis>(F);
+  bool Changed = runImpl(F, AC, DT, TLI, AA, &MemDep, LI, &ORE, Budget);
   if (!Changed)
     return PreservedAnalyses::all();
   PreservedAnalyses PA;
@@ -1975,7 +1979,8 @@ bool GVN::processInstruction(Instruction *I) {
 bool GVN::runImpl(Function &F, AssumptionCache &RunAC, DominatorTree &RunDT,
                   const TargetLibraryInfo &RunTLI, AAResults &RunAA,
                   MemoryDependenceResults *RunMD, LoopInfo *LI,
-                  OptimizationRemarkEmitter *RunORE) {
+                  OptimizationRemarkEmitter *RunORE,
+                  CompileTimeBudget *RunBudget) {
   AC = &RunAC;
   DT = &RunDT;
   VN.setDomTree(DT);
@@ -1986,6 +1991,7 @@ bool GVN::runImpl(Function &F, AssumptionCache &RunAC, DominatorTree &RunDT,
   ICF = &ImplicitCFT;
   VN.setMemDep(MD);
   ORE = RunORE;
+  Budget = RunBudget;
 
   bool Changed = false;
   bool ShouldContinue = true;
@@ -2004,14 +2010,28 @@ bool GVN::runImpl(Function &F, AssumptionCache &RunAC, DominatorTree &RunDT,
   }
 
   unsigned Iteration = 0;
+  bool OverBudget = false;
   while (ShouldContinue) {
     LLVM_DEBUG(dbgs() << "GVN iteration: " << Iteration << "\n");
     ShouldContinue = iterateOnFunction(F);
     Changed |= ShouldContinue;
     ++Iteration;
+    // Every iteration visits each instruction of the function once. Once the
+    // budget is exhausted, keep what has been found so far and skip PRE. The
+    // budget running out on the last iteration doesn't cut anything short.
+    if (Budget && !Budget->consume(F.getInstructionCount())) {
+      OverBudget = ShouldContinue;
+      break;
+    }
   }
 
-  if (EnablePRE) {
+  if (OverBudget && ORE)
+    Budget->emitDegradationRemark(
+        *ORE, DEBUG_TYPE, F,
+        "stopping after " + std::to_string(Iteration) +
+            " iteration(s) and skipping PRE");
+
+  if (EnablePRE && !OverBudget) {
     // Fabricate val-num for dead-code in order to suppress assertion in
     // performPRE().
     assignValNumForDeadCode();
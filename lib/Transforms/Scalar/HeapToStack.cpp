@@ -0,0 +1,371 @@
+//===- HeapToStack.cpp - Heap to Stack Promotion Pass ---------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the Heap to Stack pass. Calls to malloc, calloc and
+// operator new that allocate a small, constant number of bytes, and whose
+// result never escapes the function, are replaced by a static alloca. The
+// calls to free and operator delete that release the allocation are removed.
+//
+// An allocation is promoted when:
+//  * its size is a constant no larger than -heap-to-stack-max-size, and the
+//    bytes promoted in the function stay within -heap-to-stack-max-total;
+//  * it is not executed more than once per call, i.e. it is not part of a
+//    cycle, as a single stack slot then could not hold all its instances;
+//  * the pointer it returns is not captured, and is only passed to calls that
+//    cannot release it: intrinsics, calls only reading memory through it, and
+//    the calls freeing it, which must free the allocation itself rather than a
+//    value derived from it;
+//  * the function is not directly recursive, as the stack frame of every
+//    active call would grow.
+//
+// The lifetime of the stack slot is bounded by lifetime markers placed at the
+// allocation and at the calls that freed it.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Transforms/Scalar/HeapToStack.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/CFG.h"
+#include "llvm/Analysis/CaptureTracking.h"
+#include "llvm/Analysis/GlobalsModRef.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/MemoryBuiltins.h"
+#include "llvm/Analysis/OptimizationRemarkEmitter.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/Utils/Local.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "heap-to-stack"
+
+STATISTIC(NumPromoted, "Number of heap allocations moved to the stack");
+STATISTIC(NumPromotedBytes, "Number of bytes moved from the heap to the stack");
+
+static cl::opt<unsigned> MaxAllocationSize(
+    "heap-to-stack-max-size", cl::init(256), cl::Hidden,
+    cl::desc("The maximum size in bytes of a heap allocation moved to the "
+             "stack"));
+
+static cl::opt<unsigned> MaxTotalSize(
+    "heap-to-stack-max-total", cl::init(1024), cl::Hidden,
+    cl::desc("The maximum number of bytes moved from the heap to the stack in "
+             "a function"));
+
+/// The alignment that malloc and operator new guarantee on the common 64-bit
+/// targets, which the code using an allocation may rely on.
+static const unsigned DefaultAllocationAlignment = 16;
+
+namespace {
+
+/// Follows the uses of an allocation, collecting the calls that free it and
+/// rejecting those through which it may escape or be released.
+struct AllocationTracker : public CaptureTracker {
+  AllocationTracker(const Instruction *Alloc, const TargetLibraryInfo &TLI)
+      : Alloc(Alloc), TLI(TLI) {}
+
+  void tooManyUses() override { Unsafe = true; }
+
+  // The calls freeing the allocation are not explored, and so never reported
+  // as captures. CaptureTracking does not report the arguments of calls that
+  // are marked nocapture either, but such calls may still free the memory.
+  bool shouldExplore(const Use *U) override {
+    if (Unsafe)
+      return false;
+
+    Instruction *I = cast<Instruction>(U->getUser());
+    if (CallInst *Free = isFreeCall(I, &TLI)) {
+      if (U->getOperandNo() == 0 && U->get()->stripPointerCasts() == Alloc)
+        Frees.insert(Free);
+      else
+        Unsafe = true;
+      return false;
+    }
+
+    CallSite CS(I);
+    if (!CS || isa<IntrinsicInst>(I) || CS.onlyReadsMemory())
+      return true;
+    if (!CS.isArgOperand(U) || !CS.onlyReadsMemory(CS.getArgumentNo(U)))
+      Unsafe = true;
+    return !Unsafe;
+  }
+
+  bool captured(const Use *U) override {
+    Unsafe = true;
+    return true;
+  }
+
+  const Instruction *Alloc;
+  const TargetLibraryInfo &TLI;
+  SmallPtrSet<CallInst *, 4> Frees;
+  bool Unsafe = false;
+};
+
+class HeapToStack {
+public:
+  HeapToStack(Function &F, LoopInfo &LI, const TargetLibraryInfo &TLI,
+              OptimizationRemarkEmitter &ORE)
+      : F(F), LI(LI), TLI(TLI), ORE(ORE), DL(F.getParent()->getDataLayout()) {}
+
+  /// Promotes the allocations of the function. Returns true if any was
+  /// promoted, and sets ChangedCFG if an invoke was removed in the process.
+  bool run(bool &ChangedCFG);
+
+private:
+  void reportMissed(Instruction *Alloc, StringRef RemarkName,
+                    const Twine &Reason);
+  bool getAlignment(Instruction *Alloc, unsigned &Align);
+  bool isExecutedOnce(Instruction *Alloc);
+  void promote(Instruction *Alloc, uint64_t Size, unsigned Align,
+               ArrayRef<CallInst *> Frees);
+
+  Function &F;
+  LoopInfo &LI;
+  const TargetLibraryInfo &TLI;
+  OptimizationRemarkEmitter &ORE;
+  const DataLayout &DL;
+};
+
+} // end anonymous namespace
+
+void HeapToStack::reportMissed(Instruction *Alloc, StringRef RemarkName,
+                               const Twine &Reason) {
+  std::string Msg = Reason.str();
+  LLVM_DEBUG(dbgs() << "Not moving " << *Alloc << " to the stack: " << Msg
+                    << "\n");
+  ORE.emit([&]() {
+    return OptimizationRemarkMissed(DEBUG_TYPE, RemarkName, Alloc)
+           << "heap allocation not moved to the stack: " << Msg;
+  });
+}
+
+/// Computes the alignment of the memory returned by Alloc. Returns false if
+/// it is not known, or too large for the stack.
+bool HeapToStack::getAlignment(Instruction *Alloc, unsigned &Align) {
+  CallSite CS(Alloc);
+  LibFunc TLIFn;
+  if (TLI.getLibFunc(*CS.getCalledFunction(), TLIFn) && TLIFn == LibFunc_valloc)
+    return false;
+
+  Align = DefaultAllocationAlignment;
+  if (isCallocLikeFn(Alloc, &TLI))
+    return true;
+
+  // The integer argument following the size of the aligned forms of operator
+  // new is the alignment.
+  for (unsigned I = 1, E = CS.arg_size(); I != E; ++I) {
+    Value *Arg = CS.getArgument(I);
+    if (!Arg->getType()->isIntegerTy())
+      continue;
+    auto *C = dyn_cast<ConstantInt>(Arg);
+    if (!C || !C->getValue().isPowerOf2() ||
+        C->getValue().ugt(Value::MaximumAlignment))
+      return false;
+    Align = std::max<unsigned>(Align, C->getZExtValue());
+  }
+  return true;
+}
+
+/// Returns true if Alloc cannot be executed again before the function
+/// returns, including through irreducible control flow.
+bool HeapToStack::isExecutedOnce(Instruction *Alloc) {
+  BasicBlock *BB = Alloc->getParent();
+  if (LI.getLoopFor(BB))
+    return false;
+  SmallVector<BasicBlock *, 4> Worklist(succ_begin(BB), succ_end(BB));
+  return Worklist.empty() ||
+         !isPotentiallyReachableFromMany(Worklist, BB, nullptr, &LI);
+}
+
+void HeapToStack::promote(Instruction *Alloc, uint64_t Size, unsigned Align,
+                          ArrayRef<CallInst *> Frees) {
+  LLVM_DEBUG(dbgs() << "Moving " << *Alloc << " to the stack\n");
+  ORE.emit([&]() {
+    return OptimizationRemark(DEBUG_TYPE, "Promoted", Alloc)
+           << "heap allocation of " << ore::NV("Size", Size)
+           << " bytes moved to the stack";
+  });
+  ++NumPromoted;
+  NumPromotedBytes += Size;
+
+  BasicBlock &Entry = F.getEntryBlock();
+  auto *AI = new AllocaInst(ArrayType::get(Type::getInt8Ty(F.getContext()),
+                                           Size),
+                            DL.getAllocaAddrSpace(), nullptr, Align,
+                            Alloc->getName() + ".h2s",
+                            &*Entry.getFirstInsertionPt());
+
+  IRBuilder<> Builder(Alloc);
+  Builder.CreateLifetimeStart(AI, Builder.getInt64(Size));
+  Value *Ptr = Builder.CreatePointerCast(AI, Alloc->getType());
+  Ptr->takeName(Alloc);
+  if (isCallocLikeFn(Alloc, &TLI))
+    Builder.CreateMemSet(Ptr, Builder.getInt8(0), Size, Align);
+  Alloc->replaceAllUsesWith(Ptr);
+
+  for (CallInst *Free : Frees) {
+    Builder.SetInsertPoint(Free);
+    Builder.CreateLifetimeEnd(AI, Builder.getInt64(Size));
+    Free->eraseFromParent();
+  }
+
+  // The stack allocation cannot throw, so the exceptional edge of an invoke
+  // goes away.
+  if (auto *II = dyn_cast<InvokeInst>(Alloc)) {
+    BranchInst::Create(II->getNormalDest(), II);
+    II->getUnwindDest()->removePredecessor(II->getParent());
+  }
+  Alloc->eraseFromParent();
+}
+
+bool HeapToStack::run(bool &ChangedCFG) {
+  // Nothing is promoted in a recursive function, as the frame of every active
+  // call would grow.
+  SmallVector<Instruction *, 8> Allocs;
+  for (BasicBlock &BB : F)
+    for (Instruction &I : BB) {
+      CallSite CS(&I);
+      if (!CS)
+        continue;
+      if (CS.getCalledFunction() == &F)
+        return false;
+      if (isMallocOrCallocLikeFn(&I, &TLI))
+        Allocs.push_back(&I);
+    }
+
+  bool Changed = false;
+  uint64_t Budget = MaxTotalSize;
+  for (Instruction *Alloc : Allocs) {
+    uint64_t Size;
+    if (!getObjectSize(Alloc, Size, DL, &TLI)) {
+      reportMissed(Alloc, "UnknownSize", "size is not a constant");
+      continue;
+    }
+    if (Size == 0 || Size > MaxAllocationSize) {
+      reportMissed(Alloc, "TooLarge",
+                   "size of " + Twine(Size) + " bytes is not in [1, " +
+                       Twine(MaxAllocationSize) + "]");
+      continue;
+    }
+    unsigned Align;
+    if (!getAlignment(Alloc, Align) ||
+        Alloc->getType()->getPointerAddressSpace() != DL.getAllocaAddrSpace()) {
+      reportMissed(Alloc, "UnsupportedAllocation",
+                   "alignment or address space is not supported");
+      continue;
+    }
+    if (!isExecutedOnce(Alloc)) {
+      reportMissed(Alloc, "InLoop", "allocation is in a loop");
+      continue;
+    }
+
+    AllocationTracker Tracker(Alloc, TLI);
+    PointerMayBeCaptured(Alloc, &Tracker);
+    if (Tracker.Unsafe) {
+      reportMissed(Alloc, "Escapes",
+                   "allocation may escape or be freed by another call");
+      continue;
+    }
+
+    if (Size > Budget) {
+      reportMissed(Alloc, "StackBudget",
+                   "function already moved " + Twine(MaxTotalSize - Budget) +
+                       " bytes to the stack");
+      continue;
+    }
+    Budget -= Size;
+
+    ChangedCFG |= isa<InvokeInst>(Alloc);
+    SmallVector<CallInst *, 4> Frees(Tracker.Frees.begin(),
+                                     Tracker.Frees.end());
+    promote(Alloc, Size, Align, Frees);
+    Changed = true;
+  }
+
+  // Drop the landing pads that were only reached from promoted invokes.
+  if (ChangedCFG)
+    removeUnreachableBlocks(F);
+  return Changed;
+}
+
+namespace {
+
+class HeapToStackLegacyPass : public FunctionPass {
+public:
+  static char ID;
+
+  HeapToStackLegacyPass() : FunctionPass(ID) {
+    initializeHeapToStackLegacyPassPass(*PassRegistry::getPassRegistry());
+  }
+
+  bool runOnFunction(Function &F) override {
+    if (skipFunction(F))
+      return false;
+
+    auto &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+    auto &TLI = getAnalysis<TargetLibraryInfoWrapperPass>().getTLI();
+    auto &ORE = getAnalysis<OptimizationRemarkEmitterWrapperPass>().getORE();
+    bool ChangedCFG = false;
+    return HeapToStack(F, LI, TLI, ORE).run(ChangedCFG);
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<LoopInfoWrapperPass>();
+    AU.addRequired<TargetLibraryInfoWrapperPass>();
+    AU.addRequired<OptimizationRemarkEmitterWrapperPass>();
+    AU.addPreserved<GlobalsAAWrapperPass>();
+  }
+};
+
+} // end anonymous namespace
+
+PreservedAnalyses HeapToStackPass::run(Function &F,
+                                       FunctionAnalysisManager &AM) {
+  auto &LI = AM.getResult<LoopAnalysis>(F);
+  auto &TLI = AM.getResult<TargetLibraryAnalysis>(F);
+  auto &ORE = AM.getResult<OptimizationRemarkEmitterAnalysis>(F);
+
+  bool ChangedCFG = false;
+  if (!HeapToStack(F, LI, TLI, ORE).run(ChangedCFG))
+    return PreservedAnalyses::all();
+  PreservedAnalyses PA;
+  if (!ChangedCFG)
+    PA.preserveSet<CFGAnalyses>();
+  PA.preserve<GlobalsAA>();
+  return PA;
+}
+
+char HeapToStackLegacyPass::ID = 0;
+
+INITIALIZE_PASS_BEGIN(HeapToStackLegacyPass, "heap-to-stack",
+                      "Heap to Stack Promotion", false, false)
+INITIALIZE_PASS_DEPENDENCY(LoopInfoWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(TargetLibraryInfoWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(OptimizationRemarkEmitterWrapperPass)
+INITIALIZE_PASS_END(HeapToStackLegacyPass, "heap-to-stack",
+                    "Heap to Stack Promotion", false, false)
+
+FunctionPass *llvm::createHeapToStackPass() {
+  return new HeapToStackLegacyPass();
+}
@@ -21,14 +21,17 @@
 #include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/BlockFrequencyUpdater.h"
 #include "llvm/Analysis/BranchProbabilityInfo.h"
 #include "llvm/Analysis/CFG.h"
+#include "llvm/Analysis/CompileTimeBudget.h"
 #include "llvm/Analysis/ConstantFolding.h"
 #include "llvm/Analysis/GlobalsModRef.h"
 #include "llvm/Analysis/InstructionSimplify.h"
 #include "llvm/Analysis/LazyValueInfo.h"
 #include "llvm/Analysis/Loads.h"
 #include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/OptimizationRemarkEmitter.h"
 #include "llvm/Analysis/TargetLibraryInfo.h"
 #include "llvm/Analysis/ValueTracking.h"
 #include "llvm/IR/BasicBlock.h"
@@ -323,8 +326,17 @@ PreservedAnalyses JumpThreadingPass::run(Function &F,
     BFI.reset(new BlockFrequencyInfo(F, *BPI, LI));
   }
 
+  // Remarks are only needed to explain a degradation, so don't compute the
+  // emitter unless a budget is in effect.
+  CompileTimeBudget *Budget = nullptr;
+  OptimizationRemarkEmitter *ORE = nullptr;
+  if (CompileTimeBudgetAnalysis::isEnabled()) {
+    Budget = &AM.getResult<CompileTimeBudgetAnalysis>(F);
+    ORE = &AM.getResult<OptimizationRemarkEmitterAnalysis>(F);
+  }
+
   bool Changed = runImpl(F, &TLI, &LVI, &AA, &DTU, HasProfileData,
-                         std::move(BFI), std::move(BPI));
+                         std::move(BFI), std::move(BPI), Budget, ORE);
 
   if (!Changed)
     return PreservedAnalyses::all();
@@ -339,12 +351,16 @@ bool JumpThreadingPass::runImpl(Function &F, TargetLibraryInfo *TLI_,
                                 LazyValueInfo *LVI_, AliasAnalysis *AA_,
                                 DomTreeUpdater *DTU_, bool HasProfileData_,
                                 std::unique_ptr<BlockFrequencyInfo> BFI_,
-                                std::unique_ptr<BranchProbabilityInfo> BPI_) {
+                                std::unique_ptr<BranchProbabilityInfo> BPI_,
+                                CompileTimeBudget *Budget_,
+                                OptimizationRemarkEmitter *ORE_) {
   LLVM_DEBUG(dbgs() << "Jump threading on function '" << F.getName() << "'\n");
   TLI = TLI_;
   LVI = LVI_;
   AA = AA_;
   DTU = DTU_;
+  Budget = Budget_;
+  ORE = ORE_;
   BFI.reset();
   BPI.reset();
   // When profile data is available, we need to update edge weights after
@@ -368,10 +384,20 @@ bool JumpThreadingPass::runImpl(Function &F, TargetLibraryInfo *TLI_,
     if (!DT.isReachableFromEntry(&BB))
       Unreachable.insert(&BB);
 
+  // Threading is optional; skip it outright on a function that has already
+  // used up its compile-time budget.
+  if (Budget && Budget->isExhausted()) {
+    if (ORE)
+      Budget->emitDegradationRemark(*ORE, DEBUG_TYPE, F,
+                                    "skipping jump threading");
+    return false;
+  }
+
   FindLoopHeaders(F);
 
   bool EverChanged = false;
   bool Changed;
+  unsigned Sweeps = 0;
   do {
     Changed = false;
     for (auto &BB : F) {
@@ -415,6 +441,16 @@ bool JumpThreadingPass::runImpl(Function &F, TargetLibraryInfo *TLI_,
       }
     }
     EverChanged |= Changed;
+    ++Sweeps;
+    // Each sweep visits every instruction of the function at least once.
+    if (Changed && Budget && !Budget->consume(F.getInstructionCount())) {
+      if (ORE)
+        Budget->emitDegradationRemark(*ORE, DEBUG_TYPE, F,
+                                      "stopping jump threading after " +
+                                          std::to_string(Sweeps) +
+                                          " sweep(s)");
+      break;
+    }
   } while (Changed);
 
   LoopHeaders.clear();
@@ -1967,8 +2003,7 @@ bool JumpThreadingPass::ThreadEdge(BasicBlock *BB,
 
   // Set the block frequency of NewBB.
   if (HasProfileData) {
-    auto NewBBFreq =
-        BFI->getBlockFreq(PredBB) * BPI->getEdgeProbability(PredBB, BB);
+    auto NewBBFreq = BlockFrequencyUpdater(*BFI, *BPI).getEdgeFreq(PredBB, BB);
     BFI->setBlockFreq(NewBB, NewBBFreq.getFrequency());
   }
 
@@ -2080,10 +2115,11 @@ BasicBlock *JumpThreadingPass::SplitBlockPreds(BasicBlock *BB,
   // Collect the frequencies of all predecessors of BB, which will be used to
   // update the edge weight of the result of splitting predecessors.
   DenseMap<BasicBlock *, BlockFrequency> FreqMap;
-  if (HasProfileData)
+  if (HasProfileData) {
+    BlockFrequencyUpdater BFU(*BFI, *BPI);
     for (auto Pred : Preds)
-      FreqMap.insert(std::make_pair(
-          Pred, BFI->getBlockFreq(Pred) * BPI->getEdgeProbability(Pred, BB)));
+      FreqMap.insert(std::make_pair(Pred, BFU.getEdgeFreq(Pred, BB)));
+  }
 
   // In the case when BB is a LandingPad block we create 2 new predecessors
   // instead of just one.
@@ -2177,8 +2213,7 @@ void JumpThreadingPass::UpdateBlockFreqAndEdgeWeight(BasicBlock *PredBB,
   }
 
   // Update edge probabilities in BPI.
-  for (int I = 0, E = BBSuccProbs.size(); I < E; I++)
-    BPI->setEdgeProbability(BB, I, BBSuccProbs[I]);
+  BPI->setEdgeProbability(BB, BBSuccProbs);
 
   // Update the profile metadata as well.
   //
@@ -2279,6 +2314,8 @@ bool JumpThreadingPass::DuplicateCondBranchOnPHIIntoPred(
   if (!OldPredBranch || !OldPredBranch->isUnconditional()) {
     BasicBlock *OldPredBB = PredBB;
     PredBB = SplitEdge(OldPredBB, BB);
+    if (HasProfileData)
+      BlockFrequencyUpdater(*BFI, *BPI).splitEdge(OldPredBB, PredBB);
     Updates.push_back({DominatorTree::Insert, OldPredBB, PredBB});
     Updates.push_back({DominatorTree::Insert, PredBB, BB});
     Updates.push_back({DominatorTree::Delete, OldPredBB, BB});
@@ -2384,6 +2421,12 @@ bool JumpThreadingPass::DuplicateCondBranchOnPHIIntoPred(
   OldPredBranch->eraseFromParent();
   DTU->applyUpdates(Updates);
 
+  // PredBB now holds a copy of BB, and the flow from PredBB no longer goes
+  // through BB.
+  if (HasProfileData)
+    BlockFrequencyUpdater(*BFI, *BPI)
+        .cloneBlock(BB, PredBB, BFI->getBlockFreq(PredBB));
+
   ++NumDupes;
   return true;
 }
@@ -0,0 +1,460 @@
+//===- LoopFuse.cpp - Loop Fusion Pass ------------------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the Loop Fusion pass. Adjacent loops that iterate the
+// same number of times are fused into a single loop, in which every iteration
+// runs the body of the first loop followed by the body of the second one.
+// When both loops stream the same arrays, this halves the memory traffic.
+//
+// Two loops are fused when:
+//  * they are in simplified and rotated form, with the latch as the single
+//    exiting block, and access memory only through simple loads and stores;
+//  * they are control flow equivalent: the first dominates the second and
+//    the second post-dominates the first;
+//  * they are adjacent: the exit block of the first loop is the preheader of
+//    the second one and contains no code;
+//  * ScalarEvolution proves that their backedge-taken counts are equal;
+//  * no value computed in the first loop is used outside of it;
+//  * no memory dependence between them would be reversed by running their
+//    iterations in lockstep. Dependences that DependenceAnalysis cannot rule
+//    out are checked with ScalarEvolution: an access of the second loop must
+//    never touch the location that an access of the first loop touches in a
+//    later iteration.
+//
+// A missed-optimization remark explains why every adjacent pair of loops was
+// not fused.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Transforms/Scalar/LoopFuse.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Analysis/DependenceAnalysis.h"
+#include "llvm/Analysis/GlobalsModRef.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/OptimizationRemarkEmitter.h"
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/Utils/Local.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "loop-fusion"
+
+STATISTIC(NumFused, "Number of loops fused");
+STATISTIC(NumInvalidShape, "Loop has an unsupported shape");
+STATISTIC(NumUnsafeInstructions, "Loop contains unsafe instructions");
+STATISTIC(NumUnknownTripCount, "Loop has an unknown trip count");
+STATISTIC(NumNonAdjacent, "Loops are not adjacent");
+STATISTIC(NumNotControlFlowEquivalent,
+          "Loops are not control flow equivalent");
+STATISTIC(NumDifferentTripCounts, "Loops have different trip counts");
+STATISTIC(NumEscapingValues, "Loop has values used outside of it");
+STATISTIC(NumUnsafeDependences,
+          "Loops have a dependence prevented by fusion");
+
+namespace {
+
+class LoopFuser {
+public:
+  LoopFuser(Function &F, LoopInfo &LI, DominatorTree &DT,
+            PostDominatorTree &PDT, ScalarEvolution &SE, DependenceInfo &DI,
+            OptimizationRemarkEmitter &ORE)
+      : F(F), LI(LI), DT(DT), PDT(PDT), SE(SE), DI(DI), ORE(ORE),
+        DL(F.getParent()->getDataLayout()) {}
+
+  bool run();
+
+private:
+  bool fuseSiblings(ArrayRef<Loop *> Siblings);
+  bool isCandidate(Loop *L0, Loop *L1, Loop *L);
+  bool canFuse(Loop *L0, Loop *L1);
+  bool dependencesAllowFusion(Loop *L0, Loop *L1);
+  bool isLockstepSafe(Loop *L0, Loop *L1, Instruction *I0, Instruction *I1);
+  void fuse(Loop *L0, Loop *L1);
+  void reportMissed(Loop *L0, Loop *L1, StringRef RemarkName,
+                    const Twine &Reason, Statistic &Stat);
+
+  Function &F;
+  LoopInfo &LI;
+  DominatorTree &DT;
+  PostDominatorTree &PDT;
+  ScalarEvolution &SE;
+  DependenceInfo &DI;
+  OptimizationRemarkEmitter &ORE;
+  const DataLayout &DL;
+};
+
+} // end anonymous namespace
+
+void LoopFuser::reportMissed(Loop *L0, Loop *L1, StringRef RemarkName,
+                             const Twine &Reason, Statistic &Stat) {
+  ++Stat;
+  std::string Msg = Reason.str();
+  LLVM_DEBUG(dbgs() << "Not fusing " << L0->getHeader()->getName() << " and "
+                    << L1->getHeader()->getName() << ": " << Msg << "\n");
+  ORE.emit([&]() {
+    return OptimizationRemarkMissed(DEBUG_TYPE, RemarkName, L0->getStartLoc(),
+                                    L0->getHeader())
+           << "loop not fused with the following loop: " << Msg;
+  });
+}
+
+/// Returns true if L, which is either L0 or L1, has a shape the fusion of L0
+/// and L1 supports.
+bool LoopFuser::isCandidate(Loop *L0, Loop *L1, Loop *L) {
+  StringRef Which = L == L0 ? "first" : "second";
+  if (!L->isLoopSimplifyForm() || !L->getExitBlock() ||
+      L->getExitingBlock() != L->getLoopLatch()) {
+    reportMissed(L0, L1, "InvalidShape",
+                 Which + " loop is not in simplified and rotated form",
+                 NumInvalidShape);
+    return false;
+  }
+
+  for (BasicBlock *BB : L->blocks())
+    for (Instruction &I : *BB) {
+      bool Safe = !I.mayThrow();
+      if (auto *Load = dyn_cast<LoadInst>(&I))
+        Safe &= Load->isSimple();
+      else if (auto *Store = dyn_cast<StoreInst>(&I))
+        Safe &= Store->isSimple();
+      else
+        Safe &= !I.mayReadOrWriteMemory();
+      if (!Safe) {
+        reportMissed(L0, L1, "UnsafeInstruction",
+                     Which + " loop contains calls, volatile or atomic "
+                             "accesses",
+                     NumUnsafeInstructions);
+        return false;
+      }
+    }
+
+  if (isa<SCEVCouldNotCompute>(SE.getBackedgeTakenCount(L))) {
+    reportMissed(L0, L1, "UnknownTripCount",
+                 "trip count of the " + Which + " loop cannot be computed",
+                 NumUnknownTripCount);
+    return false;
+  }
+  return true;
+}
+
+bool LoopFuser::canFuse(Loop *L0, Loop *L1) {
+  if (!isCandidate(L0, L1, L0) || !isCandidate(L0, L1, L1))
+    return false;
+
+  BasicBlock *Preheader1 = L1->getLoopPreheader();
+  if (&Preheader1->front() != Preheader1->getTerminator()) {
+    reportMissed(L0, L1, "NonAdjacent", "loops are separated by other code",
+                 NumNonAdjacent);
+    return false;
+  }
+
+  if (!DT.dominates(L0->getHeader(), L1->getHeader()) ||
+      !PDT.dominates(L1->getHeader(), L0->getHeader())) {
+    reportMissed(L0, L1, "NotControlFlowEquivalent",
+                 "loops are not control flow equivalent",
+                 NumNotControlFlowEquivalent);
+    return false;
+  }
+
+  if (SE.getBackedgeTakenCount(L0) != SE.getBackedgeTakenCount(L1)) {
+    reportMissed(L0, L1, "DifferentTripCounts",
+                 "loops have different trip counts", NumDifferentTripCounts);
+    return false;
+  }
+
+  // After fusion, a use of a value of the first loop in the second one would
+  // see the value of the current iteration instead of the final one.
+  for (BasicBlock *BB : L0->blocks())
+    for (Instruction &I : *BB)
+      for (User *U : I.users())
+        if (!L0->contains(cast<Instruction>(U))) {
+          reportMissed(L0, L1, "EscapingValues",
+                       "values computed in the loop are used outside of it",
+                       NumEscapingValues);
+          return false;
+        }
+
+  if (!dependencesAllowFusion(L0, L1)) {
+    reportMissed(L0, L1, "UnsafeDependence",
+                 "a memory dependence between the loops prevents fusion",
+                 NumUnsafeDependences);
+    return false;
+  }
+  return true;
+}
+
+/// Returns true if no location accessed by I1 in some iteration of L1 is
+/// accessed by I0 in a later iteration of L0, so that running the iterations
+/// of both loops in lockstep preserves any dependence between I0 and I1.
+bool LoopFuser::isLockstepSafe(Loop *L0, Loop *L1, Instruction *I0,
+                               Instruction *I1) {
+  Value *Ptr0 = getLoadStorePointerOperand(I0);
+  Value *Ptr1 = getLoadStorePointerOperand(I1);
+  auto *AR0 = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(Ptr0));
+  auto *AR1 = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(Ptr1));
+  if (!AR0 || !AR1 || AR0->getLoop() != L0 || AR1->getLoop() != L1 ||
+      !AR0->isAffine() || !AR1->isAffine())
+    return false;
+
+  const SCEV *Step = AR0->getStepRecurrence(SE);
+  auto *StepC = dyn_cast<SCEVConstant>(Step);
+  auto *DistC = dyn_cast<SCEVConstant>(
+      SE.getMinusSCEV(AR1->getStart(), AR0->getStart()));
+  if (Step != AR1->getStepRecurrence(SE) || !StepC || !DistC)
+    return false;
+
+  // With both accesses advancing by Step per iteration, I0 in iteration i + k
+  // and I1 in iteration i are Dist - Step * k bytes apart. They must not
+  // overlap for any k > 0.
+  int64_t Stride = StepC->getAPInt().getSExtValue();
+  int64_t Dist = DistC->getAPInt().getSExtValue();
+  int64_t Size0 = DL.getTypeStoreSize(
+      cast<PointerType>(Ptr0->getType())->getElementType());
+  int64_t Size1 = DL.getTypeStoreSize(
+      cast<PointerType>(Ptr1->getType())->getElementType());
+  if (Stride > 0)
+    return Dist - Stride <= -Size1;
+  return Dist - Stride >= Size0;
+}
+
+bool LoopFuser::dependencesAllowFusion(Loop *L0, Loop *L1) {
+  SmallVector<Instruction *, 16> Accesses0, Accesses1;
+  for (BasicBlock *BB : L0->blocks())
+    for (Instruction &I : *BB)
+      if (isa<LoadInst>(I) || isa<StoreInst>(I))
+        Accesses0.push_back(&I);
+  for (BasicBlock *BB : L1->blocks())
+    for (Instruction &I : *BB)
+      if (isa<LoadInst>(I) || isa<StoreInst>(I))
+        Accesses1.push_back(&I);
+
+  for (Instruction *I0 : Accesses0)
+    for (Instruction *I1 : Accesses1) {
+      if (!I0->mayWriteToMemory() && !I1->mayWriteToMemory())
+        continue;
+      if (!DI.depends(I0, I1, /*PossiblyLoopIndependent=*/true))
+        continue;
+      if (!isLockstepSafe(L0, L1, I0, I1)) {
+        LLVM_DEBUG(dbgs() << "Unsafe dependence between " << *I0 << " and "
+                          << *I1 << "\n");
+        return false;
+      }
+    }
+  return true;
+}
+
+void LoopFuser::fuse(Loop *L0, Loop *L1) {
+  BasicBlock *Preheader0 = L0->getLoopPreheader();
+  BasicBlock *Header0 = L0->getHeader();
+  BasicBlock *Latch0 = L0->getLoopLatch();
+  BasicBlock *Preheader1 = L1->getLoopPreheader();
+  BasicBlock *Header1 = L1->getHeader();
+  BasicBlock *Latch1 = L1->getLoopLatch();
+  MDNode *LoopID = L0->getLoopID();
+
+  SE.forgetLoop(L0);
+  SE.forgetLoop(L1);
+
+  // The fused loop is entered through the first preheader and its backedge
+  // comes from the second latch. The PHIs of the second header move to the
+  // first one.
+  for (PHINode &PN : Header0->phis())
+    PN.setIncomingBlock(PN.getBasicBlockIndex(Latch0), Latch1);
+  Instruction *InsertPt = Header0->getFirstNonPHI();
+  while (auto *PN = dyn_cast<PHINode>(&Header1->front())) {
+    PN->setIncomingBlock(PN->getBasicBlockIndex(Preheader1), Preheader0);
+    PN->moveBefore(InsertPt);
+  }
+
+  // The first latch falls through into the second header, and the second
+  // latch branches back to the first header. The exit test of the first loop
+  // is redundant with the one of the second loop.
+  auto *Branch0 = cast<BranchInst>(Latch0->getTerminator());
+  Value *Cond0 = Branch0->isConditional() ? Branch0->getCondition() : nullptr;
+  BranchInst::Create(Header1, Branch0);
+  Branch0->eraseFromParent();
+  if (Cond0)
+    RecursivelyDeleteTriviallyDeadInstructions(Cond0);
+  auto *Branch1 = cast<BranchInst>(Latch1->getTerminator());
+  for (unsigned I = 0, E = Branch1->getNumSuccessors(); I != E; ++I)
+    if (Branch1->getSuccessor(I) == Header1)
+      Branch1->setSuccessor(I, Header0);
+
+  // The second preheader is now unreachable.
+  LI.removeBlock(Preheader1);
+  Preheader1->eraseFromParent();
+
+  // Merge the second loop into the first one.
+  for (BasicBlock *BB : L1->blocks()) {
+    L0->addBlockEntry(BB);
+    if (LI.getLoopFor(BB) == L1)
+      LI.changeLoopFor(BB, L0);
+  }
+  while (!L1->empty())
+    L0->addChildLoop(L1->removeChildLoop(std::prev(L1->end())));
+  if (Loop *Parent = L1->getParentLoop())
+    Parent->removeChildLoop(L1);
+  else
+    LI.removeLoop(llvm::find(LI, L1));
+  LI.destroy(L1);
+  if (LoopID)
+    L0->setLoopID(LoopID);
+
+  DT.recalculate(F);
+  PDT.recalculate(F);
+  ++NumFused;
+}
+
+bool LoopFuser::fuseSiblings(ArrayRef<Loop *> Siblings) {
+  // Adjacent loops are chained through the exit block of the first one, which
+  // is the preheader of the second one.
+  DenseMap<BasicBlock *, Loop *> ByPreheader;
+  for (Loop *L : Siblings)
+    if (BasicBlock *Preheader = L->getLoopPreheader())
+      ByPreheader[Preheader] = L;
+
+  SmallPtrSet<Loop *, 8> Fused;
+  bool Changed = false;
+  for (Loop *L0 : Siblings) {
+    if (Fused.count(L0))
+      continue;
+    while (BasicBlock *Exit = L0->getExitBlock()) {
+      Loop *L1 = ByPreheader.lookup(Exit);
+      if (!L1 || Fused.count(L1))
+        break;
+      if (!canFuse(L0, L1))
+        break;
+      ORE.emit([&]() {
+        return OptimizationRemark(DEBUG_TYPE, "Fused", L0->getStartLoc(),
+                                  L0->getHeader())
+               << "loop fused with the following loop";
+      });
+      ByPreheader.erase(Exit);
+      Fused.insert(L1);
+      fuse(L0, L1);
+      Changed = true;
+    }
+  }
+  return Changed;
+}
+
+bool LoopFuser::run() {
+  // Fuse the outermost loops first; fusing two loop nests makes their inner
+  // loops siblings that may in turn be fused.
+  bool Changed = false;
+  SmallVector<SmallVector<Loop *, 8>, 4> Worklist;
+  if (LI.empty())
+    return false;
+  Worklist.emplace_back(LI.begin(), LI.end());
+  while (!Worklist.empty()) {
+    SmallVector<Loop *, 8> Loops = Worklist.pop_back_val();
+    Loop *Parent = Loops.front()->getParentLoop();
+    if (fuseSiblings(Loops)) {
+      Changed = true;
+      // Drop the loops that were fused into their predecessor.
+      Loops.clear();
+      if (Parent)
+        Loops.append(Parent->begin(), Parent->end());
+      else
+        Loops.append(LI.begin(), LI.end());
+    }
+    for (Loop *L : Loops)
+      if (!L->empty())
+        Worklist.emplace_back(L->begin(), L->end());
+  }
+  return Changed;
+}
+
+namespace {
+
+class LoopFuseLegacy : public FunctionPass {
+public:
+  static char ID;
+
+  LoopFuseLegacy() : FunctionPass(ID) {
+    initializeLoopFuseLegacyPass(*PassRegistry::getPassRegistry());
+  }
+
+  bool runOnFunction(Function &F) override {
+    if (skipFunction(F))
+      return false;
+
+    auto &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+    auto &DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+    auto &PDT = getAnalysis<PostDominatorTreeWrapperPass>().getPostDomTree();
+    auto &SE = getAnalysis<ScalarEvolutionWrapperPass>().getSE();
+    auto &DI = getAnalysis<DependenceAnalysisWrapperPass>().getDI();
+    auto &ORE = getAnalysis<OptimizationRemarkEmitterWrapperPass>().getORE();
+    return LoopFuser(F, LI, DT, PDT, SE, DI, ORE).run();
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<ScalarEvolutionWrapperPass>();
+    AU.addRequired<LoopInfoWrapperPass>();
+    AU.addPreserved<LoopInfoWrapperPass>();
+    AU.addRequired<DominatorTreeWrapperPass>();
+    AU.addPreserved<DominatorTreeWrapperPass>();
+    AU.addRequired<PostDominatorTreeWrapperPass>();
+    AU.addPreserved<PostDominatorTreeWrapperPass>();
+    AU.addRequired<DependenceAnalysisWrapperPass>();
+    AU.addRequired<OptimizationRemarkEmitterWrapperPass>();
+    AU.addPreserved<GlobalsAAWrapperPass>();
+  }
+};
+
+} // end anonymous namespace
+
+PreservedAnalyses LoopFusePass::run(Function &F, FunctionAnalysisManager &AM) {
+  auto &LI = AM.getResult<LoopAnalysis>(F);
+  auto &DT = AM.getResult<DominatorTreeAnalysis>(F);
+  auto &PDT = AM.getResult<PostDominatorTreeAnalysis>(F);
+  auto &SE = AM.getResult<ScalarEvolutionAnalysis>(F);
+  auto &DI = AM.getResult<DependenceAnalysis>(F);
+  auto &ORE = AM.getResult<OptimizationRemarkEmitterAnalysis>(F);
+
+  if (!LoopFuser(F, LI, DT, PDT, SE, DI, ORE).run())
+    return PreservedAnalyses::all();
+  PreservedAnalyses PA;
+  PA.preserve<LoopAnalysis>();
+  PA.preserve<DominatorTreeAnalysis>();
+  PA.preserve<PostDominatorTreeAnalysis>();
+  PA.preserve<GlobalsAA>();
+  return PA;
+}
+
+char LoopFuseLegacy::ID = 0;
+
+INITIALIZE_PASS_BEGIN(LoopFuseLegacy, "loop-fusion", "Loop Fusion", false,
+                      false)
+INITIALIZE_PASS_DEPENDENCY(LoopInfoWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(DominatorTreeWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(PostDominatorTreeWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(ScalarEvolutionWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(DependenceAnalysisWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(OptimizationRemarkEmitterWrapperPass)
+INITIALIZE_PASS_END(LoopFuseLegacy, "loop-fusion", "Loop Fusion", false, false)
+
+FunctionPass *llvm::createLoopFusePass() { return new LoopFuseLegacy(); }
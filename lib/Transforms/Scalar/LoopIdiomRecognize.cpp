@@ -22,7 +22,7 @@
 // TODO List:
 //
 // Future loop memory idioms to recognize:
-//   memcmp, memmove, strlen, etc.
+//   memmove, strchr, etc.
 // Future floating point idioms to recognize in -ffast-math mode:
 //   fpowi
 // Future integer operation idioms to recognize:
@@ -47,6 +47,7 @@
 #include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/Loads.h"
 #include "llvm/Analysis/LoopAccessAnalysis.h"
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/LoopPass.h"
@@ -80,6 +81,7 @@
 #include "llvm/IR/Type.h"
 #include "llvm/IR/User.h"
 #include "llvm/IR/Value.h"
+#include "llvm/IR/PatternMatch.h"
 #include "llvm/IR/ValueHandle.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/Casting.h"
@@ -102,6 +104,9 @@ using namespace llvm;
 
 STATISTIC(NumMemSet, "Number of memset's formed from loop stores");
 STATISTIC(NumMemCpy, "Number of memcpy's formed from loop load+stores");
+STATISTIC(NumStrLen, "Number of strlen's and wcslen's formed from loop loads");
+STATISTIC(NumMemChr, "Number of memchr's formed from loop loads");
+STATISTIC(NumBCmp, "Number of bcmp's and memcmp's formed from loop loads");
 
 static cl::opt<bool> UseLIRCodeSizeHeurs(
     "use-lir-code-size-heurs",
@@ -109,6 +114,12 @@ static cl::opt<bool> UseLIRCodeSizeHeurs(
              "with -Os/-Oz"),
     cl::init(true), cl::Hidden);
 
+static cl::opt<bool> EnableLIRScanIdioms(
+    "loop-idiom-scan",
+    cl::desc("Replace loops that scan memory for a terminator, a value or a "
+             "mismatch with calls to strlen, memchr and bcmp"),
+    cl::init(true), cl::Hidden);
+
 namespace {
 
 class LoopIdiomRecognize {
@@ -192,6 +203,21 @@ private:
                                 const DebugLoc &DL, bool ZeroCheck,
                                 bool IsCntPhiUsedOutsideLoop);
 
+  bool recognizeStrLen();
+  bool recognizeMemChr();
+  bool recognizeBCmp();
+  bool isSideEffectFreeLoop() const;
+  bool matchBoundedScanLoop(BasicBlock *&Header, BasicBlock *&Latch,
+                            BasicBlock *&EndBB, const SCEV *&ExitCount);
+  const SCEV *getScanStart(LoadInst *LI);
+  bool isDereferenceableRange(const SCEV *Start, uint64_t Size);
+  bool canRewriteExitValues(BasicBlock *Exiting, BasicBlock *ExitBB,
+                            bool AllowRecurrences);
+  void rewriteExitValues(BasicBlock *Exiting, BasicBlock *ExitBB,
+                         const SCEV *Iter, SCEVExpander &Expander);
+  void setExitCondition(BasicBlock *Exiting, BasicBlock *ExitBB,
+                        Value *TakeExit, IRBuilder<> &Builder);
+
   /// @}
 };
 
@@ -278,7 +304,9 @@ bool LoopIdiomRecognize::runOnLoop(Loop *L) {
 
   // Disable loop idiom recognition if the function's name is a common idiom.
   StringRef Name = L->getHeader()->getParent()->getName();
-  if (Name == "memset" || Name == "memcpy")
+  if (Name == "memset" || Name == "memcpy" || Name == "strlen" ||
+      Name == "wcslen" || Name == "memchr" || Name == "bcmp" ||
+      Name == "memcmp")
     return false;
 
   // Determine if code size heuristics need to be applied.
@@ -1099,7 +1127,11 @@ bool LoopIdiomRecognize::avoidLIRForMultiBlockLoop(bool IsMemset,
 }
 
 bool LoopIdiomRecognize::runOnNoncountableLoop() {
-  return recognizePopcount() || recognizeAndInsertCTLZ();
+  if (recognizePopcount() || recognizeAndInsertCTLZ())
+    return true;
+  if (!EnableLIRScanIdioms)
+    return false;
+  return recognizeStrLen() || recognizeMemChr() || recognizeBCmp();
 }
 
 /// Check if the given conditional branch is based on the comparison between
@@ -1747,3 +1779,415 @@ void LoopIdiomRecognize::transformLoopToPopcount(BasicBlock *PreCondBB,
   //   loop. The loop would otherwise not be deleted even if it becomes empty.
   SE->forgetLoop(CurLoop);
 }
+
+//===----------------------------------------------------------------------===//
+//
+//          Scan loop idioms: strlen, memchr and bcmp
+//
+//===----------------------------------------------------------------------===//
+//
+// The loops below read memory until they find a terminator, a given value or
+// a mismatch. They are replaced by a library call in the preheader, whose
+// result gives the iteration in which the loop exits. The values that leave
+// the loop are rewritten as their value in that iteration, and the exit
+// conditions are replaced so that the loop is left in its first iteration.
+// The loop is then trivially dead, and its backedge is removed by later
+// passes.
+
+/// Matches the branch terminating \p BB in the current loop against a branch
+/// on 'icmp eq' or 'icmp ne' that leaves the loop when the operands of the
+/// compare are equal (if \p ExitOnEqual) or different (otherwise).
+static bool matchScanExit(Loop *L, BasicBlock *BB, bool ExitOnEqual,
+                          Value *&LHS, Value *&RHS, BasicBlock *&ExitBB) {
+  using namespace PatternMatch;
+
+  ICmpInst::Predicate Pred;
+  BasicBlock *TrueBB, *FalseBB;
+  if (!match(BB->getTerminator(),
+             m_Br(m_ICmp(Pred, m_Value(LHS), m_Value(RHS)), TrueBB, FalseBB)))
+    return false;
+  if (Pred != ICmpInst::ICMP_EQ && Pred != ICmpInst::ICMP_NE)
+    return false;
+  if (L->contains(TrueBB) == L->contains(FalseBB))
+    return false;
+
+  ExitBB = L->contains(TrueBB) ? FalseBB : TrueBB;
+  bool ExitsOnTrue = ExitBB == TrueBB;
+  return ExitsOnTrue == (Pred == (ExitOnEqual ? ICmpInst::ICMP_EQ
+                                              : ICmpInst::ICMP_NE));
+}
+
+/// \returns true if the loop only computes values, so that it can be left in
+/// its first iteration once the values leaving it are computed outside of it.
+bool LoopIdiomRecognize::isSideEffectFreeLoop() const {
+  if (CurLoop->getNumBackEdges() != 1)
+    return false;
+  for (BasicBlock *BB : CurLoop->blocks())
+    for (Instruction &I : *BB) {
+      if (I.mayHaveSideEffects())
+        return false;
+      if (isa<CallInst>(I) && !isa<DbgInfoIntrinsic>(I))
+        return false;
+      if (auto *LI = dyn_cast<LoadInst>(&I))
+        if (!LI->isSimple())
+          return false;
+    }
+  return true;
+}
+
+/// Matches a two-block loop whose header may leave it early, and whose latch
+/// leaves it after a computable number of iterations:
+///
+///   header:
+///     ...
+///     br i1 %early, label %exit.early, label %latch
+///   latch:
+///     ...
+///     br i1 %done, label %exit.end, label %header
+bool LoopIdiomRecognize::matchBoundedScanLoop(BasicBlock *&Header,
+                                              BasicBlock *&Latch,
+                                              BasicBlock *&EndBB,
+                                              const SCEV *&ExitCount) {
+  if (CurLoop->getNumBlocks() != 2 || !isSideEffectFreeLoop())
+    return false;
+
+  Header = CurLoop->getHeader();
+  Latch = CurLoop->getLoopLatch();
+  if (!Latch || Latch == Header)
+    return false;
+
+  auto *LatchBI = dyn_cast<BranchInst>(Latch->getTerminator());
+  if (!LatchBI || !LatchBI->isConditional())
+    return false;
+  EndBB = LatchBI->getSuccessor(0) == Header ? LatchBI->getSuccessor(1)
+                                             : LatchBI->getSuccessor(0);
+  if (CurLoop->contains(EndBB))
+    return false;
+
+  ExitCount = SE->getExitCount(CurLoop, Latch);
+  return !isa<SCEVCouldNotCompute>(ExitCount);
+}
+
+/// \returns the start of the pointer operand of \p LI if it is an affine
+/// recurrence of the current loop that advances by the size of the loaded
+/// value, or null otherwise. The library functions only take pointers to the
+/// default address space.
+const SCEV *LoopIdiomRecognize::getScanStart(LoadInst *LI) {
+  if (!LI->isSimple() || LI->getParent() != CurLoop->getHeader() ||
+      LI->getPointerAddressSpace() != 0)
+    return nullptr;
+
+  auto *Ev = dyn_cast<SCEVAddRecExpr>(SE->getSCEV(LI->getPointerOperand()));
+  if (!Ev || Ev->getLoop() != CurLoop || !Ev->isAffine())
+    return nullptr;
+
+  auto *Stride = dyn_cast<SCEVConstant>(Ev->getOperand(1));
+  uint64_t Size = DL->getTypeStoreSize(LI->getType());
+  if (!Stride || Stride->getAPInt() != Size ||
+      DL->getTypeSizeInBits(LI->getType()) != Size * 8)
+    return nullptr;
+
+  return Ev->getStart();
+}
+
+/// \returns true if the \p Size bytes starting at \p Start, a pointer or a
+/// pointer plus a constant offset, are known to be dereferenceable in the
+/// preheader of the current loop.
+bool LoopIdiomRecognize::isDereferenceableRange(const SCEV *Start,
+                                                uint64_t Size) {
+  uint64_t Offset = 0;
+  if (auto *Add = dyn_cast<SCEVAddExpr>(Start)) {
+    auto *C = dyn_cast<SCEVConstant>(Add->getOperand(0));
+    if (Add->getNumOperands() != 2 || !C || C->getAPInt().isNegative())
+      return false;
+    Offset = C->getAPInt().getLimitedValue();
+    Start = Add->getOperand(1);
+  }
+  auto *Base = dyn_cast<SCEVUnknown>(Start);
+  if (!Base || Offset + Size < Size)
+    return false;
+
+  Value *Ptr = Base->getValue();
+  APInt Bytes(DL->getIndexTypeSizeInBits(Ptr->getType()), Offset + Size);
+  return isDereferenceableAndAlignedPointer(
+      Ptr, 1, Bytes, *DL, CurLoop->getLoopPreheader()->getTerminator(), DT);
+}
+
+/// \returns true if all the values leaving the loop through the edge from
+/// \p Exiting to \p ExitBB are loop invariant, or (if \p AllowRecurrences)
+/// affine recurrences of the loop, whose value in any iteration is known.
+bool LoopIdiomRecognize::canRewriteExitValues(BasicBlock *Exiting,
+                                              BasicBlock *ExitBB,
+                                              bool AllowRecurrences) {
+  for (PHINode &PN : ExitBB->phis()) {
+    auto *I = dyn_cast<Instruction>(PN.getIncomingValueForBlock(Exiting));
+    if (!I || !CurLoop->contains(I))
+      continue;
+    if (!AllowRecurrences || !SE->isSCEVable(I->getType()))
+      return false;
+    auto *Ev = dyn_cast<SCEVAddRecExpr>(SE->getSCEV(I));
+    if (!Ev || Ev->getLoop() != CurLoop || !Ev->isAffine() ||
+        !isSafeToExpand(Ev->getStart(), *SE) ||
+        !isSafeToExpand(Ev->getStepRecurrence(*SE), *SE))
+      return false;
+  }
+  return true;
+}
+
+/// Rewrites the values leaving the loop through the edge from \p Exiting to
+/// \p ExitBB as their value in the iteration \p Iter, computed in the
+/// preheader.
+void LoopIdiomRecognize::rewriteExitValues(BasicBlock *Exiting,
+                                           BasicBlock *ExitBB,
+                                           const SCEV *Iter,
+                                           SCEVExpander &Expander) {
+  Instruction *InsertPt = CurLoop->getLoopPreheader()->getTerminator();
+  for (PHINode &PN : ExitBB->phis()) {
+    int Idx = PN.getBasicBlockIndex(Exiting);
+    auto *I = dyn_cast<Instruction>(PN.getIncomingValue(Idx));
+    if (!I || !CurLoop->contains(I))
+      continue;
+    auto *Ev = cast<SCEVAddRecExpr>(SE->getSCEV(I));
+    const SCEV *ExitValue = Ev->evaluateAtIteration(Iter, *SE);
+    PN.setIncomingValue(Idx,
+                        Expander.expandCodeFor(ExitValue, I->getType(),
+                                               InsertPt));
+  }
+}
+
+/// Replaces the condition of the branch terminating \p Exiting, so that it
+/// leaves the loop to \p ExitBB exactly when the loop invariant \p TakeExit
+/// is true.
+void LoopIdiomRecognize::setExitCondition(BasicBlock *Exiting,
+                                          BasicBlock *ExitBB, Value *TakeExit,
+                                          IRBuilder<> &Builder) {
+  auto *BI = cast<BranchInst>(Exiting->getTerminator());
+  Value *OldCond = BI->getCondition();
+  if (BI->getSuccessor(0) != ExitBB)
+    TakeExit = Builder.CreateNot(TakeExit);
+  BI->setCondition(TakeExit);
+  RecursivelyDeleteTriviallyDeadInstructions(OldCond, TLI);
+}
+
+/// Recognizes a loop that looks for the terminating zero of a string:
+///
+///   loop:
+///     %p = phi i8* [ %start, %preheader ], [ %p.next, %loop ]
+///     %c = load i8, i8* %p
+///     %p.next = getelementptr i8, i8* %p, i64 1
+///     %cmp = icmp eq i8 %c, 0
+///     br i1 %cmp, label %exit, label %loop
+///
+/// and replaces it with strlen, or wcslen for strings of wchar_t.
+bool LoopIdiomRecognize::recognizeStrLen() {
+  if (CurLoop->getNumBlocks() != 1 || !isSideEffectFreeLoop())
+    return false;
+
+  using namespace PatternMatch;
+
+  BasicBlock *Body = CurLoop->getHeader();
+  Value *Char, *Zero;
+  BasicBlock *ExitBB;
+  if (!matchScanExit(CurLoop, Body, /*ExitOnEqual=*/true, Char, Zero, ExitBB) ||
+      !match(Zero, m_Zero()))
+    return false;
+
+  auto *Load = dyn_cast<LoadInst>(Char);
+  if (!Load || !Load->getType()->isIntegerTy())
+    return false;
+  const SCEV *Start = getScanStart(Load);
+  if (!Start || !isSafeToExpand(Start, *SE))
+    return false;
+
+  // Strings of wide characters are measured by wcslen if their element is the
+  // wchar_t of the module.
+  bool IsWide = !Load->getType()->isIntegerTy(8);
+  if (IsWide) {
+    Module *M = Body->getModule();
+    auto *WCharSize = mdconst::extract_or_null<ConstantInt>(
+        M->getModuleFlag("wchar_size"));
+    if (!WCharSize || !TLI->has(LibFunc_wcslen) ||
+        DL->getTypeStoreSize(Load->getType()) != WCharSize->getZExtValue())
+      return false;
+  } else if (!TLI->has(LibFunc_strlen)) {
+    return false;
+  }
+
+  if (!canRewriteExitValues(Body, ExitBB, /*AllowRecurrences=*/true))
+    return false;
+
+  LLVM_DEBUG(dbgs() << "loop-idiom: Replacing loop %" << Body->getName()
+                    << " with " << (IsWide ? "wcslen" : "strlen") << "\n");
+
+  BasicBlock *Preheader = CurLoop->getLoopPreheader();
+  SCEVExpander Expander(*SE, *DL, "loop-idiom");
+  IRBuilder<> Builder(Preheader->getTerminator());
+  Value *StartPtr = Expander.expandCodeFor(
+      Start, Load->getPointerOperandType(), Preheader->getTerminator());
+  Value *Len = IsWide ? emitWcsLen(StartPtr, Builder, *DL, TLI)
+                      : emitStrLen(StartPtr, Builder, *DL, TLI);
+
+  rewriteExitValues(Body, ExitBB, SE->getSCEV(Len), Expander);
+  setExitCondition(Body, ExitBB, Builder.getTrue(), Builder);
+  SE->forgetLoop(CurLoop);
+  ++NumStrLen;
+  return true;
+}
+
+/// Recognizes a loop that looks for a byte in a bounded range:
+///
+///   header:
+///     %p = phi i8* [ %start, %preheader ], [ %p.next, %latch ]
+///     %c = load i8, i8* %p
+///     %found = icmp eq i8 %c, %ch
+///     br i1 %found, label %exit.found, label %latch
+///   latch:
+///     %p.next = getelementptr i8, i8* %p, i64 1
+///     %done = icmp eq i8* %p.next, %end
+///     br i1 %done, label %exit.end, label %header
+///
+/// and replaces it with memchr.
+bool LoopIdiomRecognize::recognizeMemChr() {
+  BasicBlock *Header, *Latch, *EndBB, *FoundBB;
+  const SCEV *ExitCount;
+  if (!matchBoundedScanLoop(Header, Latch, EndBB, ExitCount))
+    return false;
+
+  Value *LHS, *RHS;
+  if (!matchScanExit(CurLoop, Header, /*ExitOnEqual=*/true, LHS, RHS,
+                     FoundBB))
+    return false;
+  if (!isa<LoadInst>(LHS))
+    std::swap(LHS, RHS);
+  auto *Load = dyn_cast<LoadInst>(LHS);
+  Value *Ch = RHS;
+  if (!Load || !Load->getType()->isIntegerTy(8) ||
+      !CurLoop->isLoopInvariant(Ch))
+    return false;
+
+  const SCEV *Start = getScanStart(Load);
+  if (!Start || !isSafeToExpand(Start, *SE) ||
+      !isSafeToExpand(ExitCount, *SE) || !TLI->has(LibFunc_memchr))
+    return false;
+
+  if (!canRewriteExitValues(Header, FoundBB, /*AllowRecurrences=*/true) ||
+      !canRewriteExitValues(Latch, EndBB, /*AllowRecurrences=*/true))
+    return false;
+
+  LLVM_DEBUG(dbgs() << "loop-idiom: Replacing loop %" << Header->getName()
+                    << " with memchr\n");
+
+  BasicBlock *Preheader = CurLoop->getLoopPreheader();
+  SCEVExpander Expander(*SE, *DL, "loop-idiom");
+  IRBuilder<> Builder(Preheader->getTerminator());
+  Type *IntPtrTy = DL->getIntPtrType(Header->getContext());
+  Value *StartPtr = Expander.expandCodeFor(
+      Start, Load->getPointerOperandType(), Preheader->getTerminator());
+  const SCEV *NumBytesS =
+      SE->getAddExpr(SE->getTruncateOrZeroExtend(ExitCount, IntPtrTy),
+                     SE->getOne(IntPtrTy));
+  Value *NumBytes =
+      Expander.expandCodeFor(NumBytesS, IntPtrTy, Preheader->getTerminator());
+  Value *Ptr = emitMemChr(StartPtr, Builder.CreateZExt(Ch, Builder.getInt32Ty()),
+                          NumBytes, Builder, *DL, TLI);
+
+  // The byte is found in the iteration that reads its offset from the start.
+  Value *FoundIter = Builder.CreateSub(Builder.CreatePtrToInt(Ptr, IntPtrTy),
+                                       Builder.CreatePtrToInt(StartPtr, IntPtrTy),
+                                       "memchr.idx");
+  Value *Found = Builder.CreateICmpNE(
+      Ptr, Constant::getNullValue(Ptr->getType()), "memchr.found");
+
+  rewriteExitValues(Header, FoundBB, SE->getSCEV(FoundIter), Expander);
+  rewriteExitValues(Latch, EndBB, ExitCount, Expander);
+  setExitCondition(Header, FoundBB, Found, Builder);
+  setExitCondition(Latch, EndBB, Builder.getTrue(), Builder);
+  SE->forgetLoop(CurLoop);
+  ++NumMemChr;
+  return true;
+}
+
+/// Recognizes a loop that compares two ranges of integers for equality:
+///
+///   header:
+///     %i = phi i64 [ 0, %preheader ], [ %i.next, %latch ]
+///     %a = load i32, i32* %pa
+///     %b = load i32, i32* %pb
+///     %ne = icmp ne i32 %a, %b
+///     br i1 %ne, label %exit.mismatch, label %latch
+///   latch:
+///     %i.next = add i64 %i, 1
+///     %done = icmp eq i64 %i.next, %n
+///     br i1 %done, label %exit.equal, label %header
+///
+/// and replaces it with bcmp, or memcmp if bcmp is not available. The
+/// position of the mismatch is not known, so no value may leave the loop
+/// through the early exit. Unlike the loop, bcmp may read both ranges in full
+/// even if they differ early, so the trip count must be a constant for which
+/// both ranges are known to be dereferenceable.
+bool LoopIdiomRecognize::recognizeBCmp() {
+  BasicBlock *Header, *Latch, *EndBB, *MismatchBB;
+  const SCEV *ExitCount;
+  if (!matchBoundedScanLoop(Header, Latch, EndBB, ExitCount))
+    return false;
+
+  Value *LHS, *RHS;
+  if (!matchScanExit(CurLoop, Header, /*ExitOnEqual=*/false, LHS, RHS,
+                     MismatchBB))
+    return false;
+  auto *LoadA = dyn_cast<LoadInst>(LHS);
+  auto *LoadB = dyn_cast<LoadInst>(RHS);
+  if (!LoadA || !LoadB || !LoadA->getType()->isIntegerTy())
+    return false;
+
+  const SCEV *StartA = getScanStart(LoadA);
+  const SCEV *StartB = getScanStart(LoadB);
+  if (!StartA || !StartB || !isSafeToExpand(StartA, *SE) ||
+      !isSafeToExpand(StartB, *SE))
+    return false;
+
+  auto *ConstExitCount = dyn_cast<SCEVConstant>(ExitCount);
+  if (!ConstExitCount || ConstExitCount->getAPInt().getActiveBits() > 32)
+    return false;
+  uint64_t Size = (ConstExitCount->getAPInt().getZExtValue() + 1) *
+                  DL->getTypeStoreSize(LoadA->getType());
+  if (!isDereferenceableRange(StartA, Size) ||
+      !isDereferenceableRange(StartB, Size))
+    return false;
+  if (!TLI->has(LibFunc_bcmp) && !TLI->has(LibFunc_memcmp))
+    return false;
+
+  if (!canRewriteExitValues(Header, MismatchBB, /*AllowRecurrences=*/false) ||
+      !canRewriteExitValues(Latch, EndBB, /*AllowRecurrences=*/true))
+    return false;
+
+  LLVM_DEBUG(dbgs() << "loop-idiom: Replacing loop %" << Header->getName()
+                    << " with bcmp\n");
+
+  BasicBlock *Preheader = CurLoop->getLoopPreheader();
+  SCEVExpander Expander(*SE, *DL, "loop-idiom");
+  IRBuilder<> Builder(Preheader->getTerminator());
+  Type *IntPtrTy = DL->getIntPtrType(Header->getContext());
+  Value *PtrA = Expander.expandCodeFor(StartA, LoadA->getPointerOperandType(),
+                                       Preheader->getTerminator());
+  Value *PtrB = Expander.expandCodeFor(StartB, LoadB->getPointerOperandType(),
+                                       Preheader->getTerminator());
+  const SCEV *NumBytesS = SE->getMulExpr(
+      SE->getAddExpr(SE->getTruncateOrZeroExtend(ExitCount, IntPtrTy),
+                     SE->getOne(IntPtrTy)),
+      SE->getConstant(IntPtrTy, DL->getTypeStoreSize(LoadA->getType())));
+  Value *NumBytes =
+      Expander.expandCodeFor(NumBytesS, IntPtrTy, Preheader->getTerminator());
+  Value *Cmp = TLI->has(LibFunc_bcmp)
+                   ? emitBCmp(PtrA, PtrB, NumBytes, Builder, *DL, TLI)
+                   : emitMemCmp(PtrA, PtrB, NumBytes, Builder, *DL, TLI);
+  Value *Mismatch = Builder.CreateICmpNE(
+      Cmp, Constant::getNullValue(Cmp->getType()), "bcmp.mismatch");
+
+  rewriteExitValues(Latch, EndBB, ExitCount, Expander);
+  setExitCondition(Header, MismatchBB, Mismatch, Builder);
+  setExitCondition(Latch, EndBB, Builder.getTrue(), Builder);
+  SE->forgetLoop(CurLoop);
+  ++NumBCmp;
+  return true;
+}
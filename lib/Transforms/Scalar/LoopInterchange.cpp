@@ -110,6 +110,7 @@ static bool populateDependencyMatrix(CharMatrix &DepMatrix, unsigned Level,
   LLVM_DEBUG(dbgs() << "Found " << MemInstr.size()
                     << " Loads and Stores to analyze\n");
 
+  LoopDependenceGraph DG(*DI, *L);
   ValueVector::iterator I, IE, J, JE;
 
   for (I = MemInstr.begin(), IE = MemInstr.end(); I != IE; ++I) {
@@ -119,11 +120,9 @@ static bool populateDependencyMatrix(CharMatrix &DepMatrix, unsigned Level,
       Instruction *Dst = cast<Instruction>(*J);
       if (Src == Dst)
         continue;
-      // Ignore Input dependencies.
-      if (isa<LoadInst>(Src) && isa<LoadInst>(Dst))
-        continue;
-      // Track Output, Flow, and Anti dependencies.
-      if (auto D = DI->depends(Src, Dst, true)) {
+      // Track Output, Flow, and Anti dependencies. Input dependencies and
+      // accesses to distinct objects are filtered out by the graph.
+      if (auto D = DG.depends(Src, Dst)) {
         assert(D->isOrdered() && "Expected an output, flow or anti dep.");
         LLVM_DEBUG(StringRef DepType =
                        D->isFlow() ? "flow" : D->isAnti() ? "anti" : "output";
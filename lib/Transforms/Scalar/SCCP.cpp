@@ -35,6 +35,7 @@
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/CallSite.h"
 #include "llvm/IR/Constant.h"
+#include "llvm/IR/ConstantRange.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/DerivedTypes.h"
@@ -51,6 +52,7 @@
 #include "llvm/IR/Value.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
@@ -70,6 +72,13 @@ STATISTIC(IPNumInstRemoved, "Number of instructions removed by IPSCCP");
 STATISTIC(IPNumArgsElimed ,"Number of arguments constant propagated by IPSCCP");
 STATISTIC(IPNumGlobalConst, "Number of globals found to be constant by IPSCCP");
 
+// Ranges can keep growing when they flow around recursive calls, so a range
+// that is extended too many times by a non-constant range gives up.
+static cl::opt<unsigned> MaxRangeExtensions(
+    "sccp-max-range-extensions", cl::init(8), cl::Hidden,
+    cl::desc("Maximum number of times the constant range of a value is "
+             "extended before the value is considered overdefined"));
+
 namespace {
 
 /// LatticeVal class - This class represents the different lattice values that
@@ -193,9 +202,14 @@ class SCCPSolver : public InstVisitor<SCCPSolver> {
   const TargetLibraryInfo *TLI;
   SmallPtrSet<BasicBlock *, 8> BBExecutable; // The BBs that are executable.
   DenseMap<Value *, LatticeVal> ValueState;  // The state each value is in.
-  // The state each parameter is in.
+  // The state each parameter is in, and the constant range of integer values
+  // that are overdefined in ValueState.
   DenseMap<Value *, ValueLatticeElement> ParamState;
 
+  /// RangeExtensions - The number of times the range of a value in ParamState
+  /// or TrackedRetRanges was extended by a non-constant range.
+  DenseMap<Value *, unsigned> RangeExtensions;
+
   /// StructValueState - This maintains ValueState for values that have
   /// StructType, for example for formal arguments, calls, insertelement, etc.
   DenseMap<std::pair<Value *, unsigned>, LatticeVal> StructValueState;
@@ -211,6 +225,10 @@ class SCCPSolver : public InstVisitor<SCCPSolver> {
   /// what the known return value for the function is.
   DenseMap<Function *, LatticeVal> TrackedRetVals;
 
+  /// TrackedRetRanges - The constant range of the return value of the tracked
+  /// functions returning an integer, for when TrackedRetVals is overdefined.
+  DenseMap<Function *, ValueLatticeElement> TrackedRetRanges;
+
   /// TrackedMultipleRetVals - Same as TrackedRetVals, but used for functions
   /// that return multiple values.
   DenseMap<std::pair<Function *, unsigned>, LatticeVal> TrackedMultipleRetVals;
@@ -496,6 +514,50 @@ private:
     return LV;
   }
 
+  /// getRangeState - Return the state of V in the range lattice.  Values that
+  /// are overdefined in ValueState may still have a known constant range.
+  ValueLatticeElement getRangeState(Value *V) {
+    const LatticeVal &LV = getValueState(V);
+    if (!LV.isOverdefined())
+      return LV.toValueLattice();
+    auto I = ParamState.find(V);
+    if (I == ParamState.end())
+      return ValueLatticeElement::getOverdefined();
+    return I->second;
+  }
+
+  /// mergeInRange - Merge MergeWithV into Range, the range state of V, and
+  /// return true if it changed.
+  bool mergeInRange(ValueLatticeElement &Range, Value *V,
+                    const ValueLatticeElement &MergeWithV) {
+    bool Extends = Range.isConstantRange() && MergeWithV.isConstantRange() &&
+                   !MergeWithV.getConstantRange().isSingleElement();
+    if (!Range.mergeIn(MergeWithV, DL))
+      return false;
+    if (Extends && ++RangeExtensions[V] > MaxRangeExtensions)
+      Range = ValueLatticeElement::getOverdefined();
+    return true;
+  }
+
+  /// getRangeOf - Compute the constant range of the integer binary operator
+  /// or cast I from the ranges of its operands.
+  ValueLatticeElement getRangeOf(Instruction &I);
+
+  /// markOverdefinedWithRange - Mark the integer instruction I overdefined,
+  /// keeping track of the constant range its value falls in.  Users are
+  /// revisited whenever that range changes.
+  void markOverdefinedWithRange(Instruction &I) {
+    ValueLatticeElement Range = getRangeOf(I);
+    bool RangeChanged = false;
+    if (Range.isConstantRange() ||
+        (Range.isOverdefined() && ParamState.count(&I)))
+      RangeChanged = mergeInRange(ParamState[&I], &I, Range);
+
+    LatticeVal &IV = ValueState[&I];
+    if (!markOverdefined(IV, &I) && RangeChanged)
+      pushToWorkList(IV, &I);
+  }
+
   /// getStructValueState - Return the LatticeVal object that corresponds to the
   /// value/field pair.  This function handles the case when the value hasn't
   /// been seen yet by properly seeding constants etc.
@@ -788,6 +850,10 @@ void SCCPSolver::visitReturnInst(ReturnInst &I) {
       TrackedRetVals.find(F);
     if (TFRVI != TrackedRetVals.end()) {
       mergeInValue(TFRVI->second, F, getValueState(ResultOp));
+      // Callers use the range of the return value once it is overdefined.
+      if (ResultOp->getType()->isIntegerTy() &&
+          mergeInRange(TrackedRetRanges[F], F, getRangeState(ResultOp)))
+        pushToWorkList(TFRVI->second, F);
       return;
     }
   }
@@ -816,9 +882,12 @@ void SCCPSolver::visitTerminatorInst(TerminatorInst &TI) {
 
 void SCCPSolver::visitCastInst(CastInst &I) {
   LatticeVal OpSt = getValueState(I.getOperand(0));
-  if (OpSt.isOverdefined())          // Inherit overdefinedness of operand
-    markOverdefined(&I);
-  else if (OpSt.isConstant()) {
+  if (OpSt.isOverdefined()) {        // Inherit overdefinedness of operand
+    if (I.getType()->isIntegerTy())
+      markOverdefinedWithRange(I);
+    else
+      markOverdefined(&I);
+  } else if (OpSt.isConstant()) {
     // Fold the constant as we build.
     Constant *C = ConstantFoldCastOperand(I.getOpcode(), OpSt.getConstant(),
                                           I.getType(), DL);
@@ -923,7 +992,12 @@ void SCCPSolver::visitBinaryOperator(Instruction &I) {
   LatticeVal V2State = getValueState(I.getOperand(1));
 
   LatticeVal &IV = ValueState[&I];
-  if (IV.isOverdefined()) return;
+  if (IV.isOverdefined()) {
+    // The constant range of the result may still change.
+    if (I.getType()->isIntegerTy())
+      markOverdefinedWithRange(I);
+    return;
+  }
 
   if (V1State.isConstant() && V2State.isConstant()) {
     Constant *C = ConstantExpr::get(I.getOpcode(), V1State.getConstant(),
@@ -977,28 +1051,53 @@ void SCCPSolver::visitBinaryOperator(Instruction &I) {
     }
   }
 
+  if (I.getType()->isIntegerTy())
+    return markOverdefinedWithRange(I);
   markOverdefined(&I);
 }
 
-// Handle ICmpInst instruction.
-void SCCPSolver::visitCmpInst(CmpInst &I) {
-  LatticeVal &IV = ValueState[&I];
-  if (IV.isOverdefined()) return;
+/// Return the constant range of the integer value V in state LV.
+static ConstantRange getConstantRange(const ValueLatticeElement &LV, Value *V) {
+  if (LV.isConstantRange())
+    return LV.getConstantRange();
+  return ConstantRange(V->getType()->getIntegerBitWidth(), /*isFullSet=*/true);
+}
 
+ValueLatticeElement SCCPSolver::getRangeOf(Instruction &I) {
+  unsigned BitWidth = I.getType()->getIntegerBitWidth();
   Value *Op1 = I.getOperand(0);
-  Value *Op2 = I.getOperand(1);
+  if (!Op1->getType()->isIntegerTy())
+    return ValueLatticeElement::getOverdefined();
+  ValueLatticeElement V1State = getRangeState(Op1);
+  if (V1State.isUndefined())
+    return V1State;
+
+  ConstantRange Range(BitWidth, /*isFullSet=*/true);
+  if (auto *CI = dyn_cast<CastInst>(&I)) {
+    Range = getConstantRange(V1State, Op1).castOp(CI->getOpcode(), BitWidth);
+  } else {
+    Value *Op2 = I.getOperand(1);
+    ValueLatticeElement V2State = getRangeState(Op2);
+    if (V2State.isUndefined())
+      return V2State;
+    Range = getConstantRange(V1State, Op1).binaryOp(
+        cast<BinaryOperator>(I).getOpcode(), getConstantRange(V2State, Op2));
+  }
 
-  // For parameters, use ParamState which includes constant range info if
-  // available.
-  auto V1Param = ParamState.find(Op1);
-  ValueLatticeElement V1State = (V1Param != ParamState.end())
-                                    ? V1Param->second
-                                    : getValueState(Op1).toValueLattice();
+  if (Range.isFullSet())
+    return ValueLatticeElement::getOverdefined();
+  return ValueLatticeElement::getRange(std::move(Range));
+}
+
+// Handle ICmpInst instruction.
+void SCCPSolver::visitCmpInst(CmpInst &I) {
+  if (ValueState[&I].isOverdefined()) return;
 
-  auto V2Param = ParamState.find(Op2);
-  ValueLatticeElement V2State = V2Param != ParamState.end()
-                                    ? V2Param->second
-                                    : getValueState(Op2).toValueLattice();
+  // Use the constant ranges of overdefined operands, which come from call
+  // sites of parameters, from return values and from integer arithmetic.
+  ValueLatticeElement V1State = getRangeState(I.getOperand(0));
+  ValueLatticeElement V2State = getRangeState(I.getOperand(1));
+  LatticeVal &IV = ValueState[&I];
 
   Constant *C = V1State.getCompare(I.getPredicate(), I.getType(), V2State);
   if (C) {
@@ -1188,8 +1287,8 @@ CallOverdefined:
         // lattice, so we propagate changes for parameters to both lattices.
         LatticeVal ConcreteArgument = getValueState(*CAI);
         bool ParamChanged =
-            getParamState(&*AI).mergeIn(ConcreteArgument.toValueLattice(), DL);
-         bool ValueChanged = mergeInValue(&*AI, ConcreteArgument);
+            mergeInRange(getParamState(&*AI), &*AI, getRangeState(*CAI));
+        bool ValueChanged = mergeInValue(&*AI, ConcreteArgument);
         // Add argument to work list, if the state of a parameter changes but
         // ValueState does not change (because it is already overdefined there),
         // We have to take changes in ParamState into account, as it is used
@@ -1217,6 +1316,14 @@ CallOverdefined:
 
     // If so, propagate the return value of the callee into this call result.
     mergeInValue(I, TFRVI->second);
+
+    // Once the return value is overdefined, propagate its range instead.
+    if (TFRVI->second.isOverdefined() && I->getType()->isIntegerTy()) {
+      auto RI = TrackedRetRanges.find(F);
+      if (RI != TrackedRetRanges.end() && !RI->second.isUndefined() &&
+          mergeInRange(ParamState[I], I, RI->second))
+        pushToWorkList(ValueState[I], I);
+    }
   }
 }
 
@@ -41,6 +41,7 @@
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/GenericDomTree.h"
+#include "llvm/Support/MathExtras.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/Scalar/SimpleLoopUnswitch.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
@@ -60,6 +61,9 @@ using namespace llvm;
 STATISTIC(NumBranches, "Number of branches unswitched");
 STATISTIC(NumSwitches, "Number of switches unswitched");
 STATISTIC(NumTrivial, "Number of unswitches that are trivial");
+STATISTIC(
+    NumCostMultiplierSkipped,
+    "Number of unswitch candidates that had their cost multiplier skipped");
 
 static cl::opt<bool> EnableNonTrivialUnswitch(
     "enable-nontrivial-unswitch", cl::init(false), cl::Hidden,
@@ -70,6 +74,18 @@ static cl::opt<int>
     UnswitchThreshold("unswitch-threshold", cl::init(50), cl::Hidden,
                       cl::desc("The cost threshold for unswitching a loop."));
 
+static cl::opt<bool> EnableUnswitchCostMultiplier(
+    "enable-unswitch-cost-multiplier", cl::init(true), cl::Hidden,
+    cl::desc("Enable unswitch cost multiplier that prohibits exponential "
+             "explosion in nontrivial unswitch."));
+static cl::opt<int> UnswitchSiblingsToplevelDiv(
+    "unswitch-siblings-toplevel-div", cl::init(2), cl::Hidden,
+    cl::desc("Toplevel siblings divisor for cost multiplier."));
+static cl::opt<int> UnswitchNumInitialUnscaledCandidates(
+    "unswitch-num-initial-unscaled-candidates", cl::init(8), cl::Hidden,
+    cl::desc("Number of unswitch candidates that are ignored when calculating "
+             "cost multiplier."));
+
 /// Collect all of the loop invariant input values transitively used by the
 /// homogeneous instruction graph from a given root.
 ///
@@ -2171,6 +2187,68 @@ computeDomSubtreeCost(DomTreeNode &N,
   return Cost;
 }
 
+/// Compute the multiplier applied to the cost of unswitching \p TI.
+///
+/// Each non-trivial unswitch clones the loop and both copies are unswitched
+/// again on the remaining candidates, so without a budget the code size grows
+/// exponentially with the number of candidates. The multiplier grows with the
+/// number of sibling loops, which is how the clones made so far show up, and
+/// exponentially with the number of clones unswitching all of the candidates
+/// of \p L would create beyond an initial allowance.
+static int calculateUnswitchCostMultiplier(
+    TerminatorInst &TI, Loop &L, LoopInfo &LI, DominatorTree &DT,
+    ArrayRef<std::pair<TerminatorInst *, TinyPtrVector<Value *>>>
+        UnswitchCandidates) {
+  if (!EnableUnswitchCostMultiplier)
+    return 1;
+
+  // A condition that exits the loop on all but one of its successors and
+  // dominates the latch does not leave another copy of the loop behind to
+  // unswitch again, so it cannot contribute to an exponential explosion.
+  BasicBlock *Latch = L.getLoopLatch();
+  auto CountNonExitingSuccessors = [&](TerminatorInst &CandidateTI) {
+    bool SkipExitingSuccessors = DT.dominates(CandidateTI.getParent(), Latch);
+    SmallPtrSet<BasicBlock *, 4> Succs;
+    for (BasicBlock *SuccBB : CandidateTI.successors())
+      if (!SkipExitingSuccessors || L.contains(SuccBB))
+        Succs.insert(SuccBB);
+    return (int)Succs.size();
+  };
+  if (CountNonExitingSuccessors(TI) <= 1) {
+    ++NumCostMultiplierSkipped;
+    return 1;
+  }
+
+  // Count the clones that unswitching all of the candidates could create. A
+  // branch creates one, and a switch the log2 of its distinct successors.
+  int UnswitchedClones = 0;
+  for (auto &Candidate : UnswitchCandidates)
+    UnswitchedClones +=
+        Log2_32(std::max(CountNonExitingSuccessors(*Candidate.first), 1));
+
+  // A few candidates are allowed to be unswitched without scaling, relying on
+  // the siblings to stop unswitching of the clones.
+  int ClonesPower = std::max(
+      UnswitchedClones - (int)UnswitchNumInitialUnscaledCandidates, 0);
+
+  // Top-level loops are allowed to spread a bit more than nested ones.
+  Loop *ParentL = L.getParentLoop();
+  int SiblingsCount = ParentL ? ParentL->getSubLoops().size()
+                              : std::distance(LI.begin(), LI.end());
+  int SiblingsMultiplier =
+      std::max(ParentL ? SiblingsCount
+                       : SiblingsCount / (int)UnswitchSiblingsToplevelDiv,
+               1);
+
+  // Saturate at the threshold to avoid overflow, which already prevents any
+  // unswitching.
+  if (ClonesPower > (int)Log2_32(UnswitchThreshold) ||
+      SiblingsMultiplier > UnswitchThreshold)
+    return UnswitchThreshold;
+  return std::min(SiblingsMultiplier * (1 << ClonesPower),
+                  (int)UnswitchThreshold);
+}
+
 static bool
 unswitchBestCondition(Loop &L, DominatorTree &DT, LoopInfo &LI,
                       AssumptionCache &AC, TargetTransformInfo &TTI,
@@ -2349,7 +2427,15 @@ unswitchBestCondition(Loop &L, DominatorTree &DT, LoopInfo &LI,
     int CandidateCost = ComputeUnswitchedCost(
         TI, /*FullUnswitch*/ !BI || (Invariants.size() == 1 &&
                                      Invariants[0] == BI->getCondition()));
+    // Scale the cost to keep the total duplication across the repeated
+    // unswitching of the loop and its clones within budget.
+    int CostMultiplier =
+        calculateUnswitchCostMultiplier(TI, L, LI, DT, UnswitchCandidates);
+    assert(CostMultiplier > 0 && CostMultiplier <= UnswitchThreshold &&
+           "cost multiplier needs to be in the range of 1..UnswitchThreshold");
+    CandidateCost *= CostMultiplier;
     LLVM_DEBUG(dbgs() << "  Computed cost of " << CandidateCost
+                      << " (multiplier: " << CostMultiplier << ")"
                       << " for unswitch candidate: " << TI << "\n");
     if (!BestUnswitchTI || CandidateCost < BestUnswitchCost) {
       BestUnswitchTI = &TI;
@@ -2418,6 +2504,16 @@ static bool unswitchLoop(Loop &L, DominatorTree &DT, LoopInfo &LI,
   if (!NonTrivial && !EnableNonTrivialUnswitch)
     return false;
 
+  // Non-trivial unswitching duplicates code, which isn't worth it when
+  // optimizing for size.
+  if (L.getHeader()->getParent()->optForSize())
+    return false;
+
+  // On targets with divergent branches, unswitching a condition that is
+  // uniform within the loop can make it divergent across the clones.
+  if (TTI.hasBranchDivergence())
+    return false;
+
   // For non-trivial unswitching, because it often creates new loops, we rely on
   // the pass manager to iterate on the loops rather than trying to immediately
   // reach a fixed point. There is no substantial advantage to iterating
@@ -766,6 +766,24 @@ Value *llvm::emitStrLen(Value *Ptr, IRBuilder<> &B, const DataLayout &DL,
   return CI;
 }
 
+Value *llvm::emitWcsLen(Value *Ptr, IRBuilder<> &B, const DataLayout &DL,
+                        const TargetLibraryInfo *TLI) {
+  if (!TLI->has(LibFunc_wcslen))
+    return nullptr;
+
+  Module *M = B.GetInsertBlock()->getModule();
+  LLVMContext &Context = B.GetInsertBlock()->getContext();
+  Type *PtrTy = Ptr->getType();
+  Constant *WcsLen = M->getOrInsertFunction("wcslen", DL.getIntPtrType(Context),
+                                            PtrTy);
+  inferLibFuncAttributes(*M->getFunction("wcslen"), *TLI);
+  CallInst *CI = B.CreateCall(WcsLen, Ptr, "wcslen");
+  if (const Function *F = dyn_cast<Function>(WcsLen->stripPointerCasts()))
+    CI->setCallingConv(F->getCallingConv());
+
+  return CI;
+}
+
 Value *llvm::emitStrChr(Value *Ptr, char C, IRBuilder<> &B,
                         const TargetLibraryInfo *TLI) {
   if (!TLI->has(LibFunc_strchr))
@@ -899,6 +917,26 @@ Value *llvm::emitMemCmp(Value *Ptr1, Value *Ptr2, Value *Len, IRBuilder<> &B,
   return CI;
 }
 
+Value *llvm::emitBCmp(Value *Ptr1, Value *Ptr2, Value *Len, IRBuilder<> &B,
+                      const DataLayout &DL, const TargetLibraryInfo *TLI) {
+  if (!TLI->has(LibFunc_bcmp))
+    return nullptr;
+
+  Module *M = B.GetInsertBlock()->getModule();
+  LLVMContext &Context = B.GetInsertBlock()->getContext();
+  Value *BCmp = M->getOrInsertFunction("bcmp", B.getInt32Ty(),
+                                       B.getInt8PtrTy(), B.getInt8PtrTy(),
+                                       DL.getIntPtrType(Context));
+  inferLibFuncAttributes(*M->getFunction("bcmp"), *TLI);
+  CallInst *CI = B.CreateCall(
+      BCmp, {castToCStr(Ptr1, B), castToCStr(Ptr2, B), Len}, "bcmp");
+
+  if (const Function *F = dyn_cast<Function>(BCmp->stripPointerCasts()))
+    CI->setCallingConv(F->getCallingConv());
+
+  return CI;
+}
+
 /// Append a suffix to the function name according to the type of 'Op'.
 static void appendTypeSuffix(Value *Op, StringRef &Name,
                              SmallString<20> &NameBuffer) {
@@ -190,10 +190,10 @@ static void createRetBitCast(CallSite CS, Type *RetTy, CastInst **RetBitCast) {
 /// Predicate and clone the given call site.
 ///
 /// This function creates an if-then-else structure at the location of the call
-/// site. The "if" condition compares the call site's called value to the given
-/// callee. The original call site is moved into the "else" block, and a clone
-/// of the call site is placed in the "then" block. The cloned instruction is
-/// returned.
+/// site. The "if" condition is \p Cond, which usually compares the call site's
+/// called value to the given callee. The original call site is moved into the
+/// "else" block, and a clone of the call site is placed in the "then" block.
+/// The cloned instruction is returned.
 ///
 /// For example, the call instruction below:
 ///
@@ -254,19 +254,13 @@ static void createRetBitCast(CallSite CS, Type *RetTy, CastInst **RetBitCast) {
 ///     %t2 = phi i32 [ %t0, %else_bb ], [ %t1, %then_bb ]
 ///     br %normal_dst
 ///
-static Instruction *versionCallSite(CallSite CS, Value *Callee,
+static Instruction *versionCallSite(CallSite CS, Value *Cond,
                                     MDNode *BranchWeights) {
 
   IRBuilder<> Builder(CS.getInstruction());
   Instruction *OrigInst = CS.getInstruction();
   BasicBlock *OrigBlock = OrigInst->getParent();
 
-  // Create the compare. The called value and callee must have the same type to
-  // be compared.
-  if (CS.getCalledValue()->getType() != Callee->getType())
-    Callee = Builder.CreateBitCast(Callee, CS.getCalledValue()->getType());
-  auto *Cond = Builder.CreateICmpEQ(CS.getCalledValue(), Callee);
-
   // Create an if-then-else structure. The original instruction is moved into
   // the "else" block, and a clone of the original instruction is placed in the
   // "then" block.
@@ -413,13 +407,72 @@ Instruction *llvm::promoteCall(CallSite CS, Function *Callee,
 Instruction *llvm::promoteCallWithIfThenElse(CallSite CS, Function *Callee,
                                              MDNode *BranchWeights) {
 
+  // Create the compare. The called value and callee must have the same type to
+  // be compared.
+  IRBuilder<> Builder(CS.getInstruction());
+  Value *CalleeValue = Callee;
+  if (CS.getCalledValue()->getType() != Callee->getType())
+    CalleeValue =
+        Builder.CreateBitCast(Callee, CS.getCalledValue()->getType());
+  Value *Cond = Builder.CreateICmpEQ(CS.getCalledValue(), CalleeValue);
+
   // Version the indirect call site. If the called value is equal to the given
   // callee, 'NewInst' will be executed, otherwise the original call site will
   // be executed.
-  Instruction *NewInst = versionCallSite(CS, Callee, BranchWeights);
+  Instruction *NewInst = versionCallSite(CS, Cond, BranchWeights);
 
   // Promote 'NewInst' so that it directly calls the desired function.
   return promoteCall(CallSite(NewInst), Callee);
 }
 
+/// Return the load of the called value of \p CS if it can be moved down to
+/// the call site, or null.
+static LoadInst *getSinkableCalledValueLoad(CallSite CS) {
+  Instruction *Call = CS.getInstruction();
+  auto *Load = dyn_cast<LoadInst>(CS.getCalledValue());
+  if (!Load || !Load->hasOneUse() || !Load->isUnordered() ||
+      Load->getParent() != Call->getParent())
+    return nullptr;
+
+  // Loads from vtables are usually marked invariant. Otherwise, the memory
+  // must not be written to before the call.
+  if (!Load->getMetadata(LLVMContext::MD_invariant_load))
+    for (auto I = std::next(Load->getIterator()); &*I != Call; ++I)
+      if (I->mayWriteToMemory())
+        return nullptr;
+  return Load;
+}
+
+Instruction *llvm::promoteCallWithVTableCmp(CallSite CS, Function *Callee,
+                                            Value *VTable,
+                                            ArrayRef<Constant *> AddressPoints,
+                                            MDNode *BranchWeights) {
+  assert(!AddressPoints.empty() && "Expected a vtable to compare to");
+  LoadInst *CalledValueLoad = getSinkableCalledValueLoad(CS);
+
+  // Create the compare of the vtable pointer to each of the address points.
+  IRBuilder<> Builder(CS.getInstruction());
+  Value *Cond = nullptr;
+  for (Constant *AddressPoint : AddressPoints) {
+    Value *Cmp = Builder.CreateICmpEQ(
+        VTable, ConstantExpr::getBitCast(AddressPoint, VTable->getType()));
+    Cond = Cond ? Builder.CreateOr(Cond, Cmp) : Cmp;
+  }
+
+  Instruction *NewInst = versionCallSite(CS, Cond, BranchWeights);
+  Instruction *DirectCall = promoteCall(CallSite(NewInst), Callee);
+
+  // Only the original call site in the "else" block uses the called value
+  // now, so its load, and the address computation feeding it, move there.
+  if (CalledValueLoad) {
+    auto *GEP =
+        dyn_cast<GetElementPtrInst>(CalledValueLoad->getPointerOperand());
+    BasicBlock *LoadBlock = CalledValueLoad->getParent();
+    CalledValueLoad->moveBefore(CS.getInstruction());
+    if (GEP && GEP->hasOneUse() && GEP->getParent() == LoadBlock)
+      GEP->moveBefore(CalledValueLoad);
+  }
+  return DirectCall;
+}
+
 #undef DEBUG_TYPE
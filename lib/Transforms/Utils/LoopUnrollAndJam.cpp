@@ -598,7 +598,7 @@ static bool getLoadsAndStores(BasicBlockSet &Blocks,
 static bool checkDependencies(SmallVector<Value *, 4> &Earlier,
                               SmallVector<Value *, 4> &Later,
                               unsigned LoopDepth, bool InnerLoop,
-                              DependenceInfo &DI) {
+                              LoopDependenceGraph &DG) {
   // Use DA to check for dependencies between loads and stores that make unroll
   // and jam invalid
   for (Value *I : Earlier) {
@@ -607,16 +607,14 @@ static bool checkDependencies(SmallVector<Value *, 4> &Earlier,
       Instruction *Dst = cast<Instruction>(J);
       if (Src == Dst)
         continue;
-      // Ignore Input dependencies.
-      if (isa<LoadInst>(Src) && isa<LoadInst>(Dst))
-        continue;
 
       // Track dependencies, and if we find them take a conservative approach
       // by allowing only = or < (not >), altough some > would be safe
       // (depending upon unroll width).
       // For the inner loop, we need to disallow any (> <) dependencies
       // FIXME: Allow > so long as distance is less than unroll width
-      if (auto D = DI.depends(Src, Dst, true)) {
+      // Input dependencies are filtered out by the graph.
+      if (auto D = DG.depends(Src, Dst)) {
         assert(D->isOrdered() && "Expected an output, flow or anti dep.");
 
         if (D->isConfused()) {
@@ -661,14 +659,15 @@ static bool checkDependencies(Loop *L, BasicBlockSet &ForeBlocks,
     return false;
 
   // Check for dependencies between any blocks that may change order
+  LoopDependenceGraph DG(DI, *L);
   unsigned LoopDepth = L->getLoopDepth();
   return checkDependencies(ForeMemInstr, SubLoopMemInstr, LoopDepth, false,
-                           DI) &&
-         checkDependencies(ForeMemInstr, AftMemInstr, LoopDepth, false, DI) &&
+                           DG) &&
+         checkDependencies(ForeMemInstr, AftMemInstr, LoopDepth, false, DG) &&
          checkDependencies(SubLoopMemInstr, AftMemInstr, LoopDepth, false,
-                           DI) &&
+                           DG) &&
          checkDependencies(SubLoopMemInstr, SubLoopMemInstr, LoopDepth, true,
-                           DI);
+                           DG);
 }
 
 bool llvm::isSafeToUnrollAndJam(Loop *L, ScalarEvolution &SE, DominatorTree &DT,
@@ -516,9 +516,116 @@ bool LoopVectorizationLegality::canVectorizeOuterLoop() {
       return false;
   }
 
+  // The vector loop skeleton needs the trip count of the outer loop.
+  if (isa<SCEVCouldNotCompute>(PSE.getBackedgeTakenCount())) {
+    LLVM_DEBUG(
+        dbgs() << "LV: Not vectorizing: Unknown outer loop trip count.\n");
+    ORE->emit(createMissedAnalysis("CantComputeNumberOfIterations")
+              << "could not determine number of loop iterations");
+    if (DoExtraAnalysis)
+      Result = false;
+    else
+      return false;
+  }
+
+  // Check whether we are able to set up outer loop induction.
+  SmallPtrSet<Value *, 4> AllowedExit;
+  if (!setupOuterLoopInductions(AllowedExit)) {
+    LLVM_DEBUG(
+        dbgs() << "LV: Not vectorizing: Unsupported outer loop Phi(s).\n");
+    ORE->emit(createMissedAnalysis("UnsupportedPhi")
+              << "Unsupported outer loop Phi(s)");
+    if (DoExtraAnalysis)
+      Result = false;
+    else
+      return false;
+  }
+
+  // Check whether the loop nest only contains instructions we can widen.
+  if (!canWidenOuterLoopInstrs(AllowedExit)) {
+    LLVM_DEBUG(dbgs() << "LV: Not vectorizing: Outer loop contains "
+                         "instructions that cannot be widened.\n");
+    if (DoExtraAnalysis)
+      Result = false;
+    else
+      return false;
+  }
+
   return Result;
 }
 
+bool LoopVectorizationLegality::setupOuterLoopInductions(
+    SmallPtrSetImpl<Value *> &AllowedExit) {
+  BasicBlock *Header = TheLoop->getHeader();
+
+  // Returns true if a given Phi is a supported induction.
+  auto isSupportedPhi = [&](PHINode &Phi) -> bool {
+    InductionDescriptor ID;
+    if (InductionDescriptor::isInductionPHI(&Phi, TheLoop, PSE, ID) &&
+        ID.getKind() == InductionDescriptor::IK_IntInduction) {
+      addInductionPhi(&Phi, ID, AllowedExit);
+      return true;
+    }
+    // Bail out for any Phi in the outer loop header that is not a supported
+    // induction.
+    LLVM_DEBUG(
+        dbgs() << "LV: Found unsupported PHI for outer loop vectorization.\n");
+    return false;
+  };
+
+  if (!llvm::all_of(Header->phis(), isSupportedPhi))
+    return false;
+
+  // The vector loop skeleton needs an integer induction to compute the type
+  // of the vector trip count.
+  return WidestIndTy != nullptr;
+}
+
+bool LoopVectorizationLegality::canWidenOuterLoopInstrs(
+    SmallPtrSetImpl<Value *> &AllowedExit) {
+  for (BasicBlock *BB : TheLoop->blocks()) {
+    for (Instruction &I : *BB) {
+      // Debug intrinsics are dropped from the vector loop.
+      if (isa<DbgInfoIntrinsic>(I))
+        continue;
+
+      bool Supported = isa<BranchInst>(I) || isa<PHINode>(I) ||
+                       isa<GetElementPtrInst>(I) || isa<SelectInst>(I) ||
+                       isa<CmpInst>(I) || isa<CastInst>(I) || I.isBinaryOp();
+      if (auto *LdI = dyn_cast<LoadInst>(&I))
+        Supported = LdI->isSimple();
+      if (auto *StI = dyn_cast<StoreInst>(&I))
+        Supported = StI->isSimple() && VectorType::isValidElementType(
+                                           StI->getValueOperand()->getType());
+      // Calls are widened either into vector intrinsics or into calls to
+      // vector library functions.
+      if (auto *CI = dyn_cast<CallInst>(&I)) {
+        Intrinsic::ID ID = getVectorIntrinsicIDForCall(CI, TLI);
+        Supported =
+            (ID && !hasVectorInstrinsicScalarOpd(ID, 1)) ||
+            (CI->getCalledFunction() && TLI &&
+             TLI->isFunctionVectorizable(CI->getCalledFunction()->getName()));
+      }
+      if (!Supported || (!VectorType::isValidElementType(I.getType()) &&
+                         !I.getType()->isVoidTy())) {
+        ORE->emit(createMissedAnalysis("CantWidenInstruction", &I)
+                  << "instruction cannot be vectorized");
+        LLVM_DEBUG(dbgs() << "LV: Found an instruction that cannot be widened "
+                          << "in an outer loop: " << I << "\n");
+        return false;
+      }
+
+      // Live-outs other than the inductions are not supported.
+      if (hasOutsideLoopUser(TheLoop, &I, AllowedExit)) {
+        ORE->emit(createMissedAnalysis("ValueUsedOutsideLoop", &I)
+                  << "value cannot be used outside the loop");
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
 void LoopVectorizationLegality::addInductionPhi(
     PHINode *Phi, const InductionDescriptor &ID,
     SmallPtrSetImpl<Value *> &AllowedExit) {
@@ -58,6 +58,7 @@
 #include "LoopVectorizationPlanner.h"
 #include "VPRecipeBuilder.h"
 #include "VPlanHCFGBuilder.h"
+#include "VPlanHCFGTransforms.h"
 #include "llvm/ADT/APInt.h"
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/DenseMap.h"
@@ -153,6 +154,7 @@ using namespace llvm;
 
 STATISTIC(LoopsVectorized, "Number of loops vectorized");
 STATISTIC(LoopsAnalyzed, "Number of loops analyzed for vectorization");
+STATISTIC(LoopEpiloguesVectorized, "Number of epilogue loops vectorized");
 
 /// Loops with a known constant trip count below this number are vectorized only
 /// if no scalar iteration overheads are incurred.
@@ -235,12 +237,22 @@ static cl::opt<bool> EnableCondStoresVectorization(
     "enable-cond-stores-vec", cl::init(true), cl::Hidden,
     cl::desc("Enable if predication of stores during vectorization."));
 
+static cl::opt<bool> EnableEpilogueVectorization(
+    "enable-epilogue-vectorization", cl::init(true), cl::Hidden,
+    cl::desc("Vectorize the remainder loop left by the vectorization of a loop "
+             "with a smaller vectorization factor."));
+
+static cl::opt<unsigned> EpilogueVectorizationMinVF(
+    "epilogue-vectorization-minimum-VF", cl::init(16), cl::Hidden,
+    cl::desc("Only loops vectorized with a vectorization factor equal to or "
+             "larger than this value have their epilogue vectorized."));
+
 static cl::opt<unsigned> MaxNestedScalarReductionIC(
     "max-nested-scalar-reduction-interleave", cl::init(2), cl::Hidden,
     cl::desc("The maximum interleave count to use when interleaving a scalar "
              "reduction in a nested loop."));
 
-static cl::opt<bool> EnableVPlanNativePath(
+cl::opt<bool> EnableVPlanNativePath(
     "enable-vplan-native-path", cl::init(false), cl::Hidden,
     cl::desc("Enable VPlan-native vectorization path with "
              "support for outer loop vectorization."));
@@ -256,6 +268,12 @@ static cl::opt<bool> VPlanBuildStressTest(
         "out right after the build (stress test the VPlan H-CFG construction "
         "in the VPlan-native vectorization path)."));
 
+static cl::opt<unsigned> VPlanInnerLoopTripCount(
+    "vplan-inner-loop-trip-count", cl::init(8), cl::Hidden,
+    cl::desc("The trip count assumed for inner loops without a constant trip "
+             "count when estimating the cost of vectorizing an outer loop in "
+             "the VPlan-native path."));
+
 /// A helper function for converting Scalar types to vector types.
 /// If the incoming type is void, we return void. If the VF is 1, we return
 /// the scalar type.
@@ -382,6 +400,17 @@ public:
   // Return true if any runtime check is added.
   bool areSafetyChecksAdded() { return AddedSafetyChecks; }
 
+  /// Return true if the loop being vectorized is an outer loop, which is only
+  /// the case in the VPlan-native path.
+  bool isVectorizingOuterLoop() const { return !OrigLoop->empty(); }
+
+  /// Return the blocks branching around the vector loop to the scalar loop.
+  /// The first one is the entry of the vectorized code.
+  ArrayRef<BasicBlock *> getBypassBlocks() const { return LoopBypassBlocks; }
+
+  /// Return the block the vector loop exits to.
+  BasicBlock *getMiddleBlock() const { return LoopMiddleBlock; }
+
   /// A type for vectorized values in the new loop. Each value from the
   /// original loop, when vectorized, is represented by UF vector values in the
   /// new unrolled loop, where UF is the unroll factor.
@@ -496,7 +525,7 @@ protected:
 
   /// Insert the new loop to the loop hierarchy and pass manager
   /// and update the analysis passes.
-  void updateAnalysis();
+  virtual void updateAnalysis();
 
   /// Create a broadcast instruction. This method generates a broadcast
   /// instruction (shuffle) for loop invariant values and for the induction
@@ -579,10 +608,10 @@ protected:
 
   /// Emit a bypass check to see if all of the SCEV assumptions we've
   /// had to make are correct.
-  void emitSCEVChecks(Loop *L, BasicBlock *Bypass);
+  virtual void emitSCEVChecks(Loop *L, BasicBlock *Bypass);
 
   /// Emit bypass checks to check any memory assumptions we may have made.
-  void emitMemRuntimeChecks(Loop *L, BasicBlock *Bypass);
+  virtual void emitMemRuntimeChecks(Loop *L, BasicBlock *Bypass);
 
   /// Add additional metadata to \p To that was not present on \p Orig.
   ///
@@ -727,6 +756,42 @@ private:
   Value *reverseVector(Value *Vec) override;
 };
 
+/// InnerLoopEpilogueVectorizer vectorizes the remainder loop that the
+/// vectorization of a loop by another InnerLoopVectorizer leaves, with a
+/// smaller vectorization factor. The vector epilogue relies on the runtime
+/// checks of the main loop instead of emitting its own: if the main loop has
+/// any, the epilogue is only entered from its middle block, and the scalar loop
+/// is entered directly when the trip count is too small for the main loop or
+/// the checks fail.
+class InnerLoopEpilogueVectorizer : public InnerLoopVectorizer {
+public:
+  InnerLoopEpilogueVectorizer(Loop *OrigLoop, PredicatedScalarEvolution &PSE,
+                              LoopInfo *LI, DominatorTree *DT,
+                              const TargetLibraryInfo *TLI,
+                              const TargetTransformInfo *TTI,
+                              AssumptionCache *AC,
+                              OptimizationRemarkEmitter *ORE, unsigned VecWidth,
+                              LoopVectorizationLegality *LVL,
+                              LoopVectorizationCostModel *CM,
+                              const InnerLoopVectorizer &MainILV)
+      : InnerLoopVectorizer(OrigLoop, PSE, LI, DT, TLI, TTI, AC, ORE, VecWidth,
+                            1, LVL, CM),
+        MainBypassBlocks(MainILV.getBypassBlocks().begin(),
+                         MainILV.getBypassBlocks().end()),
+        MainMiddleBlock(MainILV.getMiddleBlock()) {}
+
+private:
+  void emitSCEVChecks(Loop *L, BasicBlock *Bypass) override;
+  void emitMemRuntimeChecks(Loop *L, BasicBlock *Bypass) override;
+  void updateAnalysis() override;
+
+  /// The bypass blocks of the main vector loop.
+  SmallVector<BasicBlock *, 4> MainBypassBlocks;
+
+  /// The middle block of the main vector loop, which enters the epilogue.
+  BasicBlock *MainMiddleBlock;
+};
+
 } // end namespace llvm
 
 /// Look for a meaningful debug location on the instruction or it's
@@ -1198,6 +1263,26 @@ public:
     collectInstsToScalarize(UserVF);
   }
 
+  /// \return The most profitable vectorization factor for the remainder loop
+  /// left by vectorizing the loop with \p MainVF and interleave count \p IC,
+  /// or 1 if the remainder should be left scalar.
+  unsigned selectEpilogueVectorizationFactor(unsigned MainVF, unsigned IC);
+
+  /// \return An upper bound for the vectorization factor of an outer loop
+  /// vectorized in the VPlan-native path, based on the widest type accessed in
+  /// memory by the loop nest.
+  unsigned computeOuterLoopMaxVF();
+
+  /// \return The most profitable vectorization factor of an outer loop and the
+  /// cost of that VF. This method checks every power of two up to MaxVF.
+  VectorizationFactor selectOuterLoopVectorizationFactor(unsigned MaxVF);
+
+  /// \return The expected cost of an outer loop vectorized by \p VF in the
+  /// VPlan-native path, or None if some instruction of the loop nest cannot be
+  /// widened by \p VF. The widening decisions of the memory instructions of
+  /// the loop nest are taken for \p VF as a side effect.
+  Optional<unsigned> expectedOuterLoopCost(unsigned VF);
+
   /// \return The size (in bits) of the smallest and widest types in the code
   /// that needs to be vectorized. We ignore values that remain scalar such as
   /// 64 bit loop indices.
@@ -1247,6 +1332,9 @@ public:
   /// vectorization factor \p VF.
   bool isProfitableToScalarize(Instruction *I, unsigned VF) const {
     assert(VF > 1 && "Profitable to scalarize relevant only for VF > 1.");
+    // Outer loops are fully widened in the VPlan-native path.
+    if (!TheLoop->empty())
+      return false;
     auto Scalars = InstsToScalarize.find(VF);
     assert(Scalars != InstsToScalarize.end() &&
            "VF not yet analyzed for scalarization profitability");
@@ -1257,6 +1345,8 @@ public:
   bool isUniformAfterVectorization(Instruction *I, unsigned VF) const {
     if (VF == 1)
       return true;
+    if (!TheLoop->empty())
+      return false;
     assert(Uniforms.count(VF) && "VF not yet analyzed for uniformity");
     auto UniformsPerVF = Uniforms.find(VF);
     return UniformsPerVF->second.count(I);
@@ -1266,6 +1356,8 @@ public:
   bool isScalarAfterVectorization(Instruction *I, unsigned VF) const {
     if (VF == 1)
       return true;
+    if (!TheLoop->empty())
+      return false;
     assert(Scalars.count(VF) && "Scalar values are not calculated for VF");
     auto ScalarsPerVF = Scalars.find(VF);
     return ScalarsPerVF->second.count(I);
@@ -1478,6 +1570,15 @@ private:
   /// The cost computation for Gather/Scatter instruction.
   unsigned getGatherScatterCost(Instruction *I, unsigned VF);
 
+  /// \return The cost of instruction \p I of an outer loop nest vectorized by
+  /// \p VF, or None if \p I cannot be widened by \p VF.
+  Optional<unsigned> getOuterLoopInstructionCost(Instruction *I, unsigned VF);
+
+  /// Returns true if the address \p Ptr of a memory access in an outer loop
+  /// nest is consecutive across the iterations of the outer loop, so that the
+  /// vector lanes access adjacent elements.
+  bool isConsecutiveInOuterLoop(Value *Ptr);
+
   /// The cost computation for widening instruction \p I with consecutive
   /// memory access.
   unsigned getConsecutiveMemOpCost(Instruction *I, unsigned VF);
@@ -1644,7 +1745,9 @@ static bool isExplicitVecOuterLoop(Loop *OuterLp,
     return false;
   }
 
-  if (!Hints.getWidth()) {
+  // Without a vector width, the cost model chooses one for loops whose
+  // iterations are known to be independent.
+  if (!Hints.getWidth() && !OuterLp->isAnnotatedParallel()) {
     LLVM_DEBUG(dbgs() << "LV: Not vectorizing: No user vector width.\n");
     emitMissedWarning(Fn, OuterLp, Hints, ORE);
     return false;
@@ -2756,6 +2859,11 @@ void InnerLoopVectorizer::emitSCEVChecks(Loop *L, BasicBlock *Bypass) {
 }
 
 void InnerLoopVectorizer::emitMemRuntimeChecks(Loop *L, BasicBlock *Bypass) {
+  // The VPlan-native path does not analyze the memory dependences of outer
+  // loops, which are vectorized on the strength of their explicit hints.
+  if (!Legal->getLAI())
+    return;
+
   BasicBlock *BB = L->getLoopPreheader();
 
   // Generate the code that checks in runtime if arrays overlap. We put the
@@ -3719,7 +3827,9 @@ void InnerLoopVectorizer::fixReduction(PHINode *Phi) {
 
 void InnerLoopVectorizer::fixLCSSAPHIs() {
   for (PHINode &LCSSAPhi : LoopExitBlock->phis()) {
-    if (LCSSAPhi.getNumIncomingValues() == 1) {
+    // The phis may already have incoming values from a main vector loop when
+    // vectorizing its epilogue.
+    if (LCSSAPhi.getBasicBlockIndex(LoopMiddleBlock) == -1) {
       assert(OrigLoop->isLoopInvariant(LCSSAPhi.getIncomingValue(0)) &&
              "Incoming value isn't loop invariant");
       LCSSAPhi.addIncoming(LCSSAPhi.getIncomingValue(0), LoopMiddleBlock);
@@ -3793,10 +3903,23 @@ void InnerLoopVectorizer::sinkScalarOperands(Instruction *PredInst) {
 
 void InnerLoopVectorizer::widenPHIInstruction(Instruction *PN, unsigned UF,
                                               unsigned VF) {
+  PHINode *P = cast<PHINode>(PN);
+  if (isVectorizingOuterLoop()) {
+    // In the VPlan-native path all the phis other than the inductions of the
+    // outer loop become vector phis. Their incoming values are added once all
+    // the blocks of the vector loop body have been generated.
+    Type *VecTy =
+        (VF == 1) ? PN->getType() : VectorType::get(PN->getType(), VF);
+    for (unsigned Part = 0; Part < UF; ++Part) {
+      Value *VecPhi = Builder.CreatePHI(VecTy, PN->getNumOperands(), "vec.phi");
+      VectorLoopValueMap.setVectorValue(P, Part, VecPhi);
+    }
+    return;
+  }
+
   assert(PN->getParent() == OrigLoop->getHeader() &&
          "Non-header phis should have been handled elsewhere");
 
-  PHINode *P = cast<PHINode>(PN);
   // In order to support recurrences we need to be able to vectorize Phi nodes.
   // Phi nodes have cycles, so we need to vectorize them in two stages. This is
   // stage #1: We create a new vector PHI node with no incoming edges. We'll use
@@ -4147,10 +4270,57 @@ void InnerLoopVectorizer::widenInstruction(Instruction &I) {
   } // end of switch.
 }
 
+/// Register in \p LI the loops nested in \p VectorLoop, which the vector code
+/// of an outer loop replicates from the inner loops of the original loop nest.
+/// The header of each inner loop is expected to precede its other blocks in
+/// \p VectorLoop, as it does in the order in which VPlan generates them.
+static void addInnerLoopsToLoopInfo(Loop *VectorLoop, LoopInfo *LI,
+                                    DominatorTree *DT) {
+  SmallVector<BasicBlock *, 16> Blocks(VectorLoop->blocks());
+  for (BasicBlock *H : Blocks) {
+    if (H == VectorLoop->getHeader())
+      continue;
+
+    // A block with a backedge is the header of a new inner loop.
+    SmallVector<BasicBlock *, 4> Worklist;
+    for (BasicBlock *Pred : predecessors(H))
+      if (DT->dominates(H, Pred))
+        Worklist.push_back(Pred);
+    if (Worklist.empty())
+      continue;
+
+    Loop *NewLoop = LI->AllocateLoop();
+    LI->getLoopFor(H)->addChildLoop(NewLoop);
+    NewLoop->addBlockEntry(H);
+    LI->changeLoopFor(H, NewLoop);
+
+    // The loop is made of the blocks that reach its latches backwards
+    // without going through its header.
+    SmallPtrSet<BasicBlock *, 16> Visited;
+    Visited.insert(H);
+    while (!Worklist.empty()) {
+      BasicBlock *BB = Worklist.pop_back_val();
+      if (!Visited.insert(BB).second)
+        continue;
+      NewLoop->addBlockEntry(BB);
+      LI->changeLoopFor(BB, NewLoop);
+      Worklist.append(pred_begin(BB), pred_end(BB));
+    }
+  }
+}
+
 void InnerLoopVectorizer::updateAnalysis() {
   // Forget the original basic block.
   PSE.getSE()->forgetLoop(OrigLoop);
 
+  // The vector body of an outer loop contains inner loops, and is not kept
+  // up to date incrementally.
+  if (isVectorizingOuterLoop()) {
+    DT->recalculate(*LoopVectorBody->getParent());
+    addInnerLoopsToLoopInfo(LI->getLoopFor(LoopVectorBody), LI, DT);
+    return;
+  }
+
   // Update the dominator tree information.
   assert(DT->properlyDominates(LoopBypassBlocks.front(), LoopExitBlock) &&
          "Entry does not dominate exit.");
@@ -5071,6 +5241,265 @@ LoopVectorizationCostModel::selectVectorizationFactor(unsigned MaxVF) {
   return Factor;
 }
 
+unsigned
+LoopVectorizationCostModel::selectEpilogueVectorizationFactor(unsigned MainVF,
+                                                              unsigned IC) {
+  if (!EnableEpilogueVectorization || MainVF < EpilogueVectorizationMinVF)
+    return 1;
+
+  // The remainder loop runs fewer than MainVF * IC iterations. If the trip
+  // count is known, it runs exactly the remainder of its division.
+  unsigned MaxVF = MainVF / 2;
+  if (unsigned TC = PSE.getSE()->getSmallConstantTripCount(TheLoop)) {
+    unsigned Remainder = TC % (MainVF * IC);
+    MaxVF = std::min<unsigned>(MaxVF, Remainder ? PowerOf2Floor(Remainder) : 0);
+  }
+  if (MaxVF < 2) {
+    LLVM_DEBUG(dbgs() << "LV: The remainder loop is too short to be "
+                         "vectorized.\n");
+    return 1;
+  }
+
+  float Cost = expectedCost(1).first;
+  unsigned Width = 1;
+  for (unsigned VF = 2; VF <= MaxVF; VF *= 2) {
+    // The decisions for VF were only taken if it was a candidate for the main
+    // loop.
+    selectUserVectorizationFactor(VF);
+    VectorizationCostTy C = expectedCost(VF);
+    float VectorCost = C.first / (float)VF;
+    LLVM_DEBUG(dbgs() << "LV: Vector epilogue of width " << VF
+                      << " costs: " << (int)VectorCost << ".\n");
+    if (!C.second)
+      continue;
+    if (VectorCost < Cost) {
+      Cost = VectorCost;
+      Width = VF;
+    }
+  }
+
+  LLVM_DEBUG(dbgs() << "LV: Selecting epilogue VF: " << Width << ".\n");
+  return Width;
+}
+
+unsigned LoopVectorizationCostModel::computeOuterLoopMaxVF() {
+  assert(!TheLoop->empty() && "Expected an outer loop");
+  const DataLayout &DL = TheFunction->getParent()->getDataLayout();
+  unsigned WidestType = 0;
+  for (BasicBlock *BB : TheLoop->blocks())
+    for (Instruction &I : *BB)
+      if (isa<LoadInst>(I) || isa<StoreInst>(I))
+        WidestType = std::max(
+            WidestType, (unsigned)DL.getTypeSizeInBits(getMemInstValueType(&I)));
+
+  // There is nothing worth vectorizing in a loop nest without memory accesses.
+  if (!WidestType)
+    return 1;
+
+  unsigned WidestRegister = TTI.getRegisterBitWidth(true);
+  LLVM_DEBUG(dbgs() << "LV: The widest type of the outer loop nest is "
+                    << WidestType << " bits.\n");
+  return std::max(1U, (unsigned)PowerOf2Floor(WidestRegister / WidestType));
+}
+
+VectorizationFactor
+LoopVectorizationCostModel::selectOuterLoopVectorizationFactor(unsigned MaxVF) {
+  Optional<unsigned> ScalarCost = expectedOuterLoopCost(1);
+  assert(ScalarCost && "Expected the scalar loop nest to have a cost");
+  float Cost = *ScalarCost;
+  unsigned Width = 1;
+  LLVM_DEBUG(dbgs() << "LV: Scalar outer loop costs: " << *ScalarCost
+                    << ".\n");
+
+  bool ForceVectorization = Hints->getForce() == LoopVectorizeHints::FK_Enabled;
+  if (ForceVectorization && MaxVF > 1)
+    // Ignore scalar width, because the user explicitly wants vectorization.
+    Cost = std::numeric_limits<float>::max();
+
+  for (unsigned VF = 2; VF <= MaxVF; VF *= 2) {
+    Optional<unsigned> C = expectedOuterLoopCost(VF);
+    if (!C) {
+      LLVM_DEBUG(dbgs() << "LV: Not considering outer loop vector width " << VF
+                        << " because some instructions cannot be widened.\n");
+      continue;
+    }
+    float VectorCost = *C / (float)VF;
+    LLVM_DEBUG(dbgs() << "LV: Outer loop vector width " << VF
+                      << " costs: " << (int)VectorCost << ".\n");
+    if (VectorCost < Cost) {
+      Cost = VectorCost;
+      Width = VF;
+    }
+  }
+
+  LLVM_DEBUG(dbgs() << "LV: Selecting VF: " << Width << ".\n");
+  if (Width == 1)
+    return {1, *ScalarCost};
+  return {Width, (unsigned)(Width * Cost)};
+}
+
+Optional<unsigned>
+LoopVectorizationCostModel::expectedOuterLoopCost(unsigned VF) {
+  assert(!TheLoop->empty() && "Expected an outer loop");
+  ScalarEvolution *SE = PSE.getSE();
+  uint64_t Cost = 0;
+
+  for (BasicBlock *BB : TheLoop->blocks()) {
+    // Instructions of inner loops run once per iteration of these loops.
+    uint64_t Weight = 1;
+    for (Loop *L = LI->getLoopFor(BB); L != TheLoop; L = L->getParentLoop()) {
+      unsigned TripCount = SE->getSmallConstantTripCount(L);
+      Weight *= TripCount ? TripCount : VPlanInnerLoopTripCount;
+      Weight = std::min<uint64_t>(Weight, std::numeric_limits<unsigned>::max());
+    }
+
+    for (Instruction &I : BB->instructionsWithoutDebug()) {
+      Optional<unsigned> C = getOuterLoopInstructionCost(&I, VF);
+      if (!C) {
+        LLVM_DEBUG(dbgs() << "LV: Cannot widen by VF " << VF
+                          << " instruction: " << I << '\n');
+        return None;
+      }
+      LLVM_DEBUG(dbgs() << "LV: Found an estimated cost of " << *C << " for VF "
+                        << VF << " For instruction: " << I << '\n');
+      Cost += Weight * *C;
+    }
+  }
+
+  return (unsigned)std::min<uint64_t>(Cost,
+                                      std::numeric_limits<unsigned>::max());
+}
+
+bool LoopVectorizationCostModel::isConsecutiveInOuterLoop(Value *Ptr) {
+  ScalarEvolution *SE = PSE.getSE();
+  const DataLayout &DL = TheFunction->getParent()->getDataLayout();
+  Type *ElemTy = cast<PointerType>(Ptr->getType())->getElementType();
+
+  // Peel off the recurrences of the inner loops, whose steps must be invariant
+  // in the outer loop so that all the vector lanes advance by the same amount,
+  // down to the recurrence of the outer loop.
+  const SCEV *S = SE->getSCEV(Ptr);
+  while (auto *AR = dyn_cast<SCEVAddRecExpr>(S)) {
+    if (!AR->isAffine() || !TheLoop->contains(AR->getLoop()))
+      return false;
+    const SCEV *Step = AR->getStepRecurrence(*SE);
+    if (AR->getLoop() == TheLoop) {
+      auto *ConstStep = dyn_cast<SCEVConstant>(Step);
+      return ConstStep &&
+             ConstStep->getAPInt() == DL.getTypeAllocSize(ElemTy);
+    }
+    if (!SE->isLoopInvariant(Step, TheLoop))
+      return false;
+    S = AR->getStart();
+  }
+  return false;
+}
+
+Optional<unsigned>
+LoopVectorizationCostModel::getOuterLoopInstructionCost(Instruction *I,
+                                                        unsigned VF) {
+  Type *VectorTy = ToVectorTy(I->getType(), VF);
+
+  switch (I->getOpcode()) {
+  case Instruction::GetElementPtr:
+    // The cost of the address computation is accounted for by the memory
+    // instructions.
+    return 0;
+  case Instruction::PHI:
+    // The inductions of the outer loop are replaced by the vector induction.
+    // Other phis become vector phis.
+    return TTI.getCFInstrCost(Instruction::PHI);
+  case Instruction::Br: {
+    // Branches are uniform and use lane 0 of their vector condition.
+    auto *Br = cast<BranchInst>(I);
+    unsigned Cost = TTI.getCFInstrCost(Instruction::Br);
+    if (VF > 1 && Br->isConditional())
+      Cost += TTI.getVectorInstrCost(
+          Instruction::ExtractElement,
+          ToVectorTy(Br->getCondition()->getType(), VF), 0);
+    return Cost;
+  }
+  case Instruction::Load:
+  case Instruction::Store: {
+    Type *ValTy = getMemInstValueType(I);
+    unsigned Alignment = getMemInstAlignment(I);
+    unsigned AS = getMemInstAddressSpace(I);
+    if (VF == 1)
+      return TTI.getAddressComputationCost(ValTy) +
+             TTI.getMemoryOpCost(I->getOpcode(), ValTy, Alignment, AS, I);
+
+    // Accesses that are consecutive along the outer loop become wide loads
+    // and stores, all the other ones gathers and scatters.
+    if (isConsecutiveInOuterLoop(getLoadStorePointerOperand(I))) {
+      unsigned Cost = TTI.getMemoryOpCost(
+          I->getOpcode(), ToVectorTy(ValTy, VF), Alignment, AS, I);
+      setWideningDecision(I, VF, CM_Widen, Cost);
+      return Cost;
+    }
+    unsigned Cost = getGatherScatterCost(I, VF);
+    setWideningDecision(I, VF, CM_GatherScatter, Cost);
+    return Cost;
+  }
+  case Instruction::Call: {
+    auto *CI = cast<CallInst>(I);
+    bool NeedToScalarize;
+    unsigned CallCost = getVectorCallCost(CI, VF, TTI, TLI, NeedToScalarize);
+    if (VF == 1)
+      return CallCost;
+    // InnerLoopVectorizer::widenInstruction uses the vector intrinsic if it is
+    // cheaper than the call, and cannot scalarize calls.
+    if (getVectorIntrinsicIDForCall(CI, TLI)) {
+      unsigned IntrinsicCost = getVectorIntrinsicCost(CI, VF, TTI, TLI);
+      if (IntrinsicCost <= CallCost)
+        return IntrinsicCost;
+    }
+    if (NeedToScalarize)
+      return None;
+    return CallCost;
+  }
+  case Instruction::Select: {
+    Type *CondTy = cast<SelectInst>(I)->getCondition()->getType();
+    return TTI.getCmpSelInstrCost(I->getOpcode(), VectorTy,
+                                  ToVectorTy(CondTy, VF), I);
+  }
+  case Instruction::ICmp:
+  case Instruction::FCmp:
+    return TTI.getCmpSelInstrCost(
+        I->getOpcode(), ToVectorTy(I->getOperand(0)->getType(), VF), nullptr,
+        I);
+  default:
+    break;
+  }
+
+  if (auto *Cast = dyn_cast<CastInst>(I))
+    return TTI.getCastInstrCost(I->getOpcode(), VectorTy,
+                                ToVectorTy(Cast->getSrcTy(), VF), I);
+
+  if (I->isBinaryOp()) {
+    // Operands that are invariant in the outer loop are broadcast.
+    Value *Op2 = I->getOperand(1);
+    TargetTransformInfo::OperandValueKind Op2VK =
+        TargetTransformInfo::OK_AnyValue;
+    TargetTransformInfo::OperandValueProperties Op2VP =
+        TargetTransformInfo::OP_None;
+    if (auto *CInt = dyn_cast<ConstantInt>(Op2)) {
+      if (CInt->getValue().isPowerOf2())
+        Op2VP = TargetTransformInfo::OP_PowerOf2;
+      Op2VK = TargetTransformInfo::OK_UniformConstantValue;
+    } else if (TheLoop->isLoopInvariant(Op2)) {
+      Op2VK = TargetTransformInfo::OK_UniformValue;
+    }
+    SmallVector<const Value *, 4> Operands(I->operand_values());
+    return TTI.getArithmeticInstrCost(I->getOpcode(), VectorTy,
+                                      TargetTransformInfo::OK_AnyValue, Op2VK,
+                                      TargetTransformInfo::OP_None, Op2VP,
+                                      Operands);
+  }
+
+  // Legality only lets instructions that can be widened through.
+  return None;
+}
+
 std::pair<unsigned, unsigned>
 LoopVectorizationCostModel::getSmallestAndWidestTypes() {
   unsigned MinWidth = -1U;
@@ -6283,22 +6712,36 @@ LoopVectorizationPlanner::planInVPlanNativePath(bool OptForSize,
   // the vectorization pipeline.
   if (!OrigLoop->empty()) {
     // TODO: If UserVF is not provided, we set UserVF to 4 for stress testing.
-    // This won't be necessary when UserVF is not required in the VPlan-native
-    // path.
+    // This won't be necessary when the stress test exercises the cost model.
     if (VPlanBuildStressTest && !UserVF)
       UserVF = 4;
 
     assert(EnableVPlanNativePath && "VPlan-native path is not enabled.");
-    assert(UserVF && "Expected UserVF for outer loop vectorization.");
-    assert(isPowerOf2_32(UserVF) && "VF needs to be a power of two");
-    LLVM_DEBUG(dbgs() << "LV: Using user VF " << UserVF << ".\n");
-    buildVPlans(UserVF, UserVF);
+    assert((!UserVF || isPowerOf2_32(UserVF)) &&
+           "VF needs to be a power of two");
+    unsigned MaxVF = UserVF ? UserVF : CM.computeOuterLoopMaxVF();
+    if (MaxVF < 2) {
+      LLVM_DEBUG(dbgs() << "LV: Not vectorizing: No vector width fits the "
+                           "types of the outer loop.\n");
+      return NoVectorization;
+    }
+    buildVPlans(UserVF ? UserVF : 2, MaxVF);
 
     // For VPlan build stress testing, we bail out after VPlan construction.
     if (VPlanBuildStressTest)
       return NoVectorization;
 
-    return {UserVF, 0};
+    if (!UserVF)
+      return CM.selectOuterLoopVectorizationFactor(MaxVF);
+
+    LLVM_DEBUG(dbgs() << "LV: Using user VF " << UserVF << ".\n");
+    Optional<unsigned> Cost = CM.expectedOuterLoopCost(UserVF);
+    if (!Cost) {
+      LLVM_DEBUG(dbgs() << "LV: Not vectorizing: The outer loop cannot be "
+                           "widened by the user VF.\n");
+      return NoVectorization;
+    }
+    return {UserVF, *Cost};
   }
 
   LLVM_DEBUG(
@@ -6428,6 +6871,53 @@ void LoopVectorizationPlanner::collectTriviallyDeadInstructions(
 
 Value *InnerLoopUnroller::reverseVector(Value *Vec) { return Vec; }
 
+void InnerLoopEpilogueVectorizer::emitSCEVChecks(Loop *L, BasicBlock *Bypass) {
+  // The SCEV checks of the main loop cover the iterations of the epilogue.
+}
+
+void InnerLoopEpilogueVectorizer::emitMemRuntimeChecks(Loop *L,
+                                                       BasicBlock *Bypass) {
+  // The memory checks of the main loop cover the accesses of all the
+  // iterations, including those of the epilogue.
+}
+
+void InnerLoopEpilogueVectorizer::updateAnalysis() {
+  // The preheader of the epilogue is the scalar preheader of the main loop,
+  // which the bypass blocks of the main loop branch to. If the main loop has
+  // runtime checks, they were not run or failed on these paths: send all of
+  // these blocks to the scalar loop directly, with the start values they were
+  // passing to the epilogue.
+  BasicBlock *EpiloguePH = LoopBypassBlocks.front();
+  BasicBlock *ScalarPHDom = EpiloguePH;
+  if (MainBypassBlocks.size() > 1) {
+    for (BasicBlock *BB : MainBypassBlocks) {
+      for (PHINode &Phi : LoopScalarPreHeader->phis()) {
+        Value *V = Phi.getIncomingValueForBlock(EpiloguePH);
+        auto *MainPhi = dyn_cast<PHINode>(V);
+        if (MainPhi && MainPhi->getParent() == EpiloguePH)
+          V = MainPhi->getIncomingValueForBlock(BB);
+        Phi.addIncoming(V, BB);
+      }
+      for (PHINode &Phi : EpiloguePH->phis())
+        Phi.removeIncomingValue(BB, /*DeletePHIIfEmpty=*/false);
+      BB->getTerminator()->replaceUsesOfWith(EpiloguePH, LoopScalarPreHeader);
+    }
+    DT->changeImmediateDominator(EpiloguePH, MainMiddleBlock);
+    ScalarPHDom = MainBypassBlocks.front();
+  }
+
+  // Forget the original basic block.
+  PSE.getSE()->forgetLoop(OrigLoop);
+
+  // Update the dominator tree information. The exit block is still dominated
+  // by the entry of the main vector loop.
+  DT->addNewBlock(LoopMiddleBlock,
+                  LI->getLoopFor(LoopVectorBody)->getLoopLatch());
+  DT->addNewBlock(LoopScalarPreHeader, ScalarPHDom);
+  DT->changeImmediateDominator(LoopScalarBody, LoopScalarPreHeader);
+  assert(DT->verify(DominatorTree::VerificationLevel::Fast));
+}
+
 Value *InnerLoopUnroller::getBroadcastInstrs(Value *V) { return V; }
 
 Value *InnerLoopUnroller::getStepVector(Value *Val, int StartIdx, Value *Step,
@@ -7063,6 +7553,21 @@ LoopVectorizationPlanner::buildVPlan(VFRange &Range) {
   VPlanHCFGBuilder HCFGBuilder(OrigLoop, LI, *Plan);
   HCFGBuilder.buildHierarchicalCFG();
 
+  for (unsigned VF = Range.Start; VF < Range.End; VF *= 2)
+    Plan->addVF(VF);
+
+  // The control of the outer loop and the debug intrinsics are not widened.
+  SmallPtrSet<Instruction *, 4> DeadInstructions;
+  collectTriviallyDeadInstructions(DeadInstructions);
+  for (BasicBlock *BB : OrigLoop->blocks())
+    for (Instruction &I : *BB)
+      if (isa<DbgInfoIntrinsic>(I))
+        DeadInstructions.insert(&I);
+
+  VPlanHCFGTransforms::VPInstructionsToVPRecipes(
+      Plan, Legal->getInductionVars(), DeadInstructions);
+  VPlanHCFGTransforms::removeOuterLoopControl(Plan);
+
   return Plan;
 }
 
@@ -7094,6 +7599,8 @@ void VPWidenIntOrFpInductionRecipe::execute(VPTransformState &State) {
 
 void VPWidenPHIRecipe::execute(VPTransformState &State) {
   State.ILV->widenPHIInstruction(Phi, State.UF, State.VF);
+  if (State.ILV->isVectorizingOuterLoop())
+    State.CFG.PHIsToFix.push_back(this);
 }
 
 void VPBlendRecipe::execute(VPTransformState &State) {
@@ -7251,8 +7758,6 @@ static bool processLoopInVPlanNativePath(
   LoopVectorizationCostModel CM(L, PSE, LI, LVL, *TTI, TLI, DB, AC, ORE, F,
                                 &Hints, IAI);
   // Use the planner for outer loop vectorization.
-  // TODO: CM is not used at this point inside the planner. Turn CM into an
-  // optional argument if we don't need it in the future.
   LoopVectorizationPlanner LVP(L, LI, TLI, TTI, LVL, CM);
 
   // Get user vectorization factor.
@@ -7264,11 +7769,93 @@ static bool processLoopInVPlanNativePath(
       Hints.getForce() != LoopVectorizeHints::FK_Enabled && F->optForSize();
 
   // Plan how to best vectorize, return the best VF and its cost.
-  LVP.planInVPlanNativePath(OptForSize, UserVF);
+  VectorizationFactor VF = LVP.planInVPlanNativePath(OptForSize, UserVF);
 
-  // Returning false. We are currently not generating vector code in the VPlan
-  // native path.
-  return false;
+  // If we are stress testing VPlan builds, do not attempt to generate vector
+  // code.
+  if (VPlanBuildStressTest || VF.Width == 1)
+    return false;
+
+  LVP.setBestPlan(VF.Width, 1);
+
+  InnerLoopVectorizer LB(L, PSE, LI, DT, TLI, TTI, AC, ORE, VF.Width, 1, LVL,
+                         &CM);
+  LLVM_DEBUG(dbgs() << "Vectorizing outer loop in \""
+                    << L->getHeader()->getParent()->getName() << "\"\n");
+  LVP.executePlan(LB, DT);
+  ++LoopsVectorized;
+
+  ORE->emit([&]() {
+    return OptimizationRemark(LV_NAME, "Vectorized", L->getStartLoc(),
+                              L->getHeader())
+           << "vectorized outer loop (vectorization width: "
+           << ore::NV("VectorizationFactor", VF.Width) << ")";
+  });
+
+  // Mark the loop as already vectorized to avoid vectorizing again.
+  Hints.setAlreadyVectorized();
+
+  LLVM_DEBUG(verifyFunction(*L->getHeader()->getParent()));
+  return true;
+}
+
+bool LoopVectorizePass::processEpilogueLoop(Loop *L,
+                                            const InnerLoopVectorizer &MainILV,
+                                            unsigned VF,
+                                            LoopVectorizeHints &Hints,
+                                            bool UseInterleaved) {
+  LLVM_DEBUG(dbgs() << "LV: Vectorizing the epilogue with VF " << VF
+                    << ".\n");
+
+  // The inductions and reductions of the remainder loop now start from the
+  // resume values of the main vector loop, so its legality and costs are
+  // recomputed. Its memory accesses are those of the main loop, whose runtime
+  // checks cover them, but it should not need any SCEV assumptions of its own.
+  // The cached access analysis of the loop describes the pointers before the
+  // main loop was vectorized, so it is computed again rather than reused.
+  Function *F = L->getHeader()->getParent();
+  PredicatedScalarEvolution PSE(*SE, *L);
+  LoopAccessInfo EpilogueLAI(L, SE, TLI, AA, DT, LI);
+  std::function<const LoopAccessInfo &(Loop &)> GetEpilogueLAI =
+      [&](Loop &) -> const LoopAccessInfo & { return EpilogueLAI; };
+  LoopVectorizationRequirements Requirements(*ORE);
+  LoopVectorizationLegality LVL(L, PSE, DT, TLI, AA, F, &GetEpilogueLAI, LI,
+                                ORE, &Requirements, &Hints, DB, AC);
+  if (!LVL.canVectorize(false) || !PSE.getUnionPredicate().isAlwaysTrue()) {
+    LLVM_DEBUG(dbgs() << "LV: Not vectorizing the epilogue: Cannot prove "
+                         "legality.\n");
+    return false;
+  }
+
+  InterleavedAccessInfo IAI(PSE, L, DT, LI, LVL.getLAI());
+  if (UseInterleaved)
+    IAI.analyzeInterleaving();
+
+  LoopVectorizationCostModel CM(L, PSE, LI, &LVL, *TTI, TLI, DB, AC, ORE, F,
+                                &Hints, IAI);
+  CM.collectValuesToIgnore();
+
+  LoopVectorizationPlanner LVP(L, LI, TLI, TTI, &LVL, CM);
+  if (LVP.plan(/*OptForSize=*/false, VF).Width != VF ||
+      !PSE.getUnionPredicate().isAlwaysTrue()) {
+    LLVM_DEBUG(dbgs() << "LV: Not vectorizing the epilogue: It needs runtime "
+                         "checks of its own.\n");
+    return false;
+  }
+  LVP.setBestPlan(VF, 1);
+
+  InnerLoopEpilogueVectorizer EpilogueILV(L, PSE, LI, DT, TLI, TTI, AC, ORE, VF,
+                                          &LVL, &CM, MainILV);
+  LVP.executePlan(EpilogueILV, DT);
+  ++LoopEpiloguesVectorized;
+
+  ORE->emit([&]() {
+    return OptimizationRemark(LV_NAME, "EpilogueVectorized", L->getStartLoc(),
+                              L->getHeader())
+           << "vectorized epilogue loop (vectorization width: "
+           << ore::NV("VectorizationFactor", VF) << ")";
+  });
+  return true;
 }
 
 bool LoopVectorizePass::processLoop(Loop *L) {
@@ -7488,6 +8075,12 @@ bool LoopVectorizePass::processLoop(Loop *L) {
   // Override IC if user provided an interleave count.
   IC = UserIC > 0 ? UserIC : IC;
 
+  // The remainder of a loop vectorized with a large vectorization factor may
+  // run many iterations, which are worth vectorizing with a smaller one.
+  unsigned EpilogueVF = 1;
+  if (VectorizeLoop && !OptForSize)
+    EpilogueVF = CM.selectEpilogueVectorizationFactor(VF.Width, IC);
+
   // Emit diagnostic messages, if any.
   const char *VAPassName = Hints.vectorizeAnalysisPassName();
   if (!VectorizeLoop && !InterleaveLoop) {
@@ -7549,6 +8142,9 @@ bool LoopVectorizePass::processLoop(Loop *L) {
     LVP.executePlan(LB, DT);
     ++LoopsVectorized;
 
+    if (EpilogueVF > 1)
+      processEpilogueLoop(L, LB, EpilogueVF, Hints, UseInterleaved);
+
     // Add metadata to disable runtime unrolling a scalar loop when there are
     // no runtime checks about strides and memory. A scalar loop that is
     // rarely used is not worth unrolling.
@@ -144,6 +144,16 @@ static cl::opt<unsigned> MinTreeSize(
     "slp-min-tree-size", cl::init(3), cl::Hidden,
     cl::desc("Only vectorize small trees if they are fully vectorizable"));
 
+static cl::opt<bool> VectorizeNonPowerOf2(
+    "slp-vectorize-non-power-of-2", cl::init(false), cl::Hidden,
+    cl::desc("Try to vectorize store chains and lists whose length is not a "
+             "power of two as a single padded vector"));
+
+static cl::opt<bool> ModelRegisterPressure(
+    "slp-model-register-pressure", cl::init(false), cl::Hidden,
+    cl::desc("Add the cost of spilling the vector values that do not fit in "
+             "the vector registers to the cost of the tree"));
+
 static cl::opt<bool>
     ViewSLPTree("view-slp-tree", cl::Hidden,
                 cl::desc("Display the SLP trees with Graphviz"));
@@ -403,6 +413,28 @@ static bool allSameType(ArrayRef<Value *> VL) {
   return true;
 }
 
+/// Collects the operands of the compares in \p VL into \p Left and \p Right.
+/// The operands of a compare whose predicate is the swapped predicate of the
+/// first compare (e.g. 'b > a' next to 'a < b') are exchanged, so that every
+/// lane computes the predicate of the first compare.
+static void getCmpOperands(ArrayRef<Value *> VL,
+                           SmallVectorImpl<Value *> &Left,
+                           SmallVectorImpl<Value *> &Right) {
+  CmpInst::Predicate P0 = cast<CmpInst>(VL[0])->getPredicate();
+  for (Value *V : VL) {
+    auto *Cmp = cast<CmpInst>(V);
+    if (Cmp->getPredicate() != P0) {
+      assert(Cmp->getPredicate() == CmpInst::getSwappedPredicate(P0) &&
+             "Expected the same or the swapped predicate");
+      Left.push_back(Cmp->getOperand(1));
+      Right.push_back(Cmp->getOperand(0));
+      continue;
+    }
+    Left.push_back(Cmp->getOperand(0));
+    Right.push_back(Cmp->getOperand(1));
+  }
+}
+
 /// \returns True if Extract{Value,Element} instruction extracts element Idx.
 static Optional<unsigned> getExtractIndex(Instruction *E) {
   unsigned Opcode = E->getOpcode();
@@ -1708,12 +1740,14 @@ void BoUpSLP::buildTree_rec(ArrayRef<Value *> VL, unsigned Depth,
     }
     case Instruction::ICmp:
     case Instruction::FCmp: {
-      // Check that all of the compares have the same predicate.
+      // Check that all of the compares have the same predicate, or the same
+      // predicate with their operands swapped.
       CmpInst::Predicate P0 = cast<CmpInst>(VL0)->getPredicate();
+      CmpInst::Predicate SwapP0 = CmpInst::getSwappedPredicate(P0);
       Type *ComparedTy = VL0->getOperand(0)->getType();
       for (unsigned i = 1, e = VL.size(); i < e; ++i) {
         CmpInst *Cmp = cast<CmpInst>(VL[i]);
-        if (Cmp->getPredicate() != P0 ||
+        if ((Cmp->getPredicate() != P0 && Cmp->getPredicate() != SwapP0) ||
             Cmp->getOperand(0)->getType() != ComparedTy) {
           BS.cancelScheduling(VL, VL0);
           newTreeEntry(VL, false, UserTreeIdx, ReuseShuffleIndicies);
@@ -1726,14 +1760,10 @@ void BoUpSLP::buildTree_rec(ArrayRef<Value *> VL, unsigned Depth,
       newTreeEntry(VL, true, UserTreeIdx, ReuseShuffleIndicies);
       LLVM_DEBUG(dbgs() << "SLP: added a vector of compares.\n");
 
-      for (unsigned i = 0, e = VL0->getNumOperands(); i < e; ++i) {
-        ValueList Operands;
-        // Prepare the operand vector.
-        for (Value *j : VL)
-          Operands.push_back(cast<Instruction>(j)->getOperand(i));
-
-        buildTree_rec(Operands, Depth + 1, UserTreeIdx);
-      }
+      ValueList Left, Right;
+      getCmpOperands(VL, Left, Right);
+      buildTree_rec(Left, Depth + 1, UserTreeIdx);
+      buildTree_rec(Right, Depth + 1, UserTreeIdx);
       return;
     }
     case Instruction::Select:
@@ -2461,11 +2491,14 @@ int BoUpSLP::getSpillCost() {
   // Walk from the bottom of the tree to the top, tracking which values are
   // live. When we see a call instruction that is not part of our tree,
   // query TTI to see if there is a cost to keeping values live over it
-  // (for example, if spills and fills are required).
+  // (for example, if spills and fills are required). The largest number of
+  // values live at once is compared against the number of vector registers,
+  // and the values that do not fit are assumed to be spilled and reloaded.
   unsigned BundleWidth = VectorizableTree.front().Scalars.size();
   int Cost = 0;
 
   SmallPtrSet<Instruction*, 4> LiveValues;
+  unsigned MaxLiveValues = 0;
   Instruction *PrevInst = nullptr;
 
   for (const auto &N : VectorizableTree) {
@@ -2484,6 +2517,7 @@ int BoUpSLP::getSpillCost() {
       if (isa<Instruction>(&*J) && getTreeEntry(&*J))
         LiveValues.insert(cast<Instruction>(&*J));
     }
+    MaxLiveValues = std::max<unsigned>(MaxLiveValues, LiveValues.size());
 
     LLVM_DEBUG({
       dbgs() << "SLP: #LV: " << LiveValues.size();
@@ -2519,6 +2553,22 @@ int BoUpSLP::getSpillCost() {
     PrevInst = Inst;
   }
 
+  unsigned NumRegs = TTI->getNumberOfRegisters(/*Vector=*/true);
+  if (ModelRegisterPressure && NumRegs && MaxLiveValues > NumRegs) {
+    auto *RootInst = cast<Instruction>(VectorizableTree.front().Scalars[0]);
+    Type *ScalarTy = RootInst->getType();
+    if (auto *SI = dyn_cast<StoreInst>(RootInst))
+      ScalarTy = SI->getValueOperand()->getType();
+    auto *VecTy = VectorType::get(ScalarTy, BundleWidth);
+    unsigned Alignment = DL->getABITypeAlignment(VecTy);
+    int SpillFillCost =
+        TTI->getMemoryOpCost(Instruction::Store, VecTy, Alignment, 0) +
+        TTI->getMemoryOpCost(Instruction::Load, VecTy, Alignment, 0);
+    LLVM_DEBUG(dbgs() << "SLP: " << MaxLiveValues << " live vector values for "
+                      << NumRegs << " registers.\n");
+    Cost += (MaxLiveValues - NumRegs) * SpillFillCost;
+  }
+
   return Cost;
 }
 
@@ -3203,10 +3253,7 @@ Value *BoUpSLP::vectorizeTree(TreeEntry *E) {
     case Instruction::FCmp:
     case Instruction::ICmp: {
       ValueList LHSV, RHSV;
-      for (Value *V : E->Scalars) {
-        LHSV.push_back(cast<Instruction>(V)->getOperand(0));
-        RHSV.push_back(cast<Instruction>(V)->getOperand(1));
-      }
+      getCmpOperands(E->Scalars, LHSV, RHSV);
 
       setInsertPointAfterBundle(E->Scalars, S);
 
@@ -4675,6 +4722,19 @@ static bool hasValueBeenRAUWed(ArrayRef<Value *> VL,
   return !std::equal(VL.begin(), VL.end(), VH.begin());
 }
 
+/// \returns true if a bundle of \p NumElts elements of \p Sz bits, where
+/// \p NumElts is not a power of two, may be vectorized as a single vector. Its
+/// register is padded to the next power of two during legalization, so that
+/// must fit the vector registers of the target.
+static bool isLegalNonPowerOf2VF(unsigned NumElts, unsigned Sz,
+                                 const BoUpSLP &R) {
+  if (!VectorizeNonPowerOf2 || NumElts < 3 || isPowerOf2_32(NumElts))
+    return false;
+  uint64_t PaddedSize = PowerOf2Ceil(NumElts) * Sz;
+  return PaddedSize >= R.getMinVecRegSize() &&
+         PaddedSize <= R.getMaxVecRegSize();
+}
+
 bool SLPVectorizerPass::vectorizeStoreChain(ArrayRef<Value *> Chain, BoUpSLP &R,
                                             unsigned VecRegSize) {
   const unsigned ChainLen = Chain.size();
@@ -4796,14 +4856,22 @@ bool SLPVectorizerPass::vectorizeStores(ArrayRef<StoreInst *> Stores,
 
     // FIXME: Is division-by-2 the correct step? Should we assert that the
     // register size is a power-of-2?
-    for (unsigned Size = R.getMaxVecRegSize(); Size >= R.getMinVecRegSize();
-         Size /= 2) {
-      if (vectorizeStoreChain(Operands, R, Size)) {
-        // Mark the vectorized stores so that we don't vectorize them again.
-        VectorizedStores.insert(Operands.begin(), Operands.end());
-        Changed = true;
-        break;
-      }
+    // A chain such as the three fields of a point does not fill any power of
+    // two vector factor, but may still be stored as one padded vector, which
+    // covers more of the chain than any power of two factor that fits.
+    unsigned Sz = R.getVectorElementSize(Operands[0]);
+    bool ChainVectorized =
+        isLegalNonPowerOf2VF(Operands.size(), Sz, R) &&
+        vectorizeStoreChain(Operands, R, Operands.size() * Sz);
+
+    for (unsigned Size = R.getMaxVecRegSize();
+         !ChainVectorized && Size >= R.getMinVecRegSize(); Size /= 2)
+      ChainVectorized = vectorizeStoreChain(Operands, R, Size);
+
+    if (ChainVectorized) {
+      // Mark the vectorized stores so that we don't vectorize them again.
+      VectorizedStores.insert(Operands.begin(), Operands.end());
+      Changed = true;
     }
   }
 
@@ -4904,8 +4972,16 @@ bool SLPVectorizerPass::tryToVectorizeList(ArrayRef<Value *> VL, BoUpSLP &R,
   SmallVector<WeakTrackingVH, 8> TrackValues(VL.begin(), VL.end());
 
   unsigned NextInst = 0, MaxInst = VL.size();
-  for (unsigned VF = MaxVF; NextInst + 1 < MaxInst && VF >= MinVF;
-       VF /= 2) {
+  // A list whose length is not a power of two is first tried as a single
+  // vector, before it is split into power of two bundles.
+  SmallVector<unsigned, 8> VFs;
+  if (isLegalNonPowerOf2VF(MaxInst, Sz, R))
+    VFs.push_back(MaxInst);
+  for (unsigned VF = MaxVF; VF >= MinVF; VF /= 2)
+    VFs.push_back(VF);
+  for (unsigned VF : VFs) {
+    if (NextInst + 1 >= MaxInst)
+      break;
     // No actual vectorization should happen, if number of parts is the same as
     // provided vectorization factor (i.e. the scalar type is used for vector
     // code during codegen).
@@ -4920,7 +4996,7 @@ bool SLPVectorizerPass::tryToVectorizeList(ArrayRef<Value *> VL, BoUpSLP &R,
       else
         OpsWidth = VF;
 
-      if (!isPowerOf2_32(OpsWidth) || OpsWidth < 2)
+      if ((!isPowerOf2_32(OpsWidth) && OpsWidth != VF) || OpsWidth < 2)
         break;
 
       // Check that a previous iteration of this loop did not delete the Value.
@@ -32,6 +32,7 @@
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Value.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/GenericDomTreeConstruction.h"
@@ -47,6 +48,8 @@ using namespace llvm;
 
 #define DEBUG_TYPE "vplan"
 
+extern cl::opt<bool> EnableVPlanNativePath;
+
 raw_ostream &llvm::operator<<(raw_ostream &OS, const VPValue &V) {
   if (const VPInstruction *Instr = dyn_cast<VPInstruction>(&V))
     Instr->print(OS);
@@ -124,7 +127,19 @@ VPBasicBlock::createEmptyBasicBlock(VPTransformState::CFGState &CFG) {
     VPBasicBlock *PredVPBB = PredVPBlock->getExitBasicBlock();
     auto &PredVPSuccessors = PredVPBB->getSuccessors();
     BasicBlock *PredBB = CFG.VPBB2IRBB[PredVPBB];
-    assert(PredBB && "Predecessor basic-block not found building successor.");
+
+    // In outer loop vectorization, the predecessor may not have been visited
+    // yet if it is reached through a backedge of an inner loop. Record it so
+    // its terminator is fixed at the end of vector code generation. Inner
+    // loop vectorization never gets here for the header, whose skeleton is
+    // built upfront.
+    if (!PredBB) {
+      assert(EnableVPlanNativePath &&
+             "Unexpected null predecessor in non VPlan-native path");
+      CFG.VPBBsToFix.push_back(PredVPBB);
+      continue;
+    }
+
     auto *PredBBTerminator = PredBB->getTerminator();
     LLVM_DEBUG(dbgs() << "LV: draw edge from" << PredBB->getName() << '\n');
     if (isa<UnreachableInst>(PredBBTerminator)) {
@@ -185,6 +200,27 @@ void VPBasicBlock::execute(VPTransformState *State) {
   for (VPRecipeBase &Recipe : Recipes)
     Recipe.execute(*State);
 
+  // In the VPlan-native path all branches are uniform, so the condition bit of
+  // the block is taken from lane 0 of its vector value. The successors of the
+  // new conditional branch are set as they are visited, or at the end of
+  // vector code generation for backedges.
+  VPValue *CBV;
+  if (EnableVPlanNativePath && (CBV = getCondBit()) &&
+      isa<UnreachableInst>(NewBB->getTerminator())) {
+    Value *IRCBV = CBV->getUnderlyingValue();
+    assert(IRCBV && "Unexpected null underlying value for condition bit");
+    Value *NewCond = State->Callback.getOrCreateVectorValues(IRCBV, 0);
+    if (NewCond->getType()->isVectorTy())
+      NewCond = State->Builder.CreateExtractElement(
+          NewCond, State->Builder.getInt32(0));
+    // Replace the temporary unreachable terminator with the new conditional
+    // branch.
+    auto *CurrentTerminator = NewBB->getTerminator();
+    auto *CondBr = BranchInst::Create(NewBB, nullptr, NewCond);
+    CondBr->setSuccessor(0, nullptr);
+    ReplaceInstWithInst(CurrentTerminator, CondBr);
+  }
+
   LLVM_DEBUG(dbgs() << "LV: filled BB:" << *NewBB);
 }
 
@@ -319,8 +355,37 @@ void VPlan::execute(VPTransformState *State) {
   for (VPBlockBase *Block : depth_first(Entry))
     Block->execute(State);
 
+  // Set up the successors of the terminators of the blocks in VPBBsToFix,
+  // whose successors were not generated when they were visited.
+  for (VPBasicBlock *VPBB : State->CFG.VPBBsToFix) {
+    BasicBlock *BB = State->CFG.VPBB2IRBB[VPBB];
+    assert(BB && "Unexpected null basic block for VPBB");
+    auto *BBTerminator = BB->getTerminator();
+    if (isa<UnreachableInst>(BBTerminator)) {
+      VPBasicBlock *SuccVPBB =
+          VPBB->getSingleHierarchicalSuccessor()->getEntryBasicBlock();
+      BBTerminator->eraseFromParent();
+      BranchInst::Create(State->CFG.VPBB2IRBB[SuccVPBB], BB);
+      continue;
+    }
+    unsigned Idx = 0;
+    for (VPBlockBase *SuccVPBlock : VPBB->getHierarchicalSuccessors()) {
+      VPBasicBlock *SuccVPBB = SuccVPBlock->getEntryBasicBlock();
+      BBTerminator->setSuccessor(Idx, State->CFG.VPBB2IRBB[SuccVPBB]);
+      ++Idx;
+    }
+  }
+
+  // All the blocks exist now, so the widened phis can be completed.
+  for (VPWidenPHIRecipe *PhiR : State->CFG.PHIsToFix)
+    PhiR->addIncomingValues(*State);
+
   // 3. Merge the temporary latch created with the last basic-block filled.
+  // When the body has inner loops, the last block filled in depth-first order
+  // is not necessarily the exit of the plan.
   BasicBlock *LastBB = State->CFG.PrevBB;
+  if (!State->CFG.VPBBsToFix.empty())
+    LastBB = State->CFG.VPBB2IRBB[Entry->getExitBasicBlock()];
   // Connect LastBB to VectorLatchBB to facilitate their merge.
   assert(isa<UnreachableInst>(LastBB->getTerminator()) &&
          "Expected VPlan CFG to terminate with unreachable");
@@ -333,9 +398,38 @@ void VPlan::execute(VPTransformState *State) {
   assert(Merged && "Could not merge last basic block with latch.");
   VectorLatchBB = LastBB;
 
+  // The vector loop body of an outer loop may contain inner loops, which
+  // updateDominatorTree does not handle. The vectorizer recomputes the
+  // dominator tree in that case.
+  if (!State->CFG.VPBBsToFix.empty())
+    return;
+
   updateDominatorTree(State->DT, VectorPreHeaderBB, VectorLatchBB);
 }
 
+void VPWidenPHIRecipe::addIncomingValues(VPTransformState &State) {
+  // The predecessors of the VPBasicBlock are in the order of the predecessors
+  // of the original block, which the generated block does not necessarily
+  // follow.
+  VPBasicBlock *VPBB = getParent();
+  BasicBlock *OrigBB = Phi->getParent();
+  SmallVector<BasicBlock *, 4> OrigPreds(pred_begin(OrigBB), pred_end(OrigBB));
+  auto &VPPreds = VPBB->getHierarchicalPredecessors();
+  assert(OrigPreds.size() == VPPreds.size() &&
+         "Mismatch between original and VPlan predecessors");
+
+  for (unsigned Part = 0; Part < State.UF; ++Part) {
+    auto *NewPhi = cast<PHINode>(State.ValueMap.getVectorValue(Phi, Part));
+    for (unsigned I = 0, E = OrigPreds.size(); I != E; ++I) {
+      Value *IncomingV = Phi->getIncomingValueForBlock(OrigPreds[I]);
+      BasicBlock *NewPredBB =
+          State.CFG.VPBB2IRBB[VPPreds[I]->getExitBasicBlock()];
+      NewPhi->addIncoming(
+          State.Callback.getOrCreateVectorValues(IncomingV, Part), NewPredBB);
+    }
+  }
+}
+
 void VPlan::updateDominatorTree(DominatorTree *DT, BasicBlock *LoopPreHeaderBB,
                                 BasicBlock *LoopLatchBB) {
   BasicBlock *LoopHeaderBB = LoopPreHeaderBB->getSingleSuccessor();
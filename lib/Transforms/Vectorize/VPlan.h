@@ -57,6 +57,7 @@ class raw_ostream;
 class Value;
 class VPBasicBlock;
 class VPRegionBlock;
+class VPWidenPHIRecipe;
 class VPlan;
 
 /// A range of powers-of-2 vectorization factors with fixed start and
@@ -293,6 +294,17 @@ struct VPTransformState {
     /// of replication, maps the BasicBlock of the last replica created.
     SmallDenseMap<VPBasicBlock *, BasicBlock *> VPBB2IRBB;
 
+    /// Vector of VPBasicBlocks whose terminator instruction needs to be fixed
+    /// up at the end of vector code generation. Only used in the VPlan-native
+    /// path, for the predecessors reached through the backedges of inner
+    /// loops.
+    SmallVector<VPBasicBlock *, 8> VPBBsToFix;
+
+    /// Widened phis whose incoming values are added at the end of vector code
+    /// generation, once all their incoming blocks exist. Only used in the
+    /// VPlan-native path.
+    SmallVector<VPWidenPHIRecipe *, 8> PHIsToFix;
+
     CFGState() = default;
   } CFG;
 
@@ -725,6 +737,11 @@ public:
   /// Generate the phi/select nodes.
   void execute(VPTransformState &State) override;
 
+  /// Add the incoming values of the vector phi generated in the VPlan-native
+  /// path. This must be called once all the predecessors of the parent block
+  /// have been generated.
+  void addIncomingValues(VPTransformState &State);
+
   /// Print the recipe.
   void print(raw_ostream &O, const Twine &Indent) const override;
 };
@@ -30,6 +30,16 @@ void VPlanHCFGTransforms::VPInstructionsToVPRecipes(
       continue;
 
     VPBasicBlock *VPBB = Base->getEntryBasicBlock();
+
+    // Condition bits are not recipes, but they may refer to VPInstructions
+    // that are erased below or that live in the pre-header. Represent them as
+    // external definitions of the same IR values instead.
+    if (auto *CondBit = dyn_cast_or_null<VPInstruction>(VPBB->getCondBit())) {
+      auto *NewCondBit = new VPValue(CondBit->getUnderlyingValue());
+      Plan->addExternalDef(NewCondBit);
+      VPBB->setCondBit(NewCondBit);
+    }
+
     VPRecipeBase *LastRecipe = nullptr;
     // Introduce each ingredient into VPlan.
     for (auto I = VPBB->begin(), E = VPBB->end(); I != E;) {
@@ -56,9 +66,11 @@ void VPlanHCFGTransforms::VPInstructionsToVPRecipes(
       } else {
         // If the last recipe is a VPWidenRecipe, add Inst to it instead of
         // creating a new recipe.
-        if (VPWidenRecipe *WidenRecipe =
-                dyn_cast_or_null<VPWidenRecipe>(LastRecipe)) {
-          WidenRecipe->appendInstruction(Inst);
+        // Instructions can only be appended if they are contiguous to the
+        // ones already in the recipe, which is not the case when a dead
+        // instruction was skipped in between.
+        auto *WidenRecipe = dyn_cast_or_null<VPWidenRecipe>(LastRecipe);
+        if (WidenRecipe && WidenRecipe->appendInstruction(Inst)) {
           Ingredient->eraseFromParent();
           continue;
         }
@@ -71,3 +83,22 @@ void VPlanHCFGTransforms::VPInstructionsToVPRecipes(
     }
   }
 }
+
+void VPlanHCFGTransforms::removeOuterLoopControl(VPlanPtr &Plan) {
+  auto *TopRegion = cast<VPRegionBlock>(Plan->getEntry());
+  VPBlockBase *PreheaderVPBB = TopRegion->getEntry();
+  VPBlockBase *ExitVPBB = TopRegion->getExit();
+  VPBlockBase *HeaderVPBB = PreheaderVPBB->getSingleSuccessor();
+  VPBlockBase *LatchVPBB = ExitVPBB->getSinglePredecessor();
+  assert(HeaderVPBB && LatchVPBB && "Expected a loop with a single latch");
+
+  VPBlockUtils::disconnectBlocks(PreheaderVPBB, HeaderVPBB);
+  VPBlockUtils::disconnectBlocks(LatchVPBB, HeaderVPBB);
+  VPBlockUtils::disconnectBlocks(LatchVPBB, ExitVPBB);
+  LatchVPBB->setCondBit(nullptr);
+
+  TopRegion->setEntry(HeaderVPBB);
+  TopRegion->setExit(LatchVPBB);
+  delete PreheaderVPBB;
+  delete ExitVPBB;
+}
@@ -29,6 +29,12 @@ public:
       VPlanPtr &Plan,
       LoopVectorizationLegality::InductionList *Inductions,
       SmallPtrSetImpl<Instruction *> &DeadInstructions);
+
+  /// Removes the pre-header, the exit and the backedge of the outermost loop
+  /// from the plain CFG of \p Plan. They are provided by the vector loop
+  /// skeleton when the plan is executed, so the Top Region is left with the
+  /// body of the loop, from its header to its latch.
+  static void removeOuterLoopControl(VPlanPtr &Plan);
 };
 
 } // namespace llvm
@@ -0,0 +1,70 @@
+; RUN: llc -mtriple=x86_64-unknown-linux-gnu < %s | FileCheck %s
+; RUN: sed -e 's/SyntheticProfile/InstrProf/' %s | llc -mtriple=x86_64-unknown-linux-gnu | FileCheck %s --check-prefix=INSTR
+
+; Check that the blocks of a function whose synthetic entry count is cold are
+; laid out as if the function was optimized for size, so the loop header is
+; not aligned. Real profiles leave the layout of cold functions unchanged.
+
+; CHECK-LABEL: hot:
+; CHECK:         .p2align 4
+; CHECK:         callq f
+; CHECK-LABEL: cold:
+; CHECK-NOT:     .p2align
+; CHECK:         callq f
+
+; INSTR-LABEL: hot:
+; INSTR:         .p2align 4
+; INSTR:         callq f
+; INSTR-LABEL: cold:
+; INSTR:         .p2align 4
+; INSTR:         callq f
+
+declare void @f()
+
+define void @hot(i32 %n) !prof !15 {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  call void @f()
+  %i.next = add nuw i32 %i, 1
+  %c = icmp ult i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+define void @cold(i32 %n) !prof !16 {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  call void @f()
+  %i.next = add nuw i32 %i, 1
+  %c = icmp ult i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+!llvm.module.flags = !{!0}
+!0 = !{i32 1, !"ProfileSummary", !1}
+!1 = !{!2, !3, !4, !5, !6, !7, !8, !9}
+!2 = !{!"ProfileFormat", !"SyntheticProfile"}
+!3 = !{!"TotalCount", i64 10000}
+!4 = !{!"MaxCount", i64 1000}
+!5 = !{!"MaxInternalCount", i64 1}
+!6 = !{!"MaxFunctionCount", i64 1000}
+!7 = !{!"NumCounts", i64 3}
+!8 = !{!"NumFunctions", i64 3}
+!9 = !{!"DetailedSummary", !10}
+!10 = !{!11, !12, !13}
+!11 = !{i32 10000, i64 1000, i32 1}
+!12 = !{i32 999000, i64 1000, i32 3}
+!13 = !{i32 999999, i64 5, i32 3}
+!15 = !{!"synthetic_function_entry_count", i64 1000}
+!16 = !{!"synthetic_function_entry_count", i64 1}
@@ -0,0 +1,104 @@
+; RUN: opt < %s -instrprof -sampled-instrumentation -sampled-instr-period=100 -sampled-instr-burst-duration=10 -S | FileCheck %s
+; RUN: opt < %s -passes=instrprof -sampled-instrumentation -sampled-instr-period=100 -sampled-instr-burst-duration=10 -S | FileCheck %s
+
+target triple = "x86_64-unknown-linux-gnu"
+
+@__profn_foo = hidden constant [3 x i8] c"foo"
+
+; CHECK: @__llvm_profile_sampling = linkonce_odr hidden thread_local global i32 0, comdat
+
+declare void @llvm.instrprof.increment(i8*, i64, i32, i32)
+
+; The static alloca stays in the new entry block, which selects the
+; instrumented copy for the first calls of every period.
+
+; CHECK-LABEL: define i32 @foo(
+; CHECK-NEXT: pgo.sample:
+; CHECK-NEXT:   %x = alloca i32
+; CHECK-NEXT:   %pgo.sampling = load i32, i32* @__llvm_profile_sampling
+; CHECK-NEXT:   [[NEXT:%.*]] = add i32 %pgo.sampling, 1
+; CHECK-NEXT:   [[WRAP:%.*]] = icmp uge i32 [[NEXT]], 100
+; CHECK-NEXT:   [[SEL:%.*]] = select i1 [[WRAP]], i32 0, i32 [[NEXT]]
+; CHECK-NEXT:   store i32 [[SEL]], i32* @__llvm_profile_sampling
+; CHECK-NEXT:   [[BURST:%.*]] = icmp ult i32 %pgo.sampling, 10
+; CHECK-NEXT:   br i1 [[BURST]], label %entry, label %entry.noinstr, !prof [[PROF:![0-9]+]]
+
+; CHECK:      entry:
+; CHECK:        load i64, i64* getelementptr inbounds ([2 x i64], [2 x i64]* @__profc_foo, i64 0, i64 0)
+; CHECK:        br i1 %c, label %then, label %exit
+; CHECK:      then:
+; CHECK:        load i64, i64* getelementptr inbounds ([2 x i64], [2 x i64]* @__profc_foo, i64 0, i64 1)
+; CHECK:      exit:
+; CHECK-NEXT:   %r = phi i32 [ 1, %then ], [ 0, %entry ]
+
+; CHECK:      entry.noinstr:
+; CHECK-NEXT:   store i32 0, i32* %x
+; CHECK-NEXT:   br i1 %c, label %then.noinstr, label %exit.noinstr
+; CHECK:      then.noinstr:
+; CHECK-NEXT:   br label %exit.noinstr
+; CHECK:      exit.noinstr:
+; CHECK-NEXT:   %r.noinstr = phi i32 [ 1, %then.noinstr ], [ 0, %entry.noinstr ]
+; CHECK-NEXT:   ret i32 %r.noinstr
+
+define i32 @foo(i1 %c) {
+entry:
+  %x = alloca i32
+  call void @llvm.instrprof.increment(i8* getelementptr inbounds ([3 x i8], [3 x i8]* @__profn_foo, i32 0, i32 0), i64 0, i32 2, i32 0)
+  store i32 0, i32* %x
+  br i1 %c, label %then, label %exit
+
+then:
+  call void @llvm.instrprof.increment(i8* getelementptr inbounds ([3 x i8], [3 x i8]* @__profn_foo, i32 0, i32 0), i64 0, i32 2, i32 1)
+  br label %exit
+
+exit:
+  %r = phi i32 [ 1, %then ], [ 0, %entry ]
+  ret i32 %r
+}
+
+; Functions without counters are left alone.
+
+; CHECK-LABEL: define void @bar(
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   ret void
+
+define void @bar() {
+entry:
+  ret void
+}
+
+; Functions with convergent or noduplicate calls are not duplicated.
+
+@__profn_conv = hidden constant [4 x i8] c"conv"
+@__profn_nodup = hidden constant [5 x i8] c"nodup"
+
+declare void @barrier() convergent
+declare void @unique() noduplicate
+
+; CHECK-LABEL: define void @conv(
+; CHECK-NEXT: entry:
+; CHECK-NOT:    pgo.sample
+; CHECK:        call void @barrier()
+; CHECK-NEXT:   ret void
+
+define void @conv() {
+entry:
+  call void @llvm.instrprof.increment(i8* getelementptr inbounds ([4 x i8], [4 x i8]* @__profn_conv, i32 0, i32 0), i64 0, i32 1, i32 0)
+  call void @barrier()
+  ret void
+}
+
+; CHECK-LABEL: define void @nodup(
+; CHECK-NEXT: entry:
+; CHECK-NOT:    pgo.sample
+; CHECK:        call void @unique()
+; CHECK-NEXT:   ret void
+
+define void @nodup() {
+entry:
+  call void @llvm.instrprof.increment(i8* getelementptr inbounds ([5 x i8], [5 x i8]* @__profn_nodup, i32 0, i32 0), i64 0, i32 1, i32 0)
+  call void @unique()
+  ret void
+}
+
+; CHECK: [[PROF]] = !{!"branch_weights", i32 10, i32 90}
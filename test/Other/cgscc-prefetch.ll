@@ -0,0 +1,70 @@
+; Check that the function analyses of independent RefSCCs are computed ahead
+; of the CGSCC walk with -cgscc-prefetch-threads, and that doing so does not
+; change the optimized code.
+;
+; RUN: opt -disable-output -debug-pass-manager \
+; RUN:     -passes='cgscc(function(require<loops>))' %s 2>&1 \
+; RUN:     | FileCheck %s --check-prefix=NOPREFETCH
+; RUN: opt -disable-output -debug-pass-manager -cgscc-prefetch-threads=2 \
+; RUN:     -passes='cgscc(function(require<loops>))' %s 2>&1 \
+; RUN:     | FileCheck %s --check-prefix=PREFETCH
+;
+; RUN: opt -S -passes='default<O2>' %s -o %t.O2
+; RUN: opt -S -passes='default<O2>' -cgscc-prefetch-threads=4 %s -o %t.O2.prefetch
+; RUN: diff %t.O2 %t.O2.prefetch
+
+; NOPREFETCH: Running analysis: LoopAnalysis on leaf1
+; NOPREFETCH: Running analysis: DominatorTreeAnalysis on leaf1
+; NOPREFETCH: Running analysis: LoopAnalysis on leaf2
+; NOPREFETCH: Running analysis: DominatorTreeAnalysis on leaf2
+; NOPREFETCH: Running analysis: LoopAnalysis on root
+; NOPREFETCH: Running analysis: DominatorTreeAnalysis on root
+
+; PREFETCH-NOT: Running analysis: DominatorTreeAnalysis
+; PREFETCH-NOT: Running analysis: LoopAnalysis
+; PREFETCH: Running pass: RequireAnalysisPass<{{.*}}LoopAnalysis{{.*}}> on leaf1
+; PREFETCH-NOT: Running analysis: DominatorTreeAnalysis
+; PREFETCH-NOT: Running analysis: LoopAnalysis
+; PREFETCH: Running pass: RequireAnalysisPass<{{.*}}LoopAnalysis{{.*}}> on leaf2
+; PREFETCH-NOT: Running analysis: DominatorTreeAnalysis
+; PREFETCH-NOT: Running analysis: LoopAnalysis
+; PREFETCH: Running pass: RequireAnalysisPass<{{.*}}LoopAnalysis{{.*}}> on root
+; PREFETCH-NOT: Running analysis: DominatorTreeAnalysis
+; PREFETCH-NOT: Running analysis: LoopAnalysis
+
+define i32 @leaf1(i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %sum = phi i32 [ 0, %entry ], [ %sum.next, %loop ]
+  %sum.next = add i32 %sum, %i
+  %i.next = add i32 %i, 1
+  %cmp = icmp slt i32 %i.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  ret i32 %sum.next
+}
+
+define i32 @leaf2(i32 %a, i32 %b) {
+entry:
+  %cmp = icmp sgt i32 %a, %b
+  br i1 %cmp, label %then, label %exit
+
+then:
+  %d = sub i32 %a, %b
+  br label %exit
+
+exit:
+  %r = phi i32 [ %d, %then ], [ 0, %entry ]
+  ret i32 %r
+}
+
+define i32 @root(i32 %n) {
+entry:
+  %x = call i32 @leaf1(i32 %n)
+  %y = call i32 @leaf2(i32 %x, i32 %n)
+  ret i32 %y
+}
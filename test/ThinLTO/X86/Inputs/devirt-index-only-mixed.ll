@@ -0,0 +1,18 @@
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-grtev4-linux-gnu"
+
+%struct.A = type { i32 (...)** }
+%struct.D = type { %struct.A }
+
+@_ZTV1D = constant { [4 x i8*] } { [4 x i8*] [i8* null, i8* undef, i8* bitcast (i32 (%struct.D*, i32)* @_ZN1D1fEi to i8*), i8* bitcast (i32 (%struct.D*, i32)* @_ZN1D1nEi to i8*)] }, !type !0, !type !1
+
+define i32 @_ZN1D1fEi(%struct.D* %this, i32 %a) {
+  ret i32 0
+}
+
+define i32 @_ZN1D1nEi(%struct.D* %this, i32 %a) {
+  ret i32 1
+}
+
+!0 = !{i64 16, !"_ZTS1A"}
+!1 = !{i64 16, !"_ZTS1D"}
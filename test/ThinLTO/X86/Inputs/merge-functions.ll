@@ -0,0 +1,26 @@
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@counter = internal global i32 0
+
+define i32 @caller_b(i32 %x) {
+  %r = call i32 @dup_b(i32 %x)
+  ret i32 %r
+}
+
+define i32 @dup_b(i32 %x) unnamed_addr noinline {
+  %y = add i32 %x, 1
+  %z = mul i32 %y, 3
+  ret i32 %z
+}
+
+define i32 @other_b(i32 %x) noinline {
+  %y = add i32 %x, 2
+  %z = mul i32 %y, 3
+  ret i32 %z
+}
+
+define i32 @local_b() noinline {
+  %v = load i32, i32* @counter
+  ret i32 %v
+}
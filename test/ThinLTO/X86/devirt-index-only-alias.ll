@@ -0,0 +1,91 @@
+; REQUIRES: x86-registered-target
+
+; Test that aliases in vtable slots are handled when devirtualizing on the
+; summary index: an alias that cannot be interposed is the same as its
+; aliasee, and any other alias is an unknown target.
+
+; RUN: opt -thinlto-bc -thinlto-split-lto-unit=false -o %t.o %s
+
+; RUN: llvm-lto2 run %t.o -save-temps \
+; RUN:   -o %t3 \
+; RUN:   -r=%t.o,test,px \
+; RUN:   -r=%t.o,_ZN1A1nEi,px \
+; RUN:   -r=%t.o,_ZN1A1hEi,px \
+; RUN:   -r=%t.o,_ZN1B1fEi, \
+; RUN:   -r=%t.o,_ZN1C1fEi,px \
+; RUN:   -r=%t.o,_ZN1C2fEi,px \
+; RUN:   -r=%t.o,_ZN1C1nEi,px \
+; RUN:   -r=%t.o,_ZN1C1hEi,px \
+; RUN:   -r=%t.o,_ZTV1B,px \
+; RUN:   -r=%t.o,_ZTV1C,px
+; RUN: llvm-dis %t3.1.4.opt.bc -o - | FileCheck %s --check-prefix=CHECK-IR
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-grtev4-linux-gnu"
+
+%struct.A = type { i32 (...)** }
+%struct.B = type { %struct.A }
+%struct.C = type { %struct.A }
+
+@_ZTV1B = constant { [5 x i8*] } { [5 x i8*] [i8* null, i8* undef, i8* bitcast (i32 (%struct.B*, i32)* @_ZN1B1fEi to i8*), i8* bitcast (i32 (%struct.A*, i32)* @_ZN1A1nEi to i8*), i8* bitcast (i32 (%struct.A*, i32)* @_ZN1A1hEi to i8*)] }, !type !0, !type !1
+@_ZTV1C = constant { [5 x i8*] } { [5 x i8*] [i8* null, i8* undef, i8* bitcast (i32 (%struct.C*, i32)* @_ZN1C1fEi to i8*), i8* bitcast (i32 (%struct.A*, i32)* @_ZN1C1nEi to i8*), i8* bitcast (i32 (%struct.A*, i32)* @_ZN1C1hEi to i8*)] }, !type !0, !type !2
+
+@_ZN1C1fEi = alias i32 (%struct.C*, i32), i32 (%struct.C*, i32)* @_ZN1C2fEi
+@_ZN1C1nEi = alias i32 (%struct.A*, i32), i32 (%struct.A*, i32)* @_ZN1A1nEi
+@_ZN1C1hEi = weak alias i32 (%struct.A*, i32), i32 (%struct.A*, i32)* @_ZN1A1hEi
+
+; CHECK-IR-LABEL: define i32 @test
+define i32 @test(%struct.A* %obj, i32 %a) {
+entry:
+  %0 = bitcast %struct.A* %obj to i8***
+  %vtable = load i8**, i8*** %0
+  %1 = bitcast i8** %vtable to i8*
+  %p = call i1 @llvm.type.test(i8* %1, metadata !"_ZTS1A")
+  call void @llvm.assume(i1 %p)
+
+  ; C overrides the first slot with an alias of another function.
+  %fptrptr = getelementptr i8*, i8** %vtable, i32 0
+  %2 = bitcast i8** %fptrptr to i32 (%struct.A*, i32)**
+  %fptr1 = load i32 (%struct.A*, i32)*, i32 (%struct.A*, i32)** %2, align 8
+  ; CHECK-IR: %call = tail call i32 %fptr1
+  %call = tail call i32 %fptr1(%struct.A* nonnull %obj, i32 %a)
+
+  ; The alias in the second slot of C refers to A::n.
+  %fptrptr2 = getelementptr i8*, i8** %vtable, i32 1
+  %3 = bitcast i8** %fptrptr2 to i32 (%struct.A*, i32)**
+  %fptr2 = load i32 (%struct.A*, i32)*, i32 (%struct.A*, i32)** %3, align 8
+  ; CHECK-IR: tail call i32 @_ZN1A1nEi
+  %call2 = tail call i32 %fptr2(%struct.A* nonnull %obj, i32 %call)
+
+  ; The weak alias in the third slot of C may be replaced at link time.
+  %fptrptr3 = getelementptr i8*, i8** %vtable, i32 2
+  %4 = bitcast i8** %fptrptr3 to i32 (%struct.A*, i32)**
+  %fptr3 = load i32 (%struct.A*, i32)*, i32 (%struct.A*, i32)** %4, align 8
+  ; CHECK-IR: %call3 = tail call i32 %fptr3
+  %call3 = tail call i32 %fptr3(%struct.A* nonnull %obj, i32 %call2)
+  ret i32 %call3
+}
+; CHECK-IR-LABEL: ret i32
+; CHECK-IR-LABEL: }
+
+declare i1 @llvm.type.test(i8*, metadata)
+declare void @llvm.assume(i1)
+
+declare i32 @_ZN1B1fEi(%struct.B* %this, i32 %a)
+
+define i32 @_ZN1A1nEi(%struct.A* %this, i32 %a) noinline {
+   %r = add i32 %a, 1
+   ret i32 %r
+}
+
+define i32 @_ZN1A1hEi(%struct.A* %this, i32 %a) {
+   ret i32 1
+}
+
+define i32 @_ZN1C2fEi(%struct.C* %this, i32 %a) {
+   ret i32 2
+}
+
+!0 = !{i64 16, !"_ZTS1A"}
+!1 = !{i64 16, !"_ZTS1B"}
+!2 = !{i64 16, !"_ZTS1C"}
@@ -0,0 +1,80 @@
+; Check that functions with the same structural hash in different modules are
+; merged during the thin link, and that the duplicates become thunks.
+
+; RUN: opt -module-summary -module-summary-structural-hash %s -o %t1.bc
+; RUN: opt -module-summary -module-summary-structural-hash %p/Inputs/merge-functions.ll -o %t2.bc
+; RUN: llvm-bcanalyzer -dump %t1.bc | FileCheck %s --check-prefix=BCAN
+
+; BCAN: <STRUCTURAL_HASH op0={{-?[0-9]+}} op1=
+
+; RUN: llvm-lto2 run %t1.bc %t2.bc -o %t.o -save-temps \
+; RUN:     -thinlto-merge-functions \
+; RUN:     -r=%t1.bc,caller_a,plx \
+; RUN:     -r=%t1.bc,dup_a,plx \
+; RUN:     -r=%t1.bc,other_a,plx \
+; RUN:     -r=%t1.bc,local_a,plx \
+; RUN:     -r=%t2.bc,caller_b,plx \
+; RUN:     -r=%t2.bc,dup_b,plx \
+; RUN:     -r=%t2.bc,other_b,plx \
+; RUN:     -r=%t2.bc,local_b,plx
+; RUN: llvm-dis < %t.o.1.2.internalize.bc | FileCheck %s --check-prefix=CANONICAL
+; RUN: llvm-dis < %t.o.2.2.internalize.bc | FileCheck %s --check-prefix=MERGED
+
+; Without the option, both copies are kept.
+; RUN: llvm-lto2 run %t1.bc %t2.bc -o %t3.o -save-temps \
+; RUN:     -r=%t1.bc,caller_a,plx \
+; RUN:     -r=%t1.bc,dup_a,plx \
+; RUN:     -r=%t1.bc,other_a,plx \
+; RUN:     -r=%t1.bc,local_a,plx \
+; RUN:     -r=%t2.bc,caller_b,plx \
+; RUN:     -r=%t2.bc,dup_b,plx \
+; RUN:     -r=%t2.bc,other_b,plx \
+; RUN:     -r=%t2.bc,local_b,plx
+; RUN: llvm-dis < %t3.o.2.2.internalize.bc | FileCheck %s --check-prefix=NOMERGE
+
+; dup_a has the smaller GUID, so it is the canonical copy.
+; CANONICAL-LABEL: define dso_local i32 @dup_a(
+; CANONICAL-NEXT:    %y = add i32 %x, 1
+
+; Calls to the unnamed_addr duplicate go to the canonical copy directly.
+; MERGED-LABEL: define dso_local i32 @caller_b(
+; MERGED-NEXT:    %r = call i32 @dup_a(i32 %x)
+; MERGED-LABEL: define dso_local i32 @dup_b(
+; MERGED-NEXT:    %1 = tail call i32 @dup_a(i32 %x)
+; MERGED-NEXT:    ret i32 %1
+; MERGED-LABEL: define dso_local i32 @other_b(
+; MERGED-NEXT:    %y = add i32 %x, 2
+; Functions referring to local globals are not merged.
+; MERGED-LABEL: define dso_local i32 @local_b(
+; MERGED-NEXT:    %v = load i32, i32* @counter
+; MERGED:       declare i32 @dup_a(i32)
+
+; NOMERGE-LABEL: define dso_local i32 @dup_b(
+; NOMERGE-NEXT:    %y = add i32 %x, 1
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@counter = internal global i32 0
+
+define i32 @caller_a(i32 %x) {
+  %r = call i32 @dup_a(i32 %x)
+  ret i32 %r
+}
+
+define i32 @dup_a(i32 %x) unnamed_addr noinline {
+  %y = add i32 %x, 1
+  %z = mul i32 %y, 3
+  ret i32 %z
+}
+
+define i32 @other_a(i32 %x) noinline {
+  %y = add i32 %x, 3
+  %z = mul i32 %y, 3
+  ret i32 %z
+}
+
+define i32 @local_a() noinline {
+  %v = load i32, i32* @counter
+  ret i32 %v
+}
@@ -0,0 +1,48 @@
+; Check that synthetic entry counts are propagated across modules on the
+; combined call graph, and set on the functions in the backends.
+
+; RUN: opt -module-summary -write-relbf-to-summary %s -o %t1.bc
+; RUN: opt -module-summary -write-relbf-to-summary %p/Inputs/synthetic-counts.ll -o %t2.bc
+
+; RUN: llvm-lto2 run %t1.bc %t2.bc -o %t.o -save-temps \
+; RUN:     -thinlto-synthesize-entry-counts \
+; RUN:     -r=%t1.bc,caller,plx \
+; RUN:     -r=%t1.bc,callee, \
+; RUN:     -r=%t2.bc,callee,plx
+; RUN: llvm-dis < %t.o.1.2.internalize.bc | FileCheck %s --check-prefix=CALLER
+; RUN: llvm-dis < %t.o.2.2.internalize.bc | FileCheck %s --check-prefix=CALLEE
+
+; The caller is a root of the call graph and gets the initial count, and the
+; callee gets the count of its two calls.
+; CALLER: define {{.*}}void @caller() {{.*}}!prof ![[COUNT:[0-9]+]]
+; CALLER: ![[COUNT]] = !{!"synthetic_function_entry_count", i64 10}
+; CALLEE: define {{.*}}void @callee() {{.*}}!prof ![[COUNT:[0-9]+]]
+; CALLEE: ![[COUNT]] = !{!"synthetic_function_entry_count", i64 20}
+
+; The counts are written to the distributed indexes.
+; RUN: llvm-lto2 run %t1.bc %t2.bc -o %t3.o -thinlto-distributed-indexes \
+; RUN:     -thinlto-synthesize-entry-counts \
+; RUN:     -r=%t1.bc,caller,plx \
+; RUN:     -r=%t1.bc,callee, \
+; RUN:     -r=%t2.bc,callee,plx
+; RUN: llvm-bcanalyzer -dump %t2.bc.thinlto.bc | FileCheck %s --check-prefix=INDEX
+; INDEX: <ENTRY_COUNT op0=20/>
+
+; Without the option, no counts are computed.
+; RUN: llvm-lto2 run %t1.bc %t2.bc -o %t4.o -save-temps \
+; RUN:     -r=%t1.bc,caller,plx \
+; RUN:     -r=%t1.bc,callee, \
+; RUN:     -r=%t2.bc,callee,plx
+; RUN: llvm-dis < %t4.o.2.2.internalize.bc | FileCheck %s --check-prefix=NOCOUNT
+; NOCOUNT-NOT: synthetic_function_entry_count
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+declare void @callee()
+
+define void @caller() {
+  call void @callee()
+  call void @callee()
+  ret void
+}
@@ -0,0 +1,91 @@
+; Check that values whose frame storage is never live at the same time share a
+; field of the coroutine frame, and that the fields are sorted by alignment.
+; RUN: opt < %s -coro-split -S | FileCheck %s
+; RUN: opt < %s -coro-split -coro-reuse-frame-fields=false -S | FileCheck %s -check-prefix=NOREUSE
+; RUN: opt < %s -coro-split -pass-remarks-analysis=coro-frame -disable-output 2>&1 | FileCheck %s -check-prefix=REMARK
+
+; %a is only live across the first suspend point and %b across the second one.
+; %big and %small are allocas with disjoint lifetimes. %a shares the field of
+; %small, which is only live after the first suspend point, and %b the field of
+; %big, which is dead by the time %b is defined.
+
+; CHECK: %f.Frame = type { void (%f.Frame*)*, void (%f.Frame*)*, i1, i1, [16 x i64], [4 x i32], i8 }
+; NOREUSE: %f.Frame = type { void (%f.Frame*)*, void (%f.Frame*)*, i1, i1, [16 x i64], [4 x i32], i64, i64, i8 }
+
+; REMARK: remark: <unknown>:0:0: coroutine frame is 168 bytes, with 5 spilled values in 3 fields
+
+define i8* @f(i8 %c) "coroutine.presplit"="1" {
+entry:
+  %big = alloca [16 x i64]
+  %small = alloca [4 x i32]
+  %id = call token @llvm.coro.id(i32 0, i8* null, i8* null, i8* null)
+  %size = call i32 @llvm.coro.size.i32()
+  %alloc = call i8* @malloc(i32 %size)
+  %hdl = call i8* @llvm.coro.begin(token %id, i8* %alloc)
+  %big.i8 = bitcast [16 x i64]* %big to i8*
+  call void @llvm.lifetime.start.p0i8(i64 128, i8* %big.i8)
+  call void @use(i8* %big.i8)
+  %a = call i64 @get()
+  %0 = call i8 @llvm.coro.suspend(token none, i1 false)
+  switch i8 %0, label %suspend [i8 0, label %resume
+                                i8 1, label %cleanup]
+resume:
+  call void @print(i64 %a)
+  call void @use(i8* %big.i8)
+  call void @llvm.lifetime.end.p0i8(i64 128, i8* %big.i8)
+  br label %next
+
+next:
+  %small.i8 = bitcast [4 x i32]* %small to i8*
+  call void @llvm.lifetime.start.p0i8(i64 16, i8* %small.i8)
+  call void @use(i8* %small.i8)
+  %b = call i64 @get()
+  %1 = call i8 @llvm.coro.suspend(token none, i1 false)
+  switch i8 %1, label %suspend [i8 0, label %resume2
+                                i8 1, label %cleanup]
+resume2:
+  call void @print(i64 %b)
+  call void @print8(i8 %c)
+  call void @use(i8* %small.i8)
+  call void @llvm.lifetime.end.p0i8(i64 16, i8* %small.i8)
+  br label %cleanup
+
+cleanup:
+  %mem = call i8* @llvm.coro.free(token %id, i8* %hdl)
+  call void @free(i8* %mem)
+  br label %suspend
+suspend:
+  call i1 @llvm.coro.end(i8* %hdl, i1 0)
+  ret i8* %hdl
+}
+
+; %a is reloaded from the field of %small, and %b is stored in the field of
+; %big.
+; CHECK-LABEL: @f.resume(
+; CHECK: %a.reload.addr = getelementptr inbounds %f.Frame, %f.Frame* %FramePtr, i32 0, i32 5
+; CHECK: [[AADDR:%.*]] = bitcast [4 x i32]* %a.reload.addr to i64*
+; CHECK: %a.reload = load i64, i64* [[AADDR]]
+; CHECK: %big.reload.addr = getelementptr inbounds %f.Frame, %f.Frame* %FramePtr, i32 0, i32 4
+; CHECK: [[BADDR:%.*]] = bitcast [16 x i64]* %big.reload.addr to i64*
+; CHECK: store i64 %b, i64* [[BADDR]]
+
+declare i8* @llvm.coro.free(token, i8*)
+declare i32 @llvm.coro.size.i32()
+declare i8  @llvm.coro.suspend(token, i1)
+declare void @llvm.coro.resume(i8*)
+declare void @llvm.coro.destroy(i8*)
+
+declare token @llvm.coro.id(i32, i8*, i8*, i8*)
+declare i1 @llvm.coro.alloc(token)
+declare i8* @llvm.coro.begin(token, i8*)
+declare i1 @llvm.coro.end(i8*, i1)
+
+declare void @llvm.lifetime.start.p0i8(i64, i8* nocapture)
+declare void @llvm.lifetime.end.p0i8(i64, i8* nocapture)
+
+declare noalias i8* @malloc(i32)
+declare void @use(i8*)
+declare i64 @get()
+declare void @print(i64)
+declare void @print8(i8)
+declare void @free(i8*)
@@ -0,0 +1,220 @@
+; RUN: opt < %s -basicaa -dse -enable-dse-memoryssa -S | FileCheck %s
+; RUN: opt < %s -aa-pipeline=basic-aa -passes=dse -enable-dse-memoryssa -S | FileCheck %s
+; RUN: opt < %s -basicaa -dse -S | FileCheck %s -check-prefix=MEMDEP
+
+; Check that MemorySSA-based DSE eliminates stores killed on all paths through
+; later blocks, which the block-local implementation keeps.
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+
+declare void @free(i8* nocapture)
+declare void @may_throw() readnone
+declare void @llvm.memset.p0i8.i64(i8* nocapture, i8, i64, i1)
+declare void @llvm.lifetime.start.p0i8(i64, i8* nocapture)
+declare void @llvm.lifetime.end.p0i8(i64, i8* nocapture)
+
+; The store is overwritten on both sides of a diamond.
+
+; CHECK-LABEL: @diamond(
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   br i1 %c
+; MEMDEP-LABEL: @diamond(
+; MEMDEP:       store i32 0, i32* %p
+
+define void @diamond(i32* %p, i1 %c) {
+entry:
+  store i32 0, i32* %p
+  br i1 %c, label %then, label %else
+
+then:
+  store i32 1, i32* %p
+  br label %exit
+
+else:
+  store i32 2, i32* %p
+  br label %exit
+
+exit:
+  ret void
+}
+
+; The store is read on one of the paths.
+
+; CHECK-LABEL: @diamond_read(
+; CHECK:       store i32 0, i32* %p
+
+define i32 @diamond_read(i32* %p, i1 %c) {
+entry:
+  store i32 0, i32* %p
+  br i1 %c, label %then, label %else
+
+then:
+  store i32 1, i32* %p
+  br label %exit
+
+else:
+  %v = load i32, i32* %p
+  br label %exit
+
+exit:
+  %r = phi i32 [ 0, %then ], [ %v, %else ]
+  ret i32 %r
+}
+
+; The store is only overwritten on one of the paths, and the memory is
+; visible to the caller.
+
+; CHECK-LABEL: @half_diamond(
+; CHECK:       store i32 0, i32* %p
+
+define void @half_diamond(i32* %p, i1 %c) {
+entry:
+  store i32 0, i32* %p
+  br i1 %c, label %then, label %exit
+
+then:
+  store i32 1, i32* %p
+  br label %exit
+
+exit:
+  ret void
+}
+
+; Stores to a local object are dead at the end of the function, and stores to
+; memory freed in a later block are dead as well.
+
+; CHECK-LABEL: @local(
+; CHECK-NOT:   store
+; CHECK:       ret void
+; MEMDEP-LABEL: @local(
+; MEMDEP:       store i32 0, i32* %a
+
+define void @local(i1 %c) {
+entry:
+  %a = alloca i32
+  %b = bitcast i32* %a to i8*
+  call void @llvm.lifetime.start.p0i8(i64 4, i8* %b)
+  store i32 0, i32* %a
+  br i1 %c, label %then, label %exit
+
+then:
+  call void @llvm.lifetime.end.p0i8(i64 4, i8* %b)
+  br label %exit
+
+exit:
+  ret void
+}
+
+; CHECK-LABEL: @before_free(
+; CHECK-NOT:   store
+; CHECK:       call void @free(
+; MEMDEP-LABEL: @before_free(
+; MEMDEP:       store i32 0, i32* %q
+
+define void @before_free(i8* %p, i1 %c) {
+entry:
+  %q = bitcast i8* %p to i32*
+  store i32 0, i32* %q
+  br i1 %c, label %then, label %exit
+
+then:
+  br label %exit
+
+exit:
+  call void @free(i8* %p)
+  ret void
+}
+
+; A call that may throw between the store and the overwrite makes the store
+; visible to the caller.
+
+; CHECK-LABEL: @throwing(
+; CHECK:       store i32 0, i32* %p
+
+define void @throwing(i32* %p, i1 %c) {
+entry:
+  store i32 0, i32* %p
+  br i1 %c, label %then, label %exit
+
+then:
+  call void @may_throw()
+  br label %exit
+
+exit:
+  store i32 1, i32* %p
+  ret void
+}
+
+; A store in a loop is not killed by a store of the next iteration, whose
+; pointer differs.
+
+; CHECK-LABEL: @loop(
+; CHECK:       store i32 1, i32* %prev
+; CHECK:       store i32 0, i32* %gep
+
+define void @loop(i32* %p, i64 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %gep = getelementptr i32, i32* %p, i64 %i
+  %prev = getelementptr i32, i32* %gep, i64 -1
+  store i32 1, i32* %prev
+  store i32 0, i32* %gep
+  %i.next = add i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
+
+; Two writes in later blocks, which execute on every path, together overwrite
+; the store.
+
+; CHECK-LABEL: @partials(
+; CHECK-NOT:   store i32
+; CHECK:       store i16 1
+; CHECK:       store i16 2
+; MEMDEP-LABEL: @partials(
+; MEMDEP:       store i32 0, i32* %p
+
+define void @partials(i32* %p, i1 %c) {
+entry:
+  store i32 0, i32* %p
+  %lo = bitcast i32* %p to i16*
+  %hi = getelementptr i16, i16* %lo, i64 1
+  br i1 %c, label %then, label %join
+
+then:
+  br label %join
+
+join:
+  store i16 1, i16* %lo
+  br label %exit
+
+exit:
+  store i16 2, i16* %hi
+  ret void
+}
+
+; The end of a memset is overwritten in a later block on every path.
+
+; CHECK-LABEL: @shorten(
+; CHECK:       call void @llvm.memset.p0i8.i64(i8* align 8 %p, i8 0, i64 16, i1 false)
+
+define void @shorten(i8* %p, i1 %c) {
+entry:
+  call void @llvm.memset.p0i8.i64(i8* align 8 %p, i8 0, i64 32, i1 false)
+  br i1 %c, label %then, label %exit
+
+then:
+  br label %exit
+
+exit:
+  %q = getelementptr i8, i8* %p, i64 16
+  %q64 = bitcast i8* %q to [2 x i64]*
+  store [2 x i64] [i64 1, i64 2], [2 x i64]* %q64
+  ret void
+}
@@ -0,0 +1,127 @@
+; RUN: opt -function-specialization -func-specialization-size-budget=100 -S < %s | FileCheck %s
+; RUN: opt -passes=function-specialization -func-specialization-size-budget=100 \
+; RUN:     -pass-remarks=function-specialization \
+; RUN:     -pass-remarks-missed=function-specialization -S < %s 2>%t | FileCheck %s
+; RUN: FileCheck %s --check-prefix=REMARK < %t
+; RUN: opt -passes=function-specialization \
+; RUN:     -pass-remarks-missed=function-specialization -S < %s 2>&1 \
+; RUN:     | FileCheck %s --check-prefix=BUDGET
+; RUN: opt -passes=function-specialization -func-specialization-size-budget=100 \
+; RUN:     -func-specialization-max-clones=1 \
+; RUN:     -pass-remarks-missed=function-specialization -S < %s 2>&1 \
+; RUN:     | FileCheck %s --check-prefix=CLONES
+
+declare void @use(i32)
+declare void @handler(i32)
+declare void @handler8(i8)
+
+; The second argument of @compute feeds nothing that folds.
+; REMARK: remark: <unknown>:0:0: not specializing compute: benefit 0 is too small for the cost 55
+; REMARK: remark: <unknown>:0:0: specialized dispatch into dispatch.specialized for 1 call sites
+; REMARK: remark: <unknown>:0:0: specialized dispatch into dispatch.specialized.{{[0-9]+}} for 1 call sites
+
+; By default the module is too small to leave room for the clones.
+; BUDGET: remark: <unknown>:0:0: not specializing dispatch: code size budget exhausted
+; BUDGET-NOT: define internal void @dispatch.specialized
+
+; With a single clone allowed, the budget is left but the second
+; specialization of dispatch is not made.
+; CLONES: remark: <unknown>:0:0: not specializing dispatch: reached the limit of 1 specializations
+; CLONES: define internal void @dispatch.specialized(
+; CLONES-NOT: define internal void @dispatch.specialized
+
+define void @dispatch(i32 %mode, void (i32)* %fp, i32 %x) {
+entry:
+  switch i32 %mode, label %default [
+    i32 0, label %zero
+    i32 1, label %one
+  ]
+
+zero:
+  %a = mul i32 %x, 3
+  %b = add i32 %a, 7
+  call void @use(i32 %b)
+  br label %exit
+
+one:
+  call void %fp(i32 %x)
+  br label %exit
+
+default:
+  %c = sdiv i32 %x, 5
+  %d = xor i32 %c, 12
+  %e = shl i32 %d, 2
+  call void @use(i32 %e)
+  br label %exit
+
+exit:
+  ret void
+}
+
+define i32 @compute(i32 %x, i32 %k) {
+entry:
+  %a = mul i32 %x, 3
+  %b = add i32 %a, 7
+  %c = sdiv i32 %b, 5
+  %d = xor i32 %c, 12
+  %e = shl i32 %d, 2
+  %f = sub i32 %e, %x
+  %g = and i32 %f, 255
+  %h = or i32 %g, 1
+  %i = mul i32 %h, %h
+  %j = add i32 %i, %k
+  ret i32 %j
+}
+
+; CHECK-LABEL: define void @const_fp(
+; CHECK-NEXT: call void @dispatch.specialized(i32 1, void (i32)* @handler, i32 %x)
+define void @const_fp(i32 %x) {
+  call void @dispatch(i32 1, void (i32)* @handler, i32 %x)
+  ret void
+}
+
+; Nothing is known about the arguments here; keep calling the original.
+; CHECK-LABEL: define void @unknown(
+; CHECK-NEXT: call void @dispatch(i32 %m, void (i32)* %f, i32 %x)
+define void @unknown(i32 %m, void (i32)* %f, i32 %x) {
+  call void @dispatch(i32 %m, void (i32)* %f, i32 %x)
+  ret void
+}
+
+; CHECK-LABEL: define void @const_mode(
+; CHECK-NEXT: call void @[[SPEC_MODE:dispatch.specialized.[0-9]+]](i32 0, void (i32)* %f, i32 %x)
+define void @const_mode(void (i32)* %f, i32 %x) {
+  call void @dispatch(i32 0, void (i32)* %f, i32 %x)
+  ret void
+}
+
+; A function cast by an instruction is not a constant to specialize on.
+; CHECK-LABEL: define void @cast_fp(
+; CHECK-NEXT: %fp = bitcast void (i8)* @handler8 to void (i32)*
+; CHECK-NEXT: call void @dispatch(i32 %m, void (i32)* %fp, i32 %x)
+define void @cast_fp(i32 %m, i32 %x) {
+  %fp = bitcast void (i8)* @handler8 to void (i32)*
+  call void @dispatch(i32 %m, void (i32)* %fp, i32 %x)
+  ret void
+}
+
+; CHECK-LABEL: define i32 @const_k(
+; CHECK-NEXT: call i32 @compute(i32 %x, i32 5)
+define i32 @const_k(i32 %x) {
+  %r = call i32 @compute(i32 %x, i32 5)
+  ret i32 %r
+}
+
+; The switch is gone and the indirect call is direct.
+; CHECK-LABEL: define internal void @dispatch.specialized(
+; CHECK-NOT: switch
+; CHECK-NOT: call void @use
+; CHECK: call void @handler(i32 %x)
+; CHECK-NOT: call
+; CHECK: ret void
+
+; CHECK: define internal void @[[SPEC_MODE]](
+; CHECK-NOT: switch
+; CHECK: %a = mul i32 %x, 3
+; CHECK-NOT: call void %fp
+; CHECK: ret void
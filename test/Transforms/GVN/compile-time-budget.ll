@@ -0,0 +1,78 @@
+; RUN: opt < %s -passes=gvn -S | FileCheck %s --check-prefix=UNLIMITED
+; RUN: opt < %s -passes=gvn -compile-time-budget=1 \
+; RUN:     -pass-remarks-missed=gvn -S 2>%t | FileCheck %s --check-prefix=BUDGET
+; RUN: FileCheck %s --check-prefix=REMARK-GVN < %t
+; RUN: opt < %s -passes=gvn,jump-threading -compile-time-budget=1 \
+; RUN:     -pass-remarks-missed=jump-threading -disable-output 2>&1 \
+; RUN:     | FileCheck %s --check-prefix=REMARK-JT
+
+; With a budget in effect GVN still removes full redundancies, but once the
+; budget is used up it skips PRE, and jump threading is skipped altogether.
+; GVN only degrades if the budget runs out before its iteration converges.
+
+; REMARK-GVN: remark: <unknown>:0:0: compile-time budget exhausted (used {{[0-9]+}} of 1 units); stopping after 1 iteration(s) and skipping PRE
+; REMARK-GVN-NOT: remark
+; REMARK-JT: remark: <unknown>:0:0: compile-time budget exhausted (used {{[0-9]+}} of 1 units); skipping jump threading
+
+declare void @use(i32)
+
+define i32 @f(i1 %c, i32 %a, i32 %b) {
+; UNLIMITED-LABEL: @f(
+; UNLIMITED: else:
+; UNLIMITED-NEXT: {{%.*}} = add i32 %a, %b
+; UNLIMITED: join:
+; UNLIMITED-NEXT: [[PHI:%.*]] = phi i32
+; UNLIMITED-NEXT: ret i32 [[PHI]]
+;
+; BUDGET-LABEL: @f(
+; BUDGET: else:
+; BUDGET-NEXT: br label %join
+; BUDGET: join:
+; BUDGET-NEXT: %y = add i32 %a, %b
+; BUDGET-NEXT: ret i32 %y
+entry:
+  br i1 %c, label %then, label %else
+
+then:
+  %x = add i32 %a, %b
+  call void @use(i32 %x)
+  br label %join
+
+else:
+  br label %join
+
+join:
+  %y = add i32 %a, %b
+  %z = add i32 %a, %b
+  ret i32 %z
+}
+
+define i32 @g(i1 %c, i32 %a, i32 %b) {
+; UNLIMITED-LABEL: @g(
+; UNLIMITED: else:
+; UNLIMITED-NEXT: {{%.*}} = add i32 %a, %b
+; UNLIMITED: join:
+; UNLIMITED-NEXT: [[PHI:%.*]] = phi i32
+; UNLIMITED-NEXT: ret i32 [[PHI]]
+;
+; BUDGET-LABEL: @g(
+; BUDGET: else:
+; BUDGET-NEXT: {{%.*}} = add i32 %a, %b
+; BUDGET: join:
+; BUDGET-NEXT: [[PHI:%.*]] = phi i32
+; BUDGET-NEXT: ret i32 [[PHI]]
+entry:
+  br i1 %c, label %then, label %else
+
+then:
+  %x = add i32 %a, %b
+  call void @use(i32 %x)
+  br label %join
+
+else:
+  br label %join
+
+join:
+  %y = add i32 %a, %b
+  ret i32 %y
+}
@@ -0,0 +1,236 @@
+; RUN: opt < %s -heap-to-stack -S | FileCheck %s
+; RUN: opt < %s -passes=heap-to-stack -S | FileCheck %s
+; RUN: opt < %s -heap-to-stack -pass-remarks-missed=heap-to-stack -disable-output 2>&1 | FileCheck %s -check-prefix=REMARK
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+declare noalias i8* @malloc(i64)
+declare noalias i8* @calloc(i64, i64)
+declare void @free(i8*)
+declare noalias i8* @_Znwm(i64)
+declare void @_ZdlPv(i8*)
+declare void @use(i32*)
+declare void @read(i8* nocapture readonly)
+declare void @release(i8* nocapture)
+declare i32 @__gxx_personality_v0(...)
+
+; A local buffer freed at the end of the function.
+
+; CHECK-LABEL: @sum(
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %p.h2s = alloca [16 x i8], align 16
+; CHECK-NEXT:   [[START:%.*]] = bitcast [16 x i8]* %p.h2s to i8*
+; CHECK-NEXT:   call void @llvm.lifetime.start.p0i8(i64 16, i8* [[START]])
+; CHECK-NEXT:   %p = bitcast [16 x i8]* %p.h2s to i8*
+; CHECK-NOT:    @malloc
+; CHECK:        call void @read(i8* %p)
+; CHECK-NEXT:   [[END:%.*]] = bitcast [16 x i8]* %p.h2s to i8*
+; CHECK-NEXT:   call void @llvm.lifetime.end.p0i8(i64 16, i8* [[END]])
+; CHECK-NEXT:   ret i32
+
+define i32 @sum(i32 %x, i32 %y) {
+entry:
+  %p = call i8* @malloc(i64 16)
+  %a = bitcast i8* %p to i32*
+  store i32 %x, i32* %a
+  %a1 = getelementptr i32, i32* %a, i64 1
+  store i32 %y, i32* %a1
+  %v0 = load i32, i32* %a
+  %v1 = load i32, i32* %a1
+  %s = add i32 %v0, %v1
+  call void @read(i8* %p)
+  call void @free(i8* %p)
+  ret i32 %s
+}
+
+; calloc memory is cleared, and operator new is freed by operator delete. The
+; allocation freed on one path only is promoted too.
+
+; CHECK-LABEL: @zeroed(
+; CHECK:   %p.h2s = alloca [32 x i8], align 16
+; CHECK:   call void @llvm.memset.p0i8.i64(i8* align 16 %p, i8 0, i64 32, i1 false)
+; CHECK-NOT: @calloc
+; CHECK-NOT: @free
+; CHECK:   ret i8
+
+define i8 @zeroed(i1 %c) {
+entry:
+  %p = call i8* @calloc(i64 4, i64 8)
+  %v = load i8, i8* %p
+  br i1 %c, label %then, label %exit
+
+then:
+  call void @free(i8* %p)
+  br label %exit
+
+exit:
+  ret i8 %v
+}
+
+; CHECK-LABEL: @cxx_new(
+; CHECK:   %call.h2s = alloca [8 x i8], align 16
+; CHECK-NOT: @_Znwm
+; CHECK-NOT: @_ZdlPv
+; CHECK:   ret void
+
+define void @cxx_new() {
+entry:
+  %call = call i8* @_Znwm(i64 8)
+  %0 = bitcast i8* %call to i64*
+  store i64 0, i64* %0
+  call void @_ZdlPv(i8* %call)
+  ret void
+}
+
+; An invoke of operator new loses its unwind edge.
+
+; CHECK-LABEL: @cxx_invoke(
+; CHECK:   %call.h2s = alloca [8 x i8], align 16
+; CHECK:   br label %cont
+; CHECK-NOT: landingpad
+
+define void @cxx_invoke() personality i32 (...)* @__gxx_personality_v0 {
+entry:
+  %call = invoke i8* @_Znwm(i64 8)
+          to label %cont unwind label %lpad
+
+cont:
+  call void @_ZdlPv(i8* %call)
+  ret void
+
+lpad:
+  %lp = landingpad { i8*, i32 }
+          cleanup
+  resume { i8*, i32 } %lp
+}
+
+; The pointer escapes through a call.
+
+; CHECK-LABEL: @escapes(
+; CHECK: call i8* @malloc(i64 16)
+; CHECK: call void @free(
+; REMARK: heap allocation not moved to the stack: allocation may escape or be freed by another call
+
+define void @escapes() {
+entry:
+  %p = call i8* @malloc(i64 16)
+  %a = bitcast i8* %p to i32*
+  call void @use(i32* %a)
+  call void @free(i8* %p)
+  ret void
+}
+
+; A nocapture callee may still free the memory.
+
+; CHECK-LABEL: @released(
+; CHECK: call i8* @malloc(i64 16)
+; REMARK: heap allocation not moved to the stack: allocation may escape or be freed by another call
+
+define void @released() {
+entry:
+  %p = call i8* @malloc(i64 16)
+  call void @release(i8* %p)
+  ret void
+}
+
+; A pointer that may be another allocation is freed.
+
+; CHECK-LABEL: @free_select(
+; CHECK: call i8* @malloc(i64 16)
+; CHECK: call i8* @malloc(i64 16)
+; REMARK: heap allocation not moved to the stack: allocation may escape or be freed by another call
+
+define void @free_select(i1 %c) {
+entry:
+  %p = call i8* @malloc(i64 16)
+  %q = call i8* @malloc(i64 16)
+  %r = select i1 %c, i8* %p, i8* %q
+  call void @free(i8* %r)
+  ret void
+}
+
+; Allocations in loops, too large, or of unknown size stay on the heap.
+
+; CHECK-LABEL: @in_loop(
+; CHECK: call i8* @malloc(i64 16)
+; REMARK: heap allocation not moved to the stack: allocation is in a loop
+
+define void @in_loop(i64 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %p = call i8* @malloc(i64 16)
+  store i8 0, i8* %p
+  call void @free(i8* %p)
+  %i.next = add i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
+
+; CHECK-LABEL: @too_large(
+; CHECK: call i8* @malloc(i64 4096)
+; CHECK: call i8* @malloc(i64 %n)
+; REMARK: heap allocation not moved to the stack: size of 4096 bytes is not in [1, 256]
+; REMARK: heap allocation not moved to the stack: size is not a constant
+
+define void @too_large(i64 %n) {
+entry:
+  %p = call i8* @malloc(i64 4096)
+  store i8 0, i8* %p
+  call void @free(i8* %p)
+  %q = call i8* @malloc(i64 %n)
+  store i8 0, i8* %q
+  call void @free(i8* %q)
+  ret void
+}
+
+; The stack budget of the function is exhausted by the first four allocations.
+
+; CHECK-LABEL: @budget(
+; CHECK: alloca [256 x i8]
+; CHECK: alloca [256 x i8]
+; CHECK: alloca [256 x i8]
+; CHECK: alloca [256 x i8]
+; CHECK: call i8* @malloc(i64 256)
+; REMARK: heap allocation not moved to the stack: function already moved 1024 bytes to the stack
+
+define void @budget() {
+entry:
+  %p0 = call i8* @malloc(i64 256)
+  %p1 = call i8* @malloc(i64 256)
+  %p2 = call i8* @malloc(i64 256)
+  %p3 = call i8* @malloc(i64 256)
+  %p4 = call i8* @malloc(i64 256)
+  call void @free(i8* %p0)
+  call void @free(i8* %p1)
+  call void @free(i8* %p2)
+  call void @free(i8* %p3)
+  call void @free(i8* %p4)
+  ret void
+}
+
+; Nothing is promoted in recursive functions.
+
+; CHECK-LABEL: @recursive(
+; CHECK: call i8* @malloc(i64 16)
+
+define void @recursive(i1 %c) {
+entry:
+  %p = call i8* @malloc(i64 16)
+  store i8 0, i8* %p
+  br i1 %c, label %recurse, label %exit
+
+recurse:
+  call void @recursive(i1 false)
+  br label %exit
+
+exit:
+  call void @free(i8* %p)
+  ret void
+}
@@ -0,0 +1,70 @@
+; RUN: opt -hotcoldsplit -S < %s | FileCheck %s
+; RUN: opt -passes=hotcoldsplit -S < %s | FileCheck %s
+
+; With a profile, blocks the profile summary considers cold are outlined even
+; though nothing in them is statically unlikely.
+
+target triple = "x86_64-unknown-linux-gnu"
+
+declare void @work(i32)
+
+; CHECK-LABEL: define void @hot(
+; CHECK: call void @hot_if.then(i32 %n)
+; CHECK-NOT: call void @work(i32 %n)
+; CHECK: ret void
+define void @hot(i32 %n) !prof !15 {
+entry:
+  %c = icmp eq i32 %n, 0
+  br i1 %c, label %if.then, label %if.end, !prof !16
+
+if.then:
+  call void @work(i32 %n)
+  call void @work(i32 %n)
+  call void @work(i32 %n)
+  br label %if.end
+
+if.end:
+  call void @work(i32 0)
+  ret void
+}
+
+; The entry of @cold is cold already; leave it alone.
+; CHECK-LABEL: define void @cold(
+; CHECK-NOT: codeRepl
+; CHECK: ret void
+define void @cold(i32 %n) !prof !17 {
+entry:
+  %c = icmp eq i32 %n, 0
+  br i1 %c, label %if.then, label %if.end, !prof !16
+
+if.then:
+  call void @work(i32 %n)
+  call void @work(i32 %n)
+  call void @work(i32 %n)
+  br label %if.end
+
+if.end:
+  ret void
+}
+
+; CHECK: define internal void @hot_if.then(i32 %n) [[ATTRS:#[0-9]+]] {{.*}}!section_prefix
+; CHECK: attributes [[ATTRS]] = { cold minsize noinline }
+
+!llvm.module.flags = !{!1}
+!1 = !{i32 1, !"ProfileSummary", !2}
+!2 = !{!3, !4, !5, !6, !7, !8, !9, !10}
+!3 = !{!"ProfileFormat", !"InstrProf"}
+!4 = !{!"TotalCount", i64 10000}
+!5 = !{!"MaxCount", i64 1000}
+!6 = !{!"MaxInternalCount", i64 1}
+!7 = !{!"MaxFunctionCount", i64 1000}
+!8 = !{!"NumCounts", i64 3}
+!9 = !{!"NumFunctions", i64 3}
+!10 = !{!"DetailedSummary", !11}
+!11 = !{!12, !13, !14}
+!12 = !{i32 10000, i64 100, i32 1}
+!13 = !{i32 999000, i64 100, i32 1}
+!14 = !{i32 999999, i64 1, i32 2}
+!15 = !{!"function_entry_count", i64 1000}
+!16 = !{!"branch_weights", i32 1, i32 1000}
+!17 = !{!"function_entry_count", i64 1}
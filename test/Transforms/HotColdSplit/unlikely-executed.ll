@@ -0,0 +1,80 @@
+; RUN: opt -hotcoldsplit -S < %s | FileCheck %s
+; RUN: opt -passes=hotcoldsplit -pass-remarks=hotcoldsplit \
+; RUN:     -pass-remarks-missed=hotcoldsplit -S < %s 2>%t | FileCheck %s
+; RUN: FileCheck %s --check-prefix=REMARK < %t
+
+; Without a profile, blocks that call a cold function or end in unreachable
+; are outlined when they are large enough to pay for the call.
+
+target triple = "x86_64-unknown-linux-gnu"
+
+declare void @sink() cold
+declare void @report(i32)
+declare void @fail(i32) noreturn
+
+; REMARK: remark: <unknown>:0:0: split cold code into foo_if.then
+; CHECK-LABEL: define void @foo(
+; CHECK-NOT: call void @sink()
+; CHECK: codeRepl:
+; CHECK-NEXT: call void @foo_if.then()
+define void @foo(i32 %cond) {
+entry:
+  %tobool = icmp eq i32 %cond, 0
+  br i1 %tobool, label %if.end, label %if.then
+
+if.then:
+  call void @sink()
+  call void @sink()
+  br label %if.end
+
+if.end:
+  ret void
+}
+
+; Coldness propagates backwards: both %check and %bad only lead to the
+; unreachable block, and form a single region.
+; REMARK: remark: <unknown>:0:0: split cold code into bar_check
+; CHECK-LABEL: define i32 @bar(
+; CHECK-NOT: call void @fail
+; CHECK: call void @bar_check(i32 %x)
+define i32 @bar(i32 %x) {
+entry:
+  %c = icmp slt i32 %x, 0
+  br i1 %c, label %check, label %ok
+
+check:
+  %big = icmp slt i32 %x, -100
+  br i1 %big, label %bad, label %bad
+
+bad:
+  %y = add i32 %x, 1
+  call void @fail(i32 %y)
+  unreachable
+
+ok:
+  ret i32 %x
+}
+
+; The region is too small to pay for passing two arguments.
+; REMARK: remark: <unknown>:0:0: cold region of 3 instructions is not worth the cost of the call (3)
+; CHECK-LABEL: define i32 @baz(
+; CHECK: bad:
+; CHECK-NEXT: %s = add i32 %x, %z
+define i32 @baz(i32 %x, i32 %z) {
+entry:
+  %c = icmp slt i32 %x, 0
+  br i1 %c, label %bad, label %ok
+
+bad:
+  %s = add i32 %x, %z
+  call void @report(i32 %s)
+  unreachable
+
+ok:
+  ret i32 %x
+}
+
+; CHECK: define internal void @foo_if.then() [[ATTRS:#[0-9]+]] !section_prefix [[PREFIX:![0-9]+]]
+; CHECK: define internal void @bar_check(i32 %x) [[ATTRS]] !section_prefix [[PREFIX]]
+; CHECK: attributes [[ATTRS]] = { cold minsize noinline }
+; CHECK: [[PREFIX]] = !{!"function_section_prefix", !".unlikely"}
@@ -0,0 +1,67 @@
+; REQUIRES: asserts
+; RUN: opt < %s -passes=inline -inline-threshold=50 -stats -S 2>&1 | FileCheck %s
+
+; Check that the walk over a callee body is shared between call sites with the
+; same argument context, and that contexts which fold different parts of the
+; callee still get their own cost.
+
+define i32 @callee(i1 %flag, i32 %x) {
+entry:
+  br i1 %flag, label %cheap, label %expensive
+
+cheap:
+  %r = add i32 %x, 1
+  ret i32 %r
+
+expensive:
+  %v0 = mul i32 %x, 3
+  %v1 = xor i32 %v0, 10
+  %v2 = add i32 %v1, 17
+  %v3 = sub i32 %v2, 24
+  %v4 = mul i32 %v3, 31
+  %v5 = xor i32 %v4, 38
+  %v6 = add i32 %v5, 45
+  %v7 = sub i32 %v6, 52
+  %v8 = mul i32 %v7, 59
+  %v9 = xor i32 %v8, 66
+  %v10 = add i32 %v9, 73
+  %v11 = sub i32 %v10, 80
+  %v12 = mul i32 %v11, 87
+  %v13 = xor i32 %v12, 94
+  %v14 = add i32 %v13, 101
+  %v15 = sub i32 %v14, 108
+  %v16 = mul i32 %v15, 115
+  %v17 = xor i32 %v16, 122
+  %v18 = add i32 %v17, 129
+  %v19 = sub i32 %v18, 136
+  %v20 = mul i32 %v19, 143
+  %v21 = xor i32 %v20, 150
+  %v22 = add i32 %v21, 157
+  %v23 = sub i32 %v22, 164
+  ret i32 %v23
+}
+
+define i32 @caller(i1 %c, i1 %d, i32 %a, i32 %b) {
+; CHECK-LABEL: define i32 @caller(
+; CHECK-NOT: call i32 @callee(i1 true
+; CHECK: call i32 @callee(i1 %c, i32 %a)
+; CHECK: call i32 @callee(i1 %d, i32 %b)
+; CHECK: ret i32
+entry:
+  %r1 = call i32 @callee(i1 true, i32 %a)
+  %r2 = call i32 @callee(i1 true, i32 %b)
+  %r3 = call i32 @callee(i1 true, i32 7)
+  %r4 = call i32 @callee(i1 %c, i32 %a)
+  %r5 = call i32 @callee(i1 %d, i32 %b)
+  %s1 = add i32 %r1, %r2
+  %s2 = add i32 %s1, %r3
+  %s3 = add i32 %s2, %r4
+  %s4 = add i32 %s3, %r5
+  ret i32 %s4
+}
+
+; The second call shares the context of the first one and the last call shares
+; the context of the fourth one. The constant second argument of the third call
+; is a different context.
+; CHECK: 2 inline-cost{{ +}}- Number of call sites analyzed by reusing a cached callee walk
+; CHECK: 5 inline-cost{{ +}}- Number of call sites analyzed
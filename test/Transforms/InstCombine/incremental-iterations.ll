@@ -0,0 +1,18 @@
+; RUN: opt < %s -instcombine -instcombine-incremental-iterations -S | FileCheck %s
+; RUN: opt < %s -instcombine -instcombine-incremental-iterations -stats \
+; RUN:     -disable-output 2>&1 | FileCheck %s --check-prefix=STATS
+; REQUIRES: asserts
+
+; The first iteration visits the whole function, the second one only what
+; the first one changed, and finds nothing left to do.
+; STATS-DAG: 2 instcombine - Number of instruction combining iterations performed
+; STATS-DAG: 1 instcombine - Number of functions with two iterations
+
+define i32 @test(i32 %x) {
+; CHECK-LABEL: @test(
+; CHECK-NEXT: ret i32 %x
+  %a = add i32 %x, 1
+  %b = add i32 %a, 1
+  %c = sub i32 %b, 2
+  ret i32 %c
+}
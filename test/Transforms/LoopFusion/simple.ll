@@ -0,0 +1,176 @@
+; RUN: opt -loop-fusion -S < %s | FileCheck %s
+; RUN: opt -passes=loop-fusion -pass-remarks=loop-fusion \
+; RUN:     -pass-remarks-missed=loop-fusion -S < %s 2>%t | FileCheck %s
+; RUN: FileCheck %s --check-prefix=REMARK < %t
+
+; REMARK: remark: <unknown>:0:0: loop fused with the following loop
+; REMARK: remark: <unknown>:0:0: loop not fused with the following loop: a memory dependence between the loops prevents fusion
+; REMARK: remark: <unknown>:0:0: loop not fused with the following loop: loops have different trip counts
+; REMARK: remark: <unknown>:0:0: loop not fused with the following loop: loops are separated by other code
+; REMARK: remark: <unknown>:0:0: loop not fused with the following loop: values computed in the loop are used outside of it
+
+; The second loop reads what the first one wrote in the same iteration.
+; CHECK-LABEL: @fuse(
+; CHECK: loop0:
+; CHECK-NEXT: %i = phi i64 [ 0, %entry ], [ %i.next, %loop1 ]
+; CHECK-NEXT: %j = phi i64 [ 0, %entry ], [ %j.next, %loop1 ]
+; CHECK: store i32 %t, i32* %a
+; CHECK-NOT: icmp
+; CHECK: br label %loop1
+; CHECK-NOT: mid:
+; CHECK: loop1:
+; CHECK: %v = load i32, i32* %a1
+; CHECK: br i1 %c1, label %loop0, label %exit
+define void @fuse(i32* noalias %A, i32* noalias %B) {
+entry:
+  br label %loop0
+
+loop0:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop0 ]
+  %a = getelementptr inbounds i32, i32* %A, i64 %i
+  %t = trunc i64 %i to i32
+  store i32 %t, i32* %a
+  %i.next = add nuw nsw i64 %i, 1
+  %c0 = icmp ne i64 %i.next, 100
+  br i1 %c0, label %loop0, label %mid
+
+mid:
+  br label %loop1
+
+loop1:
+  %j = phi i64 [ 0, %mid ], [ %j.next, %loop1 ]
+  %a1 = getelementptr inbounds i32, i32* %A, i64 %j
+  %v = load i32, i32* %a1
+  %b = getelementptr inbounds i32, i32* %B, i64 %j
+  store i32 %v, i32* %b
+  %j.next = add nuw nsw i64 %j, 1
+  %c1 = icmp ne i64 %j.next, 100
+  br i1 %c1, label %loop1, label %exit
+
+exit:
+  ret void
+}
+
+; The second loop reads what the first one writes in the next iteration.
+; CHECK-LABEL: @unsafe(
+; CHECK: br i1 %c0, label %loop0, label %mid
+define void @unsafe(i32* noalias %A, i32* noalias %B) {
+entry:
+  br label %loop0
+
+loop0:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop0 ]
+  %a = getelementptr inbounds i32, i32* %A, i64 %i
+  %t = trunc i64 %i to i32
+  store i32 %t, i32* %a
+  %i.next = add nuw nsw i64 %i, 1
+  %c0 = icmp ne i64 %i.next, 100
+  br i1 %c0, label %loop0, label %mid
+
+mid:
+  br label %loop1
+
+loop1:
+  %j = phi i64 [ 0, %mid ], [ %j.next, %loop1 ]
+  %j.next = add nuw nsw i64 %j, 1
+  %a1 = getelementptr inbounds i32, i32* %A, i64 %j.next
+  %v = load i32, i32* %a1
+  %b = getelementptr inbounds i32, i32* %B, i64 %j
+  store i32 %v, i32* %b
+  %c1 = icmp ne i64 %j.next, 100
+  br i1 %c1, label %loop1, label %exit
+
+exit:
+  ret void
+}
+
+; CHECK-LABEL: @different_trip_counts(
+; CHECK: br i1 %c0, label %loop0, label %mid
+define void @different_trip_counts(i32* noalias %A, i32* noalias %B) {
+entry:
+  br label %loop0
+
+loop0:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop0 ]
+  %a = getelementptr inbounds i32, i32* %A, i64 %i
+  store i32 0, i32* %a
+  %i.next = add nuw nsw i64 %i, 1
+  %c0 = icmp ne i64 %i.next, 100
+  br i1 %c0, label %loop0, label %mid
+
+mid:
+  br label %loop1
+
+loop1:
+  %j = phi i64 [ 0, %mid ], [ %j.next, %loop1 ]
+  %b = getelementptr inbounds i32, i32* %B, i64 %j
+  store i32 1, i32* %b
+  %j.next = add nuw nsw i64 %j, 1
+  %c1 = icmp ne i64 %j.next, 50
+  br i1 %c1, label %loop1, label %exit
+
+exit:
+  ret void
+}
+
+; CHECK-LABEL: @separated(
+; CHECK: br i1 %c0, label %loop0, label %mid
+define void @separated(i32* noalias %A, i32* noalias %B) {
+entry:
+  br label %loop0
+
+loop0:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop0 ]
+  %a = getelementptr inbounds i32, i32* %A, i64 %i
+  store i32 0, i32* %a
+  %i.next = add nuw nsw i64 %i, 1
+  %c0 = icmp ne i64 %i.next, 100
+  br i1 %c0, label %loop0, label %mid
+
+mid:
+  store i32 2, i32* %B
+  br label %loop1
+
+loop1:
+  %j = phi i64 [ 0, %mid ], [ %j.next, %loop1 ]
+  %b = getelementptr inbounds i32, i32* %B, i64 %j
+  store i32 1, i32* %b
+  %j.next = add nuw nsw i64 %j, 1
+  %c1 = icmp ne i64 %j.next, 100
+  br i1 %c1, label %loop1, label %exit
+
+exit:
+  ret void
+}
+
+; The first loop computes a value the second loop needs in full.
+; CHECK-LABEL: @escaping(
+; CHECK: br i1 %c0, label %loop0, label %mid
+define i32 @escaping(i32* noalias %A, i32* noalias %B) {
+entry:
+  br label %loop0
+
+loop0:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop0 ]
+  %sum = phi i32 [ 0, %entry ], [ %sum.next, %loop0 ]
+  %a = getelementptr inbounds i32, i32* %A, i64 %i
+  %x = load i32, i32* %a
+  %sum.next = add i32 %sum, %x
+  %i.next = add nuw nsw i64 %i, 1
+  %c0 = icmp ne i64 %i.next, 100
+  br i1 %c0, label %loop0, label %mid
+
+mid:
+  br label %loop1
+
+loop1:
+  %j = phi i64 [ 0, %mid ], [ %j.next, %loop1 ]
+  %b = getelementptr inbounds i32, i32* %B, i64 %j
+  store i32 %sum.next, i32* %b
+  %j.next = add nuw nsw i64 %j, 1
+  %c1 = icmp ne i64 %j.next, 100
+  br i1 %c1, label %loop1, label %exit
+
+exit:
+  ret i32 0
+}
@@ -0,0 +1,327 @@
+; RUN: opt -loop-idiom < %s -S | FileCheck %s
+; RUN: opt -loop-idiom -loop-idiom-scan=false < %s -S | FileCheck %s -check-prefix=DISABLED
+
+; Check that loops scanning memory for a terminator, a value or a mismatch are
+; replaced with calls to strlen, wcslen, memchr and bcmp.
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+; char *end(char *s) { while (*s) ++s; return s; }
+
+; CHECK-LABEL: @end(
+; CHECK:       for.body.preheader:
+; CHECK:         [[LEN:%.*]] = call i64 @strlen(i8* [[S:%.*]])
+; CHECK:       for.body:
+; CHECK:         br i1 true, label %[[EXIT:.*]], label %for.body
+; CHECK:       [[EXIT]]:
+; CHECK-NEXT:    phi i8* [ %{{.*}}, %for.body ]
+; DISABLED-LABEL: @end(
+; DISABLED-NOT:  call i64 @strlen
+
+define i8* @end(i8* %s) {
+entry:
+  %c0 = load i8, i8* %s, align 1
+  %tobool0 = icmp eq i8 %c0, 0
+  br i1 %tobool0, label %while.end, label %for.body.preheader
+
+for.body.preheader:
+  br label %for.body
+
+for.body:
+  %p = phi i8* [ %p.next, %for.body ], [ %s, %for.body.preheader ]
+  %p.next = getelementptr inbounds i8, i8* %p, i64 1
+  %c = load i8, i8* %p.next, align 1
+  %tobool = icmp eq i8 %c, 0
+  br i1 %tobool, label %while.end.loopexit, label %for.body
+
+while.end.loopexit:
+  %p.next.lcssa = phi i8* [ %p.next, %for.body ]
+  br label %while.end
+
+while.end:
+  %r = phi i8* [ %s, %entry ], [ %p.next.lcssa, %while.end.loopexit ]
+  ret i8* %r
+}
+
+; int len(const char *s) { int i = 0; while (s[i]) ++i; return i; }
+
+; CHECK-LABEL: @len(
+; CHECK:         [[LEN:%.*]] = call i64 @strlen(i8* %s)
+; CHECK:         [[I:%.*]] = trunc i64 [[LEN]] to i32
+; CHECK:       exit:
+; CHECK-NEXT:    phi i32 [ [[I]], %loop ]
+
+define i32 @len(i8* %s) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %idx = sext i32 %i to i64
+  %p = getelementptr inbounds i8, i8* %s, i64 %idx
+  %c = load i8, i8* %p, align 1
+  %i.next = add nsw i32 %i, 1
+  %cmp = icmp ne i8 %c, 0
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  %i.lcssa = phi i32 [ %i, %loop ]
+  ret i32 %i.lcssa
+}
+
+; size_t wlen(const wchar_t *s) { size_t i = 0; while (s[i]) ++i; return i; }
+
+; CHECK-LABEL: @wlen(
+; CHECK:         [[LEN:%.*]] = call i64 @wcslen(i32* %s)
+; CHECK:       exit:
+; CHECK-NEXT:    phi i64 [ [[LEN]], %loop ]
+
+define i64 @wlen(i32* %s) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %p = getelementptr inbounds i32, i32* %s, i64 %i
+  %c = load i32, i32* %p, align 4
+  %i.next = add nuw i64 %i, 1
+  %cmp = icmp eq i32 %c, 0
+  br i1 %cmp, label %exit, label %loop
+
+exit:
+  %i.lcssa = phi i64 [ %i, %loop ]
+  ret i64 %i.lcssa
+}
+
+; A loop that writes memory is not replaced.
+
+; CHECK-LABEL: @len_store(
+; CHECK-NOT:     call i64 @strlen
+
+define i64 @len_store(i8* %s, i64* %count) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  store i64 %i, i64* %count, align 8
+  %p = getelementptr inbounds i8, i8* %s, i64 %i
+  %c = load i8, i8* %p, align 1
+  %i.next = add nuw i64 %i, 1
+  %cmp = icmp eq i8 %c, 0
+  br i1 %cmp, label %exit, label %loop
+
+exit:
+  %i.lcssa = phi i64 [ %i, %loop ]
+  ret i64 %i.lcssa
+}
+
+; char *find(char *b, char *e, char c) {
+;   for (; b != e; ++b)
+;     if (*b == c)
+;       return b;
+;   return 0;
+; }
+
+; CHECK-LABEL: @find(
+; CHECK:       for.body.preheader:
+; CHECK:         [[CH:%.*]] = zext i8 %c to i32
+; CHECK:         [[PTR:%.*]] = call i8* @memchr(i8* %b, i32 [[CH]], i64 [[N:%.*]])
+; CHECK:         [[FOUND:%.*]] = icmp ne i8* [[PTR]], null
+; CHECK:       for.body:
+; CHECK:         br i1 [[FOUND]], label %return.loopexit, label %for.inc
+; CHECK:       for.inc:
+; CHECK:         br i1 true, label %return.loopexit1, label %for.body
+; CHECK:       return.loopexit:
+; CHECK-NEXT:    phi i8* [ %{{.*}}, %for.body ]
+; DISABLED-LABEL: @find(
+; DISABLED-NOT:  call i8* @memchr
+
+define i8* @find(i8* %b, i8* %e, i8 %c) {
+entry:
+  %cmp.entry = icmp eq i8* %b, %e
+  br i1 %cmp.entry, label %return, label %for.body.preheader
+
+for.body.preheader:
+  br label %for.body
+
+for.body:
+  %p = phi i8* [ %p.next, %for.inc ], [ %b, %for.body.preheader ]
+  %v = load i8, i8* %p, align 1
+  %eq = icmp eq i8 %v, %c
+  br i1 %eq, label %return.loopexit, label %for.inc
+
+for.inc:
+  %p.next = getelementptr inbounds i8, i8* %p, i64 1
+  %done = icmp eq i8* %p.next, %e
+  br i1 %done, label %return.loopexit1, label %for.body
+
+return.loopexit:
+  %p.lcssa = phi i8* [ %p, %for.body ]
+  br label %return
+
+return.loopexit1:
+  br label %return
+
+return:
+  %r = phi i8* [ null, %entry ], [ %p.lcssa, %return.loopexit ], [ null, %return.loopexit1 ]
+  ret i8* %r
+}
+
+; bool equal(const int a[16], const int b[16]) {
+;   for (long i = 0; i < 16; ++i)
+;     if (a[i] != b[i])
+;       return false;
+;   return true;
+; }
+
+; CHECK-LABEL: @equal(
+; CHECK:       entry:
+; CHECK:         [[A:%.*]] = bitcast i32* %a to i8*
+; CHECK:         [[B:%.*]] = bitcast i32* %b to i8*
+; CHECK:         [[CMP:%.*]] = call i32 @bcmp(i8* [[A]], i8* [[B]], i64 64)
+; CHECK:         [[MISMATCH:%.*]] = icmp ne i32 [[CMP]], 0
+; CHECK:       for.body:
+; CHECK:         br i1 [[MISMATCH]], label %return, label %for.inc
+; CHECK:       for.inc:
+; CHECK:         br i1 true, label %return, label %for.body
+; DISABLED-LABEL: @equal(
+; DISABLED-NOT:  call i32 @bcmp
+
+define i1 @equal(i32* dereferenceable(64) %a, i32* dereferenceable(64) %b) {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ %i.next, %for.inc ], [ 0, %entry ]
+  %pa = getelementptr inbounds i32, i32* %a, i64 %i
+  %va = load i32, i32* %pa, align 4
+  %pb = getelementptr inbounds i32, i32* %b, i64 %i
+  %vb = load i32, i32* %pb, align 4
+  %ne = icmp ne i32 %va, %vb
+  br i1 %ne, label %return, label %for.inc
+
+for.inc:
+  %i.next = add nuw nsw i64 %i, 1
+  %done = icmp eq i64 %i.next, 16
+  br i1 %done, label %return, label %for.body
+
+return:
+  %r = phi i1 [ false, %for.body ], [ true, %for.inc ]
+  ret i1 %r
+}
+
+; The loop stops reading at the first mismatch, but bcmp may read all the
+; bytes of both ranges, which are not known to be dereferenceable here.
+
+; CHECK-LABEL: @equal_unknown_size(
+; CHECK-NOT:     call i32 @bcmp
+
+define i1 @equal_unknown_size(i32* %a, i32* %b, i64 %n) {
+entry:
+  %cmp.entry = icmp sgt i64 %n, 0
+  br i1 %cmp.entry, label %for.body.preheader, label %return
+
+for.body.preheader:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ %i.next, %for.inc ], [ 0, %for.body.preheader ]
+  %pa = getelementptr inbounds i32, i32* %a, i64 %i
+  %va = load i32, i32* %pa, align 4
+  %pb = getelementptr inbounds i32, i32* %b, i64 %i
+  %vb = load i32, i32* %pb, align 4
+  %ne = icmp ne i32 %va, %vb
+  br i1 %ne, label %return, label %for.inc
+
+for.inc:
+  %i.next = add nuw nsw i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %return, label %for.body
+
+return:
+  %r = phi i1 [ true, %entry ], [ false, %for.body ], [ true, %for.inc ]
+  ret i1 %r
+}
+
+; Only the second range is known to be dereferenceable.
+
+; CHECK-LABEL: @equal_one_deref(
+; CHECK-NOT:     call i32 @bcmp
+
+define i1 @equal_one_deref(i8* %a, i8* dereferenceable(16) %b) {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ %i.next, %for.inc ], [ 0, %entry ]
+  %pa = getelementptr inbounds i8, i8* %a, i64 %i
+  %va = load i8, i8* %pa, align 1
+  %pb = getelementptr inbounds i8, i8* %b, i64 %i
+  %vb = load i8, i8* %pb, align 1
+  %ne = icmp ne i8 %va, %vb
+  br i1 %ne, label %return, label %for.inc
+
+for.inc:
+  %i.next = add nuw nsw i64 %i, 1
+  %done = icmp eq i64 %i.next, 16
+  br i1 %done, label %return, label %for.body
+
+return:
+  %r = phi i1 [ false, %for.body ], [ true, %for.inc ]
+  ret i1 %r
+}
+
+; The index of the first mismatch is not computed by bcmp.
+
+; CHECK-LABEL: @mismatch(
+; CHECK-NOT:     call i32 @bcmp
+
+define i64 @mismatch(i8* %a, i8* %b, i64 %n) {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ %i.next, %for.inc ], [ 0, %entry ]
+  %pa = getelementptr inbounds i8, i8* %a, i64 %i
+  %va = load i8, i8* %pa, align 1
+  %pb = getelementptr inbounds i8, i8* %b, i64 %i
+  %vb = load i8, i8* %pb, align 1
+  %ne = icmp ne i8 %va, %vb
+  br i1 %ne, label %return, label %for.inc
+
+for.inc:
+  %i.next = add nuw nsw i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %return, label %for.body
+
+return:
+  %r = phi i64 [ %i, %for.body ], [ %n, %for.inc ]
+  ret i64 %r
+}
+
+; strlen only takes pointers to the default address space.
+
+; CHECK-LABEL: @len_addrspace(
+; CHECK-NOT:     call i64 @strlen
+
+define i64 @len_addrspace(i8 addrspace(1)* %s) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %p = getelementptr inbounds i8, i8 addrspace(1)* %s, i64 %i
+  %c = load i8, i8 addrspace(1)* %p, align 1
+  %i.next = add nuw i64 %i, 1
+  %cmp = icmp eq i8 %c, 0
+  br i1 %cmp, label %exit, label %loop
+
+exit:
+  %i.lcssa = phi i64 [ %i, %loop ]
+  ret i64 %i.lcssa
+}
+
+!llvm.module.flags = !{!0}
+!0 = !{i32 1, !"wchar_size", i32 4}
@@ -1,5 +1,6 @@
-; RUN: opt -mattr=+avx512f --loop-vectorize -S < %s | llc -mattr=+avx512f | FileCheck %s
-; RUN: opt -mattr=+avx512vl,+prefer-256-bit --loop-vectorize -S < %s | llc -mattr=+avx512f | FileCheck %s --check-prefix=CHECK-PREFER-AVX256
+; RUN: opt -mattr=+avx512f --loop-vectorize -enable-epilogue-vectorization=false -S < %s | llc -mattr=+avx512f | FileCheck %s
+; RUN: opt -mattr=+avx512vl,+prefer-256-bit --loop-vectorize -enable-epilogue-vectorization=false -S < %s | llc -mattr=+avx512f | FileCheck %s --check-prefix=CHECK-PREFER-AVX256
+; RUN: opt -mattr=+avx512f --loop-vectorize -S < %s | llc -mattr=+avx512f | FileCheck %s --check-prefix=CHECK-EPILOGUE
 
 target datalayout = "e-m:o-i64:64-f80:128-n8:16:32:64-S128"
 target triple = "x86_64-apple-macosx10.9.0"
@@ -17,6 +18,14 @@ target triple = "x86_64-apple-macosx10.9.0"
 ; CHECK-PREFER-AVX256: vmovdqu %ymm{{.}},
 ; CHECK-PREFER-AVX256-NOT: %zmm
 
+; The remainder of the 512-bit loop is itself vectorized with 256-bit vectors.
+
+; CHECK-EPILOGUE-LABEL: f:
+; CHECK-EPILOGUE: vmovdqu64 %zmm{{.}},
+; CHECK-EPILOGUE: vmovdqu %ymm{{.}},
+; CHECK-EPILOGUE-NOT: %zmm
+; CHECK-EPILOGUE: retq
+
 define void @f(i32* %a, i32 %n) {
 entry:
   %cmp4 = icmp sgt i32 %n, 0
@@ -0,0 +1,152 @@
+; RUN: opt < %s -loop-vectorize -mattr=+avx512f -force-vector-interleave=1 -S | FileCheck %s
+; RUN: opt < %s -loop-vectorize -mattr=+avx512f -force-vector-interleave=1 -enable-epilogue-vectorization=false -S | FileCheck %s -check-prefix=DISABLED
+
+; Check that the remainder of loops vectorized with a large VF is vectorized
+; with a smaller one.
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+; void add(float *restrict a, float *restrict b, int n) {
+;   for (int i = 0; i < n; i++)
+;     a[i] += b[i];
+; }
+;
+; No runtime checks are needed, so the vector epilogue is also entered when the
+; trip count is too small for the main vector loop.
+
+; CHECK-LABEL: @add(
+; CHECK: vector.body:
+; CHECK:   load <16 x float>
+; CHECK: middle.block:
+; CHECK:   br i1 %cmp.n, label %{{.*}}, label %scalar.ph
+; CHECK: scalar.ph:
+; CHECK:   %bc.resume.val = phi i64
+; CHECK:   br i1 %min.iters.check{{[0-9]+}}, label %[[SCALAR_PH:.*]], label %[[EPI_PH:.*]]
+; CHECK: [[EPI_PH]]:
+; CHECK: [[EPI_BODY:vector.body[0-9]+]]:
+; CHECK:   load <8 x float>
+; CHECK:   store <8 x float>
+; CHECK:   br i1 {{.*}}, label %[[EPI_MIDDLE:.*]], label %[[EPI_BODY]]
+; CHECK: [[EPI_MIDDLE]]:
+; CHECK: [[SCALAR_PH]]:
+; CHECK:   phi i64 [ %{{.*}}, %[[EPI_MIDDLE]] ], [ %bc.resume.val, %scalar.ph ]
+
+; DISABLED-LABEL: @add(
+; DISABLED: load <16 x float>
+; DISABLED-NOT: load <8 x float>
+
+define void @add(float* noalias nocapture %a, float* noalias nocapture readonly %b, i64 %n) {
+entry:
+  %cmp6 = icmp sgt i64 %n, 0
+  br i1 %cmp6, label %for.body, label %for.end
+
+for.body:
+  %iv = phi i64 [ %iv.next, %for.body ], [ 0, %entry ]
+  %arrayidx = getelementptr inbounds float, float* %b, i64 %iv
+  %0 = load float, float* %arrayidx, align 4
+  %arrayidx2 = getelementptr inbounds float, float* %a, i64 %iv
+  %1 = load float, float* %arrayidx2, align 4
+  %add = fadd float %0, %1
+  store float %add, float* %arrayidx2, align 4
+  %iv.next = add nuw nsw i64 %iv, 1
+  %exitcond = icmp eq i64 %iv.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+}
+
+; The same loop with pointers that may alias. The vector epilogue relies on the
+; memory checks of the main loop, and is only entered from its middle block.
+
+; CHECK-LABEL: @add_may_alias(
+; CHECK: vector.memcheck:
+; CHECK:   br i1 %memcheck.conflict, label %[[SCALAR_PH:.*]], label %vector.ph
+; CHECK: vector.body:
+; CHECK:   load <16 x float>
+; CHECK: scalar.ph:
+; CHECK:   phi i64 [ %{{.*}}, %middle.block ]
+; CHECK-NOT: vector.memcheck
+; CHECK:   load <8 x float>
+; CHECK: [[SCALAR_PH]]:
+; CHECK-DAG: [ 0, %vector.memcheck ]
+; CHECK-DAG: [ 0, %for.body.preheader ]
+
+define void @add_may_alias(float* nocapture %a, float* nocapture readonly %b, i64 %n) {
+entry:
+  %cmp6 = icmp sgt i64 %n, 0
+  br i1 %cmp6, label %for.body, label %for.end
+
+for.body:
+  %iv = phi i64 [ %iv.next, %for.body ], [ 0, %entry ]
+  %arrayidx = getelementptr inbounds float, float* %b, i64 %iv
+  %0 = load float, float* %arrayidx, align 4
+  %arrayidx2 = getelementptr inbounds float, float* %a, i64 %iv
+  %1 = load float, float* %arrayidx2, align 4
+  %add = fadd float %0, %1
+  store float %add, float* %arrayidx2, align 4
+  %iv.next = add nuw nsw i64 %iv, 1
+  %exitcond = icmp eq i64 %iv.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+}
+
+; A sum reduction, whose epilogue starts from the partial sum of the main loop.
+
+; CHECK-LABEL: @sum(
+; CHECK: vector.body:
+; CHECK:   load <16 x i32>
+; CHECK: scalar.ph:
+; CHECK:   %bc.merge.rdx = phi i32
+; CHECK:   insertelement <8 x i32> zeroinitializer, i32 %bc.merge.rdx, i32 0
+; CHECK:   load <8 x i32>
+; CHECK: for.end:
+; CHECK:   phi i32 [ %{{.*}}, %for.body ], [ %{{.*}}, %middle.block ], [ %{{.*}}, %middle.block{{[0-9]+}} ]
+
+define i32 @sum(i32* nocapture readonly %a, i64 %n) {
+entry:
+  br label %for.body
+
+for.body:
+  %iv = phi i64 [ %iv.next, %for.body ], [ 0, %entry ]
+  %s = phi i32 [ %add, %for.body ], [ 0, %entry ]
+  %arrayidx = getelementptr inbounds i32, i32* %a, i64 %iv
+  %0 = load i32, i32* %arrayidx, align 4
+  %add = add nsw i32 %0, %s
+  %iv.next = add nuw nsw i64 %iv, 1
+  %exitcond = icmp eq i64 %iv.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret i32 %add
+}
+
+; With a known trip count, the epilogue is only vectorized if the remainder is
+; long enough: 100 = 6 * 16 + 4 leaves 4 iterations, which are vectorized by 4.
+
+; CHECK-LABEL: @add_tc100(
+; CHECK: load <16 x float>
+; CHECK: load <4 x float>
+
+define void @add_tc100(float* noalias nocapture %a, float* noalias nocapture readonly %b) {
+entry:
+  br label %for.body
+
+for.body:
+  %iv = phi i64 [ %iv.next, %for.body ], [ 0, %entry ]
+  %arrayidx = getelementptr inbounds float, float* %b, i64 %iv
+  %0 = load float, float* %arrayidx, align 4
+  %arrayidx2 = getelementptr inbounds float, float* %a, i64 %iv
+  %1 = load float, float* %arrayidx2, align 4
+  %add = fadd float %0, %1
+  store float %add, float* %arrayidx2, align 4
+  %iv.next = add nuw nsw i64 %iv, 1
+  %exitcond = icmp eq i64 %iv.next, 100
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+}
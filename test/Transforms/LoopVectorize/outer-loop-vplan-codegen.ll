@@ -0,0 +1,157 @@
+; RUN: opt -S -loop-vectorize -enable-vplan-native-path < %s | FileCheck %s
+; RUN: opt -S -loop-vectorize -enable-vplan-native-path -mattr=+avx2 < %s | FileCheck %s -check-prefix=AVX
+
+; Check that outer loops with uniform inner loops are vectorized along the
+; outer dimension in the VPlan-native path. The inner loop is kept, and all
+; the lanes of the vector loop run its iterations in lock-step.
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@A = common global [64 x [1024 x float]] zeroinitializer, align 16
+@B = common global [64 x [1024 x float]] zeroinitializer, align 16
+
+; 2-D stencil with a user vector width:
+;
+;   #pragma clang loop vectorize(enable) vectorize_width(4)
+;   for (i = 0; i < 1024; i++)
+;     for (j = 0; j < 62; j++)
+;       A[j+1][i] = B[j][i] + B[j+2][i];
+;
+; The accesses are consecutive along the outer loop and become wide loads and
+; stores.
+
+; CHECK-LABEL: @stencil(
+; CHECK: vector.body:
+; CHECK:   %vec.ind = phi <4 x i64>
+; CHECK: [[INNER:[a-z.0-9]+]]:
+; CHECK:   %vec.phi = phi <4 x i64> [ {{.*}}, %[[INNER]] ], [ zeroinitializer, %vector.body ]
+; CHECK:   load <4 x float>
+; CHECK:   load <4 x float>
+; CHECK:   fadd <4 x float>
+; CHECK:   store <4 x float>
+; CHECK:   [[CMP:%.*]] = icmp eq <4 x i64>
+; CHECK:   [[C0:%.*]] = extractelement <4 x i1> [[CMP]], i32 0
+; CHECK:   br i1 [[C0]], label %{{.*}}, label %[[INNER]]
+; CHECK: middle.block:
+
+define void @stencil() {
+entry:
+  br label %outer.header
+
+outer.header:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %outer.latch ]
+  br label %inner.body
+
+inner.body:
+  %j = phi i64 [ 0, %outer.header ], [ %j.next, %inner.body ]
+  %j1 = add nuw nsw i64 %j, 1
+  %jp1 = add nuw nsw i64 %j, 2
+  %pm1 = getelementptr inbounds [64 x [1024 x float]], [64 x [1024 x float]]* @B, i64 0, i64 %j, i64 %i
+  %vm1 = load float, float* %pm1, align 4
+  %pp1 = getelementptr inbounds [64 x [1024 x float]], [64 x [1024 x float]]* @B, i64 0, i64 %jp1, i64 %i
+  %vp1 = load float, float* %pp1, align 4
+  %sum = fadd float %vm1, %vp1
+  %pa = getelementptr inbounds [64 x [1024 x float]], [64 x [1024 x float]]* @A, i64 0, i64 %j1, i64 %i
+  store float %sum, float* %pa, align 4
+  %j.next = add nuw nsw i64 %j, 1
+  %inner.exitcond = icmp eq i64 %j.next, 62
+  br i1 %inner.exitcond, label %outer.latch, label %inner.body
+
+outer.latch:
+  %i.next = add nuw nsw i64 %i, 1
+  %outer.exitcond = icmp eq i64 %i.next, 1024
+  br i1 %outer.exitcond, label %exit, label %outer.header, !llvm.loop !1
+
+exit:
+  ret void
+}
+
+; Transposition, whose loads are strided along the outer loop:
+;
+;   #pragma clang loop vectorize(enable) vectorize_width(4)
+;   for (i = 0; i < 64; i++)
+;     for (j = 0; j < 64; j++)
+;       A[j][i] = B[i][j];
+
+; CHECK-LABEL: @transpose(
+; CHECK: vector.body:
+; CHECK:   call <4 x float> @llvm.masked.gather.v4f32.v4p0f32(
+; CHECK:   store <4 x float>
+; CHECK: middle.block:
+
+define void @transpose() {
+entry:
+  br label %outer.header
+
+outer.header:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %outer.latch ]
+  br label %inner.body
+
+inner.body:
+  %j = phi i64 [ 0, %outer.header ], [ %j.next, %inner.body ]
+  %pb = getelementptr inbounds [64 x [1024 x float]], [64 x [1024 x float]]* @B, i64 0, i64 %i, i64 %j
+  %v = load float, float* %pb, align 4
+  %pa = getelementptr inbounds [64 x [1024 x float]], [64 x [1024 x float]]* @A, i64 0, i64 %j, i64 %i
+  store float %v, float* %pa, align 4
+  %j.next = add nuw nsw i64 %j, 1
+  %inner.exitcond = icmp eq i64 %j.next, 64
+  br i1 %inner.exitcond, label %outer.latch, label %inner.body
+
+outer.latch:
+  %i.next = add nuw nsw i64 %i, 1
+  %outer.exitcond = icmp eq i64 %i.next, 64
+  br i1 %outer.exitcond, label %exit, label %outer.header, !llvm.loop !4
+
+exit:
+  ret void
+}
+
+; The same stencil without a vector width. The loop is annotated parallel, so
+; the cost model picks the width, which the vector registers bound. The inner
+; induction is widened to <VF x i64>, so AVX2 is needed for the wider factor.
+
+; CHECK-LABEL: @stencil_cost_model(
+; CHECK: load <4 x float>
+; CHECK: store <4 x float>
+; AVX-LABEL: @stencil_cost_model(
+; AVX: load <8 x float>
+; AVX: store <8 x float>
+
+define void @stencil_cost_model() {
+entry:
+  br label %outer.header
+
+outer.header:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %outer.latch ]
+  br label %inner.body
+
+inner.body:
+  %j = phi i64 [ 0, %outer.header ], [ %j.next, %inner.body ]
+  %j1 = add nuw nsw i64 %j, 1
+  %jp1 = add nuw nsw i64 %j, 2
+  %pm1 = getelementptr inbounds [64 x [1024 x float]], [64 x [1024 x float]]* @B, i64 0, i64 %j, i64 %i
+  %vm1 = load float, float* %pm1, align 4, !llvm.mem.parallel_loop_access !3
+  %pp1 = getelementptr inbounds [64 x [1024 x float]], [64 x [1024 x float]]* @B, i64 0, i64 %jp1, i64 %i
+  %vp1 = load float, float* %pp1, align 4, !llvm.mem.parallel_loop_access !3
+  %sum = fadd float %vm1, %vp1
+  %pa = getelementptr inbounds [64 x [1024 x float]], [64 x [1024 x float]]* @A, i64 0, i64 %j1, i64 %i
+  store float %sum, float* %pa, align 4, !llvm.mem.parallel_loop_access !3
+  %j.next = add nuw nsw i64 %j, 1
+  %inner.exitcond = icmp eq i64 %j.next, 62
+  br i1 %inner.exitcond, label %outer.latch, label %inner.body
+
+outer.latch:
+  %i.next = add nuw nsw i64 %i, 1
+  %outer.exitcond = icmp eq i64 %i.next, 1024
+  br i1 %outer.exitcond, label %exit, label %outer.header, !llvm.loop !3
+
+exit:
+  ret void
+}
+
+!0 = !{!"llvm.loop.vectorize.enable", i1 true}
+!1 = distinct !{!1, !0, !2}
+!2 = !{!"llvm.loop.vectorize.width", i32 4}
+!3 = distinct !{!3, !0}
+!4 = distinct !{!4, !0, !2}
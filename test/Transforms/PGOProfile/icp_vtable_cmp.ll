@@ -0,0 +1,79 @@
+; RUN: opt < %s -pgo-icall-prom -icp-enable-vtable-cmp -S | FileCheck %s
+; RUN: opt < %s -passes=pgo-icall-prom -icp-enable-vtable-cmp -S | FileCheck %s
+; RUN: opt < %s -pgo-icall-prom -icp-enable-vtable-cmp -pass-remarks=pgo-icall-prom -S 2>&1 | FileCheck %s --check-prefix=REMARK
+; RUN: opt < %s -pgo-icall-prom -S | FileCheck %s --check-prefix=FPTR
+; RUN: opt < %s -pgo-icall-prom -icp-enable-vtable-cmp -icp-max-num-vtables=1 -S | FileCheck %s --check-prefix=MAX1
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+; B::g is in the vtables of B and D, and C::g is in the vtable of C.
+
+@_ZTV1B = constant { [4 x i8*] } { [4 x i8*] [i8* null, i8* null, i8* bitcast (i32 (i8*, i32)* @_ZN1B1fEi to i8*), i8* bitcast (i32 (i8*, i32)* @_ZN1B1gEi to i8*)] }, !type !0
+@_ZTV1C = constant { [4 x i8*] } { [4 x i8*] [i8* null, i8* null, i8* bitcast (i32 (i8*, i32)* @_ZN1C1fEi to i8*), i8* bitcast (i32 (i8*, i32)* @_ZN1C1gEi to i8*)] }, !type !0
+@_ZTV1D = constant { [4 x i8*] } { [4 x i8*] [i8* null, i8* null, i8* bitcast (i32 (i8*, i32)* @_ZN1D1fEi to i8*), i8* bitcast (i32 (i8*, i32)* @_ZN1B1gEi to i8*)] }, !type !0
+
+declare i32 @_ZN1B1fEi(i8*, i32)
+declare i32 @_ZN1B1gEi(i8*, i32)
+declare i32 @_ZN1C1fEi(i8*, i32)
+declare i32 @_ZN1C1gEi(i8*, i32)
+declare i32 @_ZN1D1fEi(i8*, i32)
+
+declare i1 @llvm.type.test(i8*, metadata)
+declare void @llvm.assume(i1)
+
+; The vtable pointer is compared to the address points of the vtables holding
+; each target, and the load of the function pointer only happens when no
+; target matches.
+
+; CHECK-LABEL: @call_g(
+; CHECK:         %vtable = load i32 (i8*, i32)**, i32 (i8*, i32)*** %vtableptr
+; CHECK:         call void @llvm.assume(
+; CHECK-NEXT:    [[CMPB:%[0-9]+]] = icmp eq i32 (i8*, i32)** %vtable, bitcast (i8* getelementptr inbounds (i8, i8* bitcast ({ [4 x i8*] }* @_ZTV1B to i8*), i64 16) to i32 (i8*, i32)**)
+; CHECK-NEXT:    [[CMPD:%[0-9]+]] = icmp eq i32 (i8*, i32)** %vtable, bitcast (i8* getelementptr inbounds (i8, i8* bitcast ({ [4 x i8*] }* @_ZTV1D to i8*), i64 16) to i32 (i8*, i32)**)
+; CHECK-NEXT:    [[OR:%[0-9]+]] = or i1 [[CMPB]], [[CMPD]]
+; CHECK-NEXT:    br i1 [[OR]], label %if.true.direct_targ, label %if.false.orig_indirect, !prof [[WEIGHTS_B:![0-9]+]]
+; CHECK:       if.true.direct_targ:
+; CHECK-NEXT:    call i32 @_ZN1B1gEi(i8* %obj, i32 %a)
+; CHECK:       if.false.orig_indirect:
+; CHECK-NEXT:    [[CMPC:%[0-9]+]] = icmp eq i32 (i8*, i32)** %vtable, bitcast (i8* getelementptr inbounds (i8, i8* bitcast ({ [4 x i8*] }* @_ZTV1C to i8*), i64 16) to i32 (i8*, i32)**)
+; CHECK-NEXT:    br i1 [[CMPC]], label %if.true.direct_targ1, label %if.false.orig_indirect2, !prof [[WEIGHTS_C:![0-9]+]]
+; CHECK:       if.true.direct_targ1:
+; CHECK-NEXT:    call i32 @_ZN1C1gEi(i8* %obj, i32 %a)
+; CHECK:       if.false.orig_indirect2:
+; CHECK-NEXT:    %vfn = getelementptr inbounds i32 (i8*, i32)*, i32 (i8*, i32)** %vtable, i64 1
+; CHECK-NEXT:    %fptr = load i32 (i8*, i32)*, i32 (i8*, i32)** %vfn
+; CHECK-NEXT:    %call = call i32 %fptr(i8* %obj, i32 %a)
+
+; CHECK: [[WEIGHTS_B]] = !{!"branch_weights", i32 1500, i32 100}
+; CHECK: [[WEIGHTS_C]] = !{!"branch_weights", i32 100, i32 0}
+
+; REMARK: remark: <unknown>:0:0: Promote indirect call to _ZN1B1gEi with count 1500 out of 1600 by comparing 2 vtables
+; REMARK: remark: <unknown>:0:0: Promote indirect call to _ZN1C1gEi with count 100 out of 100 by comparing 1 vtables
+
+; FPTR-LABEL: @call_g(
+; FPTR:         %fptr = load i32 (i8*, i32)*, i32 (i8*, i32)** %vfn
+; FPTR-NEXT:    [[CMP:%[0-9]+]] = icmp eq i32 (i8*, i32)* %fptr, @_ZN1B1gEi
+; FPTR-NOT:     icmp eq i32 (i8*, i32)** %vtable
+
+; MAX1-LABEL: @call_g(
+; MAX1:         %fptr = load i32 (i8*, i32)*, i32 (i8*, i32)** %vfn
+; MAX1-NEXT:    [[CMP:%[0-9]+]] = icmp eq i32 (i8*, i32)* %fptr, @_ZN1B1gEi
+; MAX1:       if.false.orig_indirect:
+; MAX1-NEXT:    icmp eq i32 (i8*, i32)** %vtable, bitcast (i8* getelementptr inbounds (i8, i8* bitcast ({ [4 x i8*] }* @_ZTV1C to i8*), i64 16) to i32 (i8*, i32)**)
+
+define i32 @call_g(i8* %obj, i32 %a) {
+entry:
+  %vtableptr = bitcast i8* %obj to i32 (i8*, i32)***
+  %vtable = load i32 (i8*, i32)**, i32 (i8*, i32)*** %vtableptr
+  %vtablei8 = bitcast i32 (i8*, i32)** %vtable to i8*
+  %p = call i1 @llvm.type.test(i8* %vtablei8, metadata !"_ZTS1A")
+  call void @llvm.assume(i1 %p)
+  %vfn = getelementptr inbounds i32 (i8*, i32)*, i32 (i8*, i32)** %vtable, i64 1
+  %fptr = load i32 (i8*, i32)*, i32 (i8*, i32)** %vfn
+  %call = call i32 %fptr(i8* %obj, i32 %a), !prof !1
+  ret i32 %call
+}
+
+!0 = !{i64 16, !"_ZTS1A"}
+!1 = !{!"VP", i32 0, i64 1600, i64 -91239693552967080, i64 1500, i64 8392582708229377067, i64 100}
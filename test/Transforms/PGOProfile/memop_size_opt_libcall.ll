@@ -0,0 +1,138 @@
+; RUN: opt < %s -pgo-memop-opt -verify-dom-info -S | FileCheck %s
+; RUN: opt < %s -passes=pgo-memop-opt -verify-dom-info -S | FileCheck %s
+; RUN: opt < %s -pgo-memop-opt -verify-dom-info -pgo-memop-range-opt -memop-size-range=0:32 -S | FileCheck %s --check-prefix=RANGE
+; RUN: opt < %s -pgo-instr-gen -pgo-instr-memop-libcalls -S | FileCheck %s --check-prefix=GEN
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+declare i32 @memcmp(i8*, i8*, i64)
+declare i8* @memset(i8*, i32, i64)
+declare void @llvm.memmove.p0i8.p0i8.i64(i8* nocapture, i8* nocapture readonly, i64, i1)
+
+; A library call with a hot size, whose result merges after the versions.
+
+; CHECK-LABEL: @cmp(
+; CHECK:       switch i64 %n, label %MemOP.Default [
+; CHECK-NEXT:    i64 8, label %MemOP.Case.8
+; CHECK-NEXT:  ], !prof [[CMP_SWITCH:![0-9]+]]
+; CHECK:     MemOP.Case.8:
+; CHECK-NEXT:  [[R8:%.*]] = call i32 @memcmp(i8* %a, i8* %b, i64 8)
+; CHECK-NEXT:  br label %MemOP.Merge
+; CHECK:     MemOP.Default:
+; CHECK-NEXT:  %r = call i32 @memcmp(i8* %a, i8* %b, i64 %n), !prof [[CMP_VP:![0-9]+]]
+; CHECK-NEXT:  br label %MemOP.Merge
+; CHECK:     MemOP.Merge:
+; CHECK-NEXT:  %r.merge = phi i32 [ %r, %MemOP.Default ], [ [[R8]], %MemOP.Case.8 ]
+; CHECK-NEXT:  ret i32 %r.merge
+
+; GEN-LABEL: @cmp(
+; GEN:       call void @llvm.instrprof.value.profile(i8* getelementptr inbounds ([3 x i8], [3 x i8]* @__profn_cmp, i32 0, i32 0), i64 {{[0-9]+}}, i64 %n, i32 1, i32 0)
+; GEN-NEXT:  %r = call i32 @memcmp(
+
+define i32 @cmp(i8* %a, i8* %b, i64 %n) !prof !0 {
+entry:
+  %r = call i32 @memcmp(i8* %a, i8* %b, i64 %n), !prof !1
+  ret i32 %r
+}
+
+; A memmove with a hot size, and a hot range of larger sizes that is copied
+; with two overlapping 16 byte accesses.
+
+; CHECK-LABEL: @move(
+; CHECK:       switch i64 %n, label %MemOP.Default [
+; CHECK-NEXT:    i64 8, label %MemOP.Case.8
+; CHECK-NEXT:  ]
+; CHECK:     MemOP.Case.8:
+; CHECK-NEXT:  call void @llvm.memmove.p0i8.p0i8.i64(i8* %d, i8* %s, i64 8, i1 false)
+; CHECK:     MemOP.Default:
+; CHECK-NEXT:  call void @llvm.memmove.p0i8.p0i8.i64(i8* %d, i8* %s, i64 %n, i1 false), !prof [[MOVE_VP:![0-9]+]]
+
+; RANGE-LABEL: @move(
+; RANGE:       switch i64 %n, label %MemOP.RangeCheck [
+; RANGE-NEXT:    i64 8, label %MemOP.Case.8
+; RANGE-NEXT:  ], !prof [[MOVE_SWITCH:![0-9]+]]
+; RANGE:     MemOP.RangeCheck:
+; RANGE-NEXT:  [[OFF:%.*]] = sub i64 %n, 17
+; RANGE-NEXT:  [[IN:%.*]] = icmp ule i64 [[OFF]], 15
+; RANGE-NEXT:  br i1 [[IN]], label %MemOP.Range.17.32, label %MemOP.Default, !prof [[MOVE_RANGE:![0-9]+]]
+; RANGE:     MemOP.Case.8:
+; RANGE-NEXT:  call void @llvm.memmove.p0i8.p0i8.i64(i8* %d, i8* %s, i64 8, i1 false)
+; RANGE:     MemOP.Range.17.32:
+; RANGE-NEXT:  [[TAIL:%.*]] = sub i64 %n, 16
+; RANGE-NEXT:  [[SH:%.*]] = bitcast i8* %s to i128*
+; RANGE-NEXT:  [[ST8:%.*]] = getelementptr inbounds i8, i8* %s, i64 [[TAIL]]
+; RANGE-NEXT:  [[ST:%.*]] = bitcast i8* [[ST8]] to i128*
+; RANGE-NEXT:  [[HEAD:%.*]] = load i128, i128* [[SH]], align 1
+; RANGE-NEXT:  [[END:%.*]] = load i128, i128* [[ST]], align 1
+; RANGE-NEXT:  [[DH:%.*]] = bitcast i8* %d to i128*
+; RANGE-NEXT:  [[DT8:%.*]] = getelementptr inbounds i8, i8* %d, i64 [[TAIL]]
+; RANGE-NEXT:  [[DT:%.*]] = bitcast i8* [[DT8]] to i128*
+; RANGE-NEXT:  store i128 [[HEAD]], i128* [[DH]], align 1
+; RANGE-NEXT:  store i128 [[END]], i128* [[DT]], align 1
+; RANGE-NEXT:  br label %MemOP.Merge
+; RANGE:     MemOP.Default:
+; RANGE-NEXT:  call void @llvm.memmove.p0i8.p0i8.i64(i8* %d, i8* %s, i64 %n, i1 false), !prof [[MOVE_RANGE_VP:![0-9]+]]
+
+define void @move(i8* %d, i8* %s, i64 %n) !prof !2 {
+entry:
+  call void @llvm.memmove.p0i8.p0i8.i64(i8* %d, i8* %s, i64 %n, i1 false), !prof !3
+  ret void
+}
+
+; No size is hot enough on its own, but the range of sizes 3 and 4 is. The
+; byte is splatted for the two overlapping stores.
+
+; CHECK-LABEL: @fill(
+; CHECK-NOT:   MemOP
+; CHECK:       ret i8* %r
+
+; RANGE-LABEL: @fill(
+; RANGE-NEXT:  entry:
+; RANGE-NEXT:    br label %MemOP.RangeCheck
+; RANGE:       MemOP.RangeCheck:
+; RANGE-NEXT:    [[OFF:%.*]] = sub i64 %n, 3
+; RANGE-NEXT:    [[IN:%.*]] = icmp ule i64 [[OFF]], 1
+; RANGE-NEXT:    br i1 [[IN]], label %MemOP.Range.3.4, label %MemOP.Default
+; RANGE:       MemOP.Range.3.4:
+; RANGE-NEXT:    [[TAIL:%.*]] = sub i64 %n, 2
+; RANGE-NEXT:    [[BYTE:%.*]] = trunc i32 %c to i8
+; RANGE-NEXT:    [[EXT:%.*]] = zext i8 [[BYTE]] to i16
+; RANGE-NEXT:    [[SPLAT:%.*]] = mul i16 [[EXT]], 257
+; RANGE-NEXT:    [[DH:%.*]] = bitcast i8* %d to i16*
+; RANGE-NEXT:    [[DT8:%.*]] = getelementptr inbounds i8, i8* %d, i64 [[TAIL]]
+; RANGE-NEXT:    [[DT:%.*]] = bitcast i8* [[DT8]] to i16*
+; RANGE-NEXT:    store i16 [[SPLAT]], i16* [[DH]], align 1
+; RANGE-NEXT:    store i16 [[SPLAT]], i16* [[DT]], align 1
+; RANGE-NEXT:    br label %MemOP.Merge
+; RANGE:       MemOP.Default:
+; RANGE-NEXT:    %r = call i8* @memset(i8* %d, i32 %c, i64 %n), !prof [[FILL_VP:![0-9]+]]
+; RANGE-NEXT:    br label %MemOP.Merge
+; RANGE:       MemOP.Merge:
+; RANGE-NEXT:    %r.merge = phi i8* [ %r, %MemOP.Default ], [ %d, %MemOP.Range.3.4 ]
+; RANGE-NEXT:    ret i8* %r.merge
+
+; GEN-LABEL: @fill(
+; GEN:       call void @llvm.instrprof.value.profile(
+; GEN-NEXT:  %r = call i8* @memset(
+
+define i8* @fill(i8* %d, i32 %c, i64 %n) !prof !2 {
+entry:
+  %r = call i8* @memset(i8* %d, i32 %c, i64 %n), !prof !4
+  ret i8* %r
+}
+
+!0 = !{!"function_entry_count", i64 2000}
+!1 = !{!"VP", i32 1, i64 2000, i64 8, i64 1500, i64 16, i64 300, i64 3, i64 200}
+!2 = !{!"function_entry_count", i64 4000}
+!3 = !{!"VP", i32 1, i64 4000, i64 8, i64 2000, i64 24, i64 800, i64 20, i64 600, i64 30, i64 300, i64 12, i64 300}
+!4 = !{!"VP", i32 1, i64 4000, i64 3, i64 1500, i64 4, i64 1300, i64 40, i64 1200}
+
+; CHECK-DAG: [[CMP_SWITCH]] = !{!"branch_weights", i32 500, i32 1500}
+; CHECK-DAG: [[CMP_VP]] = !{!"VP", i32 1, i64 500, i64 16, i64 300, i64 3, i64 200}
+; CHECK-DAG: [[MOVE_VP]] = !{!"VP", i32 1, i64 2000, i64 24, i64 800, i64 20, i64 600, i64 30, i64 300, i64 12, i64 300}
+
+; RANGE-DAG: [[MOVE_SWITCH]] = !{!"branch_weights", i32 2000, i32 2000}
+; RANGE-DAG: [[MOVE_RANGE]] = !{!"branch_weights", i32 1700, i32 300}
+; RANGE-DAG: [[MOVE_RANGE_VP]] = !{!"VP", i32 1, i64 300, i64 12, i64 300}
+; RANGE-DAG: [[FILL_VP]] = !{!"VP", i32 1, i64 1200, i64 40, i64 1200}
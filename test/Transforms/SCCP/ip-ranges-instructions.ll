@@ -0,0 +1,100 @@
+; RUN: opt < %s -ipsccp -S | FileCheck %s
+; RUN: opt < %s -ipsccp -sccp-max-range-extensions=0 -S | FileCheck %s --check-prefix=NOEXT
+
+; The range of %idx is [0, 8) at one call site and [8, 16) at the other, so
+; the bounds checks on it and on the values computed from it fold.
+
+; CHECK-LABEL: define internal i32 @load_checked(
+; CHECK-NOT:     icmp
+; CHECK:         %next = add i32 %idx, 1
+; CHECK-NOT:     icmp
+; CHECK:         ret i32 %v
+
+; NOEXT-LABEL: define internal i32 @load_checked(
+; NOEXT:         %inbounds = icmp ult i32 %idx, 16
+; NOEXT:         %inbounds.next = icmp ult i32 %next, 17
+
+@table = external global [17 x i32]
+
+declare void @abort()
+
+define internal i32 @load_checked(i32 %idx) {
+entry:
+  %inbounds = icmp ult i32 %idx, 16
+  br i1 %inbounds, label %ok, label %fail
+
+ok:
+  %next = add i32 %idx, 1
+  %inbounds.next = icmp ult i32 %next, 17
+  br i1 %inbounds.next, label %load, label %fail
+
+load:
+  %val = getelementptr inbounds [17 x i32], [17 x i32]* @table, i32 0, i32 %next
+  %v = load i32, i32* %val
+  ret i32 %v
+
+fail:
+  call void @abort()
+  unreachable
+}
+
+define i32 @caller_low(i32 %x) {
+  %idx = and i32 %x, 7
+  %r = call i32 @load_checked(i32 %idx)
+  ret i32 %r
+}
+
+define i32 @caller_high(i32 %x) {
+  %low = and i32 %x, 7
+  %idx = add i32 %low, 8
+  %r = call i32 @load_checked(i32 %idx)
+  ret i32 %r
+}
+
+; The range of the return value of @get_small is [0, 256), which folds the
+; comparisons of its callers, including through the truncation.
+
+; CHECK-LABEL: define i1 @use_small(
+; CHECK-NEXT:    %r = call i32 @get_small(i8 %b)
+; CHECK-NEXT:    %t = trunc i32 %r to i16
+; CHECK-NEXT:    ret i1 true
+
+define internal i32 @get_small(i8 %b) {
+  %z = zext i8 %b to i32
+  ret i32 %z
+}
+
+define i1 @use_small(i8 %b) {
+  %r = call i32 @get_small(i8 %b)
+  %c1 = icmp ult i32 %r, 256
+  %t = trunc i32 %r to i16
+  %c2 = icmp sge i16 %t, 0
+  %c = and i1 %c1, %c2
+  ret i1 %c
+}
+
+; The range of %n keeps growing through the recursive call until it is given
+; up on, so the comparison is kept.
+
+; CHECK-LABEL: define internal i32 @recurse(
+; CHECK:         %small = icmp ult i32 %n, 100
+; CHECK-NEXT:    br i1 %small, label %rec, label %done
+
+define internal i32 @recurse(i32 %n) {
+entry:
+  %small = icmp ult i32 %n, 100
+  br i1 %small, label %rec, label %done
+
+rec:
+  %n.1 = add i32 %n, 1
+  %r = call i32 @recurse(i32 %n.1)
+  ret i32 %r
+
+done:
+  ret i32 %n
+}
+
+define i32 @caller_recurse() {
+  %r = call i32 @recurse(i32 0)
+  ret i32 %r
+}
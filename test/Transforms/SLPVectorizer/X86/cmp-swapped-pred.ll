@@ -0,0 +1,86 @@
+; RUN: opt < %s -mtriple=x86_64-unknown -basicaa -slp-vectorizer -S | FileCheck %s
+
+; Check that compares whose predicates are swapped versions of each other are
+; vectorized as a single vector compare, with the operands of the swapped
+; lanes exchanged.
+
+; CHECK-LABEL: @max4(
+; CHECK:         [[A:%.*]] = load <4 x i32>
+; CHECK:         [[B:%.*]] = load <4 x i32>
+; CHECK:         [[C:%.*]] = icmp sgt <4 x i32> [[A]], [[B]]
+; CHECK:         [[S:%.*]] = select <4 x i1> [[C]], <4 x i32> [[A]], <4 x i32> [[B]]
+; CHECK:         store <4 x i32> [[S]]
+
+define void @max4(i32* noalias %r, i32* noalias %a, i32* noalias %b) {
+entry:
+  %a1 = getelementptr inbounds i32, i32* %a, i64 1
+  %a2 = getelementptr inbounds i32, i32* %a, i64 2
+  %a3 = getelementptr inbounds i32, i32* %a, i64 3
+  %b1 = getelementptr inbounds i32, i32* %b, i64 1
+  %b2 = getelementptr inbounds i32, i32* %b, i64 2
+  %b3 = getelementptr inbounds i32, i32* %b, i64 3
+  %r1 = getelementptr inbounds i32, i32* %r, i64 1
+  %r2 = getelementptr inbounds i32, i32* %r, i64 2
+  %r3 = getelementptr inbounds i32, i32* %r, i64 3
+  %va0 = load i32, i32* %a, align 4
+  %va1 = load i32, i32* %a1, align 4
+  %va2 = load i32, i32* %a2, align 4
+  %va3 = load i32, i32* %a3, align 4
+  %vb0 = load i32, i32* %b, align 4
+  %vb1 = load i32, i32* %b1, align 4
+  %vb2 = load i32, i32* %b2, align 4
+  %vb3 = load i32, i32* %b3, align 4
+  %c0 = icmp sgt i32 %va0, %vb0
+  %c1 = icmp slt i32 %vb1, %va1
+  %c2 = icmp sgt i32 %va2, %vb2
+  %c3 = icmp slt i32 %vb3, %va3
+  %s0 = select i1 %c0, i32 %va0, i32 %vb0
+  %s1 = select i1 %c1, i32 %va1, i32 %vb1
+  %s2 = select i1 %c2, i32 %va2, i32 %vb2
+  %s3 = select i1 %c3, i32 %va3, i32 %vb3
+  store i32 %s0, i32* %r, align 4
+  store i32 %s1, i32* %r1, align 4
+  store i32 %s2, i32* %r2, align 4
+  store i32 %s3, i32* %r3, align 4
+  ret void
+}
+
+; Predicates that are neither equal nor swapped are still gathered.
+
+; CHECK-LABEL: @mixed4(
+; CHECK-NOT:     icmp {{.*}} <4 x i32>
+; CHECK:         ret void
+
+define void @mixed4(i32* noalias %r, i32* noalias %a, i32* noalias %b) {
+entry:
+  %a1 = getelementptr inbounds i32, i32* %a, i64 1
+  %a2 = getelementptr inbounds i32, i32* %a, i64 2
+  %a3 = getelementptr inbounds i32, i32* %a, i64 3
+  %b1 = getelementptr inbounds i32, i32* %b, i64 1
+  %b2 = getelementptr inbounds i32, i32* %b, i64 2
+  %b3 = getelementptr inbounds i32, i32* %b, i64 3
+  %r1 = getelementptr inbounds i32, i32* %r, i64 1
+  %r2 = getelementptr inbounds i32, i32* %r, i64 2
+  %r3 = getelementptr inbounds i32, i32* %r, i64 3
+  %va0 = load i32, i32* %a, align 4
+  %va1 = load i32, i32* %a1, align 4
+  %va2 = load i32, i32* %a2, align 4
+  %va3 = load i32, i32* %a3, align 4
+  %vb0 = load i32, i32* %b, align 4
+  %vb1 = load i32, i32* %b1, align 4
+  %vb2 = load i32, i32* %b2, align 4
+  %vb3 = load i32, i32* %b3, align 4
+  %c0 = icmp sgt i32 %va0, %vb0
+  %c1 = icmp sge i32 %va1, %vb1
+  %c2 = icmp sgt i32 %va2, %vb2
+  %c3 = icmp sge i32 %va3, %vb3
+  %s0 = select i1 %c0, i32 %va0, i32 %vb0
+  %s1 = select i1 %c1, i32 %va1, i32 %vb1
+  %s2 = select i1 %c2, i32 %va2, i32 %vb2
+  %s3 = select i1 %c3, i32 %va3, i32 %vb3
+  store i32 %s0, i32* %r, align 4
+  store i32 %s1, i32* %r1, align 4
+  store i32 %s2, i32* %r2, align 4
+  store i32 %s3, i32* %r3, align 4
+  ret void
+}
@@ -0,0 +1,192 @@
+; RUN: opt < %s -mtriple=x86_64-unknown -basicaa -slp-vectorizer -slp-vectorize-non-power-of-2 -S | FileCheck %s --check-prefixes=CHECK,SSE
+; RUN: opt < %s -mtriple=x86_64-unknown -mcpu=corei7-avx -basicaa -slp-vectorizer -slp-vectorize-non-power-of-2 -S | FileCheck %s --check-prefixes=CHECK,AVX
+; RUN: opt < %s -mtriple=x86_64-unknown -mcpu=corei7-avx -basicaa -slp-vectorizer -S | FileCheck %s --check-prefix=DEFAULT
+; RUN: opt < %s -mtriple=x86_64-unknown -basicaa -slp-vectorizer -slp-vectorize-non-power-of-2 -slp-threshold=-1 -S | FileCheck %s --check-prefix=ALT
+
+; Check that bundles of 3 and 6 elements, such as the coordinates of a point
+; or the channels of two RGB pixels, are vectorized as single padded vectors.
+
+%struct.point = type { float, float, float }
+
+; struct point { float x, y, z; };
+; void translate(struct point *restrict p, struct point *restrict q) {
+;   p->x += q->x;
+;   p->y += q->y;
+;   p->z += q->z;
+; }
+
+; CHECK-LABEL: @translate(
+; CHECK:         [[P:%.*]] = load <3 x float>
+; CHECK:         [[Q:%.*]] = load <3 x float>
+; CHECK:         [[ADD:%.*]] = fadd <3 x float> [[P]], [[Q]]
+; CHECK:         store <3 x float> [[ADD]]
+; CHECK-NEXT:    ret void
+; DEFAULT-LABEL: @translate(
+; DEFAULT-NOT:   <3 x float>
+; DEFAULT:       ret void
+
+define void @translate(%struct.point* noalias %p, %struct.point* noalias %q) {
+entry:
+  %px = getelementptr inbounds %struct.point, %struct.point* %p, i64 0, i32 0
+  %py = getelementptr inbounds %struct.point, %struct.point* %p, i64 0, i32 1
+  %pz = getelementptr inbounds %struct.point, %struct.point* %p, i64 0, i32 2
+  %qx = getelementptr inbounds %struct.point, %struct.point* %q, i64 0, i32 0
+  %qy = getelementptr inbounds %struct.point, %struct.point* %q, i64 0, i32 1
+  %qz = getelementptr inbounds %struct.point, %struct.point* %q, i64 0, i32 2
+  %x0 = load float, float* %px, align 4
+  %y0 = load float, float* %py, align 4
+  %z0 = load float, float* %pz, align 4
+  %x1 = load float, float* %qx, align 4
+  %y1 = load float, float* %qy, align 4
+  %z1 = load float, float* %qz, align 4
+  %x = fadd float %x0, %x1
+  %y = fadd float %y0, %y1
+  %z = fadd float %z0, %z1
+  store float %x, float* %px, align 4
+  store float %y, float* %py, align 4
+  store float %z, float* %pz, align 4
+  ret void
+}
+
+; The same with alternating opcodes: p = (p.x + q.x, p.y - q.y, p.z + q.z).
+; The blend of the two <3 x float> results costs as much as is saved, so the
+; bundle is only formed when no gain is required.
+
+; CHECK-LABEL: @addsub(
+; CHECK-NOT:     <3 x float>
+; CHECK:         ret void
+
+; ALT-LABEL: @addsub(
+; ALT:           [[ADD:%.*]] = fadd <3 x float>
+; ALT:           [[SUB:%.*]] = fsub <3 x float>
+; ALT:           [[R:%.*]] = shufflevector <3 x float> [[ADD]], <3 x float> [[SUB]], <3 x i32> <i32 0, i32 4, i32 2>
+; ALT:           store <3 x float> [[R]]
+
+define void @addsub(%struct.point* noalias %p, %struct.point* noalias %q) {
+entry:
+  %px = getelementptr inbounds %struct.point, %struct.point* %p, i64 0, i32 0
+  %py = getelementptr inbounds %struct.point, %struct.point* %p, i64 0, i32 1
+  %pz = getelementptr inbounds %struct.point, %struct.point* %p, i64 0, i32 2
+  %qx = getelementptr inbounds %struct.point, %struct.point* %q, i64 0, i32 0
+  %qy = getelementptr inbounds %struct.point, %struct.point* %q, i64 0, i32 1
+  %qz = getelementptr inbounds %struct.point, %struct.point* %q, i64 0, i32 2
+  %x0 = load float, float* %px, align 4
+  %y0 = load float, float* %py, align 4
+  %z0 = load float, float* %pz, align 4
+  %x1 = load float, float* %qx, align 4
+  %y1 = load float, float* %qy, align 4
+  %z1 = load float, float* %qz, align 4
+  %x = fadd float %x0, %x1
+  %y = fsub float %y0, %y1
+  %z = fadd float %z0, %z1
+  store float %x, float* %px, align 4
+  store float %y, float* %py, align 4
+  store float %z, float* %pz, align 4
+  ret void
+}
+
+; Two RGB pixels scaled by a constant: 6 floats only fit a 256-bit register,
+; where the <6 x float> load and store are a 128-bit and a 64-bit access. With
+; SSE only, the first four channels are vectorized instead.
+
+; SSE-LABEL:     @scale_rgb2(
+; SSE:           fmul <4 x float>
+; SSE-NOT:       <6 x float>
+; SSE:           ret void
+; AVX-LABEL:     @scale_rgb2(
+; AVX:           [[SRC:%.*]] = load <6 x float>
+; AVX:           [[MUL:%.*]] = fmul <6 x float> <float 5.000000e-01, float 5.000000e-01, float 5.000000e-01, float 5.000000e-01, float 5.000000e-01, float 5.000000e-01>, [[SRC]]
+; AVX:           store <6 x float> [[MUL]]
+; AVX-NEXT:      ret void
+
+define void @scale_rgb2(float* noalias %dst, float* noalias %src) {
+entry:
+  %s1 = getelementptr inbounds float, float* %src, i64 1
+  %s2 = getelementptr inbounds float, float* %src, i64 2
+  %s3 = getelementptr inbounds float, float* %src, i64 3
+  %s4 = getelementptr inbounds float, float* %src, i64 4
+  %s5 = getelementptr inbounds float, float* %src, i64 5
+  %d1 = getelementptr inbounds float, float* %dst, i64 1
+  %d2 = getelementptr inbounds float, float* %dst, i64 2
+  %d3 = getelementptr inbounds float, float* %dst, i64 3
+  %d4 = getelementptr inbounds float, float* %dst, i64 4
+  %d5 = getelementptr inbounds float, float* %dst, i64 5
+  %r0 = load float, float* %src, align 4
+  %g0 = load float, float* %s1, align 4
+  %b0 = load float, float* %s2, align 4
+  %r1 = load float, float* %s3, align 4
+  %g1 = load float, float* %s4, align 4
+  %b1 = load float, float* %s5, align 4
+  %r0.s = fmul float %r0, 5.000000e-01
+  %g0.s = fmul float %g0, 5.000000e-01
+  %b0.s = fmul float %b0, 5.000000e-01
+  %r1.s = fmul float %r1, 5.000000e-01
+  %g1.s = fmul float %g1, 5.000000e-01
+  %b1.s = fmul float %b1, 5.000000e-01
+  store float %r0.s, float* %dst, align 4
+  store float %g0.s, float* %d1, align 4
+  store float %b0.s, float* %d2, align 4
+  store float %r1.s, float* %d3, align 4
+  store float %g1.s, float* %d4, align 4
+  store float %b1.s, float* %d5, align 4
+  ret void
+}
+
+; The same channels, multiplied pairwise and returned as a <6 x float> built
+; from the scalar products. The list of six products is tried as one vector
+; before it is split into bundles of four and two.
+
+; SSE-LABEL:     @mul_rgb2_vec(
+; SSE:           fmul <4 x float>
+; SSE:           fmul <2 x float>
+; SSE-NOT:       fmul <6 x float>
+; SSE:           ret <6 x float>
+; AVX-LABEL:     @mul_rgb2_vec(
+; AVX:           [[A:%.*]] = load <6 x float>
+; AVX:           [[B:%.*]] = load <6 x float>
+; AVX:           fmul <6 x float> [[A]], [[B]]
+; AVX-NOT:       fmul
+; AVX:           ret <6 x float>
+; DEFAULT-LABEL: @mul_rgb2_vec(
+; DEFAULT-NOT:   load <6 x float>
+; DEFAULT:       fmul <4 x float>
+; DEFAULT:       fmul <2 x float>
+
+define <6 x float> @mul_rgb2_vec(float* noalias %a, float* noalias %b) {
+entry:
+  %a1p = getelementptr inbounds float, float* %a, i64 1
+  %a2p = getelementptr inbounds float, float* %a, i64 2
+  %a3p = getelementptr inbounds float, float* %a, i64 3
+  %a4p = getelementptr inbounds float, float* %a, i64 4
+  %a5p = getelementptr inbounds float, float* %a, i64 5
+  %b1p = getelementptr inbounds float, float* %b, i64 1
+  %b2p = getelementptr inbounds float, float* %b, i64 2
+  %b3p = getelementptr inbounds float, float* %b, i64 3
+  %b4p = getelementptr inbounds float, float* %b, i64 4
+  %b5p = getelementptr inbounds float, float* %b, i64 5
+  %a0 = load float, float* %a, align 4
+  %a1 = load float, float* %a1p, align 4
+  %a2 = load float, float* %a2p, align 4
+  %a3 = load float, float* %a3p, align 4
+  %a4 = load float, float* %a4p, align 4
+  %a5 = load float, float* %a5p, align 4
+  %b0 = load float, float* %b, align 4
+  %b1 = load float, float* %b1p, align 4
+  %b2 = load float, float* %b2p, align 4
+  %b3 = load float, float* %b3p, align 4
+  %b4 = load float, float* %b4p, align 4
+  %b5 = load float, float* %b5p, align 4
+  %m0 = fmul float %a0, %b0
+  %m1 = fmul float %a1, %b1
+  %m2 = fmul float %a2, %b2
+  %m3 = fmul float %a3, %b3
+  %m4 = fmul float %a4, %b4
+  %m5 = fmul float %a5, %b5
+  %v0 = insertelement <6 x float> undef, float %m0, i32 0
+  %v1 = insertelement <6 x float> %v0, float %m1, i32 1
+  %v2 = insertelement <6 x float> %v1, float %m2, i32 2
+  %v3 = insertelement <6 x float> %v2, float %m3, i32 3
+  %v4 = insertelement <6 x float> %v3, float %m4, i32 4
+  %v5 = insertelement <6 x float> %v4, float %m5, i32 5
+  ret <6 x float> %v5
+}
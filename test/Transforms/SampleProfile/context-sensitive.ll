@@ -0,0 +1,63 @@
+; RUN: opt < %s -sample-profile -sample-profile-file=%S/Inputs/context-sensitive.prof -S | FileCheck %s
+; RUN: opt < %s -passes=sample-profile -sample-profile-file=%S/Inputs/context-sensitive.prof -S | FileCheck %s
+
+; Check that context-sensitive profiles inline the hot context of foo and bar
+; called from main, and that the cold context is the only one left in the
+; profiles of foo and bar. Callees are defined first, so they must be
+; processed after their callers.
+
+; CHECK-LABEL: define void @bar()
+; CHECK-SAME: !prof ![[COLD_ENTRY:[0-9]+]]
+define void @bar() !dbg !11 {
+entry:
+  call void @effect(), !dbg !12
+  ret void, !dbg !12
+}
+
+; CHECK-LABEL: define void @foo()
+; CHECK-SAME: !prof ![[COLD_ENTRY]]
+; CHECK: call void @effect()
+; CHECK: call void @bar()
+define void @foo() !dbg !8 {
+entry:
+  call void @effect(), !dbg !9
+  call void @bar(), !dbg !10
+  ret void, !dbg !10
+}
+
+; The first call to foo is inlined along with its call to bar, the second
+; one is not.
+; CHECK-LABEL: define void @main()
+; CHECK-NEXT: entry:
+; CHECK-NEXT: call void @effect()
+; CHECK-NEXT: call void @effect()
+; CHECK-NEXT: call void @foo()
+; CHECK-NEXT: ret void
+define void @main() !dbg !4 {
+entry:
+  call void @foo(), !dbg !5
+  call void @foo(), !dbg !6
+  ret void, !dbg !6
+}
+
+declare void @effect()
+
+; Both cold contexts are entered 4 times, so foo and bar share the node.
+; CHECK: ![[COLD_ENTRY]] = !{!"function_entry_count", i64 4}
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!2, !3}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "clang", isOptimized: true, runtimeVersion: 0, emissionKind: LineTablesOnly)
+!1 = !DIFile(filename: "context-sensitive.c", directory: ".")
+!2 = !{i32 2, !"Dwarf Version", i32 4}
+!3 = !{i32 2, !"Debug Info Version", i32 3}
+!4 = distinct !DISubprogram(name: "main", scope: !1, file: !1, line: 10, type: !7, isLocal: false, isDefinition: true, scopeLine: 10, isOptimized: true, unit: !0)
+!5 = !DILocation(line: 11, column: 3, scope: !4)
+!6 = !DILocation(line: 12, column: 3, scope: !4)
+!7 = !DISubroutineType(types: !{null})
+!8 = distinct !DISubprogram(name: "foo", scope: !1, file: !1, line: 20, type: !7, isLocal: false, isDefinition: true, scopeLine: 20, isOptimized: true, unit: !0)
+!9 = !DILocation(line: 21, column: 3, scope: !8)
+!10 = !DILocation(line: 22, column: 3, scope: !8)
+!11 = distinct !DISubprogram(name: "bar", scope: !1, file: !1, line: 30, type: !7, isLocal: false, isDefinition: true, scopeLine: 30, isOptimized: true, unit: !0)
+!12 = !DILocation(line: 31, column: 3, scope: !11)
@@ -0,0 +1,90 @@
+; Exercise the cost multiplier that bounds the duplication of repeated
+; non-trivial unswitching.
+;
+; REQUIRES: asserts
+; RUN: opt -passes='loop(unswitch),verify<loops>' -enable-nontrivial-unswitch -unswitch-num-initial-unscaled-candidates=1 -debug-only=simple-loop-unswitch -disable-output < %s 2>&1 | FileCheck %s
+; RUN: opt -passes='loop(unswitch),verify<loops>' -enable-nontrivial-unswitch -unswitch-num-initial-unscaled-candidates=1 -enable-unswitch-cost-multiplier=false -debug-only=simple-loop-unswitch -disable-output < %s 2>&1 | FileCheck %s --check-prefix=NOMULT
+; RUN: opt -passes='loop(unswitch),verify<loops>' -enable-nontrivial-unswitch -unswitch-num-initial-unscaled-candidates=1 -unswitch-threshold=3 -S < %s | FileCheck %s --check-prefix=BUDGET
+
+declare void @a()
+declare void @b()
+declare void @c()
+
+; Unswitching all three candidates could create three clones, two more than the
+; allowance, so the cost of each candidate is scaled by 2^2.
+;
+; CHECK-LABEL: Unswitching loop in test3
+; CHECK-DAG:   Computed cost of {{[0-9]+}} (multiplier: 4) for unswitch candidate: {{.*}}br i1 %c1
+; CHECK-DAG:   Computed cost of {{[0-9]+}} (multiplier: 4) for unswitch candidate: {{.*}}br i1 %c2
+; CHECK-DAG:   Computed cost of {{[0-9]+}} (multiplier: 4) for unswitch candidate: {{.*}}br i1 %c3
+;
+; NOMULT-LABEL: Unswitching loop in test3
+; NOMULT-DAG:   Computed cost of {{[0-9]+}} (multiplier: 1) for unswitch candidate: {{.*}}br i1 %c1
+; NOMULT-DAG:   Computed cost of {{[0-9]+}} (multiplier: 1) for unswitch candidate: {{.*}}br i1 %c2
+; NOMULT-DAG:   Computed cost of {{[0-9]+}} (multiplier: 1) for unswitch candidate: {{.*}}br i1 %c3
+;
+; With a small threshold the scaled costs are out of budget, and the loop is
+; left alone.
+;
+; BUDGET-LABEL: @test3(
+; BUDGET-NEXT:  entry:
+; BUDGET-NEXT:    br label %loop
+define void @test3(i1 %c1, i1 %c2, i1 %c3, i1* %ptr) {
+entry:
+  br label %loop
+
+loop:
+  br i1 %c1, label %do_a, label %check_b
+
+do_a:
+  call void @a()
+  br label %check_b
+
+check_b:
+  br i1 %c2, label %do_b, label %check_c
+
+do_b:
+  call void @b()
+  br label %check_c
+
+check_c:
+  br i1 %c3, label %do_c, label %latch
+
+do_c:
+  call void @c()
+  br label %latch
+
+latch:
+  %v = load volatile i1, i1* %ptr
+  br i1 %v, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+; Functions optimized for size are not unswitched non-trivially.
+;
+; CHECK-LABEL: Unswitching loop in test_optsize
+; CHECK-NOT:   Computed cost
+;
+; BUDGET-LABEL: @test_optsize(
+; BUDGET-NEXT:  entry:
+; BUDGET-NEXT:    br label %loop
+define void @test_optsize(i1 %c1, i1* %ptr) optsize {
+entry:
+  br label %loop
+
+loop:
+  br i1 %c1, label %do_a, label %latch
+
+do_a:
+  call void @a()
+  br label %latch
+
+latch:
+  %v = load volatile i1, i1* %ptr
+  br i1 %v, label %loop, label %exit
+
+exit:
+  ret void
+}
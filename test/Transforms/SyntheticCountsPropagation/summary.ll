@@ -0,0 +1,31 @@
+; RUN: opt -passes=synthetic-counts-propagation -S < %s | FileCheck %s
+; RUN: opt -passes=synthetic-counts-propagation -synthetic-counts-summary=false -S < %s | FileCheck %s --check-prefix=NOSUMMARY
+
+; Check that a profile summary of the synthetic counts is attached to the
+; module. @foo gets the initial count and @bar gets its count from the two
+; calls in @foo.
+
+; CHECK: !llvm.module.flags = !{![[FLAG:[0-9]+]]}
+; CHECK: ![[FLAG]] = !{i32 1, !"ProfileSummary", ![[SUMMARY:[0-9]+]]}
+; CHECK: ![[SUMMARY]] = !{![[FORMAT:[0-9]+]], ![[TOTAL:[0-9]+]], ![[MAX:[0-9]+]], ![[MAXINTERNAL:[0-9]+]], ![[MAXFUNCTION:[0-9]+]], ![[NUMCOUNTS:[0-9]+]], ![[NUMFUNCTIONS:[0-9]+]], !{{[0-9]+}}}
+; CHECK: ![[FORMAT]] = !{!"ProfileFormat", !"SyntheticProfile"}
+; CHECK: ![[TOTAL]] = !{!"TotalCount", i64 30}
+; CHECK: ![[MAX]] = !{!"MaxCount", i64 20}
+; CHECK: ![[MAXINTERNAL]] = !{!"MaxInternalCount", i64 0}
+; CHECK: ![[MAXFUNCTION]] = !{!"MaxFunctionCount", i64 20}
+; CHECK: ![[NUMCOUNTS]] = !{!"NumCounts", i64 2}
+; CHECK: ![[NUMFUNCTIONS]] = !{!"NumFunctions", i64 2}
+; CHECK: !{!"synthetic_function_entry_count", i64 10}
+; CHECK: !{!"synthetic_function_entry_count", i64 20}
+
+; NOSUMMARY-NOT: ProfileSummary
+
+define void @foo() {
+  call void @bar()
+  call void @bar()
+  ret void
+}
+
+define internal void @bar() {
+  ret void
+}
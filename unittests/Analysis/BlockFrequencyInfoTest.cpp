@@ -8,12 +8,14 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/BlockFrequencyUpdater.h"
 #include "llvm/Analysis/BranchProbabilityInfo.h"
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/AsmParser/Parser.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Dominators.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Support/DataTypes.h"
@@ -89,5 +91,52 @@ TEST_F(BlockFrequencyInfoTest, Basic) {
   EXPECT_EQ(BFI.getBlockFreq(BB3).getFrequency(), BB3Freq);
 }
 
+TEST_F(BlockFrequencyInfoTest, IncrementalUpdates) {
+  auto M = makeLLVMModule();
+  Function *F = M->getFunction("f");
+
+  BlockFrequencyInfo BFI = buildBFI(*F);
+  BasicBlock &BB0 = F->getEntryBlock();
+  BasicBlock *BB1 = BB0.getTerminator()->getSuccessor(0);
+  BasicBlock *BB2 = BB0.getTerminator()->getSuccessor(1);
+  BasicBlock *BB3 = BB1->getSingleSuccessor();
+  BlockFrequencyUpdater BFU(BFI, *BPI);
+
+  // Make the branch in BB0 lopsided.
+  SmallVector<BranchProbability, 2> Probs = {BranchProbability(3, 4),
+                                             BranchProbability(1, 4)};
+  BPI->setEdgeProbability(&BB0, Probs);
+  uint64_t BB0Freq = BFI.getBlockFreq(&BB0).getFrequency();
+  BFI.setBlockFreq(BB1, BFU.getEdgeFreq(&BB0, BB1).getFrequency());
+  BFI.setBlockFreq(BB2, BFU.getEdgeFreq(&BB0, BB2).getFrequency());
+  uint64_t BB1Freq = BFI.getBlockFreq(BB1).getFrequency();
+  uint64_t BB2Freq = BFI.getBlockFreq(BB2).getFrequency();
+  EXPECT_GT(BB1Freq, BB2Freq);
+
+  // Split the edge BB0 -> BB1.
+  BasicBlock *Split = BasicBlock::Create(C, "split", F, BB1);
+  BranchInst::Create(BB1, Split);
+  BB0.getTerminator()->setSuccessor(0, Split);
+  BFU.splitEdge(&BB0, Split);
+  EXPECT_EQ(BFI.getBlockFreq(Split).getFrequency(), BB1Freq);
+  EXPECT_EQ(BPI->getEdgeProbability(&BB0, Split), BranchProbability(3, 4));
+
+  // Redirect BB0 -> BB2 to BB3; all the flow through BB2 moves to BB3.
+  uint64_t BB3Freq = BFI.getBlockFreq(BB3).getFrequency();
+  BB0.getTerminator()->setSuccessor(1, BB3);
+  BFU.redirectEdge(&BB0, 1, BB2);
+  EXPECT_EQ(BFI.getBlockFreq(BB2).getFrequency(), 0u);
+  EXPECT_EQ(BFI.getBlockFreq(BB3).getFrequency(), BB3Freq + BB2Freq);
+
+  // Clone BB0, moving a quarter of its frequency to the clone.
+  BasicBlock *Clone = BasicBlock::Create(C, "clone", F);
+  Clone->getInstList().push_back(BB0.getTerminator()->clone());
+  BFU.cloneBlock(&BB0, Clone, BlockFrequency(BB0Freq / 4));
+  EXPECT_EQ(BFI.getBlockFreq(Clone).getFrequency(), BB0Freq / 4);
+  EXPECT_EQ(BFI.getBlockFreq(&BB0).getFrequency(), BB0Freq - BB0Freq / 4);
+  EXPECT_EQ(BPI->getEdgeProbability(Clone, 0u), BranchProbability(3, 4));
+  EXPECT_EQ(BPI->getEdgeProbability(Clone, 1u), BranchProbability(1, 4));
+}
+
 } // end anonymous namespace
 } // end namespace llvm
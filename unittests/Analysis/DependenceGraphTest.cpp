@@ -0,0 +1,93 @@
+//===- DependenceGraphTest.cpp - LoopDependenceGraph unit tests -----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/Analysis/BasicAliasAnalysis.h"
+#include "llvm/Analysis/DependenceAnalysis.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/SourceMgr.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+
+namespace {
+
+static Instruction *getInstructionByName(Function &F, StringRef Name) {
+  for (Instruction &I : instructions(F))
+    if (I.getName() == Name)
+      return &I;
+  llvm_unreachable("Expected to find instruction!");
+}
+
+TEST(DependenceGraphTest, FiltersIndependentPairs) {
+  LLVMContext C;
+  SMDiagnostic Err;
+  std::unique_ptr<Module> M = parseAssemblyString(
+      "define void @f(i32* noalias %a, i32* noalias %b, i64 %n) {\n"
+      "entry:\n"
+      "  br label %loop\n"
+      "loop:\n"
+      "  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]\n"
+      "  %a.i = getelementptr inbounds i32, i32* %a, i64 %i\n"
+      "  %b.i = getelementptr inbounds i32, i32* %b, i64 %i\n"
+      "  %i.next = add nuw nsw i64 %i, 1\n"
+      "  %a.next = getelementptr inbounds i32, i32* %a, i64 %i.next\n"
+      "  %ld.a = load i32, i32* %a.i\n"
+      "  %ld.b = load i32, i32* %b.i\n"
+      "  store i32 %ld.b, i32* %a.next\n"
+      "  store i32 %ld.a, i32* %b.i\n"
+      "  %cmp = icmp slt i64 %i.next, %n\n"
+      "  br i1 %cmp, label %loop, label %exit\n"
+      "exit:\n"
+      "  ret void\n"
+      "}\n",
+      Err, C);
+  ASSERT_TRUE(M);
+
+  Function &F = *M->getFunction("f");
+  TargetLibraryInfoImpl TLII;
+  TargetLibraryInfo TLI(TLII);
+  AssumptionCache AC(F);
+  DominatorTree DT(F);
+  LoopInfo LI(DT);
+  ScalarEvolution SE(F, TLI, AC, DT, LI);
+  AAResults AA(TLI);
+  BasicAAResult BAA(M->getDataLayout(), F, TLI, AC, &DT);
+  AA.addAAResult(BAA);
+  DependenceInfo DI(&F, &AA, &SE, &LI);
+
+  Loop *L = *LI.begin();
+  LoopDependenceGraph DG(DI, *L);
+
+  Instruction *LdA = getInstructionByName(F, "ld.a");
+  Instruction *LdB = getInstructionByName(F, "ld.b");
+  Instruction *StA = &*std::next(LdB->getIterator());
+  Instruction *StB = &*std::next(StA->getIterator());
+
+  // Loads never depend on each other, and %a and %b are distinct objects.
+  EXPECT_FALSE(DG.mayDepend(LdA, LdB));
+  EXPECT_FALSE(DG.mayDepend(LdA, StB));
+  EXPECT_EQ(nullptr, DG.depends(LdA, StB));
+  EXPECT_TRUE(DG.mayDepend(LdA, StA));
+
+  // The flow dependence through %a is carried by the loop.
+  auto D = DG.depends(StA, LdA);
+  ASSERT_NE(nullptr, D);
+  EXPECT_TRUE(D->isFlow());
+}
+
+} // end anonymous namespace
@@ -391,6 +391,34 @@ TEST(LazyCallGraphTest, BasicGraphFormation) {
   EXPECT_EQ(J, std::next(CG.postorder_ref_scc_begin(), 4));
 }
 
+TEST(LazyCallGraphTest, RefSCCWaves) {
+  LLVMContext Context;
+  std::unique_ptr<Module> M = parseAssembly(Context, DiamondOfTriangles);
+  LazyCallGraph CG = buildCG(*M);
+
+  SmallVector<SmallVector<LazyCallGraph::RefSCC *, 4>, 4> Waves;
+  CG.buildRefSCCWaves(Waves);
+
+  // The 'd' RefSCC is the only leaf, the 'b' and 'c' RefSCCs only depend on
+  // it and not on each other, and 'a' depends on both of them.
+  auto J = CG.postorder_ref_scc_begin();
+  LazyCallGraph::RefSCC &D = *J++;
+  LazyCallGraph::RefSCC &C = *J++;
+  LazyCallGraph::RefSCC &B = *J++;
+  LazyCallGraph::RefSCC &A = *J++;
+  EXPECT_EQ(CG.postorder_ref_scc_end(), J);
+
+  ASSERT_EQ(3u, Waves.size());
+  ASSERT_EQ(1u, Waves[0].size());
+  EXPECT_EQ(&D, Waves[0][0]);
+  // Independent RefSCCs stay in post-order within their wave.
+  ASSERT_EQ(2u, Waves[1].size());
+  EXPECT_EQ(&C, Waves[1][0]);
+  EXPECT_EQ(&B, Waves[1][1]);
+  ASSERT_EQ(1u, Waves[2].size());
+  EXPECT_EQ(&A, Waves[2][0]);
+}
+
 static Function &lookupFunction(Module &M, StringRef Name) {
   for (Function &F : M)
     if (F.getName() == Name)
@@ -187,6 +187,52 @@ TEST_F(SampleProfTest, roundtrip_compact_binary_profile) {
   testRoundTrip(SampleProfileFormat::SPF_Compact_Binary);
 }
 
+TEST_F(SampleProfTest, context_sensitive_text_profile) {
+  StringRef Text = "[main:3 @ _Z3fooi:2.1 @ _Z3bari]:100:10\n"
+                   " 1: 100\n"
+                   "[main]:50:50\n"
+                   " 3: 50\n";
+  auto Profile = MemoryBuffer::getMemBufferCopy(Text);
+  readProfile(Profile);
+  ASSERT_TRUE(NoError(Reader->read()));
+  ASSERT_TRUE(Reader->profileIsCS());
+
+  StringMap<FunctionSamples> &ReadProfiles = Reader->getProfiles();
+  ASSERT_EQ(2u, ReadProfiles.size());
+  FunctionSamples &BarSamples =
+      ReadProfiles["main:3 @ _Z3fooi:2.1 @ _Z3bari"];
+  ASSERT_EQ(StringRef("_Z3bari"), BarSamples.getName());
+  ASSERT_EQ(100u, BarSamples.getTotalSamples());
+  ASSERT_TRUE(BarSamples.getContext().hasCallers());
+  ASSERT_FALSE(ReadProfiles["main"].getContext().hasCallers());
+
+  SampleContextFrames Frames;
+  ASSERT_TRUE(SampleContext::decodeContextString(
+      BarSamples.getContext().getNameWithContext(), Frames));
+  ASSERT_EQ(3u, Frames.size());
+  ASSERT_EQ(StringRef("main"), Frames[0].FuncName);
+  ASSERT_EQ(3u, Frames[0].Location.LineOffset);
+  ASSERT_EQ(StringRef("_Z3fooi"), Frames[1].FuncName);
+  ASSERT_EQ(2u, Frames[1].Location.LineOffset);
+  ASSERT_EQ(1u, Frames[1].Location.Discriminator);
+  ASSERT_EQ(StringRef("_Z3bari"), Frames[2].FuncName);
+  ASSERT_FALSE(SampleContext::decodeContextString("main @ _Z3fooi", Frames));
+
+  // The text format keeps the contexts, the binary formats reject them.
+  createWriter(SPF_Text);
+  ASSERT_TRUE(NoError(Writer->write(ReadProfiles)));
+  Writer->getOutputStream().flush();
+  ASSERT_NE(std::string::npos,
+            Data.find("[main:3 @ _Z3fooi:2.1 @ _Z3bari]:100:10\n"));
+  ASSERT_NE(std::string::npos, Data.find("[main]:50:50\n"));
+
+  std::string BinaryData;
+  OS.reset(new raw_string_ostream(BinaryData));
+  createWriter(SPF_Binary);
+  ASSERT_EQ(std::error_code(sampleprof_error::unsupported_writing_format),
+            Writer->write(ReadProfiles));
+}
+
 TEST_F(SampleProfTest, sample_overflow_saturation) {
   const uint64_t Max = std::numeric_limits<uint64_t>::max();
   sampleprof_error Result;